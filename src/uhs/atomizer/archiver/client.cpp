@@ -8,6 +8,7 @@
 #include "uhs/atomizer/atomizer/format.hpp"
 #include "util/serialization/format.hpp"
 
+#include <algorithm>
 #include <utility>
 
 namespace cbdc::archiver {
@@ -29,6 +30,78 @@ namespace cbdc::archiver {
         }
 
         m_logger->info("Waiting for archiver response...");
+        auto resp = receive_block();
+        if(!resp.has_value()) {
+            return std::nullopt;
+        }
+
+        return resp.value();
+    }
+
+    auto client::get_blocks(
+        uint64_t start,
+        uint64_t end,
+        size_t max_inflight,
+        const std::function<bool(cbdc::atomizer::block&&)>& apply_fn)
+        -> uint64_t {
+        m_logger->info("Requesting blocks",
+                       start,
+                       "to",
+                       end - 1,
+                       "from archiver...");
+        auto next_request = start;
+        auto next_apply = start;
+        size_t inflight{0};
+        auto stopped = false;
+        while(next_apply < end || inflight > 0) {
+            while(!stopped && next_request < end
+                  && inflight < std::max(max_inflight, size_t{1})) {
+                if(!m_sock.send(next_request)) {
+                    m_logger->error("Error requesting block from archiver.");
+                    stopped = true;
+                    break;
+                }
+                next_request++;
+                inflight++;
+            }
+
+            if(inflight == 0) {
+                break;
+            }
+
+            auto resp = receive_block();
+            if(!resp.has_value()) {
+                // The responses still outstanding can no longer be matched
+                // with their requests
+                if(!m_sock.reconnect()) {
+                    m_logger->error("Failed to reconnect to archiver.");
+                }
+                break;
+            }
+            inflight--;
+
+            if(stopped) {
+                continue;
+            }
+
+            auto& blk = resp.value();
+            if(!blk.has_value() || blk->m_height != next_apply) {
+                m_logger->info("Archiver does not have block", next_apply);
+                stopped = true;
+                continue;
+            }
+
+            if(!apply_fn(std::move(blk.value()))) {
+                stopped = true;
+                continue;
+            }
+            next_apply++;
+        }
+
+        return next_apply;
+    }
+
+    auto client::receive_block() -> std::optional<response> {
         cbdc::buffer resp_pkt;
         if(!m_sock.receive(resp_pkt)) {
             m_logger->error("Error receiving block from archiver.");
@@ -41,6 +114,6 @@ namespace cbdc::archiver {
             return std::nullopt;
         }
 
-        return resp.value();
+        return resp;
     }
 }
@@ -10,6 +10,8 @@
 #include "util/common/logging.hpp"
 #include "util/network/tcp_socket.hpp"
 
+#include <functional>
+
 namespace cbdc::archiver {
     /// Height of the block to fetch from the archiver.
     using request = uint64_t;
@@ -40,7 +42,32 @@ namespace cbdc::archiver {
         auto get_block(uint64_t height)
             -> std::optional<cbdc::atomizer::block>;
 
+        /// \brief Retrieves the blocks in a range of heights from the
+        ///        archiver, in height order.
+        ///
+        /// Pipelines the requests over the connection, keeping up to the
+        /// given number outstanding, so that the archiver looks up and sends
+        /// later blocks while earlier ones are applied. The archiver answers
+        /// requests from a connection in order. Stops requesting blocks once
+        /// the archiver does not have a block or the callback returns false,
+        /// and discards the responses to the requests still outstanding.
+        /// \param start height of the first block to retrieve.
+        /// \param end height after the last block to retrieve.
+        /// \param max_inflight maximum number of outstanding requests.
+        /// \param apply_fn function to call with each retrieved block. Returns
+        ///                 false to stop retrieving blocks.
+        /// \return height of the first block not passed to the callback, or
+        ///         end if all blocks in the range were.
+        auto get_blocks(
+            uint64_t start,
+            uint64_t end,
+            size_t max_inflight,
+            const std::function<bool(cbdc::atomizer::block&&)>& apply_fn)
+            -> uint64_t;
+
       private:
+        [[nodiscard]] auto receive_block() -> std::optional<response>;
+
         network::tcp_socket m_sock;
         network::endpoint_t m_endpoint;
         std::shared_ptr<logging::log> m_logger;
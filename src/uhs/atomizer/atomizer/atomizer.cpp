@@ -9,6 +9,10 @@
 #include "util/common/config.hpp"
 #include "util/serialization/buffer_serializer.hpp"
 #include "util/serialization/format.hpp"
+#include "util/serialization/util.hpp"
+
+#include <functional>
+#include <utility>
 
 namespace cbdc::atomizer {
     auto atomizer::make_block()
@@ -16,29 +20,55 @@ namespace cbdc::atomizer {
         block blk;
 
         blk.m_transactions.swap(m_complete_txs);
+        m_complete_bytes = 0;
 
         m_best_height++;
 
+        // The generation holding the oldest height offset occupies the ring
+        // slot for the new best height. Report the transactions notified at
+        // that height which are still incomplete and discard their
+        // attestations from that height. Destroying transactions left with
+        // no attestations is left to the background reclaimer so block
+        // creation does not pay for it.
+        auto& oldest = generation(0);
         std::vector<cbdc::watchtower::tx_error> errs;
-        for(auto&& tx : m_txs[m_spent_cache_depth]) {
-            errs.push_back(cbdc::watchtower::tx_error{
-                tx.first.m_id,
-                cbdc::watchtower::tx_error_incomplete{}});
+        if(!oldest.empty()) {
+            const auto evicted_height
+                = m_best_height - m_spent_cache_depth - 1;
+            auto evicted = std::vector<decltype(m_pending)::node_type>();
+            for(const auto& tx_id : oldest) {
+                auto it = m_pending.find(tx_id);
+                if(it == m_pending.end()
+                   || !it->second.evict(evicted_height)) {
+                    continue;
+                }
+                errs.push_back(cbdc::watchtower::tx_error{
+                    tx_id,
+                    cbdc::watchtower::tx_error_incomplete{}});
+                if(it->second.empty()) {
+                    evicted.push_back(m_pending.extract(it));
+                }
+            }
+            oldest.clear();
+            if(!evicted.empty()) {
+                m_reclaimer.retire(std::move(evicted));
+            }
         }
 
-        for(size_t i = m_spent_cache_depth; i > 0; i--) {
-            m_spent[i] = std::move(m_spent[i - 1]);
-            m_txs[i] = std::move(m_txs[i - 1]);
+        // Evict the UHS IDs spent at the height that just fell out of the
+        // STXO cache range.
+        if(m_best_height > m_spent_cache_depth) {
+            const auto min_height = m_best_height - m_spent_cache_depth;
+            for(auto& part : m_spent) {
+                part.evict_below(min_height);
+            }
+            m_spent_journal.erase(m_spent_journal.begin(),
+                                  m_spent_journal.lower_bound(min_height));
         }
 
-        m_spent[0].clear();
-        m_txs[0].clear();
-        static constexpr auto initial_spent_cache_size = 500000;
-        m_spent[0].reserve(initial_spent_cache_size);
-
         blk.m_height = m_best_height;
 
-        return {blk, errs};
+        return {std::move(blk), std::move(errs)};
     }
 
     auto atomizer::insert(const uint64_t block_height,
@@ -52,82 +82,43 @@ namespace cbdc::atomizer {
             return offset_err;
         }
 
-        // Search the incomplete transactions vector for this notification's
-        // block height offset. Note, we might be able to defer this insertion
-        // until after we've checked if the transaction is complete.
-        auto it = m_txs[height_offset].find(tx);
-        if(it == m_txs[height_offset].end()) {
-            // If we did not already receive a notification of this transaction
-            // for its height offset, insert the transaction and its
-            // attestations into the pending vector.
-            it = m_txs[height_offset]
-                     .insert({std::move(tx), std::move(attestations)})
-                     .first;
-        } else {
-            // Otherwise merge the new set of attestations with the existing
-            // set.
-            it->second.insert(attestations.begin(), attestations.end());
-        }
-
-        std::unordered_set<uint32_t> total_attestations;
-        size_t oldest_attestation{0};
-        std::map<size_t, decltype(m_txs)::value_type::const_iterator> tx_its;
-
-        // Iterate over each height offset in the incomplete transactions
-        // vector to accumulate the sets of attestations received for any
-        // offset in our cache.
-        for(size_t offset = 0; offset <= m_spent_cache_depth; offset++) {
-            const auto& tx_map = m_txs[offset];
-
-            // Check if we received a notification of this TX for the given
-            // height offset.
-            const auto tx_it = tx_map.find(it->first);
-            if(tx_it != tx_map.end()) {
-                // Merge the attestations from this offset with the full set of
-                // attestations so far.
-                total_attestations.insert(tx_it->second.begin(),
-                                          tx_it->second.end());
-
-                // Keep track of the oldest height offset that we're using
-                // an attestation from.
-                oldest_attestation = offset;
-
-                // Store the iterator to the transaction in the incomplete TXs
-                // vector for the given height offset so we can quickly access
-                // it later.
-                tx_its.emplace(offset, tx_it);
-            }
+        // Find the pending record for this transaction, creating it if this
+        // is the first notification we received.
+        const auto tx_id = tx.m_id;
+        auto it = m_pending.find(tx_id);
+        if(it == m_pending.end()) {
+            it = m_pending.emplace(tx_id, pending_tx(std::move(tx))).first;
+        }
+        auto& ptx = it->second;
+
+        // Merge the attestations into the bitmap for this block height. If
+        // this is the first notification at the height, remember the
+        // transaction so its attestations can be discarded once the height
+        // leaves the cache.
+        if(ptx.add(block_height, attestations)) {
+            generation(height_offset).push_back(tx_id);
         }
-
-        const auto& txit = it->first;
-
-        auto cache_check_range = oldest_attestation;
 
         // Check whether this transaction now has attestations for each of its
         // inputs.
-        if(total_attestations.size() == txit.m_inputs.size()) {
-            auto err_set = check_stxo_cache(txit, cache_check_range);
-            if(err_set) {
-                return err_set;
-            }
+        if(!ptx.complete()) {
+            return std::nullopt;
+        }
 
-            add_tx_to_stxo_cache(txit);
-
-            // For each of the incomplete transaction notifications we
-            // recovered while accumulating attestations, either extract the TX
-            // from the oldest notification and move it to the complete TXs
-            // vector, or erase the TX notification.
-            for(const auto& pending_offset : tx_its) {
-                if(pending_offset.first == oldest_attestation) {
-                    auto tx_ext = m_txs[pending_offset.first].extract(
-                        pending_offset.second);
-                    m_complete_txs.push_back(std::move(tx_ext.key()));
-                } else {
-                    m_txs[pending_offset.first].erase(pending_offset.second);
-                }
-            }
+        // Check the STXO cache back to the oldest height we're using an
+        // attestation from.
+        const auto cache_check_range
+            = get_notification_offset(ptx.oldest_height());
+        auto err_set = check_stxo_cache(ptx.tx(), cache_check_range);
+        if(err_set) {
+            return err_set;
         }
 
+        add_tx_to_stxo_cache(ptx.tx());
+
+        add_complete_tx(ptx.take_tx());
+        m_pending.erase(it);
+
         return std::nullopt;
     }
 
@@ -150,25 +141,181 @@ namespace cbdc::atomizer {
 
         add_tx_to_stxo_cache(tx);
 
-        m_complete_txs.push_back(std::move(tx));
+        add_complete_tx(std::move(tx));
 
         return std::nullopt;
     }
 
+    auto atomizer::insert_complete_batch(
+        std::vector<aggregate_tx_notification>&& txs,
+        size_t n_threads) -> std::vector<cbdc::watchtower::tx_error> {
+        auto errs = std::vector<cbdc::watchtower::tx_error>();
+        n_threads = std::min(n_threads, m_spent.size());
+        if(n_threads < 2 || txs.size() < min_parallel_batch) {
+            for(auto&& msg : txs) {
+                auto err = insert_complete(msg.m_oldest_attestation,
+                                           std::move(msg.m_tx));
+                if(err.has_value()) {
+                    errs.push_back(std::move(*err));
+                }
+            }
+            return errs;
+        }
+
+        // Runs the given function once for each worker index on the
+        // persistent pool, using the calling thread as one of the workers.
+        if(!m_workers || m_workers->size() != n_threads) {
+            m_workers = std::make_unique<worker_pool>(n_threads);
+        }
+        auto run_workers = [&](const std::function<void(size_t)>& fn) {
+            m_workers->run(n_threads, fn);
+        };
+
+        // Lay out the inputs of all transactions within the STXO cache range
+        // in one array so each worker can record results for the inputs in
+        // its partitions without synchronization.
+        static constexpr uint8_t input_spent = 1;
+        static constexpr uint8_t input_contended = 2;
+        auto tx_errs = std::vector<std::optional<cbdc::watchtower::tx_error>>(
+            txs.size());
+        auto input_offsets = std::vector<size_t>(txs.size() + 1);
+        for(size_t i = 0; i < txs.size(); i++) {
+            const auto& msg = txs[i];
+            tx_errs[i] = check_notification_offset(
+                get_notification_offset(msg.m_oldest_attestation),
+                msg.m_tx);
+            input_offsets[i + 1] = input_offsets[i];
+            if(!tx_errs[i].has_value()) {
+                input_offsets[i + 1] += msg.m_tx.m_inputs.size();
+            }
+        }
+        auto input_flags = std::vector<uint8_t>(input_offsets.back());
+
+        // Check each input against the STXO cache as of the start of the
+        // batch. Also flag inputs spent by more than one transaction in the
+        // batch, since their outcome depends on which transactions earlier
+        // in the batch are accepted.
+        run_workers([&](size_t worker) {
+            auto first_use
+                = std::unordered_map<hash_t, size_t, hashing::null>();
+            first_use.reserve(input_flags.size() / n_threads);
+            for(size_t i = 0; i < txs.size(); i++) {
+                if(tx_errs[i].has_value()) {
+                    continue;
+                }
+                const auto& msg = txs[i];
+                const auto cache_check_range
+                    = get_notification_offset(msg.m_oldest_attestation);
+                for(size_t j = 0; j < msg.m_tx.m_inputs.size(); j++) {
+                    const auto& inp = msg.m_tx.m_inputs[j];
+                    if(spent_partition(inp) % n_threads != worker) {
+                        continue;
+                    }
+                    const auto idx = input_offsets[i] + j;
+                    if(is_spent(inp, cache_check_range)) {
+                        input_flags[idx] |= input_spent;
+                    }
+                    auto [it, inserted] = first_use.emplace(inp, idx);
+                    if(!inserted && it->second < input_offsets[i]) {
+                        input_flags[it->second] |= input_contended;
+                        input_flags[idx] |= input_contended;
+                    }
+                }
+            }
+        });
+
+        // Resolve conflicts between transactions in the batch in order. Only
+        // the contended inputs of accepted transactions need to be tracked.
+        auto batch_spent = std::unordered_set<hash_t, hashing::null>();
+        for(size_t i = 0; i < txs.size(); i++) {
+            if(tx_errs[i].has_value()) {
+                continue;
+            }
+            const auto& tx = txs[i].m_tx;
+            auto err_set = std::unordered_set<hash_t, hashing::null>();
+            for(size_t j = 0; j < tx.m_inputs.size(); j++) {
+                const auto flags = input_flags[input_offsets[i] + j];
+                const auto& inp = tx.m_inputs[j];
+                if((flags & input_spent) != 0
+                   || ((flags & input_contended) != 0
+                       && batch_spent.find(inp) != batch_spent.end())) {
+                    err_set.insert(inp);
+                }
+            }
+            if(!err_set.empty()) {
+                tx_errs[i] = cbdc::watchtower::tx_error{
+                    tx.m_id,
+                    cbdc::watchtower::tx_error_inputs_spent{
+                        std::move(err_set)}};
+                continue;
+            }
+            for(size_t j = 0; j < tx.m_inputs.size(); j++) {
+                if((input_flags[input_offsets[i] + j] & input_contended)
+                   != 0) {
+                    batch_spent.insert(tx.m_inputs[j]);
+                }
+            }
+        }
+
+        // Spend the inputs of the accepted transactions, with each worker
+        // updating only its own partitions.
+        run_workers([&](size_t worker) {
+            for(size_t i = 0; i < txs.size(); i++) {
+                if(tx_errs[i].has_value()) {
+                    continue;
+                }
+                for(const auto& inp : txs[i].m_tx.m_inputs) {
+                    const auto part = spent_partition(inp);
+                    if(part % n_threads == worker) {
+                        m_spent[part].insert(inp, m_best_height);
+                    }
+                }
+            }
+        });
+
+        auto& journal = current_journal();
+        for(size_t i = 0; i < txs.size(); i++) {
+            if(tx_errs[i].has_value()) {
+                errs.push_back(std::move(*tx_errs[i]));
+            } else {
+                const auto& inputs = txs[i].m_tx.m_inputs;
+                journal.insert(journal.end(), inputs.begin(), inputs.end());
+                add_complete_tx(std::move(txs[i].m_tx));
+            }
+        }
+
+        return errs;
+    }
+
     auto atomizer::pending_transactions() const -> size_t {
         return m_complete_txs.size();
     }
 
+    auto atomizer::pending_bytes() const -> size_t {
+        return m_complete_bytes;
+    }
+
     auto atomizer::height() const -> uint64_t {
         return m_best_height;
     }
 
     atomizer::atomizer(const uint64_t best_height,
-                       const size_t stxo_cache_depth)
+                       const size_t stxo_cache_depth,
+                       const size_t stxo_filter_capacity)
         : m_best_height(best_height),
-          m_spent_cache_depth(stxo_cache_depth) {
+          m_spent_cache_depth(stxo_cache_depth),
+          m_spent_filter_capacity((stxo_filter_capacity + stxo_partitions - 1)
+                                  / stxo_partitions) {
         m_txs.resize(stxo_cache_depth + 1);
-        m_spent.resize(stxo_cache_depth + 1);
+        m_spent.resize(stxo_partitions, stxo_cache(m_spent_filter_capacity));
+    }
+
+    auto atomizer::stxo_filter_stats() const -> stxo_cache::filter_stats {
+        auto stats = stxo_cache::filter_stats();
+        for(const auto& part : m_spent) {
+            stats += part.stats();
+        }
+        return stats;
     }
 
     auto atomizer::serialize() -> cbdc::buffer {
@@ -176,24 +323,84 @@ namespace cbdc::atomizer {
         auto ser = cbdc::buffer_serializer(buf);
 
         ser << static_cast<uint64_t>(m_spent_cache_depth) << m_best_height
-            << m_complete_txs << m_spent << m_txs;
+            << m_complete_txs << m_spent << m_pending << m_txs;
 
         return buf;
     }
 
     void atomizer::deserialize(cbdc::serializer& buf) {
+        m_spent_journal.clear();
+
         m_complete_txs.clear();
 
+        m_pending.clear();
+
         m_spent.clear();
 
         m_txs.clear();
 
         buf >> m_spent_cache_depth >> m_best_height >> m_complete_txs
-            >> m_spent >> m_txs;
+            >> m_spent >> m_pending >> m_txs;
+        for(auto& part : m_spent) {
+            part.set_filter_capacity(m_spent_filter_capacity);
+        }
+
+        recount_complete_bytes();
+    }
+
+    auto atomizer::serialize_delta() const -> cbdc::buffer {
+        auto buf = cbdc::buffer();
+        auto ser = cbdc::buffer_serializer(buf);
+
+        ser << static_cast<uint64_t>(m_spent_cache_depth) << m_best_height
+            << m_complete_txs << m_spent_journal << m_pending << m_txs;
+
+        return buf;
+    }
+
+    void atomizer::apply_delta(cbdc::serializer& buf) {
+        auto journal = decltype(m_spent_journal)();
+
+        m_complete_txs.clear();
+
+        m_pending.clear();
+
+        m_txs.clear();
+
+        if(!(buf >> m_spent_cache_depth >> m_best_height >> m_complete_txs
+             >> journal >> m_pending >> m_txs)) {
+            return;
+        }
+
+        recount_complete_bytes();
+
+        // Evict the heights that left the cache range since the delta
+        // started, then replay the spends recorded in the delta that are
+        // still in range.
+        auto min_height = uint64_t();
+        if(m_best_height > m_spent_cache_depth) {
+            min_height = m_best_height - m_spent_cache_depth;
+            for(auto& part : m_spent) {
+                part.evict_below(min_height);
+            }
+        }
+        for(auto it = journal.lower_bound(min_height); it != journal.end();
+            it++) {
+            for(const auto& uhs_id : it->second) {
+                m_spent[spent_partition(uhs_id)].insert(uhs_id, it->first);
+            }
+        }
+
+        m_spent_journal.clear();
+    }
+
+    void atomizer::clear_delta() {
+        m_spent_journal.clear();
     }
 
     auto atomizer::operator==(const atomizer& other) const -> bool {
-        return m_txs == other.m_txs && m_complete_txs == other.m_complete_txs
+        return m_pending == other.m_pending && m_txs == other.m_txs
+            && m_complete_txs == other.m_complete_txs
             && m_spent == other.m_spent && m_best_height == other.m_best_height
             && m_spent_cache_depth == other.m_spent_cache_depth;
     }
@@ -205,6 +412,23 @@ namespace cbdc::atomizer {
         return m_best_height - block_height;
     }
 
+    auto atomizer::generation(uint64_t height_offset) -> tx_generation& {
+        return m_txs[generation_index(height_offset)];
+    }
+
+    auto atomizer::generation(uint64_t height_offset) const
+        -> const tx_generation& {
+        return m_txs[generation_index(height_offset)];
+    }
+
+    auto atomizer::generation_index(uint64_t height_offset) const -> size_t {
+        // Each generation stays in the same ring slot for as long as it is
+        // cached, so the slot is determined by the absolute block height.
+        const auto ring_size = m_txs.size();
+        return (m_best_height % ring_size + ring_size - height_offset)
+             % ring_size;
+    }
+
     auto atomizer::check_notification_offset(uint64_t height_offset,
                                              const transaction::compact_tx& tx)
         const -> std::optional<cbdc::watchtower::tx_error> {
@@ -218,18 +442,28 @@ namespace cbdc::atomizer {
         return std::nullopt;
     }
 
+    auto atomizer::spent_partition(const hash_t& uhs_id) const -> size_t {
+        return uhs_id[0] % m_spent.size();
+    }
+
+    auto atomizer::is_spent(const hash_t& uhs_id,
+                            uint64_t cache_check_range) const -> bool {
+        auto spent_height = m_spent[spent_partition(uhs_id)].find(uhs_id);
+        return spent_height.has_value()
+            && m_best_height - spent_height.value() <= cache_check_range;
+    }
+
     auto atomizer::check_stxo_cache(const transaction::compact_tx& tx,
                                     uint64_t cache_check_range) const
         -> std::optional<cbdc::watchtower::tx_error> {
-        // For each height offset in our STXO cache up to the offset of the
-        // oldest attestation we're using, check that the inputs have not
-        // already been spent.
+        // Check that none of the inputs were spent at any height offset in
+        // our STXO cache up to the offset of the oldest attestation we're
+        // using. The cache records the height at which each input was spent,
+        // so one lookup per input covers every offset.
         auto err_set = std::unordered_set<hash_t, hashing::null>{};
-        for(size_t offset = 0; offset <= cache_check_range; offset++) {
-            for(const auto& inp : tx.m_inputs) {
-                if(m_spent[offset].find(inp) != m_spent[offset].end()) {
-                    err_set.insert(inp);
-                }
+        for(const auto& inp : tx.m_inputs) {
+            if(is_spent(inp, cache_check_range)) {
+                err_set.insert(inp);
             }
         }
 
@@ -246,6 +480,36 @@ namespace cbdc::atomizer {
         // None of the inputs have previously been spent during block heights
         // we used attestations from, so spend all the TX inputs in the current
         // block height (offset 0).
-        m_spent[0].insert(tx.m_inputs.begin(), tx.m_inputs.end());
+        auto& journal = current_journal();
+        for(const auto& inp : tx.m_inputs) {
+            m_spent[spent_partition(inp)].insert(inp, m_best_height);
+            journal.push_back(inp);
+        }
+    }
+
+    auto atomizer::current_journal() -> std::vector<hash_t>& {
+        // Spends are always recorded at the current best height, which is
+        // the newest height in the journal.
+        if(m_spent_journal.empty()
+           || m_spent_journal.rbegin()->first != m_best_height) {
+            return m_spent_journal
+                .emplace_hint(m_spent_journal.end(),
+                              m_best_height,
+                              std::vector<hash_t>())
+                ->second;
+        }
+        return m_spent_journal.rbegin()->second;
+    }
+
+    void atomizer::add_complete_tx(transaction::compact_tx&& tx) {
+        m_complete_bytes += serialized_size(tx);
+        m_complete_txs.push_back(std::move(tx));
+    }
+
+    void atomizer::recount_complete_bytes() {
+        m_complete_bytes = 0;
+        for(const auto& tx : m_complete_txs) {
+            m_complete_bytes += serialized_size(tx);
+        }
     }
 }
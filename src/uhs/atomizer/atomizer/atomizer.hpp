@@ -7,11 +7,17 @@
 #define OPENCBDC_TX_SRC_ATOMIZER_ATOMIZER_H_
 
 #include "block.hpp"
+#include "messages.hpp"
+#include "pending_tx.hpp"
+#include "stxo_cache.hpp"
 #include "uhs/atomizer/watchtower/tx_error_messages.hpp"
 #include "uhs/transaction/transaction.hpp"
+#include "util/common/background_reclaimer.hpp"
 #include "util/common/hashmap.hpp"
+#include "util/common/worker_pool.hpp"
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -35,7 +41,14 @@ namespace cbdc::atomizer {
         /// \param best_height starting block height.
         /// \param stxo_cache_depth maximum number of recent blocks over which
         ///                         to maintain the spent UHS IDs cache.
-        atomizer(uint64_t best_height, size_t stxo_cache_depth);
+        /// \param stxo_filter_capacity minimum number of spent UHS IDs the
+        ///                             filters of the cache are sized for,
+        ///                             across all of its partitions, or
+        ///                             zero to disable the filters.
+        atomizer(uint64_t best_height,
+                 size_t stxo_cache_depth,
+                 size_t stxo_filter_capacity
+                 = stxo_partitions * stxo_cache::default_filter_capacity);
 
         ~atomizer() = default;
 
@@ -83,6 +96,26 @@ namespace cbdc::atomizer {
                                            transaction::compact_tx&& tx)
             -> std::optional<watchtower::tx_error>;
 
+        /// \brief Attempts to add each of the given aggregate notifications
+        /// to the list of complete transactions, in order.
+        ///
+        /// Produces the same atomizer state and errors as calling \ref
+        /// insert_complete for each notification in turn. Large batches are
+        /// checked against the STXO cache by a persistent pool of worker
+        /// threads, each owning a subset of the cache partitions. The pool
+        /// is started by the first such batch and restarted only if the
+        /// number of threads changes. Conflicts between transactions in the
+        /// batch are then resolved in batch order.
+        /// \param txs aggregate notifications to insert.
+        /// \param n_threads number of worker threads to use. Values less
+        ///                  than two apply the batch sequentially.
+        /// \return watchtower errors for the rejected transactions, in batch
+        ///         order.
+        [[nodiscard]] auto
+        insert_complete_batch(std::vector<aggregate_tx_notification>&& txs,
+                              size_t n_threads)
+            -> std::vector<watchtower::tx_error>;
+
         /// Adds the current set of complete transactions to a new block and
         /// returns it for storage and transmission to subscribers. Rotates the
         /// STXO cache, evicting the oldest set of transactions. Generates and
@@ -100,10 +133,21 @@ namespace cbdc::atomizer {
         /// \return number of transactions.
         [[nodiscard]] auto pending_transactions() const -> size_t;
 
+        /// Returns the serialized size of the complete transactions waiting
+        /// to be included in the next block.
+        /// \return size in bytes.
+        [[nodiscard]] auto pending_bytes() const -> size_t;
+
         /// Returns the height of the most recent block.
         /// \return block height.
         [[nodiscard]] auto height() const -> uint64_t;
 
+        /// Returns the spent UHS ID filter counters summed over all STXO
+        /// cache partitions.
+        /// \return filter statistics.
+        [[nodiscard]] auto stxo_filter_stats() const
+            -> stxo_cache::filter_stats;
+
         /// Serializes the internal state of the atomizer into a buffer.
         /// \return serialized atomizer state.
         [[nodiscard]] auto serialize() -> buffer;
@@ -113,22 +157,73 @@ namespace cbdc::atomizer {
         /// \param buf serialized atomizer state produced with \ref serialize.
         void deserialize(serializer& buf);
 
+        /// \brief Serializes the changes to the atomizer state since the
+        ///        last call to \ref clear_delta.
+        ///
+        /// Contains the UHS IDs spent since the last call that are still
+        /// within the STXO cache range, along with the rest of the state,
+        /// which does not grow with the cache depth.
+        /// \return serialized atomizer state delta.
+        [[nodiscard]] auto serialize_delta() const -> buffer;
+
+        /// Applies a state delta to this atomizer. The atomizer must be in
+        /// the state it was in when the delta's recording started.
+        /// \param buf serialized delta produced with \ref serialize_delta.
+        void apply_delta(serializer& buf);
+
+        /// Starts recording a new state delta, discarding the current one.
+        void clear_delta();
+
         auto operator==(const atomizer& other) const -> bool;
 
       private:
-        std::vector<std::unordered_map<transaction::compact_tx,
-                                       std::unordered_set<uint32_t>,
-                                       transaction::compact_tx_hasher>>
-            m_txs;
+        /// Transactions awaiting attestations, keyed by transaction ID.
+        std::unordered_map<hash_t, pending_tx, hashing::null> m_pending;
+
+        using tx_generation = std::vector<hash_t>;
+
+        /// IDs of the pending transactions notified at each cached block
+        /// height. Used as a ring indexed by block height so that rotating
+        /// the cache on block creation does not move the other generations.
+        std::vector<tx_generation> m_txs;
 
         // These maps should be keyed/salted for safety. For now they
         // use input values directly as an optimization.
         std::vector<transaction::compact_tx> m_complete_txs;
+        /// Serialized size of the transactions in \ref m_complete_txs.
+        size_t m_complete_bytes{0};
 
-        std::vector<std::unordered_set<hash_t, hashing::null>> m_spent;
+        /// Number of partitions of the spent UHS ID cache.
+        static constexpr size_t stxo_partitions{16};
+        /// Minimum batch size for which \ref insert_complete_batch uses
+        /// worker threads.
+        static constexpr size_t min_parallel_batch{256};
+
+        /// Spent UHS ID cache, partitioned by UHS ID prefix.
+        std::vector<stxo_cache> m_spent;
+
+        /// UHS IDs added to the spent cache since the last call to \ref
+        /// clear_delta, by the height at which they were spent.
+        std::map<uint64_t, std::vector<hash_t>> m_spent_journal;
 
         uint64_t m_best_height{};
         size_t m_spent_cache_depth;
+        /// Minimum filter capacity of each partition of \ref m_spent.
+        size_t m_spent_filter_capacity;
+
+        background_reclaimer m_reclaimer;
+
+        /// Threads which apply large batches in \ref insert_complete_batch.
+        std::unique_ptr<worker_pool> m_workers;
+
+        /// Returns the generation of incomplete transactions for the given
+        /// height offset from the current block height.
+        [[nodiscard]] auto generation(uint64_t height_offset)
+            -> tx_generation&;
+        [[nodiscard]] auto generation(uint64_t height_offset) const
+            -> const tx_generation&;
+        [[nodiscard]] auto generation_index(uint64_t height_offset) const
+            -> size_t;
 
         [[nodiscard]] auto get_notification_offset(uint64_t block_height) const
             -> uint64_t;
@@ -138,11 +233,23 @@ namespace cbdc::atomizer {
                                   const transaction::compact_tx& tx) const
             -> std::optional<watchtower::tx_error>;
 
+        [[nodiscard]] auto spent_partition(const hash_t& uhs_id) const
+            -> size_t;
+
+        [[nodiscard]] auto is_spent(const hash_t& uhs_id,
+                                    uint64_t cache_check_range) const -> bool;
+
         [[nodiscard]] auto check_stxo_cache(const transaction::compact_tx& tx,
                                             uint64_t cache_check_range) const
             -> std::optional<watchtower::tx_error>;
 
         void add_tx_to_stxo_cache(const transaction::compact_tx& tx);
+
+        [[nodiscard]] auto current_journal() -> std::vector<hash_t>&;
+
+        void add_complete_tx(transaction::compact_tx&& tx);
+
+        void recount_complete_bytes();
     };
 }
 
@@ -11,6 +11,10 @@
 #include "util/raft/util.hpp"
 #include "util/serialization/util.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 namespace cbdc::atomizer {
     atomizer_raft::atomizer_raft(
         uint32_t atomizer_id,
@@ -25,12 +29,23 @@ namespace cbdc::atomizer {
                false,
                nuraft::cs_new<state_machine>(
                    stxo_cache_depth,
-                   "atomizer_snps_" + std::to_string(atomizer_id)),
+                   opts.m_stxo_filter_capacity,
+                   "atomizer_snps_" + std::to_string(atomizer_id),
+                   opts.m_atomizer_apply_threads,
+                   "atomizer_blocks_" + std::to_string(atomizer_id),
+                   opts.m_atomizer_block_memory),
                0,
                logger,
                std::move(raft_callback)),
+          m_pending(pending_stripes),
           m_log(std::move(logger)),
-          m_opts(std::move(opts)) {}
+          m_opts(std::move(opts)),
+          m_stxo_cache_depth(stxo_cache_depth),
+          m_attestation_cache(m_opts.m_attestation_cache_size),
+          m_complete(m_opts.m_atomizer_replication_max_txs,
+                     std::chrono::microseconds(
+                         m_opts.m_atomizer_replication_delay),
+                     m_opts.m_atomizer_replication_max_inflight) {}
 
     auto atomizer_raft::get_sm() -> state_machine* {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
@@ -52,57 +67,203 @@ namespace cbdc::atomizer {
         return get_sm()->tx_notify_count();
     }
 
+    auto atomizer_raft::stxo_filter_stats() -> stxo_cache::filter_stats {
+        return get_sm()->stxo_filter_stats();
+    }
+
+    auto atomizer_raft::block_retention_stats()
+        -> block_store::retention_stats {
+        return get_sm()->block_retention_stats();
+    }
+
+    auto atomizer_raft::attestation_cache_stats()
+        -> transaction::attestation_cache::cache_stats {
+        return m_attestation_cache.stats();
+    }
+
+    auto atomizer_raft::orphan_count() -> size_t {
+        auto count = size_t();
+        for(auto& stripe : m_pending) {
+            std::unique_lock l(stripe.m_mut);
+            count += stripe.m_orphans.size();
+        }
+        return count;
+    }
+
+    auto atomizer_raft::pending_block_stats() -> state_machine::pending_block {
+        return get_sm()->pending_block_stats();
+    }
+
+    auto atomizer_raft::get_serialized_block(uint64_t height)
+        -> std::shared_ptr<buffer> {
+        return get_sm()->get_serialized_block(height);
+    }
+
     void atomizer_raft::tx_notify(tx_notify_request&& notif) {
         if(!transaction::validation::check_attestations(
                notif.m_tx,
                m_opts.m_sentinel_public_keys,
-               m_opts.m_attestation_threshold)) {
+               m_opts.m_attestation_threshold,
+               m_attestation_cache)) {
             m_log->warn("Received invalid compact transaction",
                         to_string(notif.m_tx.m_id));
             return;
         }
 
-        auto maybe_tx = [&]() -> std::optional<decltype(m_txs)::node_type> {
-            std::unique_lock l(m_txs_mut);
-            auto it = m_txs.find(notif.m_tx);
-            if(it != m_txs.end()) {
-                for(auto n : notif.m_attestations) {
-                    auto p = std::make_pair(n, notif.m_block_height);
-                    auto n_it = it->second.find(p);
-                    if((n_it != it->second.end()
-                        && n_it->second < notif.m_block_height)
-                       || n_it == it->second.end()) {
-                        it->second.insert(std::move(p));
-                    }
+        if(notif.m_attestations.size() == notif.m_tx.m_inputs.size()) {
+            // Every input is attested to by this notification so there is
+            // nothing to combine it with.
+            auto agg = aggregate_tx_notification();
+            agg.m_tx = std::move(notif.m_tx);
+            agg.m_oldest_attestation = notif.m_block_height;
+            m_complete.push(std::move(agg));
+            return;
+        }
+
+        auto agg = add_notification(std::move(notif));
+        if(agg.has_value()) {
+            m_complete.push(std::move(agg.value()));
+        }
+    }
+
+    void atomizer_raft::tx_attestation_notify(
+        tx_attestation_notify_request&& notif) {
+        auto& stripe = get_stripe(notif.m_tx_id);
+        auto taken = [&]() -> std::optional<pending_map::node_type> {
+            std::unique_lock l(stripe.m_mut);
+            expire_orphans(stripe, notif.m_block_height);
+            auto key = transaction::compact_tx();
+            key.m_id = notif.m_tx_id;
+            auto it = stripe.m_txs.find(key);
+            if(it == stripe.m_txs.end()) {
+                // The transaction body has not arrived yet. Input indexes are
+                // checked against the transaction once it does.
+                auto& atts = stripe.m_orphans[notif.m_tx_id];
+                for(auto idx : attested_inputs(notif)) {
+                    add_attestation(atts, idx, notif.m_block_height);
                 }
-            } else {
+                stripe.m_orphan_heights.emplace_back(notif.m_block_height,
+                                                     notif.m_tx_id);
+                return std::nullopt;
+            }
+
+            for(auto idx : attested_inputs(notif)) {
+                if(idx < it->first.m_inputs.size()) {
+                    add_attestation(it->second, idx, notif.m_block_height);
+                }
+            }
+            return take_if_complete(stripe, it);
+        }();
+
+        auto agg = make_aggregate(std::move(taken));
+        if(agg.has_value()) {
+            m_complete.push(std::move(agg.value()));
+        }
+    }
+
+    auto atomizer_raft::add_notification(tx_notify_request&& notif)
+        -> std::optional<aggregate_tx_notification> {
+        auto& stripe = get_stripe(notif.m_tx.m_id);
+        auto taken = [&]() -> std::optional<pending_map::node_type> {
+            std::unique_lock l(stripe.m_mut);
+            expire_orphans(stripe, notif.m_block_height);
+            auto it = stripe.m_txs.find(notif.m_tx);
+            if(it == stripe.m_txs.end()) {
                 auto attestations = attestation_set();
-                attestations.reserve(notif.m_attestations.size());
-                for(auto n : notif.m_attestations) {
-                    attestations.insert(
-                        std::make_pair(n, notif.m_block_height));
+                auto orphan = stripe.m_orphans.find(notif.m_tx.m_id);
+                if(orphan != stripe.m_orphans.end()) {
+                    for(const auto& att : orphan->second) {
+                        if(att.first < notif.m_tx.m_inputs.size()) {
+                            attestations.insert(att);
+                        }
+                    }
+                    stripe.m_orphans.erase(orphan);
                 }
-                it = m_txs
+                it = stripe.m_txs
                          .insert(std::make_pair(std::move(notif.m_tx),
                                                 std::move(attestations)))
                          .first;
             }
 
-            // TODO: handle notifications that never spill over due to lack of
-            //       attestations
-            if(it->second.size() != it->first.m_inputs.size()) {
-                return std::nullopt;
+            for(auto n : notif.m_attestations) {
+                add_attestation(it->second, n, notif.m_block_height);
             }
 
-            auto tx = m_txs.extract(it);
-            return tx;
+            // TODO: handle notifications that never spill over due to lack of
+            //       attestations
+            return take_if_complete(stripe, it);
         }();
 
-        if(!maybe_tx.has_value()) {
+        return make_aggregate(std::move(taken));
+    }
+
+    auto atomizer_raft::get_stripe(const hash_t& tx_id) -> pending_stripe& {
+        // Matches compact_tx_hasher so that a stripe's map buckets are
+        // selected by the same hash.
+        size_t h{};
+        std::memcpy(&h, tx_id.data(), sizeof(h));
+        return m_pending[h % m_pending.size()];
+    }
+
+    void atomizer_raft::expire_orphans(pending_stripe& stripe,
+                                       uint64_t block_height) {
+        stripe.m_best_height = std::max(stripe.m_best_height, block_height);
+        if(stripe.m_best_height <= m_stxo_cache_depth) {
             return;
         }
+        const auto min_height = stripe.m_best_height - m_stxo_cache_depth;
+        auto& heights = stripe.m_orphan_heights;
+        while(!heights.empty() && heights.front().first < min_height) {
+            // A transaction may have been orphaned again, or received newer
+            // attestations, since this entry was added. Only discard it
+            // once its newest attestation has expired.
+            auto it = stripe.m_orphans.find(heights.front().second);
+            heights.pop_front();
+            if(it == stripe.m_orphans.end()) {
+                continue;
+            }
+            auto expired = std::all_of(it->second.begin(),
+                                       it->second.end(),
+                                       [&](const attestation& att) {
+                                           return att.second < min_height;
+                                       });
+            if(expired) {
+                stripe.m_orphans.erase(it);
+            }
+        }
+    }
 
-        auto& tx = maybe_tx.value();
+    void atomizer_raft::add_attestation(attestation_set& atts,
+                                        uint64_t idx,
+                                        uint64_t block_height) {
+        // Keep the most recent attestation for each input.
+        auto p = std::make_pair(idx, block_height);
+        auto it = atts.find(p);
+        if(it == atts.end()) {
+            atts.insert(p);
+        } else if(it->second < block_height) {
+            atts.erase(it);
+            atts.insert(p);
+        }
+    }
+
+    auto atomizer_raft::take_if_complete(pending_stripe& stripe,
+                                         pending_map::iterator it)
+        -> std::optional<pending_map::node_type> {
+        if(it->second.size() != it->first.m_inputs.size()) {
+            return std::nullopt;
+        }
+        return stripe.m_txs.extract(it);
+    }
+
+    auto atomizer_raft::make_aggregate(
+        std::optional<pending_map::node_type>&& node)
+        -> std::optional<aggregate_tx_notification> {
+        if(!node.has_value()) {
+            return std::nullopt;
+        }
+
+        auto& tx = node.value();
         auto agg = aggregate_tx_notification();
         agg.m_tx = std::move(tx.key());
         uint64_t oldest{0};
@@ -112,24 +273,33 @@ namespace cbdc::atomizer {
             }
         }
         agg.m_oldest_attestation = oldest;
+        return agg;
+    }
 
-        {
-            std::lock_guard<std::mutex> l(m_complete_mut);
-            m_complete_txs.push_back(std::move(agg));
-        }
+    auto atomizer_raft::wait_for_complete_txs() -> bool {
+        return m_complete.wait();
     }
 
     auto atomizer_raft::send_complete_txs(const raft::callback_type& result_fn)
         -> bool {
-        auto atns = aggregate_tx_notify_request();
-        {
-            std::lock_guard<std::mutex> l(m_complete_mut);
-            std::swap(atns.m_agg_txs, m_complete_txs);
-        }
-        if(atns.m_agg_txs.empty()) {
-            return false;
-        }
-        return make_request(atns, result_fn);
+        return m_complete.send(
+            [&](aggregate_tx_notify_request&& atns,
+                std::function<void()> done) {
+                return make_request(
+                    atns,
+                    [result_fn, done = std::move(done)](
+                        raft::result_type& r,
+                        nuraft::ptr<std::exception>& err) {
+                        done();
+                        if(result_fn) {
+                            result_fn(r, err);
+                        }
+                    });
+            });
+    }
+
+    void atomizer_raft::stop_complete_txs() {
+        m_complete.stop();
     }
 
     auto atomizer_raft::attestation_hash::operator()(
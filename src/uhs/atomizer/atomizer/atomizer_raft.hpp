@@ -6,12 +6,16 @@
 #ifndef OPENCBDC_TX_SRC_ATOMIZER_ATOMIZER_RAFT_H_
 #define OPENCBDC_TX_SRC_ATOMIZER_ATOMIZER_RAFT_H_
 
+#include "complete_tx_queue.hpp"
 #include "messages.hpp"
 #include "state_machine.hpp"
+#include "uhs/transaction/attestation_cache.hpp"
 #include "util/network/connection_manager.hpp"
 #include "util/raft/node.hpp"
 #include "util/raft/state_manager.hpp"
 
+#include <deque>
+
 namespace cbdc::atomizer {
     /// \brief Manager for an atomizer raft node.
     ///
@@ -53,22 +57,86 @@ namespace cbdc::atomizer {
         /// \return number of transaction notifications.
         [[nodiscard]] auto tx_notify_count() -> uint64_t;
 
+        /// Return the spent UHS ID filter counters of the state machine's
+        /// atomizer.
+        /// \return filter statistics.
+        [[nodiscard]] auto stxo_filter_stats() -> stxo_cache::filter_stats;
+
+        /// Return the number and size of the blocks retained by the state
+        /// machine for archivers.
+        /// \return block retention statistics.
+        [[nodiscard]] auto block_retention_stats()
+            -> block_store::retention_stats;
+
+        /// Return the hit and miss counters of the verified sentinel
+        /// attestation cache used by \ref tx_notify.
+        /// \return attestation cache statistics.
+        [[nodiscard]] auto attestation_cache_stats()
+            -> transaction::attestation_cache::cache_stats;
+
+        /// Return the complete transactions in the state machine waiting to
+        /// be included in the next block.
+        /// \return pending block statistics.
+        [[nodiscard]] auto pending_block_stats()
+            -> state_machine::pending_block;
+
+        /// Return the serialized block at the given height from the state
+        /// machine's block store.
+        /// \param height height of the block.
+        /// \return serialized block, or nullptr if the block is not retained.
+        [[nodiscard]] auto get_serialized_block(uint64_t height)
+            -> std::shared_ptr<buffer>;
+
         /// Add the given transaction notification to the set of pending
         /// notifications. If the notification can be combined with previously
         /// received notifications to create an aggregate notification with a
         /// full set of input attestations, create an aggregate notification
-        /// and add it to a list of complete transactions.
+        /// and add it to a list of complete transactions. Notifications which
+        /// attest to every input bypass the set of pending notifications.
+        /// Thread-safe; contention is limited to notifications for
+        /// transactions in the same lock stripe.
         /// \param notif transaction notification.
         void tx_notify(tx_notify_request&& notif);
 
-        /// Replicate a transaction notification command in the state machine
-        /// containing the current set of complete transactions.
+        /// Add the attestations in the given attestation-only notification
+        /// to the pending notifications for its transaction. If the
+        /// transaction body has not been received yet, hold the attestations
+        /// until a full notification for the transaction arrives. Creates an
+        /// aggregate notification once the attestations are complete.
+        /// Held attestations are discarded once they are older than the
+        /// spent output cache depth relative to the newest notification in
+        /// their lock stripe, as the atomizer would reject them anyway.
+        /// Thread-safe.
+        /// \param notif attestation-only transaction notification.
+        void tx_attestation_notify(tx_attestation_notify_request&& notif);
+
+        /// Return the number of transactions with attestations held until a
+        /// full notification arrives.
+        /// \return number of held transactions.
+        [[nodiscard]] auto orphan_count() -> size_t;
+
+        /// Blocks until complete transactions are ready to be replicated with
+        /// \ref send_complete_txs. Returns once the configured maximum number
+        /// of transactions per log entry is waiting, or the configured flush
+        /// delay has elapsed since the first waiting transaction arrived.
+        /// \return false if interrupted by \ref stop_complete_txs.
+        [[nodiscard]] auto wait_for_complete_txs() -> bool;
+
+        /// Replicate transaction notification commands in the state machine
+        /// containing the current set of complete transactions. Splits the
+        /// transactions into log entries of at most the configured maximum
+        /// size, and waits before replicating each entry while the
+        /// configured maximum number of entries are in flight.
         /// \param result_fn function to call with the state machine execution
-        ///                  result.
-        /// \return true if the command was accepted for replication.
+        ///                  result of each entry.
+        /// \return true if at least one command was accepted for replication.
         [[nodiscard]] auto
         send_complete_txs(const raft::callback_type& result_fn) -> bool;
 
+        /// Unblocks threads waiting in \ref wait_for_complete_txs or \ref
+        /// send_complete_txs, and causes future calls to return immediately.
+        void stop_complete_txs();
+
       private:
         static constexpr const auto m_node_type = "atomizer";
 
@@ -86,16 +154,54 @@ namespace cbdc::atomizer {
         using attestation_set = std::
             unordered_set<attestation, attestation_hash, attestation_cmp>;
 
-        std::unordered_map<transaction::compact_tx,
-                           attestation_set,
-                           transaction::compact_tx_hasher>
-            m_txs;
-        std::mutex m_complete_mut;
-        std::vector<aggregate_tx_notification> m_complete_txs;
+        using pending_map = std::unordered_map<transaction::compact_tx,
+                                               attestation_set,
+                                               transaction::compact_tx_hasher>;
+
+        /// Partition of the pending notifications guarded by its own lock.
+        struct pending_stripe {
+            std::mutex m_mut;
+            pending_map m_txs;
+            /// Attestations from attestation-only notifications received
+            /// before any full notification for their transaction.
+            std::unordered_map<hash_t, attestation_set, hashing::null>
+                m_orphans;
+            /// Orphaned transaction IDs with the block height of each
+            /// attestation-only notification received for them, in order of
+            /// arrival.
+            std::deque<std::pair<uint64_t, hash_t>> m_orphan_heights;
+            /// Highest block height of any notification in this stripe.
+            uint64_t m_best_height{};
+        };
+
+        /// Number of lock stripes for pending notifications.
+        static constexpr size_t pending_stripes{64};
+
+        std::vector<pending_stripe> m_pending;
         std::shared_ptr<logging::log> m_log;
         config::options m_opts;
+        size_t m_stxo_cache_depth;
+        transaction::attestation_cache m_attestation_cache;
+        complete_tx_queue m_complete;
+
+        [[nodiscard]] auto add_notification(tx_notify_request&& notif)
+            -> std::optional<aggregate_tx_notification>;
+
+        [[nodiscard]] auto get_stripe(const hash_t& tx_id) -> pending_stripe&;
+
+        void expire_orphans(pending_stripe& stripe, uint64_t block_height);
+
+        static void add_attestation(attestation_set& atts,
+                                    uint64_t idx,
+                                    uint64_t block_height);
+
+        [[nodiscard]] static auto take_if_complete(pending_stripe& stripe,
+                                                   pending_map::iterator it)
+            -> std::optional<pending_map::node_type>;
 
-        std::mutex m_txs_mut;
+        [[nodiscard]] static auto
+        make_aggregate(std::optional<pending_map::node_type>&& node)
+            -> std::optional<aggregate_tx_notification>;
     };
 }
 
@@ -0,0 +1,231 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "block_store.hpp"
+
+#include "format.hpp"
+#include "util/serialization/util.hpp"
+
+#include <filesystem>
+
+namespace cbdc::atomizer {
+    block_store::block_store(std::string dir,
+                             size_t memory_limit,
+                             size_t segment_size)
+        : m_dir(std::move(dir)),
+          m_memory_limit(memory_limit),
+          m_segment_size(segment_size) {
+        auto err = std::error_code();
+        std::filesystem::remove_all(m_dir, err);
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+        std::filesystem::create_directories(m_dir, err);
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    block_store::~block_store() {
+        clear();
+        if(!m_dir.empty()) {
+            auto err = std::error_code();
+            std::filesystem::remove_all(m_dir, err);
+        }
+    }
+
+    auto block_store::add(const block& blk) -> std::shared_ptr<buffer> {
+        auto data = make_shared_buffer(blk);
+        add(blk.m_height, data);
+        return data;
+    }
+
+    void block_store::add(uint64_t height, std::shared_ptr<buffer> data) {
+        auto loc = m_index.find(height);
+        if(loc != m_index.end()) {
+            auto spilled = loc->second;
+            m_index.erase(loc);
+            drop_spilled(spilled);
+        }
+        auto it = m_blocks.find(height);
+        if(it != m_blocks.end()) {
+            m_memory_bytes -= it->second->size();
+            m_blocks.erase(it);
+        }
+
+        m_memory_bytes += data->size();
+        m_blocks.emplace(height, std::move(data));
+
+        spill();
+    }
+
+    auto block_store::get(uint64_t height) const -> std::optional<block> {
+        auto data = get_serialized(height);
+        if(!data) {
+            return std::nullopt;
+        }
+        auto blk = from_buffer<block>(*data);
+        if(!blk.has_value()) {
+            std::exit(EXIT_FAILURE);
+        }
+        return blk;
+    }
+
+    auto block_store::contains(uint64_t height) const -> bool {
+        return m_blocks.find(height) != m_blocks.end()
+            || m_index.find(height) != m_index.end();
+    }
+
+    auto block_store::get_serialized(uint64_t height) const
+        -> std::shared_ptr<buffer> {
+        auto it = m_blocks.find(height);
+        if(it != m_blocks.end()) {
+            return it->second;
+        }
+
+        auto loc = m_index.find(height);
+        if(loc == m_index.end()) {
+            return nullptr;
+        }
+
+        auto ss = std::ifstream(segment_path(loc->second.m_segment),
+                                std::ios::in | std::ios::binary);
+        ss.seekg(static_cast<std::streamoff>(loc->second.m_offset));
+        auto data = std::make_shared<buffer>();
+        data->extend(loc->second.m_size);
+        ss.read(static_cast<char*>(data->data()),
+                static_cast<std::streamsize>(data->size()));
+        if(!ss.good()) {
+            // We wrote the segment so reading it back should work unless
+            // the system is broken
+            std::exit(EXIT_FAILURE);
+        }
+        return data;
+    }
+
+    void block_store::prune(uint64_t height) {
+        auto mem_end = m_blocks.lower_bound(height);
+        for(auto it = m_blocks.begin(); it != mem_end; it++) {
+            m_memory_bytes -= it->second->size();
+        }
+        m_blocks.erase(m_blocks.begin(), mem_end);
+
+        auto disk_end = m_index.lower_bound(height);
+        for(auto it = m_index.begin(); it != disk_end; it++) {
+            drop_spilled(it->second);
+        }
+        m_index.erase(m_index.begin(), disk_end);
+        while(!m_segments.empty()
+              && m_segments.begin()->second.m_max_height < height) {
+            remove_segment(m_segments.begin()->first);
+        }
+    }
+
+    void block_store::clear() {
+        m_blocks.clear();
+        m_memory_bytes = 0;
+        m_index.clear();
+        m_disk_bytes = 0;
+        while(!m_segments.empty()) {
+            remove_segment(m_segments.begin()->first);
+        }
+    }
+
+    void block_store::for_each(
+        const std::function<void(uint64_t, const buffer&)>& fn) const {
+        auto mem_it = m_blocks.begin();
+        auto disk_it = m_index.begin();
+        while(mem_it != m_blocks.end() || disk_it != m_index.end()) {
+            if(disk_it == m_index.end()
+               || (mem_it != m_blocks.end()
+                   && mem_it->first < disk_it->first)) {
+                fn(mem_it->first, *mem_it->second);
+                mem_it++;
+            } else {
+                fn(disk_it->first, *get_serialized(disk_it->first));
+                disk_it++;
+            }
+        }
+    }
+
+    auto block_store::size() const -> size_t {
+        return m_blocks.size() + m_index.size();
+    }
+
+    auto block_store::stats() const -> retention_stats {
+        return {size(), m_memory_bytes, m_disk_bytes};
+    }
+
+    auto block_store::segment_path(uint64_t id) const -> std::string {
+        return m_dir + "/" + std::to_string(id);
+    }
+
+    void block_store::spill() {
+        if(m_dir.empty() || m_memory_bytes <= m_memory_limit) {
+            return;
+        }
+
+        while(m_memory_bytes > m_memory_limit && !m_blocks.empty()) {
+            if(!m_writer.is_open()
+               || m_segments.rbegin()->second.m_size >= m_segment_size) {
+                m_writer.close();
+                auto id = m_next_segment++;
+                m_writer.open(segment_path(id),
+                              std::ios::out | std::ios::trunc
+                                  | std::ios::binary);
+                if(!m_writer.good()) {
+                    std::exit(EXIT_FAILURE);
+                }
+                m_segments.emplace(id, segment{});
+            }
+
+            auto& [id, seg] = *m_segments.rbegin();
+            auto it = m_blocks.begin();
+            const auto& data = *it->second;
+            m_writer.write(static_cast<const char*>(data.data()),
+                           static_cast<std::streamsize>(data.size()));
+            if(!m_writer.good()) {
+                std::exit(EXIT_FAILURE);
+            }
+
+            m_index[it->first] = location{id, seg.m_size, data.size()};
+            seg.m_size += data.size();
+            seg.m_live_size += data.size();
+            seg.m_max_height = std::max(seg.m_max_height, it->first);
+            m_disk_bytes += data.size();
+
+            m_memory_bytes -= data.size();
+            m_blocks.erase(it);
+        }
+
+        m_writer.flush();
+    }
+
+    void block_store::drop_spilled(const location& loc) {
+        m_disk_bytes -= loc.m_size;
+        auto it = m_segments.find(loc.m_segment);
+        it->second.m_live_size -= loc.m_size;
+        // Remove a segment once every block in it has been replaced, unless
+        // it is still being written
+        if(it->second.m_live_size == 0 && std::next(it) != m_segments.end()) {
+            remove_segment(it->first);
+        }
+    }
+
+    void block_store::remove_segment(uint64_t id) {
+        auto it = m_segments.find(id);
+        if(it == m_segments.end()) {
+            return;
+        }
+        if(std::next(it) == m_segments.end()) {
+            m_writer.close();
+        }
+        m_disk_bytes -= it->second.m_live_size;
+        m_segments.erase(it);
+
+        auto err = std::error_code();
+        std::filesystem::remove(segment_path(id), err);
+    }
+}
@@ -0,0 +1,161 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_ATOMIZER_BLOCK_STORE_H_
+#define OPENCBDC_TX_SRC_ATOMIZER_BLOCK_STORE_H_
+
+#include "block.hpp"
+
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace cbdc::atomizer {
+    /// \brief Retains blocks until archivers prune them.
+    ///
+    /// Holds the most recent blocks in memory in serialized form, so the
+    /// same buffer can be sent to every peer without serializing the block
+    /// again. Once the size of the blocks in memory exceeds the memory
+    /// limit, the oldest blocks are
+    /// appended to segment files on disk, from which they can still be read.
+    /// Pruning drops whole ranges of heights and removes segment files once
+    /// all of their blocks have been pruned. The contents of the segment
+    /// files are not persistent and are discarded when the store is
+    /// destroyed.
+    class block_store {
+      public:
+        /// Default maximum size of a segment file in bytes.
+        static constexpr size_t default_segment_size{64UL * 1024 * 1024};
+
+        /// Retained block counters.
+        struct retention_stats {
+            /// Number of blocks retained.
+            uint64_t m_blocks{};
+            /// Serialized size of the blocks held in memory.
+            uint64_t m_memory_bytes{};
+            /// Serialized size of the blocks held on disk.
+            uint64_t m_disk_bytes{};
+        };
+
+        /// Constructs a store which holds all blocks in memory.
+        block_store() = default;
+
+        /// Constructs a store which spills blocks to disk.
+        /// \param dir directory in which to write segment files. Created if
+        ///            it does not exist. Existing segment files are removed.
+        /// \param memory_limit maximum serialized size in bytes of the blocks
+        ///                     held in memory.
+        /// \param segment_size size in bytes after which to start a new
+        ///                     segment file.
+        block_store(std::string dir,
+                    size_t memory_limit,
+                    size_t segment_size = default_segment_size);
+
+        /// Removes the segment files and their directory.
+        ~block_store();
+
+        block_store(const block_store&) = delete;
+        auto operator=(const block_store&) -> block_store& = delete;
+
+        block_store(block_store&&) = delete;
+        auto operator=(block_store&&) -> block_store& = delete;
+
+        /// Serializes a block and adds it to the store.
+        /// \see \ref add(uint64_t, std::shared_ptr<buffer>)
+        /// \param blk block to add.
+        /// \return the serialized block.
+        auto add(const block& blk) -> std::shared_ptr<buffer>;
+
+        /// Adds a serialized block to the store, replacing any block at the
+        /// same height. Spills the oldest blocks in memory to disk if the
+        /// memory limit is exceeded.
+        /// \param height height of the block.
+        /// \param data serialized block. Must not be modified afterwards.
+        void add(uint64_t height, std::shared_ptr<buffer> data);
+
+        /// Returns the block at the given height.
+        /// \param height height of the block.
+        /// \return the block, or std::nullopt if the store does not contain
+        ///         a block at the given height.
+        [[nodiscard]] auto get(uint64_t height) const -> std::optional<block>;
+
+        /// Checks whether the store holds a block at the given height,
+        /// without reading spilled blocks from disk.
+        /// \param height height of the block.
+        /// \return true if the store contains a block at the given height.
+        [[nodiscard]] auto contains(uint64_t height) const -> bool;
+
+        /// Returns the serialized block at the given height. Blocks held in
+        /// memory are returned without copying.
+        /// \param height height of the block.
+        /// \return the serialized block, or nullptr if the store does not
+        ///         contain a block at the given height.
+        [[nodiscard]] auto get_serialized(uint64_t height) const
+            -> std::shared_ptr<buffer>;
+
+        /// Removes all blocks below the given height.
+        /// \param height lowest height to retain.
+        void prune(uint64_t height);
+
+        /// Removes all blocks.
+        void clear();
+
+        /// Calls the given function with the height and serialized form of
+        /// each block, in height order.
+        /// \param fn function to call.
+        void for_each(
+            const std::function<void(uint64_t, const buffer&)>& fn) const;
+
+        /// Returns the number of blocks in the store.
+        /// \return block count.
+        [[nodiscard]] auto size() const -> size_t;
+
+        /// Returns the number and size of the retained blocks.
+        /// \return retention statistics.
+        [[nodiscard]] auto stats() const -> retention_stats;
+
+      private:
+        struct segment {
+            uint64_t m_max_height{};
+            /// Size of the segment file.
+            uint64_t m_size{};
+            /// Size of the blocks in the file which have not been pruned or
+            /// replaced.
+            uint64_t m_live_size{};
+        };
+
+        struct location {
+            uint64_t m_segment{};
+            uint64_t m_offset{};
+            uint64_t m_size{};
+        };
+
+        std::string m_dir;
+        size_t m_memory_limit{};
+        size_t m_segment_size{};
+
+        std::map<uint64_t, std::shared_ptr<buffer>> m_blocks;
+        uint64_t m_memory_bytes{};
+
+        std::map<uint64_t, location> m_index;
+        std::map<uint64_t, segment> m_segments;
+        uint64_t m_next_segment{};
+        std::ofstream m_writer;
+        uint64_t m_disk_bytes{};
+
+        [[nodiscard]] auto segment_path(uint64_t id) const -> std::string;
+
+        void spill();
+
+        void drop_spilled(const location& loc);
+
+        void remove_segment(uint64_t id);
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_ATOMIZER_BLOCK_STORE_H_
@@ -0,0 +1,129 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "complete_tx_queue.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace cbdc::atomizer {
+    complete_tx_queue::complete_tx_queue(size_t max_txs,
+                                         std::chrono::microseconds delay,
+                                         size_t max_inflight)
+        : m_max_txs(max_txs),
+          m_delay(delay),
+          m_max_inflight(max_inflight),
+          m_buffers(std::max(std::thread::hardware_concurrency(), 1U)) {}
+
+    void complete_tx_queue::push(aggregate_tx_notification&& agg) {
+        auto count = size_t();
+        {
+            auto& buf = local_buffer();
+            std::lock_guard<std::mutex> l(buf.m_mut);
+            buf.m_txs.push_back(std::move(agg));
+            count = m_count.fetch_add(1) + 1;
+        }
+        // Only the first transaction of a batch and the one filling it
+        // change the outcome of wait.
+        if(count == 1 || count == m_max_txs) {
+            {
+                // Orders the notification after a waiter's check of the
+                // transaction count.
+                std::lock_guard<std::mutex> l(m_mut);
+            }
+            m_cv.notify_all();
+        }
+    }
+
+    auto complete_tx_queue::wait() -> bool {
+        std::unique_lock<std::mutex> l(m_mut);
+        m_cv.wait(l, [&]() {
+            return m_stopped || m_count > 0;
+        });
+        const auto deadline = std::chrono::steady_clock::now() + m_delay;
+        m_cv.wait_until(l, deadline, [&]() {
+            return m_stopped || (m_max_txs > 0 && m_count >= m_max_txs);
+        });
+        return !m_stopped;
+    }
+
+    auto complete_tx_queue::send(const replicate_fn& fn) -> bool {
+        auto txs = take();
+        const auto max_txs = m_max_txs > 0 ? m_max_txs : txs.size();
+        auto sent = false;
+        for(size_t i = 0; i < txs.size(); i += max_txs) {
+            if(m_max_inflight > 0) {
+                std::unique_lock<std::mutex> l(m_mut);
+                m_cv.wait(l, [&]() {
+                    return m_stopped || m_inflight < m_max_inflight;
+                });
+                if(m_stopped) {
+                    break;
+                }
+            }
+
+            auto first = txs.begin() + static_cast<ptrdiff_t>(i);
+            auto last = txs.begin()
+                      + static_cast<ptrdiff_t>(std::min(i + max_txs,
+                                                        txs.size()));
+            auto atns = aggregate_tx_notify_request();
+            atns.m_agg_txs.assign(std::make_move_iterator(first),
+                                  std::make_move_iterator(last));
+
+            m_inflight++;
+            auto done = [this]() {
+                {
+                    std::lock_guard<std::mutex> l(m_mut);
+                    m_inflight--;
+                }
+                m_cv.notify_all();
+            };
+            if(!fn(std::move(atns), done)) {
+                m_inflight--;
+                continue;
+            }
+            sent = true;
+        }
+        return sent;
+    }
+
+    void complete_tx_queue::stop() {
+        {
+            std::lock_guard<std::mutex> l(m_mut);
+            m_stopped = true;
+        }
+        m_cv.notify_all();
+    }
+
+    auto complete_tx_queue::size() const -> size_t {
+        return m_count;
+    }
+
+    auto complete_tx_queue::inflight() const -> size_t {
+        return m_inflight;
+    }
+
+    auto complete_tx_queue::local_buffer() -> buffer& {
+        auto idx = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return m_buffers[idx % m_buffers.size()];
+    }
+
+    auto complete_tx_queue::take() -> std::vector<aggregate_tx_notification> {
+        auto txs = std::vector<aggregate_tx_notification>();
+        for(auto& buf : m_buffers) {
+            std::lock_guard<std::mutex> l(buf.m_mut);
+            m_count -= buf.m_txs.size();
+            if(txs.empty()) {
+                std::swap(txs, buf.m_txs);
+            } else {
+                txs.insert(txs.end(),
+                           std::make_move_iterator(buf.m_txs.begin()),
+                           std::make_move_iterator(buf.m_txs.end()));
+                buf.m_txs.clear();
+            }
+        }
+        return txs;
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_ATOMIZER_COMPLETE_TX_QUEUE_H_
+#define OPENCBDC_TX_SRC_ATOMIZER_COMPLETE_TX_QUEUE_H_
+
+#include "messages.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace cbdc::atomizer {
+    /// \brief Complete transactions waiting to be replicated.
+    ///
+    /// Notification threads append transactions to buffers selected by their
+    /// thread ID. A replication thread waits until enough transactions are
+    /// waiting, or a delay has elapsed, and splits them into log entries of
+    /// a maximum size while limiting the number of entries in flight.
+    class complete_tx_queue {
+      public:
+        /// Function type to replicate a log entry. Accepts the entry and a
+        /// function to call once the entry's result is available, and
+        /// returns false if the entry was not accepted for replication.
+        using replicate_fn
+            = std::function<bool(aggregate_tx_notify_request&& req,
+                                 std::function<void()> done)>;
+
+        /// Constructor.
+        /// \param max_txs maximum number of transactions per log entry, or
+        ///                zero for no limit.
+        /// \param delay time to wait for more transactions after the first
+        ///              waiting transaction arrives.
+        /// \param max_inflight maximum number of log entries without a
+        ///                     result, or zero for no limit.
+        complete_tx_queue(size_t max_txs,
+                          std::chrono::microseconds delay,
+                          size_t max_inflight);
+
+        /// Adds a complete transaction. Thread-safe.
+        /// \param agg aggregate notification for the transaction.
+        void push(aggregate_tx_notification&& agg);
+
+        /// Blocks until transactions are ready to be sent with \ref send.
+        /// Returns once the maximum number of transactions per log entry is
+        /// waiting, or the delay has elapsed since the first waiting
+        /// transaction arrived.
+        /// \return false if interrupted by \ref stop.
+        [[nodiscard]] auto wait() -> bool;
+
+        /// Replicates the waiting transactions in log entries of at most the
+        /// maximum size. Waits before replicating each entry while the
+        /// maximum number of entries are in flight.
+        /// \param fn function to replicate each entry with.
+        /// \return true if at least one entry was accepted for replication.
+        [[nodiscard]] auto send(const replicate_fn& fn) -> bool;
+
+        /// Unblocks threads waiting in \ref wait or \ref send, and causes
+        /// future calls to return immediately.
+        void stop();
+
+        /// Returns the number of waiting transactions.
+        /// \return number of transactions.
+        [[nodiscard]] auto size() const -> size_t;
+
+        /// Returns the number of replicated log entries without a result.
+        /// \return number of entries in flight.
+        [[nodiscard]] auto inflight() const -> size_t;
+
+      private:
+        struct buffer {
+            std::mutex m_mut;
+            std::vector<aggregate_tx_notification> m_txs;
+        };
+
+        size_t m_max_txs;
+        std::chrono::microseconds m_delay;
+        size_t m_max_inflight;
+
+        std::vector<buffer> m_buffers;
+        /// Number of transactions in \ref m_buffers.
+        std::atomic<size_t> m_count{0};
+        /// Number of replicated log entries without a result.
+        std::atomic<size_t> m_inflight{0};
+        /// Guards waits for complete transactions and in-flight entries.
+        std::mutex m_mut;
+        std::condition_variable m_cv;
+        bool m_stopped{false};
+
+        [[nodiscard]] auto local_buffer() -> buffer&;
+
+        [[nodiscard]] auto take() -> std::vector<aggregate_tx_notification>;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_ATOMIZER_COMPLETE_TX_QUEUE_H_
@@ -36,6 +36,7 @@ namespace cbdc::atomizer {
         m_atomizer_network.close();
 
         m_running = false;
+        m_raft_node.stop_complete_txs();
 
         if(m_tx_notify_thread.joinable()) {
             m_tx_notify_thread.join();
@@ -118,7 +119,27 @@ namespace cbdc::atomizer {
                                     to_string(notif.m_tx.m_id),
                                     "with height",
                                     notif.m_block_height);
-                    m_notification_queue.push(notif);
+                    m_notification_queue.push(std::move(notif));
+                },
+                [&](tx_attestation_notify_request& notif) {
+                    m_logger->trace("Received attestation notification",
+                                    to_string(notif.m_tx_id),
+                                    "with height",
+                                    notif.m_block_height);
+                    m_raft_node.tx_attestation_notify(std::move(notif));
+                },
+                [&](tx_notify_batch_request& batch) {
+                    m_logger->trace("Received notification batch with",
+                                    batch.m_notifications.size(),
+                                    "transactions and",
+                                    batch.m_attestation_notifications.size(),
+                                    "attestation notifications");
+                    for(auto& notif : batch.m_notifications) {
+                        m_notification_queue.push(std::move(notif));
+                    }
+                    for(auto& notif : batch.m_attestation_notifications) {
+                        m_raft_node.tx_attestation_notify(std::move(notif));
+                    }
                 },
                 [&](const prune_request& p) {
                     m_raft_node.make_request(p, nullptr);
@@ -146,7 +167,13 @@ namespace cbdc::atomizer {
                             maybe_resp.value()));
                         auto& resp
                             = std::get<get_block_response>(maybe_resp.value());
-                        m_atomizer_network.send(resp.m_blk, peer_id);
+                        auto blk_pkt
+                            = m_raft_node.get_serialized_block(resp.m_height);
+                        if(!blk_pkt) {
+                            m_logger->error("Requested block was pruned.");
+                            return;
+                        }
+                        m_atomizer_network.send(blk_pkt, peer_id);
                     };
                     m_raft_node.make_request(g, result_fn);
                 }},
@@ -156,29 +183,46 @@ namespace cbdc::atomizer {
     }
 
     void controller::tx_notify_handler() {
-        while(m_running) {
-            if(!m_raft_node.send_complete_txs([&](auto&& res, auto&& err) {
-                   err_return_handler(std::forward<decltype(res)>(res),
-                                      std::forward<decltype(err)>(err));
-               })) {
-                static constexpr auto batch_send_delay
-                    = std::chrono::milliseconds(20);
-                std::this_thread::sleep_for(batch_send_delay);
-            }
+        while(m_running && m_raft_node.wait_for_complete_txs()) {
+            std::ignore
+                = m_raft_node.send_complete_txs([&](auto&& res, auto&& err) {
+                      err_return_handler(std::forward<decltype(res)>(res),
+                                         std::forward<decltype(err)>(err));
+                  });
         }
     }
 
     void controller::main_handler() {
+        // The target block interval is the upper bound between blocks. If
+        // size or latency limits are configured, poll the pending
+        // transactions in the meantime to create blocks early.
+        static constexpr auto block_poll_interval
+            = std::chrono::milliseconds(1);
+        const auto adaptive = m_opts.m_atomizer_block_max_txs > 0
+                           || m_opts.m_atomizer_block_max_bytes > 0
+                           || m_opts.m_atomizer_block_max_latency > 0;
+        const auto max_interval
+            = std::chrono::milliseconds(m_opts.m_target_block_interval);
         auto last_time = std::chrono::high_resolution_clock::now();
 
         while(m_running) {
-            const auto next_time
-                = last_time
-                + std::chrono::milliseconds(m_opts.m_target_block_interval);
+            auto next_time = last_time + max_interval;
+            if(adaptive) {
+                next_time
+                    = std::min(next_time,
+                               std::chrono::high_resolution_clock::now()
+                                   + block_poll_interval);
+            }
             std::this_thread::sleep_until(next_time);
-            last_time = std::chrono::high_resolution_clock::now();
+            const auto now = std::chrono::high_resolution_clock::now();
+            if(now < last_time + max_interval
+               && !(m_raft_node.is_leader() && block_ready())) {
+                continue;
+            }
+            last_time = now;
 
             if(m_raft_node.is_leader()) {
+                m_block_in_flight = true;
                 auto req = make_block_request();
                 auto res
                     = m_raft_node.make_request(req, [&](auto&& r, auto&& err) {
@@ -186,16 +230,49 @@ namespace cbdc::atomizer {
                               std::forward<decltype(r)>(r),
                               std::forward<decltype(err)>(err));
                       });
-                if(!res && m_running) {
-                    m_logger->error("Failed to make block at time",
-                                    last_time.time_since_epoch().count());
+                if(!res) {
+                    m_block_in_flight = false;
+                    if(m_running) {
+                        m_logger->error("Failed to make block at time",
+                                        last_time.time_since_epoch().count());
+                    }
                 }
             }
         }
     }
 
+    auto controller::block_ready() -> bool {
+        // Wait for the previous block so its transactions are not counted
+        // towards the next one
+        if(m_block_in_flight) {
+            return false;
+        }
+
+        const auto pending = m_raft_node.pending_block_stats();
+        if(pending.m_txs == 0) {
+            return false;
+        }
+
+        const auto max_txs = m_opts.m_atomizer_block_max_txs;
+        if(max_txs > 0 && pending.m_txs >= max_txs) {
+            return true;
+        }
+
+        const auto max_bytes = m_opts.m_atomizer_block_max_bytes;
+        if(max_bytes > 0 && pending.m_bytes >= max_bytes) {
+            return true;
+        }
+
+        const auto max_latency
+            = std::chrono::milliseconds(m_opts.m_atomizer_block_max_latency);
+        return max_latency.count() > 0
+            && std::chrono::steady_clock::now() - pending.m_oldest
+                   >= max_latency;
+    }
+
     void controller::raft_result_handler(raft::result_type& r,
                                          nuraft::ptr<std::exception>& err) {
+        m_block_in_flight = false;
         if(err) {
             return;
         }
@@ -208,19 +285,56 @@ namespace cbdc::atomizer {
             std::holds_alternative<make_block_response>(maybe_resp.value()));
         auto& resp = std::get<make_block_response>(maybe_resp.value());
 
-        auto blk_pkt = make_shared_buffer(resp.m_blk);
-
-        m_atomizer_network.broadcast(blk_pkt);
+        // Broadcast the buffer serialized by the state machine rather than
+        // serializing the block again
+        auto blk_pkt = m_raft_node.get_serialized_block(resp.m_height);
+        if(blk_pkt) {
+            m_atomizer_network.broadcast(blk_pkt);
+        } else {
+            m_logger->error("Block",
+                            resp.m_height,
+                            "was pruned before broadcast");
+        }
 
         m_logger->info("Block h:",
-                       resp.m_blk.m_height,
+                       resp.m_height,
                        ", nTXs:",
-                       resp.m_blk.m_transactions.size(),
+                       resp.m_tx_count,
                        ", log idx:",
                        m_raft_node.last_log_idx(),
                        ", notifications:",
                        m_raft_node.tx_notify_count());
 
+        // Lookups of unspent IDs either end at the filters or are false
+        // positives, so these two counts give the filter's false positive
+        // rate.
+        const auto stats = m_raft_node.stxo_filter_stats();
+        const auto negatives = stats.m_filtered + stats.m_false_positives;
+        if(negatives > 0) {
+            m_logger->debug(
+                "STXO filter lookups:",
+                stats.m_queries,
+                ", filtered:",
+                stats.m_filtered,
+                ", false positive rate:",
+                static_cast<double>(stats.m_false_positives)
+                    / static_cast<double>(negatives));
+        }
+
+        const auto retained = m_raft_node.block_retention_stats();
+        m_logger->debug("Retained blocks:",
+                        retained.m_blocks,
+                        ", memory bytes:",
+                        retained.m_memory_bytes,
+                        ", disk bytes:",
+                        retained.m_disk_bytes);
+
+        const auto att_stats = m_raft_node.attestation_cache_stats();
+        m_logger->debug("Attestation cache hits:",
+                        att_stats.m_hits,
+                        ", misses:",
+                        att_stats.m_misses);
+
         if(!resp.m_errs.empty()) {
             auto buf = make_shared_buffer(resp.m_errs);
             m_watchtower_network.broadcast(buf);
@@ -282,13 +396,19 @@ namespace cbdc::atomizer {
     }
 
     void controller::notification_consumer() {
+        auto notifs = std::vector<tx_notify_request>();
+        notifs.reserve(notification_batch_size);
         while(m_running) {
-            auto notif = tx_notify_request();
-            auto popped = m_notification_queue.pop(notif);
-            if(!popped) {
+            notifs.clear();
+            auto popped = m_notification_queue.pop_batch(
+                notifs,
+                notification_batch_size);
+            if(popped == 0) {
                 break;
             }
-            m_raft_node.tx_notify(std::move(notif));
+            for(auto& notif : notifs) {
+                m_raft_node.tx_notify(std::move(notif));
+            }
         }
     }
 }
@@ -9,6 +9,7 @@
 #include "atomizer_raft.hpp"
 #include "uhs/atomizer/atomizer/block.hpp"
 #include "util/common/config.hpp"
+#include "util/common/mpmc_queue.hpp"
 #include "util/network/connection_manager.hpp"
 
 #include <memory>
@@ -44,6 +45,7 @@ namespace cbdc::atomizer {
 
         atomizer_raft m_raft_node;
         std::atomic_bool m_running{true};
+        std::atomic_bool m_block_in_flight{false};
 
         cbdc::network::connection_manager m_watchtower_network;
         cbdc::network::connection_manager m_atomizer_network;
@@ -52,13 +54,22 @@ namespace cbdc::atomizer {
         std::thread m_tx_notify_thread;
         std::thread m_main_thread;
 
-        blocking_queue<tx_notify_request> m_notification_queue;
+        /// Maximum number of notifications waiting for a consumer thread.
+        /// The network handler blocks once the queue is full.
+        static constexpr size_t notification_queue_size{1UL << 16};
+        /// Maximum number of notifications a consumer thread dequeues at
+        /// once.
+        static constexpr size_t notification_batch_size{256};
+
+        mpmc_queue<tx_notify_request> m_notification_queue{
+            notification_queue_size};
         std::vector<std::thread> m_notification_threads;
 
         auto server_handler(cbdc::network::message_t&& pkt)
             -> std::optional<cbdc::buffer>;
         void tx_notify_handler();
         void main_handler();
+        [[nodiscard]] auto block_ready() -> bool;
         void raft_result_handler(raft::result_type& r,
                                  nuraft::ptr<std::exception>& err);
         void err_return_handler(raft::result_type& r,
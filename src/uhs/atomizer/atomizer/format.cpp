@@ -42,11 +42,36 @@ namespace cbdc {
         auto nuraft_snp = nuraft::snapshot::deserialize(*snp_buf);
         snp.m_snp = std::move(nuraft_snp);
         snp.m_atomizer->deserialize(deser);
-        snp.m_blocks->clear();
         deser >> *snp.m_blocks;
         return deser;
     }
 
+    auto operator<<(serializer& ser, const atomizer::block_store& blocks)
+        -> serializer& {
+        ser << static_cast<uint64_t>(blocks.size());
+        blocks.for_each([&](uint64_t /* height */, const buffer& blk) {
+            ser.write(blk.data(), blk.size());
+        });
+        return ser;
+    }
+
+    auto operator>>(serializer& deser, atomizer::block_store& blocks)
+        -> serializer& {
+        blocks.clear();
+        uint64_t count{};
+        if(!(deser >> count)) {
+            return deser;
+        }
+        for(uint64_t i = 0; i < count; i++) {
+            auto blk = atomizer::block();
+            if(!(deser >> blk)) {
+                return deser;
+            }
+            blocks.add(blk);
+        }
+        return deser;
+    }
+
     auto operator<<(serializer& packet,
                     const cbdc::atomizer::tx_notify_request& msg)
         -> serializer& {
@@ -60,6 +85,34 @@ namespace cbdc {
         return packet;
     }
 
+    auto operator<<(serializer& packet,
+                    const cbdc::atomizer::tx_attestation_notify_request& msg)
+        -> serializer& {
+        return packet << msg.m_block_height << msg.m_tx_id
+                      << msg.m_attestations;
+    }
+
+    auto operator>>(serializer& packet,
+                    cbdc::atomizer::tx_attestation_notify_request& msg)
+        -> serializer& {
+        return packet >> msg.m_block_height >> msg.m_tx_id
+            >> msg.m_attestations;
+    }
+
+    auto operator<<(serializer& packet,
+                    const cbdc::atomizer::tx_notify_batch_request& msg)
+        -> serializer& {
+        return packet << msg.m_notifications
+                      << msg.m_attestation_notifications;
+    }
+
+    auto operator>>(serializer& packet,
+                    cbdc::atomizer::tx_notify_batch_request& msg)
+        -> serializer& {
+        return packet >> msg.m_notifications
+            >> msg.m_attestation_notifications;
+    }
+
     auto operator<<(serializer& packet,
                     const cbdc::atomizer::aggregate_tx_notification& msg)
         -> serializer& {
@@ -116,19 +169,19 @@ namespace cbdc {
 
     auto operator<<(serializer& ser, const atomizer::make_block_response& r)
         -> serializer& {
-        return ser << r.m_blk << r.m_errs;
+        return ser << r.m_height << r.m_tx_count << r.m_errs;
     }
     auto operator>>(serializer& deser, atomizer::make_block_response& r)
         -> serializer& {
-        return deser >> r.m_blk >> r.m_errs;
+        return deser >> r.m_height >> r.m_tx_count >> r.m_errs;
     }
 
     auto operator<<(serializer& ser, const atomizer::get_block_response& r)
         -> serializer& {
-        return ser << r.m_blk;
+        return ser << r.m_height;
     }
     auto operator>>(serializer& deser, atomizer::get_block_response& r)
         -> serializer& {
-        return deser >> r.m_blk;
+        return deser >> r.m_height;
     }
 }
@@ -33,11 +33,29 @@ namespace cbdc {
     auto operator>>(serializer& packet, atomizer::tx_notify_request& msg)
         -> serializer&;
 
+    auto operator<<(serializer& packet,
+                    const atomizer::tx_attestation_notify_request& msg)
+        -> serializer&;
+    auto operator>>(serializer& packet,
+                    atomizer::tx_attestation_notify_request& msg)
+        -> serializer&;
+
+    auto operator<<(serializer& packet,
+                    const atomizer::tx_notify_batch_request& msg)
+        -> serializer&;
+    auto operator>>(serializer& packet, atomizer::tx_notify_batch_request& msg)
+        -> serializer&;
+
     auto operator<<(serializer& packet, const cbdc::atomizer::block& blk)
         -> serializer&;
     auto operator>>(serializer& packet, cbdc::atomizer::block& blk)
         -> serializer&;
 
+    auto operator<<(serializer& ser, const atomizer::block_store& blocks)
+        -> serializer&;
+    auto operator>>(serializer& deser, atomizer::block_store& blocks)
+        -> serializer&;
+
     auto operator<<(serializer& ser, const atomizer::prune_request& r)
         -> serializer&;
     auto operator>>(serializer& deser, atomizer::prune_request& r)
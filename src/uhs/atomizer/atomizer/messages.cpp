@@ -12,6 +12,52 @@ namespace cbdc::atomizer {
             && (rhs.m_block_height == m_block_height);
     }
 
+    auto tx_attestation_notify_request::operator==(
+        const tx_attestation_notify_request& rhs) const -> bool {
+        return (rhs.m_tx_id == m_tx_id)
+            && (rhs.m_attestations == m_attestations)
+            && (rhs.m_block_height == m_block_height);
+    }
+
+    auto tx_notify_batch_request::operator==(
+        const tx_notify_batch_request& rhs) const -> bool {
+        return (rhs.m_notifications == m_notifications)
+            && (rhs.m_attestation_notifications
+                == m_attestation_notifications);
+    }
+
+    auto make_attestation_notify(const tx_notify_request& notif)
+        -> tx_attestation_notify_request {
+        static constexpr auto word_bits = sizeof(uint64_t) * 8;
+        auto ret = tx_attestation_notify_request();
+        ret.m_tx_id = notif.m_tx.m_id;
+        ret.m_block_height = notif.m_block_height;
+        ret.m_attestations.resize(
+            (notif.m_tx.m_inputs.size() + word_bits - 1) / word_bits);
+        for(auto idx : notif.m_attestations) {
+            if(idx >= notif.m_tx.m_inputs.size()) {
+                continue;
+            }
+            ret.m_attestations[idx / word_bits] |= uint64_t{1}
+                                                << (idx % word_bits);
+        }
+        return ret;
+    }
+
+    auto attested_inputs(const tx_attestation_notify_request& notif)
+        -> std::vector<uint64_t> {
+        static constexpr auto word_bits = sizeof(uint64_t) * 8;
+        auto ret = std::vector<uint64_t>();
+        for(size_t i = 0; i < notif.m_attestations.size(); i++) {
+            for(size_t j = 0; j < word_bits; j++) {
+                if((notif.m_attestations[i] >> j) & 1) {
+                    ret.push_back(i * word_bits + j);
+                }
+            }
+        }
+        return ret;
+    }
+
     auto aggregate_tx_notification::operator==(
         const aggregate_tx_notification& rhs) const -> bool {
         return (rhs.m_oldest_attestation == m_oldest_attestation)
@@ -30,6 +30,56 @@ namespace cbdc::atomizer {
         uint64_t m_block_height{};
     };
 
+    /// \brief Transaction notification message without the transaction body.
+    ///
+    /// Sent from shards to the atomizer in place of a \ref tx_notify_request
+    /// when the shard is not responsible for the transaction's first input.
+    /// The shard holding the first input sends the full notification with
+    /// which the atomizer joins this one, so the transaction body crosses
+    /// the network once rather than once per shard.
+    struct tx_attestation_notify_request {
+        auto operator==(const tx_attestation_notify_request& rhs) const
+            -> bool;
+
+        /// ID of the transaction associated with the notification.
+        hash_t m_tx_id{};
+        /// Bitmap of the input indexes the shard is attesting are unspent at
+        /// the given block height. Bit i of word i / 64 is set if input i is
+        /// attested.
+        std::vector<uint64_t> m_attestations;
+        /// Block height at which the given input attestations are valid.
+        uint64_t m_block_height{};
+    };
+
+    /// Converts a transaction notification into a notification without the
+    /// transaction body.
+    /// \param notif full transaction notification.
+    /// \return attestation-only notification.
+    auto make_attestation_notify(const tx_notify_request& notif)
+        -> tx_attestation_notify_request;
+
+    /// Returns the input indexes set in the bitmap of an attestation-only
+    /// notification.
+    /// \param notif attestation-only notification.
+    /// \return attested input indexes in ascending order.
+    auto attested_inputs(const tx_attestation_notify_request& notif)
+        -> std::vector<uint64_t>;
+
+    /// \brief Batch of transaction notifications.
+    ///
+    /// Sent from shards to the atomizer in place of individual notification
+    /// messages, so that a shard sends one message per batch of transactions
+    /// it digests.
+    struct tx_notify_batch_request {
+        auto operator==(const tx_notify_batch_request& rhs) const -> bool;
+
+        /// Full transaction notifications.
+        std::vector<tx_notify_request> m_notifications;
+        /// Attestation-only transaction notifications.
+        std::vector<tx_attestation_notify_request>
+            m_attestation_notifications;
+    };
+
     /// \brief Transaction notification message with a full set of input
     ///        attestations.
     ///
@@ -79,23 +129,30 @@ namespace cbdc::atomizer {
     /// List of watchtower errors returned by the atomizer state machine.
     using errors = std::vector<watchtower::tx_error>;
 
-    /// Response from atomizer state machine to a make block request.
+    /// Response from atomizer state machine to a make block request. The
+    /// block itself is retained by the state machine in serialized form.
     struct make_block_response {
-        /// Block generated by request.
-        block m_blk;
+        /// Height of the block generated by request.
+        uint64_t m_height{};
+        /// Number of transactions in the block.
+        uint64_t m_tx_count{};
         /// Watchtower errors resulting from block creation.
         errors m_errs;
     };
 
-    /// Atomizer state machine response from get block request.
+    /// Atomizer state machine response from get block request, indicating
+    /// that the state machine retains the requested block.
     struct get_block_response {
-        /// Block returned by request.
-        block m_blk;
+        /// Height of the requested block.
+        uint64_t m_height{};
     };
 
     /// Atomizer RPC request.
-    using request
-        = std::variant<tx_notify_request, prune_request, get_block_request>;
+    using request = std::variant<tx_notify_request,
+                                 prune_request,
+                                 get_block_request,
+                                 tx_attestation_notify_request,
+                                 tx_notify_batch_request>;
 }
 
 #endif
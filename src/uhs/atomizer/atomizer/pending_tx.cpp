@@ -0,0 +1,134 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pending_tx.hpp"
+
+#include "uhs/transaction/messages.hpp"
+#include "util/serialization/format.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+namespace cbdc::atomizer {
+    pending_tx::pending_tx(transaction::compact_tx tx)
+        : m_tx(std::move(tx)),
+          m_words(word_count()) {}
+
+    auto pending_tx::add(uint64_t height,
+                         const std::unordered_set<uint32_t>& attestations)
+        -> bool {
+        auto idx = size_t();
+        while(idx < m_heights.size() && m_heights[idx] != height) {
+            idx++;
+        }
+
+        const auto added = idx == m_heights.size();
+        if(added) {
+            if(m_heights.empty() || height < m_oldest_height) {
+                m_oldest_height = height;
+            }
+            m_heights.push_back(height);
+            m_bits.resize(m_bits.size() + m_words);
+        }
+
+        auto* bits = m_bits.data() + idx * m_words;
+        for(const auto& att : attestations) {
+            if(att < m_tx.m_inputs.size()) {
+                bits[att / bits_per_word] |= uint64_t{1}
+                                          << (att % bits_per_word);
+            }
+        }
+
+        return added;
+    }
+
+    auto pending_tx::evict(uint64_t height) -> bool {
+        auto it = std::find(m_heights.begin(), m_heights.end(), height);
+        if(it == m_heights.end()) {
+            return false;
+        }
+
+        // Swap the evicted height's bitmap with the last one so removal
+        // does not shift the remaining bitmaps.
+        const auto idx = static_cast<size_t>(it - m_heights.begin());
+        const auto last = m_heights.size() - 1;
+        if(idx != last) {
+            m_heights[idx] = m_heights[last];
+            std::copy_n(m_bits.begin()
+                            + static_cast<std::ptrdiff_t>(last * m_words),
+                        m_words,
+                        m_bits.begin()
+                            + static_cast<std::ptrdiff_t>(idx * m_words));
+        }
+        m_heights.pop_back();
+        m_bits.resize(m_bits.size() - m_words);
+
+        if(!m_heights.empty() && height == m_oldest_height) {
+            m_oldest_height
+                = *std::min_element(m_heights.begin(), m_heights.end());
+        }
+
+        return true;
+    }
+
+    auto pending_tx::complete() const -> bool {
+        size_t attested{0};
+        for(size_t w = 0; w < m_words; w++) {
+            uint64_t word{0};
+            for(size_t h = 0; h < m_heights.size(); h++) {
+                word |= m_bits[h * m_words + w];
+            }
+            attested += std::bitset<bits_per_word>(word).count();
+        }
+        return attested == m_tx.m_inputs.size();
+    }
+
+    auto pending_tx::empty() const -> bool {
+        return m_heights.empty();
+    }
+
+    auto pending_tx::oldest_height() const -> uint64_t {
+        return m_oldest_height;
+    }
+
+    auto pending_tx::tx() const -> const transaction::compact_tx& {
+        return m_tx;
+    }
+
+    auto pending_tx::take_tx() -> transaction::compact_tx {
+        return std::move(m_tx);
+    }
+
+    auto pending_tx::operator==(const pending_tx& rhs) const -> bool {
+        return m_tx == rhs.m_tx && m_heights == rhs.m_heights
+            && m_bits == rhs.m_bits;
+    }
+
+    auto pending_tx::word_count() const -> size_t {
+        return (m_tx.m_inputs.size() + bits_per_word - 1) / bits_per_word;
+    }
+}
+
+namespace cbdc {
+    auto operator<<(serializer& ser, const atomizer::pending_tx& ptx)
+        -> serializer& {
+        return ser << ptx.m_tx << ptx.m_heights << ptx.m_bits;
+    }
+
+    auto operator>>(serializer& deser, atomizer::pending_tx& ptx)
+        -> serializer& {
+        ptx = atomizer::pending_tx();
+        if(!(deser >> ptx.m_tx >> ptx.m_heights >> ptx.m_bits)) {
+            return deser;
+        }
+        ptx.m_words = ptx.word_count();
+        ptx.m_bits.resize(ptx.m_heights.size() * ptx.m_words);
+        if(!ptx.m_heights.empty()) {
+            ptx.m_oldest_height = *std::min_element(ptx.m_heights.begin(),
+                                                    ptx.m_heights.end());
+        }
+        return deser;
+    }
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_ATOMIZER_PENDING_TX_H_
+#define OPENCBDC_TX_SRC_ATOMIZER_PENDING_TX_H_
+
+#include "uhs/transaction/transaction.hpp"
+#include "util/serialization/serializer.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+namespace cbdc::atomizer {
+    class pending_tx;
+}
+
+namespace cbdc {
+    /// Serializes a pending transaction.
+    auto operator<<(serializer& ser, const atomizer::pending_tx& ptx)
+        -> serializer&;
+
+    /// Deserializes a pending transaction.
+    auto operator>>(serializer& deser, atomizer::pending_tx& ptx)
+        -> serializer&;
+}
+
+namespace cbdc::atomizer {
+    /// \brief Transaction awaiting attestations for all of its inputs.
+    ///
+    /// Stores the input attestations received from shards as one bitmap per
+    /// block height at which attestations were provided. Each bitmap has
+    /// one bit per transaction input. The transaction is complete once the
+    /// union of the bitmaps covers every input.
+    class pending_tx {
+      public:
+        pending_tx() = default;
+
+        /// Constructor.
+        /// \param tx transaction to accumulate attestations for.
+        explicit pending_tx(transaction::compact_tx tx);
+
+        /// Merges the given input attestations provided at the given block
+        /// height. Ignores input indices outside the transaction.
+        /// \param height block height at which the shard attested to the
+        ///               inputs.
+        /// \param attestations indices of the attested inputs.
+        /// \return true if this is the first set of attestations at the given
+        ///         height.
+        auto add(uint64_t height,
+                 const std::unordered_set<uint32_t>& attestations) -> bool;
+
+        /// Discards the attestations provided at the given block height.
+        /// \param height block height to discard.
+        /// \return true if there were attestations at the given height.
+        auto evict(uint64_t height) -> bool;
+
+        /// Returns whether every input has been attested to at some height.
+        /// \return true if the transaction is complete.
+        [[nodiscard]] auto complete() const -> bool;
+
+        /// Returns whether the transaction has no attestations at any height.
+        /// \return true if there are no attestations.
+        [[nodiscard]] auto empty() const -> bool;
+
+        /// Returns the lowest block height with attestations.
+        /// \return oldest attestation height. Undefined if \ref empty.
+        [[nodiscard]] auto oldest_height() const -> uint64_t;
+
+        /// Returns the pending transaction.
+        /// \return compact transaction.
+        [[nodiscard]] auto tx() const -> const transaction::compact_tx&;
+
+        /// Moves the transaction out of this object.
+        /// \return compact transaction.
+        [[nodiscard]] auto take_tx() -> transaction::compact_tx;
+
+        auto operator==(const pending_tx& rhs) const -> bool;
+
+        friend auto cbdc::operator<<(serializer& ser, const pending_tx& ptx)
+            -> serializer&;
+        friend auto cbdc::operator>>(serializer& deser, pending_tx& ptx)
+            -> serializer&;
+
+      private:
+        static constexpr size_t bits_per_word = 64;
+
+        transaction::compact_tx m_tx;
+        /// Block heights with attestations, in the order received.
+        std::vector<uint64_t> m_heights;
+        /// Attestation bitmaps, one per entry in m_heights, each of
+        /// m_words words.
+        std::vector<uint64_t> m_bits;
+        size_t m_words{};
+        uint64_t m_oldest_height{};
+
+        [[nodiscard]] auto word_count() const -> size_t;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_ATOMIZER_PENDING_TX_H_
@@ -8,31 +8,57 @@
 #include "atomizer.hpp"
 #include "atomizer_raft.hpp"
 #include "format.hpp"
+#include "util/common/mapped_file.hpp"
 #include "util/raft/serialization.hpp"
 #include "util/raft/util.hpp"
+#include "util/serialization/buffer_serializer.hpp"
 #include "util/serialization/format.hpp"
 #include "util/serialization/istream_serializer.hpp"
 #include "util/serialization/ostream_serializer.hpp"
 #include "util/serialization/util.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <libnuraft/nuraft.hxx>
 #include <utility>
 
 namespace cbdc::atomizer {
     state_machine::state_machine(size_t stxo_cache_depth,
-                                 std::string snapshot_dir)
-        : m_snapshot_dir(std::move(snapshot_dir)),
-          m_stxo_cache_depth(stxo_cache_depth) {
-        m_atomizer = std::make_shared<atomizer>(0, m_stxo_cache_depth);
-        m_blocks = std::make_shared<decltype(m_blocks)::element_type>();
+                                 size_t stxo_filter_capacity,
+                                 std::string snapshot_dir,
+                                 size_t apply_threads,
+                                 std::string blocks_dir,
+                                 size_t block_memory_limit)
+        : m_blocks_dir(std::move(blocks_dir)),
+          m_block_memory_limit(block_memory_limit),
+          m_snapshot_dir(std::move(snapshot_dir)),
+          m_stxo_cache_depth(stxo_cache_depth),
+          m_stxo_filter_capacity(stxo_filter_capacity),
+          m_apply_threads(apply_threads) {
+        m_atomizer = std::make_shared<atomizer>(0,
+                                                m_stxo_cache_depth,
+                                                m_stxo_filter_capacity);
+        m_blocks = std::make_shared<block_store>(m_blocks_dir,
+                                                 m_block_memory_limit);
         auto err = std::error_code();
         std::filesystem::create_directory(m_snapshot_dir, err);
         if(err) {
             std::exit(EXIT_FAILURE);
         }
-        auto snp = state_machine::last_snapshot();
-        if(snp) {
+        // Remove temporary files left behind by a previous run
+        for(const auto& p :
+            std::filesystem::directory_iterator(m_snapshot_dir, err)) {
+            if(!is_snapshot_name(p.path().filename().generic_string())) {
+                std::filesystem::remove(p, err);
+            }
+        }
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto idx = newest_snapshot_idx();
+        if(idx != 0) {
+            auto snp = read_snapshot_meta(idx);
             if(!state_machine::apply_snapshot(*snp)) {
                 std::exit(EXIT_FAILURE);
             }
@@ -50,17 +76,15 @@ namespace cbdc::atomizer {
             overloaded{
                 [&](aggregate_tx_notify_request& r)
                     -> std::optional<response> {
-                    auto errs = errors();
-                    for(auto&& msg : r.m_agg_txs) {
-                        auto err = m_atomizer->insert_complete(
-                            msg.m_oldest_attestation,
-                            std::move(msg.m_tx));
-
-                        if(err.has_value()) {
-                            errs.push_back(*err);
-                        }
-                        m_tx_notify_count++;
+                    m_tx_notify_count += r.m_agg_txs.size();
+                    auto errs = m_atomizer->insert_complete_batch(
+                        std::move(r.m_agg_txs),
+                        m_apply_threads);
+                    {
+                        std::unique_lock<std::mutex> l(m_stats_mut);
+                        m_stxo_filter_stats = m_atomizer->stxo_filter_stats();
                     }
+                    update_pending_block();
 
                     if(!errs.empty()) {
                         return errs;
@@ -71,24 +95,35 @@ namespace cbdc::atomizer {
                 [&](const make_block_request& /* r */)
                     -> std::optional<response> {
                     auto [blk, errs] = m_atomizer->make_block();
-                    m_blocks->emplace(blk.m_height, blk);
-                    return make_block_response{blk, errs};
+                    {
+                        // Serialize the block once for the store and every
+                        // peer it is sent to
+                        std::unique_lock<std::mutex> l(m_blocks_mut);
+                        m_blocks->add(blk);
+                    }
+                    update_block_stats();
+                    update_pending_block();
+                    return make_block_response{blk.m_height,
+                                               blk.m_transactions.size(),
+                                               std::move(errs)};
                 },
                 [&](const get_block_request& r) -> std::optional<response> {
-                    auto it = m_blocks->find(r.m_block_height);
-                    if(it != m_blocks->end()) {
-                        return get_block_response{it->second};
+                    // The caller reads the block itself, so only check it
+                    // is still in the store
+                    std::unique_lock<std::mutex> l(m_blocks_mut);
+                    if(m_blocks->contains(r.m_block_height)) {
+                        return get_block_response{r.m_block_height};
                     }
                     return std::nullopt;
                 },
                 [&](const prune_request& r) -> std::optional<response> {
-                    for(auto it = m_blocks->begin(); it != m_blocks->end();) {
-                        if(it->second.m_height < r.m_block_height) {
-                            it = m_blocks->erase(it);
-                        } else {
-                            it++;
-                        }
+                    m_snp_prune_height
+                        = std::max(m_snp_prune_height, r.m_block_height);
+                    {
+                        std::unique_lock<std::mutex> l(m_blocks_mut);
+                        m_blocks->prune(r.m_block_height);
                     }
+                    update_block_stats();
                     return std::nullopt;
                 },
             },
@@ -109,40 +144,32 @@ namespace cbdc::atomizer {
 
     auto
     state_machine::read_logical_snp_obj(nuraft::snapshot& s,
-                                        void*& /* user_snp_ctx */,
-                                        nuraft::ulong /* obj_id */,
+                                        void*& user_snp_ctx,
+                                        nuraft::ulong obj_id,
                                         nuraft::ptr<nuraft::buffer>& data_out,
                                         bool& is_last_obj) -> int {
-        auto path = get_snapshot_path(s.get_last_log_idx());
-        {
-            std::shared_lock<std::shared_mutex> l(m_snp_mut);
-            auto ss = std::ifstream(path, std::ios::in | std::ios::binary);
-            if(!ss.good()) {
+        auto* file = static_cast<mapped_file*>(user_snp_ctx);
+        if(file == nullptr) {
+            // Keep the file mapped for the rest of the transfer. The mapping
+            // remains valid if the snapshot is deleted in the meantime.
+            auto mapped = materialize_snapshot(s.get_last_log_idx());
+            if(!mapped) {
                 // Requested snapshot doesn't exit anymore, not fatal
                 return -1;
             }
-            auto err = std::error_code();
-            auto sz = std::filesystem::file_size(path, err);
-            if(err) {
-                // If we got this far, this should work unless our system is
-                // broken
-                std::exit(EXIT_FAILURE);
-            }
-            auto buf = nuraft::buffer::alloc(sz);
-            auto read_vec = std::vector<char>(sz);
-            ss.read(read_vec.data(),
-                    static_cast<std::streamsize>(buf->size()));
-            if(!ss.good()) {
-                // If we got this far, this should work unless our system is
-                // broken
-                std::exit(EXIT_FAILURE);
-            }
-            std::memcpy(buf->data_begin(), read_vec.data(), sz);
-            data_out = std::move(buf);
+            file = new mapped_file(std::move(mapped.value()));
+            user_snp_ctx = file;
         }
 
-        // TODO: send and receive in chunks
-        is_last_obj = true;
+        const auto offset = obj_id * m_snp_chunk_size;
+        if(offset >= file->size()) {
+            return -1;
+        }
+        const auto sz = std::min(m_snp_chunk_size, file->size() - offset);
+        auto buf = nuraft::buffer::alloc(sz);
+        std::memcpy(buf->data_begin(), file->data() + offset, sz);
+        data_out = std::move(buf);
+        is_last_obj = offset + sz == file->size();
 
         return 0;
     }
@@ -151,57 +178,95 @@ namespace cbdc::atomizer {
                                              nuraft::ulong& obj_id,
                                              nuraft::buffer& data,
                                              bool /* is_first_obj */,
-                                             bool /* is_last_obj */) {
-        assert(obj_id == 0);
-        auto tmp_path = get_tmp_path();
-        {
-            std::unique_lock<std::shared_mutex> l(m_snp_mut);
-            auto ss = std::ofstream(tmp_path,
-                                    std::ios::out | std::ios::trunc
-                                        | std::ios::binary);
-            if(!ss.good()) {
-                // Since we're the exclusive writer, this should work
-                std::exit(EXIT_FAILURE);
-            }
+                                             bool is_last_obj) {
+        auto recv_path = get_recv_path();
+        std::unique_lock<std::shared_mutex> l(m_snp_mut);
+        auto mode = std::ios::out | std::ios::binary;
+        if(m_recv_idx != s.get_last_log_idx()) {
+            // Objects of a different snapshot start a new transfer
+            m_recv_idx = s.get_last_log_idx();
+            m_recv_objs.clear();
+            m_recv_last_obj.reset();
+            mode |= std::ios::trunc;
+        } else {
+            mode |= std::ios::in;
+        }
+        auto ss = std::ofstream(recv_path, mode);
+        if(!ss.good()) {
+            // Since we're the exclusive writer, this should work
+            std::exit(EXIT_FAILURE);
+        }
 
-            auto write_vec = std::vector<char>(data.size());
-            std::memcpy(write_vec.data(), data.data_begin(), data.size());
-            ss.write(write_vec.data(),
-                     static_cast<std::streamsize>(data.size()));
-            if(!ss.good()) {
-                std::exit(EXIT_FAILURE);
-            }
+        // Objects are written at their offset so a transfer can resume from
+        // any object ID.
+        ss.seekp(static_cast<std::streamoff>(obj_id * m_snp_chunk_size));
+        ss.write(reinterpret_cast<const char*>(data.data_begin()),
+                 static_cast<std::streamsize>(data.size()));
+        if(!ss.good()) {
+            std::exit(EXIT_FAILURE);
+        }
 
-            ss.flush();
-            ss.close();
+        ss.flush();
+        ss.close();
+
+        m_recv_objs.insert(obj_id);
+        if(is_last_obj) {
+            m_recv_last_obj = obj_id;
+        }
 
-            auto path = get_snapshot_path(s.get_last_log_idx());
+        // Ask for the first object missing from the file next
+        uint64_t next_obj{0};
+        for(auto id : m_recv_objs) {
+            if(id != next_obj) {
+                break;
+            }
+            next_obj++;
+        }
+        obj_id = next_obj;
+
+        if(m_recv_last_obj.has_value()
+           && next_obj > m_recv_last_obj.value()) {
+            auto path = get_snapshot_path(m_recv_idx);
             auto err = std::error_code();
-            std::filesystem::rename(tmp_path, path, err);
+            std::filesystem::rename(recv_path, path, err);
             if(err) {
                 std::exit(EXIT_FAILURE);
             }
+            m_recv_idx = 0;
+            m_recv_objs.clear();
+            m_recv_last_obj.reset();
         }
+    }
 
-        obj_id++;
+    void state_machine::free_user_snp_ctx(void*& user_snp_ctx) {
+        delete static_cast<mapped_file*>(user_snp_ctx);
+        user_snp_ctx = nullptr;
     }
 
     auto state_machine::apply_snapshot(nuraft::snapshot& s) -> bool {
-        auto snp = read_snapshot(s.get_last_log_idx());
+        auto n_deltas = size_t();
+        auto snp = read_snapshot(s.get_last_log_idx(), n_deltas);
         if(snp) {
-            m_blocks = snp->m_blocks;
+            // The snapshot's store is subject to the same memory limit, so
+            // it can replace the existing one without copying the blocks
+            {
+                std::unique_lock<std::mutex> l(m_blocks_mut);
+                m_blocks = snp->m_blocks;
+            }
+            update_block_stats();
             m_atomizer = snp->m_atomizer;
+            update_pending_block();
             m_last_committed_idx = s.get_last_log_idx();
+            reset_snapshot_delta(s.get_last_log_idx(), n_deltas);
+            std::unique_lock<std::shared_mutex> l(m_snp_mut);
+            m_last_snp = snp->m_snp;
         }
         return snp.has_value();
     }
 
     auto state_machine::last_snapshot() -> nuraft::ptr<nuraft::snapshot> {
-        auto snp = read_snapshot(0);
-        if(!snp) {
-            return nullptr;
-        }
-        return snp->m_snp;
+        std::shared_lock<std::shared_mutex> l(m_snp_mut);
+        return m_last_snp;
     }
 
     auto state_machine::last_commit_index() -> nuraft::ulong {
@@ -220,6 +285,12 @@ namespace cbdc::atomizer {
                             nuraft::snapshot::deserialize(*snp_ser),
                             m_blocks};
 
+        // Write a full image if there is no previous snapshot to build on or
+        // the delta chain is at its maximum length. Otherwise only write the
+        // changes since the previous snapshot.
+        const auto write_base = m_snp_last_idx == 0
+                             || m_snp_n_deltas >= m_max_snapshot_deltas;
+
         auto tmp_path = get_tmp_path();
         auto path = get_snapshot_path(s.get_last_log_idx());
         {
@@ -234,8 +305,32 @@ namespace cbdc::atomizer {
             }
 
             auto ser = cbdc::ostream_serializer(ss);
-            if(!(ser << snp)) {
-                std::exit(EXIT_FAILURE);
+            if(write_base) {
+                if(!(ser << snapshot_type::base << snp)) {
+                    std::exit(EXIT_FAILURE);
+                }
+            } else {
+                // Written in the format of std::vector<block> from the
+                // already serialized blocks
+                auto new_blocks = std::vector<std::shared_ptr<buffer>>();
+                for(auto h = m_snp_block_height + 1; h <= m_atomizer->height();
+                    h++) {
+                    auto data = m_blocks->get_serialized(h);
+                    if(data) {
+                        new_blocks.push_back(std::move(data));
+                    }
+                }
+                ser << snapshot_type::delta << m_snp_last_idx
+                    << static_cast<uint64_t>(snp_ser->size());
+                ser.write(snp_ser->data_begin(), snp_ser->size());
+                ser << m_atomizer->serialize_delta() << m_snp_prune_height
+                    << static_cast<uint64_t>(new_blocks.size());
+                for(const auto& data : new_blocks) {
+                    ser.write(data->data(), data->size());
+                }
+                if(!ser) {
+                    std::exit(EXIT_FAILURE);
+                }
             }
 
             ss.flush();
@@ -246,12 +341,20 @@ namespace cbdc::atomizer {
             if(err) {
                 std::exit(EXIT_FAILURE);
             }
+            snp.m_snp->set_size(std::filesystem::file_size(path, err));
+            if(err) {
+                std::exit(EXIT_FAILURE);
+            }
+            m_last_snp = snp.m_snp;
 
             for(const auto& p :
                 std::filesystem::directory_iterator(m_snapshot_dir)) {
+                // Snapshots before a new base are no longer needed. Earlier
+                // snapshots in the current delta chain are.
                 auto name = p.path().filename().generic_string();
                 if(name == m_tmp_file
-                   || std::stoull(name) < s.get_last_log_idx()) {
+                   || (write_base && is_snapshot_name(name)
+                       && std::stoull(name) < s.get_last_log_idx())) {
                     std::filesystem::remove(p, err);
                     if(err) {
                         std::exit(EXIT_FAILURE);
@@ -260,6 +363,9 @@ namespace cbdc::atomizer {
             }
         }
 
+        reset_snapshot_delta(s.get_last_log_idx(),
+                             write_base ? 0 : m_snp_n_deltas + 1);
+
         when_done(ret, except);
     }
 
@@ -267,6 +373,45 @@ namespace cbdc::atomizer {
         return m_tx_notify_count;
     }
 
+    auto state_machine::stxo_filter_stats() -> stxo_cache::filter_stats {
+        std::unique_lock<std::mutex> l(m_stats_mut);
+        return m_stxo_filter_stats;
+    }
+
+    auto state_machine::block_retention_stats()
+        -> block_store::retention_stats {
+        std::unique_lock<std::mutex> l(m_stats_mut);
+        return m_block_stats;
+    }
+
+    auto state_machine::get_serialized_block(uint64_t height)
+        -> std::shared_ptr<buffer> {
+        std::unique_lock<std::mutex> l(m_blocks_mut);
+        return m_blocks->get_serialized(height);
+    }
+
+    auto state_machine::pending_block_stats() -> pending_block {
+        std::unique_lock<std::mutex> l(m_stats_mut);
+        return m_pending_block;
+    }
+
+    void state_machine::update_pending_block() {
+        const auto txs = m_atomizer->pending_transactions();
+        const auto bytes = m_atomizer->pending_bytes();
+        std::unique_lock<std::mutex> l(m_stats_mut);
+        if(m_pending_block.m_txs == 0 && txs > 0) {
+            m_pending_block.m_oldest = std::chrono::steady_clock::now();
+        }
+        m_pending_block.m_txs = txs;
+        m_pending_block.m_bytes = bytes;
+    }
+
+    void state_machine::update_block_stats() {
+        auto stats = m_blocks->stats();
+        std::unique_lock<std::mutex> l(m_stats_mut);
+        m_block_stats = stats;
+    }
+
     auto state_machine::get_snapshot_path(uint64_t idx) const -> std::string {
         return m_snapshot_dir + "/" + std::to_string(idx);
     }
@@ -275,59 +420,258 @@ namespace cbdc::atomizer {
         return m_snapshot_dir + "/" + m_tmp_file;
     }
 
-    auto state_machine::read_snapshot(uint64_t idx)
-        -> std::optional<snapshot> {
-        std::shared_lock<std::shared_mutex> l(m_snp_mut);
-        auto open_fail_fatal = false;
-        if(idx == 0) {
-            uint64_t max_idx{0};
-            auto err = std::error_code();
-            for(const auto& p :
-                std::filesystem::directory_iterator(m_snapshot_dir, err)) {
-                if(err) {
-                    std::exit(EXIT_FAILURE);
-                }
-                auto name = p.path().filename().generic_string();
-                if(name == m_tmp_file) {
-                    continue;
-                }
-                auto f_idx = std::stoull(name);
-                if(f_idx > max_idx) {
-                    max_idx = f_idx;
-                }
-            }
+    auto state_machine::get_recv_path() const -> std::string {
+        return m_snapshot_dir + "/" + m_recv_file;
+    }
 
-            if(max_idx == 0) {
+    auto state_machine::get_xfer_path() -> std::string {
+        return m_snapshot_dir + "/" + m_xfer_prefix
+             + std::to_string(m_xfer_count++);
+    }
+
+    auto state_machine::is_snapshot_name(const std::string& name) -> bool {
+        return !name.empty()
+            && std::all_of(name.begin(), name.end(), [](char c) {
+                   return std::isdigit(static_cast<unsigned char>(c)) != 0;
+               });
+    }
+
+    auto state_machine::materialize_snapshot(uint64_t idx)
+        -> std::optional<mapped_file> {
+        auto chain = std::vector<snapshot_file>();
+        {
+            std::shared_lock<std::shared_mutex> l(m_snp_mut);
+            auto files = open_snapshot_chain(idx);
+            if(!files) {
                 return std::nullopt;
             }
+            if(files->size() == 1) {
+                auto mapped = mapped_file();
+                if(!mapped.open(get_snapshot_path(idx))) {
+                    return std::nullopt;
+                }
+                return mapped;
+            }
+            chain = std::move(files.value());
+        }
 
-            idx = max_idx;
-            open_fail_fatal = true;
+        // Other nodes need the full state, so replay the delta chain from
+        // the files opened above, which stay readable if a new base snapshot
+        // removes them in the meantime. Replaying outside of the lock keeps
+        // snapshot creation on the commit thread from waiting for it.
+        auto snp = replay_snapshot_chain(chain);
+        auto xfer_path = get_xfer_path();
+        {
+            auto ss = std::ofstream(xfer_path,
+                                    std::ios::out | std::ios::trunc
+                                        | std::ios::binary);
+            if(!ss.good()) {
+                std::exit(EXIT_FAILURE);
+            }
+            auto ser = cbdc::ostream_serializer(ss);
+            if(!(ser << snapshot_type::base << snp)) {
+                std::exit(EXIT_FAILURE);
+            }
+            ss.flush();
+        }
+        auto mapped = mapped_file();
+        if(!mapped.open(xfer_path)) {
+            std::exit(EXIT_FAILURE);
         }
 
+        // Replace the delta with the resulting image so later transfers can
+        // send it directly, unless it has been removed since. Later deltas
+        // are unaffected since the state at this index is unchanged.
+        std::unique_lock<std::shared_mutex> l(m_snp_mut);
         auto path = get_snapshot_path(idx);
+        auto err = std::error_code();
+        if(std::filesystem::exists(path, err)) {
+            std::filesystem::rename(xfer_path, path, err);
+        } else {
+            std::filesystem::remove(xfer_path, err);
+        }
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+        return mapped;
+    }
 
+    auto state_machine::make_block_store() -> std::shared_ptr<block_store> {
+        // Blocks loaded from snapshots spill to disk like the blocks of the
+        // live store, each store into its own directory
+        return std::make_shared<block_store>(
+            m_blocks_dir + "_load_" + std::to_string(m_load_count++),
+            m_block_memory_limit);
+    }
+
+    void state_machine::reset_snapshot_delta(uint64_t idx, size_t n_deltas) {
+        m_snp_last_idx = idx;
+        m_snp_n_deltas = n_deltas;
+        m_snp_block_height = m_atomizer->height();
+        m_snp_prune_height = 0;
+        m_atomizer->clear_delta();
+    }
+
+    auto state_machine::newest_snapshot_idx() -> uint64_t {
+        uint64_t max_idx{0};
+        auto err = std::error_code();
+        for(const auto& p :
+            std::filesystem::directory_iterator(m_snapshot_dir, err)) {
+            auto name = p.path().filename().generic_string();
+            if(!is_snapshot_name(name)) {
+                continue;
+            }
+            max_idx = std::max(max_idx,
+                               static_cast<uint64_t>(std::stoull(name)));
+        }
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+        return max_idx;
+    }
+
+    auto state_machine::read_snapshot_meta(uint64_t idx)
+        -> nuraft::ptr<nuraft::snapshot> {
+        // The metadata follows the type of the snapshot and, for a delta,
+        // the index of the previous snapshot, so the rest of the file is
+        // not read
+        auto path = get_snapshot_path(idx);
         auto ss = std::ifstream(path, std::ios::in | std::ios::binary);
         if(!ss.good()) {
-            if(open_fail_fatal) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto deser = cbdc::istream_serializer(ss);
+        auto type = snapshot_type();
+        if(!(deser >> type)) {
+            std::exit(EXIT_FAILURE);
+        }
+        if(type == snapshot_type::delta) {
+            uint64_t prev_idx{};
+            if(!(deser >> prev_idx)) {
                 std::exit(EXIT_FAILURE);
             }
-            return std::nullopt;
         }
+        uint64_t snp_sz{};
+        if(!(deser >> snp_sz)) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto snp_buf = nuraft::buffer::alloc(snp_sz);
+        if(!deser.read(snp_buf->data_begin(), snp_buf->size())) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto snp = nuraft::snapshot::deserialize(*snp_buf);
         auto err = std::error_code();
-        auto sz = std::filesystem::file_size(path, err);
+        snp->set_size(std::filesystem::file_size(path, err));
         if(err) {
             std::exit(EXIT_FAILURE);
         }
-        auto deser = cbdc::istream_serializer(ss);
-        auto new_atm = std::make_shared<atomizer>(0, m_stxo_cache_depth);
-        auto new_blocks = std::make_shared<decltype(m_blocks)::element_type>();
+        return snp;
+    }
+
+    auto state_machine::read_snapshot(uint64_t idx, size_t& n_deltas)
+        -> std::optional<snapshot> {
+        auto chain = std::vector<snapshot_file>();
+        {
+            std::shared_lock<std::shared_mutex> l(m_snp_mut);
+            auto files = open_snapshot_chain(idx);
+            if(!files) {
+                return std::nullopt;
+            }
+            chain = std::move(files.value());
+        }
+
+        n_deltas = chain.size() - 1;
+        return replay_snapshot_chain(chain);
+    }
+
+    auto state_machine::open_snapshot_chain(uint64_t idx)
+        -> std::optional<std::vector<snapshot_file>> {
+        // Open the snapshot and each previous snapshot its delta builds on,
+        // down to the base. Every snapshot in the chain must exist.
+        auto chain = std::vector<snapshot_file>();
+        while(true) {
+            auto path = get_snapshot_path(idx);
+            auto file = snapshot_file{
+                std::ifstream(path, std::ios::in | std::ios::binary),
+                0};
+            if(!file.m_stream.good()) {
+                if(!chain.empty()) {
+                    std::exit(EXIT_FAILURE);
+                }
+                return std::nullopt;
+            }
+            auto err = std::error_code();
+            file.m_size = std::filesystem::file_size(path, err);
+            if(err) {
+                std::exit(EXIT_FAILURE);
+            }
+            auto deser = cbdc::istream_serializer(file.m_stream);
+            auto type = snapshot_type();
+            if(!(deser >> type)) {
+                std::exit(EXIT_FAILURE);
+            }
+            if(type == snapshot_type::base) {
+                chain.push_back(std::move(file));
+                return chain;
+            }
+            uint64_t prev_idx{};
+            if(!(deser >> prev_idx) || prev_idx >= idx) {
+                std::exit(EXIT_FAILURE);
+            }
+            chain.push_back(std::move(file));
+            idx = prev_idx;
+        }
+    }
+
+    auto
+    state_machine::replay_snapshot_chain(std::vector<snapshot_file>& chain)
+        -> snapshot {
+        // Load the base image at the end of the chain, then apply the
+        // changes recorded in each delta in turn
+        auto new_atm = std::make_shared<atomizer>(0,
+                                                  m_stxo_cache_depth,
+                                                  m_stxo_filter_capacity);
+        auto new_blocks = make_block_store();
         auto snp
             = snapshot{std::move(new_atm), nullptr, std::move(new_blocks)};
-        if(!(deser >> snp)) {
-            std::exit(EXIT_FAILURE);
+        {
+            auto deser = cbdc::istream_serializer(chain.back().m_stream);
+            if(!(deser >> snp)) {
+                std::exit(EXIT_FAILURE);
+            }
         }
-        snp.m_snp->set_size(sz);
+
+        for(auto it = std::next(chain.rbegin()); it != chain.rend(); it++) {
+            auto deser = cbdc::istream_serializer(it->m_stream);
+            uint64_t snp_sz{};
+            if(!(deser >> snp_sz)) {
+                std::exit(EXIT_FAILURE);
+            }
+            auto snp_buf = nuraft::buffer::alloc(snp_sz);
+            if(!deser.read(snp_buf->data_begin(), snp_buf->size())) {
+                std::exit(EXIT_FAILURE);
+            }
+            snp.m_snp = nuraft::snapshot::deserialize(*snp_buf);
+
+            auto atm_delta = cbdc::buffer();
+            uint64_t prune_height{};
+            auto new_blks = std::vector<block>();
+            if(!(deser >> atm_delta >> prune_height >> new_blks)) {
+                std::exit(EXIT_FAILURE);
+            }
+            auto atm_deser = cbdc::buffer_serializer(atm_delta);
+            snp.m_atomizer->apply_delta(atm_deser);
+            if(!atm_deser) {
+                std::exit(EXIT_FAILURE);
+            }
+
+            snp.m_blocks->prune(prune_height);
+            for(auto& blk : new_blks) {
+                snp.m_blocks->add(std::move(blk));
+            }
+        }
+
+        snp.m_snp->set_size(chain.front().m_size);
         return snp;
     }
 }
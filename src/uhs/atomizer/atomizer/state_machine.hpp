@@ -7,24 +7,54 @@
 #define OPENCBDC_TX_SRC_ATOMIZER_STATE_MACHINE_H_
 
 #include "atomizer.hpp"
+#include "block_store.hpp"
 #include "messages.hpp"
+#include "util/common/mapped_file.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
 #include <libnuraft/nuraft.hxx>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <shared_mutex>
+#include <vector>
 
 namespace cbdc::atomizer {
     /// \brief Raft state machine for managing a replicated atomizer.
     ///
-    /// Contains a \ref atomizer and a cache of recently created blocks.
-    /// Accepts requests to retrieve and prune recent blocks from the cache.
+    /// Contains a \ref atomizer and a \ref block_store of recently created
+    /// blocks. Accepts requests to retrieve and prune recent blocks from the
+    /// store.
+    ///
+    /// Snapshots are stored as a base image of the full state followed by a
+    /// chain of deltas, each containing the spent UHS IDs, blocks and pruning
+    /// since the previous snapshot. A new base image is written once the
+    /// chain reaches a maximum length. Snapshots sent to other nodes are
+    /// always full images.
     class state_machine : public nuraft::state_machine {
       public:
         /// Constructor.
         /// \param stxo_cache_depth depth of the spent transaction output
         ///                         cache, passed to the atomizer.
+        /// \param stxo_filter_capacity initial capacity of the spent
+        ///                             transaction output filter, passed to
+        ///                             the atomizer.
         /// \param snapshot_dir path to directory in which to store snapshots.
         ///                     Will create the directory if it doesn't exist.
-        state_machine(size_t stxo_cache_depth, std::string snapshot_dir);
+        /// \param apply_threads number of worker threads to use when applying
+        ///                      aggregate transaction notifications.
+        /// \param blocks_dir path to directory in which to spill blocks
+        ///                   which exceed the block memory limit.
+        /// \param block_memory_limit maximum size in bytes of the blocks to
+        ///                           hold in memory.
+        state_machine(size_t stxo_cache_depth,
+                      size_t stxo_filter_capacity,
+                      std::string snapshot_dir,
+                      size_t apply_threads,
+                      std::string blocks_dir,
+                      size_t block_memory_limit);
 
         /// Atomizer state machine request.
         using request = std::variant<aggregate_tx_notify_request,
@@ -52,7 +82,12 @@ namespace cbdc::atomizer {
             nuraft::ptr<nuraft::cluster_config>& /*new_conf*/) override;
 
         /// Read the portion of the state machine snapshot associated with
-        /// the given metadata and object ID into a buffer.
+        /// the given metadata and object ID into a buffer. Each object is a
+        /// chunk of the snapshot file of at most \ref m_snp_chunk_size
+        /// bytes, read from a memory mapping of the file. Delta snapshots
+        /// are first rewritten as base snapshots. The delta chain is replayed
+        /// without holding the snapshot lock, so snapshot creation is not
+        /// blocked meanwhile.
         /// \param s metadata of snapshot to read.
         /// \param user_snp_ctx pointer to a snapshot context; must be provided
         ///                     to all successive calls to this method for the
@@ -71,12 +106,17 @@ namespace cbdc::atomizer {
 
         /// Saves the portion of the state machine snapshot associated with
         /// the given metadata and object ID into persistent storage.
+        /// Each object is written at its offset in a temporary file which
+        /// replaces the snapshot once every object up to the last has been
+        /// received, so objects may arrive in any order and a transfer can
+        /// resume from any object.
         /// \param s metadata of snapshot to save.
-        /// \param obj_id ID of the snapshot object to save.
+        /// \param obj_id ID of the snapshot object to save. Set to the
+        ///               lowest object ID not yet received.
         /// \param data buffer from which to read the snapshot object data to
         ///             save.
-        /// \param is_first_obj true if this object ID is the first snapshot
-        ///                     object.
+        /// \param is_first_obj unused. A new transfer starts whenever an
+        ///                     object of a different snapshot arrives.
         /// \param is_last_obj true if this object ID is the last snapshot
         ///                    object.
         void save_logical_snp_obj(nuraft::snapshot& s,
@@ -85,6 +125,10 @@ namespace cbdc::atomizer {
                                   bool is_first_obj,
                                   bool is_last_obj) override;
 
+        /// Releases the snapshot file mapping held by a snapshot context.
+        /// \param user_snp_ctx snapshot context from read_logical_snp_obj.
+        void free_user_snp_ctx(void*& user_snp_ctx) override;
+
         /// Replaces the state of the state machine with the state stored in
         /// the snapshot referenced by the given snapshot metadata.
         /// \param s snapshot metadata.
@@ -114,9 +158,40 @@ namespace cbdc::atomizer {
         /// \return transaction notification count.
         [[nodiscard]] auto tx_notify_count() -> uint64_t;
 
-        /// Maps block heights to blocks.
-        using blockstore_t
-            = std::unordered_map<uint64_t, cbdc::atomizer::block>;
+        /// Returns the atomizer's spent UHS ID filter counters as of the most
+        /// recently applied batch of transaction notifications.
+        /// \return filter statistics.
+        [[nodiscard]] auto stxo_filter_stats() -> stxo_cache::filter_stats;
+
+        /// Returns the number and size of the blocks retained for archivers
+        /// as of the most recent block creation or pruning.
+        /// \return block retention statistics.
+        [[nodiscard]] auto block_retention_stats()
+            -> block_store::retention_stats;
+
+        /// Complete transactions waiting to be included in the next block.
+        struct pending_block {
+            /// Number of transactions.
+            size_t m_txs{};
+            /// Serialized size of the transactions in bytes.
+            size_t m_bytes{};
+            /// Local time at which the oldest of the transactions was
+            /// applied.
+            std::chrono::steady_clock::time_point m_oldest{};
+        };
+
+        /// Returns the complete transactions waiting to be included in the
+        /// next block as of the most recently applied log entry.
+        /// \return pending block statistics.
+        [[nodiscard]] auto pending_block_stats() -> pending_block;
+
+        /// Returns the serialized block at the given height, if the state
+        /// machine retains it. Blocks held in memory are shared rather than
+        /// copied. Safe to call from any thread.
+        /// \param height height of the block.
+        /// \return serialized block, or nullptr if the block is not retained.
+        [[nodiscard]] auto get_serialized_block(uint64_t height)
+            -> std::shared_ptr<buffer>;
 
         /// Represents a snapshot of the state machine with associated
         /// metadata.
@@ -125,33 +200,130 @@ namespace cbdc::atomizer {
             std::shared_ptr<cbdc::atomizer::atomizer> m_atomizer;
             /// Pointer to the nuraft snapshot metadata.
             nuraft::ptr<nuraft::snapshot> m_snp{};
-            /// Pointer to the state of the block cache.
-            std::shared_ptr<blockstore_t> m_blocks{};
+            /// Pointer to the state of the block store.
+            std::shared_ptr<block_store> m_blocks{};
         };
 
       private:
+        /// Type of the state stored in a snapshot file.
+        enum class snapshot_type : uint8_t {
+            /// Full state machine image.
+            base = 0,
+            /// Changes since the snapshot at a previous log index.
+            delta = 1
+        };
+
         [[nodiscard]] auto get_snapshot_path(uint64_t idx) const
             -> std::string;
 
         [[nodiscard]] auto get_tmp_path() const -> std::string;
 
-        [[nodiscard]] auto read_snapshot(uint64_t idx)
+        [[nodiscard]] auto get_recv_path() const -> std::string;
+
+        [[nodiscard]] auto get_xfer_path() -> std::string;
+
+        [[nodiscard]] static auto is_snapshot_name(const std::string& name)
+            -> bool;
+
+        /// Snapshot file opened for reading, positioned after its header.
+        struct snapshot_file {
+            /// Stream of the file contents.
+            std::ifstream m_stream;
+            /// Size of the file in bytes.
+            uint64_t m_size{};
+        };
+
+        [[nodiscard]] auto materialize_snapshot(uint64_t idx)
+            -> std::optional<mapped_file>;
+
+        [[nodiscard]] auto newest_snapshot_idx() -> uint64_t;
+
+        [[nodiscard]] auto read_snapshot_meta(uint64_t idx)
+            -> nuraft::ptr<nuraft::snapshot>;
+
+        [[nodiscard]] auto read_snapshot(uint64_t idx, size_t& n_deltas)
             -> std::optional<snapshot>;
 
+        [[nodiscard]] auto open_snapshot_chain(uint64_t idx)
+            -> std::optional<std::vector<snapshot_file>>;
+
+        [[nodiscard]] auto
+        replay_snapshot_chain(std::vector<snapshot_file>& chain) -> snapshot;
+
+        [[nodiscard]] auto make_block_store() -> std::shared_ptr<block_store>;
+
+        void reset_snapshot_delta(uint64_t idx, size_t n_deltas);
+
+        void update_block_stats();
+
+        void update_pending_block();
+
         static constexpr auto m_tmp_file = "tmp";
+        static constexpr auto m_recv_file = "recv";
+        static constexpr auto m_xfer_prefix = "xfer_";
+
+        /// Size of the objects used to transfer snapshots to other nodes.
+        /// Receivers place each object at its ID times this size, so it
+        /// must be the same on every node.
+        static constexpr size_t m_snp_chunk_size{4UL * 1024 * 1024};
+
+        /// Maximum number of deltas written after a base snapshot before
+        /// writing a new base snapshot.
+        static constexpr size_t m_max_snapshot_deltas{16};
 
         std::atomic<uint64_t> m_last_committed_idx{0};
 
         std::shared_ptr<cbdc::atomizer::atomizer> m_atomizer;
-        std::shared_ptr<blockstore_t> m_blocks;
+        std::shared_ptr<block_store> m_blocks;
+        /// Guards modifications of the block store against reads from
+        /// threads other than the one applying log entries.
+        std::mutex m_blocks_mut;
+        std::string m_blocks_dir;
+        size_t m_block_memory_limit;
+        /// Counter to name the directories of the block stores of
+        /// snapshots being loaded.
+        std::atomic<uint64_t> m_load_count{0};
 
         std::atomic<uint64_t> m_tx_notify_count{0};
 
+        std::mutex m_stats_mut;
+        stxo_cache::filter_stats m_stxo_filter_stats;
+        block_store::retention_stats m_block_stats;
+        pending_block m_pending_block;
+
         std::string m_snapshot_dir;
 
         size_t m_stxo_cache_depth{};
+        size_t m_stxo_filter_capacity{};
+
+        size_t m_apply_threads{};
+
+        /// Log index of the most recent snapshot, or zero if there is none.
+        uint64_t m_snp_last_idx{0};
+        /// Number of deltas between the most recent snapshot and its base.
+        size_t m_snp_n_deltas{0};
+        /// Block height as of the most recent snapshot.
+        uint64_t m_snp_block_height{0};
+        /// Highest prune height requested since the most recent snapshot.
+        uint64_t m_snp_prune_height{0};
 
         std::shared_mutex m_snp_mut;
+        /// Metadata of the most recent snapshot, so it can be returned
+        /// without replaying the snapshot chain.
+        nuraft::ptr<nuraft::snapshot> m_last_snp{};
+
+        /// Log index of the snapshot being received, or zero if none.
+        uint64_t m_recv_idx{0};
+        /// IDs of the objects of the snapshot being received which have
+        /// been saved.
+        std::set<uint64_t> m_recv_objs;
+        /// ID of the last object of the snapshot being received, once it
+        /// has arrived.
+        std::optional<uint64_t> m_recv_last_obj;
+
+        /// Counter to name the files of delta snapshots being rewritten as
+        /// base snapshots.
+        std::atomic<uint64_t> m_xfer_count{0};
     };
 }
 #endif // OPENCBDC_TX_SRC_ATOMIZER_STATE_MACHINE_H_
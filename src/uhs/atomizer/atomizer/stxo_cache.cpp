@@ -0,0 +1,273 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "stxo_cache.hpp"
+
+#include "util/common/hashmap.hpp"
+#include "util/serialization/format.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace cbdc::atomizer {
+    auto stxo_cache::filter_stats::operator+=(const filter_stats& rhs)
+        -> filter_stats& {
+        m_queries += rhs.m_queries;
+        m_filtered += rhs.m_filtered;
+        m_false_positives += rhs.m_false_positives;
+        return *this;
+    }
+
+    stxo_cache::stxo_cache() : stxo_cache(default_filter_capacity) {}
+
+    stxo_cache::stxo_cache(size_t filter_capacity)
+        : m_filter_capacity(filter_capacity) {
+        rebuild(m_min_capacity);
+        if(m_filter_capacity != 0) {
+            rebuild_filter();
+        }
+    }
+
+    auto stxo_cache::find(const hash_t& uhs_id) const
+        -> std::optional<uint64_t> {
+        const auto key = key_hash(uhs_id);
+        m_stats.m_queries++;
+        if(m_filter_capacity != 0 && !m_filter.maybe_contains(key)) {
+            m_stats.m_filtered++;
+            return std::nullopt;
+        }
+
+        for(auto idx = slot_index(key); m_slots[idx].m_tag != 0;
+            idx = (idx + 1) & m_mask) {
+            const auto& s = m_slots[idx];
+            if(s.m_key == uhs_id) {
+                if(!is_live(s)) {
+                    break;
+                }
+                return s.m_tag - 1;
+            }
+        }
+
+        if(m_filter_capacity != 0) {
+            m_stats.m_false_positives++;
+        }
+        return std::nullopt;
+    }
+
+    void stxo_cache::insert(const hash_t& uhs_id, uint64_t height) {
+        assert(height >= m_min_height);
+
+        // Probe until we find the existing entry for this ID or an unused
+        // slot. Remember the first expired slot along the way so we can
+        // reuse it instead of consuming a never-used slot.
+        const auto key = key_hash(uhs_id);
+        auto idx = slot_index(key);
+        auto reuse = std::optional<size_t>();
+        for(; m_slots[idx].m_tag != 0; idx = (idx + 1) & m_mask) {
+            auto& s = m_slots[idx];
+            if(s.m_key == uhs_id) {
+                if(is_live(s)) {
+                    auto it = m_height_counts.find(s.m_tag - 1);
+                    assert(it != m_height_counts.end());
+                    if(--it->second == 0) {
+                        m_height_counts.erase(it);
+                    }
+                    m_size--;
+                }
+                s.m_tag = height + 1;
+                m_height_counts[height]++;
+                m_size++;
+                add_to_filter(key);
+                return;
+            }
+            if(!reuse.has_value() && !is_live(s)) {
+                reuse = idx;
+            }
+        }
+
+        if(reuse.has_value()) {
+            idx = reuse.value();
+        } else {
+            m_used++;
+        }
+        m_slots[idx] = slot{uhs_id, height + 1};
+        m_height_counts[height]++;
+        m_size++;
+
+        // Keep at least half of the slots unused so probe sequences stay
+        // short and always terminate.
+        if(m_used * 2 > m_slots.size()) {
+            static constexpr size_t growth_factor = 4;
+            auto capacity = m_min_capacity;
+            while(capacity < m_size * growth_factor) {
+                capacity <<= 1;
+            }
+            rebuild(capacity);
+        }
+        add_to_filter(key);
+    }
+
+    void stxo_cache::evict_below(uint64_t height) {
+        if(height <= m_min_height) {
+            return;
+        }
+        m_min_height = height;
+        auto end = m_height_counts.lower_bound(height);
+        for(auto it = m_height_counts.begin(); it != end; it++) {
+            m_size -= it->second;
+        }
+        m_height_counts.erase(m_height_counts.begin(), end);
+
+        // Drop the evicted IDs from the filter once they outnumber the live
+        // ones.
+        if(m_filter_capacity != 0 && m_filter.size() > m_size * 2) {
+            rebuild_filter();
+        }
+    }
+
+    void stxo_cache::clear() {
+        m_min_height = 0;
+        m_height_counts.clear();
+        m_size = 0;
+        rebuild(m_min_capacity);
+        if(m_filter_capacity != 0) {
+            rebuild_filter();
+        }
+    }
+
+    auto stxo_cache::size() const -> size_t {
+        return m_size;
+    }
+
+    auto stxo_cache::min_height() const -> uint64_t {
+        return m_min_height;
+    }
+
+    void stxo_cache::set_filter_capacity(size_t filter_capacity) {
+        m_filter_capacity = filter_capacity;
+        m_filter_limit = 0;
+        if(m_filter_capacity != 0) {
+            rebuild_filter();
+        } else {
+            m_filter = blocked_bloom_filter(1);
+        }
+    }
+
+    auto stxo_cache::stats() const -> const filter_stats& {
+        return m_stats;
+    }
+
+    auto stxo_cache::operator==(const stxo_cache& rhs) const -> bool {
+        if(m_min_height != rhs.m_min_height || m_size != rhs.m_size) {
+            return false;
+        }
+        auto equal = true;
+        for_each([&](const hash_t& uhs_id, uint64_t height) {
+            auto other = rhs.find(uhs_id);
+            equal = equal && other.has_value() && other.value() == height;
+        });
+        return equal;
+    }
+
+    auto stxo_cache::is_live(const slot& s) const -> bool {
+        return s.m_tag > m_min_height;
+    }
+
+    auto stxo_cache::key_hash(const hash_t& uhs_id) -> uint64_t {
+        // UHS IDs are uniformly distributed hashes, but mix the prefix anyway
+        // so that structured IDs do not cluster in the table or filters.
+        static constexpr auto mix_shift = 33;
+        static constexpr uint64_t mix_mul = 0xff51afd7ed558ccd;
+        uint64_t h = hashing::null()(uhs_id);
+        h ^= h >> mix_shift;
+        h *= mix_mul;
+        h ^= h >> mix_shift;
+        return h;
+    }
+
+    auto stxo_cache::slot_index(uint64_t key) const -> size_t {
+        return static_cast<size_t>(key) & m_mask;
+    }
+
+    void stxo_cache::add_to_filter(uint64_t key) {
+        if(m_filter_capacity == 0) {
+            return;
+        }
+        m_filter.insert(key);
+        if(m_filter.size() > m_filter_limit) {
+            rebuild_filter();
+        }
+    }
+
+    void stxo_cache::rebuild(size_t capacity) {
+        auto old_slots = std::move(m_slots);
+        m_slots = std::vector<slot>(capacity);
+        m_mask = capacity - 1;
+        m_used = 0;
+        for(const auto& s : old_slots) {
+            if(!is_live(s)) {
+                continue;
+            }
+            auto idx = slot_index(key_hash(s.m_key));
+            while(m_slots[idx].m_tag != 0) {
+                idx = (idx + 1) & m_mask;
+            }
+            m_slots[idx] = s;
+            m_used++;
+        }
+    }
+
+    void stxo_cache::rebuild_filter() {
+        // Leave room for as many new IDs as there are live IDs. Keep the
+        // existing allocation unless it is too small or much too large.
+        const auto limit = std::max(m_filter_capacity, m_size * 2);
+        static constexpr size_t shrink_factor = 4;
+        if(limit > m_filter_limit || limit < m_filter_limit / shrink_factor) {
+            m_filter = blocked_bloom_filter(limit);
+            m_filter_limit = limit;
+        } else {
+            m_filter.clear();
+        }
+        for(const auto& s : m_slots) {
+            if(is_live(s)) {
+                m_filter.insert(key_hash(s.m_key));
+            }
+        }
+    }
+}
+
+namespace cbdc {
+    auto operator<<(serializer& ser, const atomizer::stxo_cache& cache)
+        -> serializer& {
+        ser << cache.min_height() << static_cast<uint64_t>(cache.size());
+        cache.for_each([&](const hash_t& uhs_id, uint64_t height) {
+            ser << uhs_id << height;
+        });
+        return ser;
+    }
+
+    auto operator>>(serializer& deser, atomizer::stxo_cache& cache)
+        -> serializer& {
+        cache.clear();
+        uint64_t min_height{};
+        uint64_t count{};
+        if(!(deser >> min_height >> count)) {
+            return deser;
+        }
+        cache.evict_below(min_height);
+        for(uint64_t i = 0; i < count; i++) {
+            auto uhs_id = hash_t();
+            uint64_t height{};
+            if(!(deser >> uhs_id >> height)) {
+                return deser;
+            }
+            if(height < min_height) {
+                continue;
+            }
+            cache.insert(uhs_id, height);
+        }
+        return deser;
+    }
+}
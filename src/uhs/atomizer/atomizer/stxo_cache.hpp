@@ -0,0 +1,161 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_ATOMIZER_STXO_CACHE_H_
+#define OPENCBDC_TX_SRC_ATOMIZER_STXO_CACHE_H_
+
+#include "util/common/blocked_bloom_filter.hpp"
+#include "util/common/hash.hpp"
+#include "util/serialization/serializer.hpp"
+
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace cbdc::atomizer {
+    /// \brief Index of recently spent UHS IDs.
+    ///
+    /// Open-addressing hash table mapping each spent UHS ID to the block
+    /// height at which it was spent. Looking up an ID takes a single probe
+    /// sequence regardless of how many block heights the cache covers.
+    /// Evicting old heights only raises the lower bound of the cached range;
+    /// entries below the bound are ignored by lookups and their slots are
+    /// reused by later insertions. The table is rebuilt from its live entries
+    /// once expired and live entries together exceed the maximum load.
+    ///
+    /// A single blocked Bloom filter covers the IDs spent at every cached
+    /// height. Lookups consult the filter first and only probe the table if
+    /// it reports a possible match, so a lookup of an unspent ID, the common
+    /// case, touches one cache line whatever the cache depth. The filter
+    /// cannot remove IDs, so it is rebuilt from the live entries once it
+    /// holds more IDs than it was sized for, or once most of its IDs have
+    /// been evicted. Each rebuild sizes it for twice the live entries, which
+    /// amortizes rebuilds over insertions and tracks the block size.
+    /// \warning Not thread-safe.
+    class stxo_cache {
+      public:
+        /// Counters describing the effectiveness of the spent UHS ID
+        /// filter.
+        struct filter_stats {
+            /// Number of lookups.
+            uint64_t m_queries{};
+            /// Number of lookups answered by the filter alone.
+            uint64_t m_filtered{};
+            /// Number of lookups that passed the filter but did not find a
+            /// live entry.
+            uint64_t m_false_positives{};
+
+            auto operator+=(const filter_stats& rhs) -> filter_stats&;
+        };
+
+        /// Minimum number of IDs the filter is sized for by default.
+        static constexpr size_t default_filter_capacity{16384};
+
+        stxo_cache();
+
+        /// Constructor.
+        /// \param filter_capacity minimum number of IDs the filter is sized
+        ///                        for, or zero to disable the filter.
+        explicit stxo_cache(size_t filter_capacity);
+
+        /// Returns the block height at which the given UHS ID was spent.
+        /// \param uhs_id UHS ID to look up.
+        /// \return spent height, or std::nullopt if the ID is not in the
+        ///         cache or was spent below the lowest cached height.
+        [[nodiscard]] auto find(const hash_t& uhs_id) const
+            -> std::optional<uint64_t>;
+
+        /// Records the given UHS ID as spent at the given block height,
+        /// replacing any existing entry for the ID.
+        /// \param uhs_id UHS ID to insert.
+        /// \param height block height at which the ID was spent. Must not be
+        ///               lower than the lowest cached height.
+        void insert(const hash_t& uhs_id, uint64_t height);
+
+        /// Evicts every entry spent below the given block height.
+        /// \param height new lowest cached height. Lower values than the
+        ///               current lowest height are ignored.
+        void evict_below(uint64_t height);
+
+        /// Removes all entries and resets the lowest cached height to zero.
+        void clear();
+
+        /// Returns the number of live entries in the cache.
+        /// \return entry count.
+        [[nodiscard]] auto size() const -> size_t;
+
+        /// Returns the lowest block height covered by the cache.
+        /// \return lowest cached height.
+        [[nodiscard]] auto min_height() const -> uint64_t;
+
+        /// Calls the given function with each live UHS ID and the height at
+        /// which it was spent, in table order.
+        /// \param fn function accepting a UHS ID and height.
+        template<typename F>
+        void for_each(F&& fn) const {
+            for(const auto& s : m_slots) {
+                if(is_live(s)) {
+                    fn(s.m_key, s.m_tag - 1);
+                }
+            }
+        }
+
+        /// Sets the minimum number of IDs the filter is sized for, and
+        /// rebuilds the filter.
+        /// \param filter_capacity minimum filter capacity, or zero to
+        ///                        disable the filter.
+        void set_filter_capacity(size_t filter_capacity);
+
+        /// Returns the filter counters accumulated since construction.
+        /// \return filter statistics.
+        [[nodiscard]] auto stats() const -> const filter_stats&;
+
+        /// Two caches are equal if they cover the same height range and
+        /// contain the same live entries.
+        auto operator==(const stxo_cache& rhs) const -> bool;
+
+      private:
+        struct slot {
+            hash_t m_key{};
+            /// Spent height plus one, or zero if the slot was never used.
+            uint64_t m_tag{};
+        };
+
+        static constexpr size_t m_min_capacity{1024};
+
+        std::vector<slot> m_slots;
+        size_t m_mask{};
+        size_t m_used{};
+        size_t m_size{};
+        uint64_t m_min_height{};
+        std::map<uint64_t, size_t> m_height_counts;
+
+        size_t m_filter_capacity{};
+        blocked_bloom_filter m_filter{1};
+        /// Number of IDs \ref m_filter is sized for.
+        size_t m_filter_limit{};
+        mutable filter_stats m_stats;
+
+        [[nodiscard]] auto is_live(const slot& s) const -> bool;
+        [[nodiscard]] static auto key_hash(const hash_t& uhs_id) -> uint64_t;
+        [[nodiscard]] auto slot_index(uint64_t key) const -> size_t;
+        void add_to_filter(uint64_t key);
+        void rebuild(size_t capacity);
+        void rebuild_filter();
+    };
+}
+
+namespace cbdc {
+    /// Serializes the lowest cached height followed by the live entries of
+    /// the spent UHS ID cache.
+    auto operator<<(serializer& ser, const atomizer::stxo_cache& cache)
+        -> serializer&;
+
+    /// Deserializes a spent UHS ID cache, replacing its existing contents.
+    auto operator>>(serializer& deser, atomizer::stxo_cache& cache)
+        -> serializer&;
+}
+
+#endif // OPENCBDC_TX_SRC_ATOMIZER_STXO_CACHE_H_
@@ -17,7 +17,8 @@ namespace cbdc::sentinel {
                            std::shared_ptr<logging::log> logger)
         : m_sentinel_id(sentinel_id),
           m_opts(std::move(opts)),
-          m_logger(std::move(logger)) {}
+          m_logger(std::move(logger)),
+          m_routes(m_opts.m_shard_ranges) {}
 
     auto controller::init() -> bool {
         auto skey = m_opts.m_sentinel_private_keys.find(m_sentinel_id);
@@ -176,30 +177,34 @@ namespace cbdc::sentinel {
             std::unique_lock l(m_rand_mut);
             return m_shard_dist(m_rand);
         }();
-        auto inputs_sent = std::unordered_set<size_t>();
-        for(size_t i = 0; i < m_shard_data.size(); i++) {
-            auto idx = (i + offset) % m_shard_data.size();
-            const auto& range = m_shard_data[idx].m_range;
-            const auto& pid = m_shard_data[idx].m_peer_id;
-            if(inputs_sent.size() == ctx.m_inputs.size()) {
-                break;
-            }
-            if(!m_shard_network.connected(pid)) {
-                continue;
-            }
-            auto should_send = false;
-            for(size_t j = 0; j < ctx.m_inputs.size(); j++) {
-                if(inputs_sent.find(j) != inputs_sent.end()) {
+        // Send each input to the first connected shard holding it, in the
+        // order starting at the random offset. Using the same order for
+        // every input lets inputs held by the same shards share a message.
+        const auto shard_count = m_shard_data.size();
+        auto send_to = std::vector<bool>(shard_count);
+        for(const auto& inp : ctx.m_inputs) {
+            auto best = shard_count;
+            auto best_dist = shard_count;
+            for(const auto idx : m_routes.shards_for(inp)) {
+                const auto& pid = m_shard_data[idx].m_peer_id;
+                if(!m_shard_network.connected(pid)) {
                     continue;
                 }
-                if(!config::hash_in_shard_range(range, ctx.m_inputs[i])) {
-                    continue;
+                const auto dist = (idx + shard_count - offset) % shard_count;
+                if(dist < best_dist) {
+                    best = idx;
+                    best_dist = dist;
                 }
-                inputs_sent.insert(j);
-                should_send = true;
             }
-            if(should_send) {
-                m_shard_network.send(ctx_pkt, pid);
+            if(best != shard_count) {
+                send_to[best] = true;
+            }
+        }
+
+        for(size_t i = 0; i < shard_count; i++) {
+            auto idx = (i + offset) % shard_count;
+            if(send_to[idx]) {
+                m_shard_network.send(ctx_pkt, m_shard_data[idx].m_peer_id);
             }
         }
     }
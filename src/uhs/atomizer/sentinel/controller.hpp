@@ -11,6 +11,7 @@
 #include "uhs/sentinel/client.hpp"
 #include "uhs/sentinel/interface.hpp"
 #include "util/common/config.hpp"
+#include "util/common/routing_table.hpp"
 #include "util/network/connection_manager.hpp"
 
 #include <memory>
@@ -62,6 +63,8 @@ namespace cbdc::sentinel {
         std::shared_ptr<logging::log> m_logger;
 
         std::vector<shard_info> m_shard_data;
+        /// Routes UHS IDs to indexes in \ref m_shard_data.
+        config::routing_table m_routes;
 
         cbdc::network::connection_manager m_shard_network;
 
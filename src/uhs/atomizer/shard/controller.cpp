@@ -5,9 +5,12 @@
 
 #include "controller.hpp"
 
+#include "format.hpp"
+#include "memory_uhs_store.hpp"
 #include "uhs/atomizer/atomizer/atomizer_raft.hpp"
 #include "uhs/transaction/messages.hpp"
 
+#include <filesystem>
 #include <utility>
 
 namespace cbdc::shard {
@@ -17,16 +20,25 @@ namespace cbdc::shard {
         : m_shard_id(shard_id),
           m_opts(std::move(opts)),
           m_logger(std::move(logger)),
-          m_shard(m_opts.m_shard_ranges[shard_id]),
-          m_archiver_client(m_opts.m_archiver_endpoints[0], m_logger) {}
+          m_shard(m_opts.m_shard_ranges[shard_id], make_uhs_store(m_opts)),
+          m_archiver_client(m_opts.m_archiver_endpoints[0], m_logger),
+          m_snapshot_server(m_shard,
+                            m_opts.m_shard_db_dirs[shard_id] + "_snapshot",
+                            m_opts.m_shard_sync_chunk_size,
+                            m_opts.m_shard_sync_threshold,
+                            m_logger) {}
 
     controller::~controller() {
         m_shard_network.close();
+        m_sync_network.close();
         m_atomizer_network.close();
 
         if(m_shard_server.joinable()) {
             m_shard_server.join();
         }
+        if(m_sync_server.joinable()) {
+            m_sync_server.join();
+        }
         if(m_atomizer_client.joinable()) {
             m_atomizer_client.join();
         }
@@ -49,6 +61,10 @@ namespace cbdc::shard {
             return false;
         }
 
+        if(m_opts.m_shard_sync_threshold != 0) {
+            sync_from_peers();
+        }
+
         if(!m_archiver_client.init()) {
             m_logger->warn("Failed to connect to archiver");
         }
@@ -93,6 +109,20 @@ namespace cbdc::shard {
 
         m_shard_server = std::move(ss.value());
 
+        const auto& sync_ep = m_opts.m_shard_sync_endpoints[m_shard_id];
+        if(sync_ep.has_value()) {
+            auto sync_ss = m_sync_network.start_server(
+                sync_ep.value(),
+                [&](auto&& pkt) {
+                    return sync_handler(std::forward<decltype(pkt)>(pkt));
+                });
+            if(!sync_ss.has_value()) {
+                m_logger->error("Failed to establish shard sync server.");
+                return false;
+            }
+            m_sync_server = std::move(sync_ss.value());
+        }
+
         auto n_threads = std::thread::hardware_concurrency();
         for(size_t i = 0; i < n_threads; i++) {
             m_handler_threads.emplace_back([&]() {
@@ -105,7 +135,7 @@ namespace cbdc::shard {
 
     auto controller::server_handler(cbdc::network::message_t&& pkt)
         -> std::optional<cbdc::buffer> {
-        m_request_queue.push(pkt);
+        m_request_queue.push(std::move(pkt));
         return std::nullopt;
     }
 
@@ -133,19 +163,19 @@ namespace cbdc::shard {
                 break;
             }
 
-            // Attempt to catch up to the latest block
-            for(uint64_t i = m_shard.best_block_height() + 1; i < blk.m_height;
-                i++) {
-                const auto past_blk = m_archiver_client.get_block(i);
-                if(past_blk) {
-                    m_shard.digest_block(past_blk.value());
-                } else {
-                    m_logger->info("Waiting for archiver sync");
-                    const auto wait_time = std::chrono::milliseconds(10);
-                    std::this_thread::sleep_for(wait_time);
-                    i--;
-                    continue;
-                }
+            // Attempt to catch up to the latest block, applying blocks as
+            // they arrive while the archiver sends the following ones
+            const auto next = m_archiver_client.get_blocks(
+                m_shard.best_block_height() + 1,
+                blk.m_height,
+                m_opts.m_archiver_max_inflight,
+                [&](atomizer::block&& past_blk) {
+                    return m_shard.digest_block(past_blk);
+                });
+            if(next < blk.m_height) {
+                m_logger->info("Waiting for archiver sync");
+                const auto wait_time = std::chrono::milliseconds(10);
+                std::this_thread::sleep_for(wait_time);
             }
         }
 
@@ -154,8 +184,24 @@ namespace cbdc::shard {
     }
 
     void controller::request_consumer() {
-        auto pkt = network::message_t();
-        while(m_request_queue.pop(pkt)) {
+        auto pkts = std::vector<network::message_t>();
+        pkts.reserve(request_batch_size);
+        while(true) {
+            pkts.clear();
+            if(m_request_queue.pop_batch(pkts, request_batch_size) == 0) {
+                break;
+            }
+            handle_requests(pkts);
+        }
+    }
+
+    void controller::handle_requests(
+        const std::vector<network::message_t>& pkts) {
+        // Each consumer thread deserializes and verifies its own batch, so
+        // batches are verified in parallel
+        auto txs = std::vector<transaction::compact_tx>();
+        txs.reserve(pkts.size());
+        for(const auto& pkt : pkts) {
             auto maybe_tx = from_buffer<transaction::compact_tx>(*pkt.m_pkt);
             if(!maybe_tx.has_value()) {
                 m_logger->error("Invalid transaction packet");
@@ -175,35 +221,132 @@ namespace cbdc::shard {
                 continue;
             }
 
-            auto res = m_shard.digest_transaction(std::move(tx));
-
-            auto res_handler = overloaded{
-                [&](const atomizer::tx_notify_request& msg) {
-                    m_logger->info("Digested transaction",
-                                   to_string(msg.m_tx.m_id));
-
-                    m_logger->debug("Sending",
-                                    msg.m_attestations.size(),
-                                    "/",
-                                    msg.m_tx.m_inputs.size(),
-                                    "attestations...");
-                    if(!m_atomizer_network.send_to_one(
-                           atomizer::request{msg})) {
-                        m_logger->error(
-                            "Failed to transmit tx to atomizer. ID:",
-                            to_string(msg.m_tx.m_id));
-                    }
-                },
-                [&](const cbdc::watchtower::tx_error& err) {
-                    m_logger->info("error for Tx:",
-                                   to_string(err.tx_id()),
-                                   err.to_string());
-                    // TODO: batch errors into a single RPC
-                    auto data = std::vector<cbdc::watchtower::tx_error>{err};
-                    auto buf = make_shared_buffer(data);
-                    m_watchtower_network.broadcast(buf);
-                }};
+            txs.push_back(std::move(tx));
+        }
+
+        if(txs.empty()) {
+            return;
+        }
+
+        auto results = m_shard.digest_transactions(std::move(txs));
+
+        auto batch = atomizer::tx_notify_batch_request();
+        auto errs = std::vector<cbdc::watchtower::tx_error>();
+        auto res_handler = overloaded{
+            [&](atomizer::tx_notify_request& msg) {
+                m_logger->info("Digested transaction",
+                               to_string(msg.m_tx.m_id));
+
+                m_logger->debug("Sending",
+                                msg.m_attestations.size(),
+                                "/",
+                                msg.m_tx.m_inputs.size(),
+                                "attestations...");
+                // The shard holding the first input sends the transaction
+                // body. The others only need to send their attestations for
+                // the atomizer to join.
+                if(m_opts.m_shard_compact_notifications
+                   && !m_shard.is_output_on_shard(msg.m_tx.m_inputs[0])) {
+                    batch.m_attestation_notifications.push_back(
+                        atomizer::make_attestation_notify(msg));
+                } else {
+                    batch.m_notifications.push_back(std::move(msg));
+                }
+            },
+            [&](cbdc::watchtower::tx_error& err) {
+                m_logger->info("error for Tx:",
+                               to_string(err.tx_id()),
+                               err.to_string());
+                errs.push_back(std::move(err));
+            }};
+        for(auto& res : results) {
             std::visit(res_handler, res);
         }
+
+        const auto n_notifications = batch.m_notifications.size()
+                                   + batch.m_attestation_notifications.size();
+        if(n_notifications > 0
+           && !m_atomizer_network.send_to_one(
+               atomizer::request{std::move(batch)})) {
+            m_logger->error("Failed to transmit",
+                            n_notifications,
+                            "txs to atomizer");
+        }
+
+        if(!errs.empty()) {
+            auto buf = make_shared_buffer(errs);
+            m_watchtower_network.broadcast(buf);
+        }
+    }
+
+    auto controller::make_uhs_store(const config::options& opts)
+        -> std::unique_ptr<uhs_store> {
+        if(opts.m_shard_memory_uhs) {
+            return std::make_unique<memory_uhs_store>(
+                opts.m_shard_checkpoint_interval);
+        }
+        // The shard defaults to LevelDB
+        return nullptr;
+    }
+
+    auto controller::sync_handler(cbdc::network::message_t&& pkt)
+        -> std::optional<cbdc::buffer> {
+        auto req = from_buffer<snapshot_request>(*pkt.m_pkt);
+        if(!req.has_value()) {
+            m_logger->error("Invalid snapshot request packet");
+            return std::nullopt;
+        }
+
+        // The connection manager calls this handler from a single thread,
+        // as the snapshot server requires
+        auto resp = m_snapshot_server.handle(req.value());
+        return make_buffer(resp);
+    }
+
+    void controller::sync_from_peers() {
+        const auto& range = m_opts.m_shard_ranges[m_shard_id];
+        const auto min_height
+            = m_shard.best_block_height() + m_opts.m_shard_sync_threshold;
+        const auto sync_dir = m_opts.m_shard_db_dirs[m_shard_id] + "_sync";
+        for(size_t i = 0; i < m_opts.m_shard_sync_endpoints.size(); i++) {
+            const auto& ep = m_opts.m_shard_sync_endpoints[i];
+            const auto& peer_range = m_opts.m_shard_ranges[i];
+            if(i == m_shard_id || !ep.has_value()
+               || peer_range.first > range.first
+               || peer_range.second < range.second) {
+                continue;
+            }
+
+            auto client = snapshot_client(ep.value(), m_logger);
+            if(!client.init()) {
+                m_logger->warn("Failed to connect to shard", i, "for sync");
+                continue;
+            }
+
+            auto snp = download_snapshot(
+                [&](const snapshot_request& req) {
+                    return client.fetch(req);
+                },
+                sync_dir,
+                min_height,
+                m_logger);
+            if(!snp.has_value()) {
+                continue;
+            }
+
+            if(!m_shard.install_snapshot(snp->second)) {
+                m_logger->error("Failed to install UHS snapshot from shard",
+                                i);
+                continue;
+            }
+
+            m_logger->info("Installed UHS snapshot at height",
+                           snp->first,
+                           "from shard",
+                           i);
+            auto err = std::error_code();
+            std::filesystem::remove_all(sync_dir, err);
+            return;
+        }
     }
 }
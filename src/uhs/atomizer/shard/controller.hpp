@@ -7,9 +7,11 @@
 #define OPENCBDC_TX_SRC_SHARD_CONTROLLER_H_
 
 #include "shard.hpp"
+#include "snapshot_sync.hpp"
 #include "uhs/atomizer/archiver/client.hpp"
 #include "uhs/atomizer/atomizer/block.hpp"
 #include "util/common/config.hpp"
+#include "util/common/mpmc_queue.hpp"
 #include "util/network/connection_manager.hpp"
 
 #include <memory>
@@ -51,13 +53,26 @@ namespace cbdc::shard {
         cbdc::network::connection_manager m_watchtower_network;
         cbdc::network::connection_manager m_atomizer_network;
         cbdc::network::connection_manager m_shard_network;
+        cbdc::network::connection_manager m_sync_network;
 
         std::thread m_shard_server;
+        std::thread m_sync_server;
         std::thread m_atomizer_client;
 
         cbdc::archiver::client m_archiver_client;
 
-        blocking_queue<network::message_t> m_request_queue;
+        snapshot_server m_snapshot_server;
+
+        /// Maximum number of transactions waiting for a consumer thread.
+        /// The network handler blocks once the queue is full.
+        static constexpr size_t request_queue_size{1UL << 16};
+        /// Maximum number of transactions a consumer thread dequeues at
+        /// once. Each thread verifies its batch serially, so the batch is
+        /// kept small enough that a burst of requests is spread across the
+        /// consumer threads rather than verified by the first to wake.
+        static constexpr size_t request_batch_size{16};
+
+        mpmc_queue<network::message_t> m_request_queue{request_queue_size};
         std::vector<std::thread> m_handler_threads;
 
         auto server_handler(cbdc::network::message_t&& pkt)
@@ -65,6 +80,17 @@ namespace cbdc::shard {
         auto atomizer_handler(cbdc::network::message_t&& pkt)
             -> std::optional<cbdc::buffer>;
         void request_consumer();
+        void handle_requests(const std::vector<network::message_t>& pkts);
+        auto sync_handler(cbdc::network::message_t&& pkt)
+            -> std::optional<cbdc::buffer>;
+
+        /// Installs a UHS snapshot from a peer shard covering this shard's
+        /// range, if one is at least the configured threshold of blocks
+        /// ahead of this shard.
+        void sync_from_peers();
+
+        [[nodiscard]] static auto make_uhs_store(const config::options& opts)
+            -> std::unique_ptr<uhs_store>;
     };
 }
 
@@ -0,0 +1,32 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "format.hpp"
+
+#include "util/serialization/format.hpp"
+
+namespace cbdc {
+    auto operator<<(serializer& packet, const shard::snapshot_request& msg)
+        -> serializer& {
+        return packet << msg.m_height << msg.m_offset;
+    }
+
+    auto operator>>(serializer& packet, shard::snapshot_request& msg)
+        -> serializer& {
+        return packet >> msg.m_height >> msg.m_offset;
+    }
+
+    auto operator<<(serializer& packet, const shard::snapshot_chunk& msg)
+        -> serializer& {
+        return packet << msg.m_height << msg.m_digest << msg.m_size
+                      << msg.m_offset << msg.m_data;
+    }
+
+    auto operator>>(serializer& packet, shard::snapshot_chunk& msg)
+        -> serializer& {
+        return packet >> msg.m_height >> msg.m_digest >> msg.m_size
+            >> msg.m_offset >> msg.m_data;
+    }
+}
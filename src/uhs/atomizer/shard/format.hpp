@@ -0,0 +1,24 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_FORMAT_H_
+#define OPENCBDC_TX_SRC_SHARD_FORMAT_H_
+
+#include "messages.hpp"
+#include "util/serialization/serializer.hpp"
+
+namespace cbdc {
+    auto operator<<(serializer& packet, const shard::snapshot_request& msg)
+        -> serializer&;
+    auto operator>>(serializer& packet, shard::snapshot_request& msg)
+        -> serializer&;
+
+    auto operator<<(serializer& packet, const shard::snapshot_chunk& msg)
+        -> serializer&;
+    auto operator>>(serializer& packet, shard::snapshot_chunk& msg)
+        -> serializer&;
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_FORMAT_H_
@@ -0,0 +1,296 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "leveldb_uhs_store.hpp"
+
+#include "uhs_snapshot.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <leveldb/write_batch.h>
+
+namespace cbdc::shard {
+    auto leveldb_uhs_store::open(const std::string& dir)
+        -> std::optional<std::string> {
+        leveldb::Options opt;
+        opt.create_if_missing = true;
+
+        leveldb::DB* db_ptr{};
+        const auto res = leveldb::DB::Open(opt, dir, &db_ptr);
+
+        if(!res.ok()) {
+            return res.ToString();
+        }
+        this->m_db.reset(db_ptr);
+
+        // Read best block height from database or initialize it to zero
+        std::string bestBlockHeight;
+        const auto bestBlockRes = this->m_db->Get(this->m_read_options,
+                                                  m_best_block_height_key,
+                                                  &bestBlockHeight);
+        if(bestBlockRes.IsNotFound()) {
+            this->m_best_block_height = 0;
+            std::array<char, sizeof(m_best_block_height)> height_arr{};
+            std::memcpy(height_arr.data(),
+                        &m_best_block_height,
+                        sizeof(m_best_block_height));
+            leveldb::Slice startBestBlockHeight(
+                height_arr.data(),
+                sizeof(this->m_best_block_height));
+            this->m_db->Put(this->m_write_options,
+                            m_best_block_height_key,
+                            startBestBlockHeight);
+        } else {
+            assert(bestBlockHeight.size()
+                   == sizeof(this->m_best_block_height));
+            std::memcpy(&this->m_best_block_height,
+                        bestBlockHeight.c_str(),
+                        sizeof(this->m_best_block_height));
+        }
+
+        update_snapshot();
+
+        return std::nullopt;
+    }
+
+    auto leveldb_uhs_store::find(const std::vector<hash_t>& ids,
+                                 std::vector<bool>& found) -> uint64_t {
+        std::shared_ptr<const leveldb::Snapshot> snp{};
+        uint64_t snp_height{};
+        {
+            std::shared_lock<std::shared_mutex> l(m_snp_mut);
+            snp_height = m_snp_height;
+            snp = m_snp;
+        }
+
+        found.assign(ids.size(), false);
+        if(snp_height == 0) {
+            return 0;
+        }
+
+        auto read_options = m_read_options;
+        read_options.snapshot = snp.get();
+
+        std::string op;
+        for(size_t i = 0; i < ids.size(); i++) {
+            const auto& id = ids[i];
+            std::array<char, sizeof(id)> id_arr{};
+            std::memcpy(id_arr.data(), id.data(), id.size());
+            leveldb::Slice OutPointKey(id_arr.data(), id.size());
+
+            const auto& res = m_db->Get(read_options, OutPointKey, &op);
+            found[i] = !res.IsNotFound();
+        }
+
+        return snp_height;
+    }
+
+    auto leveldb_uhs_store::apply(uint64_t height,
+                                  const std::vector<hash_t>& added,
+                                  const std::vector<hash_t>& removed)
+        -> bool {
+        if(height != m_best_block_height + 1) {
+            return false;
+        }
+
+        leveldb::WriteBatch batch;
+
+        // Add new outputs
+        for(const auto& out : added) {
+            std::array<char, sizeof(out)> out_arr{};
+            std::memcpy(out_arr.data(), out.data(), out.size());
+            leveldb::Slice OutPointKey(out_arr.data(), out.size());
+            batch.Put(OutPointKey, leveldb::Slice());
+        }
+
+        // Delete spent inputs
+        for(const auto& inp : removed) {
+            std::array<char, sizeof(inp)> inp_arr{};
+            std::memcpy(inp_arr.data(), inp.data(), inp.size());
+            leveldb::Slice OutPointKey(inp_arr.data(), inp.size());
+            batch.Delete(OutPointKey);
+        }
+
+        // Bump the best block height
+        this->m_best_block_height++;
+        std::array<char, sizeof(m_best_block_height)> height_arr{};
+        std::memcpy(height_arr.data(),
+                    &m_best_block_height,
+                    sizeof(m_best_block_height));
+        leveldb::Slice newBestBlockHeight(height_arr.data(),
+                                          sizeof(this->m_best_block_height));
+        batch.Put(m_best_block_height_key, newBestBlockHeight);
+
+        // Commit the changes atomically
+        this->m_db->Write(this->m_write_options, &batch);
+
+        update_snapshot();
+
+        return true;
+    }
+
+    auto leveldb_uhs_store::height() const -> uint64_t {
+        std::shared_lock<std::shared_mutex> l(m_snp_mut);
+        return m_snp_height;
+    }
+
+    auto leveldb_uhs_store::write_snapshot(const std::string& path)
+        -> std::optional<uint64_t> {
+        std::shared_ptr<const leveldb::Snapshot> snp{};
+        uint64_t snp_height{};
+        {
+            std::shared_lock<std::shared_mutex> l(m_snp_mut);
+            snp_height = m_snp_height;
+            snp = m_snp;
+        }
+
+        auto read_options = m_read_options;
+        read_options.snapshot = snp.get();
+        read_options.fill_cache = false;
+
+        const auto tmp_file = path + ".tmp";
+        {
+            auto file = std::ofstream(tmp_file,
+                                      std::ios::binary | std::ios::trunc
+                                          | std::ios::out);
+            auto ser = ostream_serializer(file);
+
+            // The number of UHS IDs is not known until the iteration ends,
+            // so write a placeholder and fill it in afterwards
+            uint64_t count{};
+            auto ok = static_cast<bool>(ser << snp_height << count);
+            auto it = std::unique_ptr<leveldb::Iterator>(
+                m_db->NewIterator(read_options));
+            for(it->SeekToFirst(); ok && it->Valid(); it->Next()) {
+                const auto key = it->key();
+                if(key.size() != std::tuple_size<hash_t>::value) {
+                    // Skip the best block height
+                    continue;
+                }
+                auto id = hash_t();
+                std::memcpy(id.data(), key.data(), id.size());
+                ok = static_cast<bool>(ser << id);
+                count++;
+            }
+            ok = ok && it->status().ok();
+
+            file.seekp(sizeof(snp_height));
+            ok = ok && static_cast<bool>(ser << count);
+            if(!ok || !file.flush()) {
+                return std::nullopt;
+            }
+        }
+
+        auto err = std::error_code();
+        std::filesystem::rename(tmp_file, path, err);
+        if(err) {
+            return std::nullopt;
+        }
+
+        return snp_height;
+    }
+
+    auto leveldb_uhs_store::load_snapshot(const std::string& path,
+                                          const config::shard_range_t& range)
+        -> bool {
+        // Check the snapshot before discarding the existing UHS IDs
+        uint64_t height{};
+        if(!read_uhs_snapshot(
+               path,
+               [&](uint64_t snp_height, uint64_t /* count */) {
+                   height = snp_height;
+               },
+               [](const hash_t& /* id */) {})) {
+            return false;
+        }
+
+        // Reset the height first, so that if the process stops part-way
+        // through, the shard restarts from an empty height rather than
+        // with an incomplete UHS
+        set_best_block_height(0);
+
+        static constexpr size_t max_batch_size{100000};
+        leveldb::WriteBatch batch;
+        size_t batch_size{0};
+        auto flush_batch = [&]() {
+            if(batch_size > 0) {
+                m_db->Write(m_write_options, &batch);
+                batch.Clear();
+                batch_size = 0;
+            }
+        };
+
+        {
+            auto read_options = m_read_options;
+            read_options.fill_cache = false;
+            auto it = std::unique_ptr<leveldb::Iterator>(
+                m_db->NewIterator(read_options));
+            for(it->SeekToFirst(); it->Valid(); it->Next()) {
+                if(it->key() == m_best_block_height_key) {
+                    continue;
+                }
+                batch.Delete(it->key());
+                if(++batch_size == max_batch_size) {
+                    flush_batch();
+                }
+            }
+            flush_batch();
+        }
+
+        auto ok = read_uhs_snapshot(
+            path,
+            [](uint64_t /* height */, uint64_t /* count */) {},
+            [&](const hash_t& id) {
+                if(!config::hash_in_shard_range(range, id)) {
+                    return;
+                }
+                std::array<char, sizeof(id)> id_arr{};
+                std::memcpy(id_arr.data(), id.data(), id.size());
+                batch.Put(leveldb::Slice(id_arr.data(), id.size()),
+                          leveldb::Slice());
+                if(++batch_size == max_batch_size) {
+                    flush_batch();
+                }
+            });
+        if(!ok) {
+            // The file was checked above, so it changed or could no longer
+            // be read. Leave the store empty at height zero.
+            batch.Clear();
+            return false;
+        }
+        flush_batch();
+
+        set_best_block_height(height);
+        return true;
+    }
+
+    void leveldb_uhs_store::set_best_block_height(uint64_t height) {
+        m_best_block_height = height;
+        std::array<char, sizeof(m_best_block_height)> height_arr{};
+        std::memcpy(height_arr.data(),
+                    &m_best_block_height,
+                    sizeof(m_best_block_height));
+        leveldb::Slice height_slice(height_arr.data(),
+                                    sizeof(m_best_block_height));
+        m_db->Put(m_write_options, m_best_block_height_key, height_slice);
+
+        update_snapshot();
+    }
+
+    void leveldb_uhs_store::update_snapshot() {
+        std::unique_lock<std::shared_mutex> l(m_snp_mut);
+        m_snp_height = m_best_block_height;
+        m_snp = std::shared_ptr<const leveldb::Snapshot>(
+            m_db->GetSnapshot(),
+            [&](const leveldb::Snapshot* p) {
+                m_db->ReleaseSnapshot(p);
+            });
+    }
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_LEVELDB_UHS_STORE_H_
+#define OPENCBDC_TX_SRC_SHARD_LEVELDB_UHS_STORE_H_
+
+#include "uhs_store.hpp"
+
+#include <leveldb/db.h>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+namespace cbdc::shard {
+    /// \brief UHS ID store backed by a LevelDB database.
+    ///
+    /// Stores each UHS ID as a key with an empty value, along with the best
+    /// block height. Lookups read from a database snapshot taken after the
+    /// most recent block was written.
+    class leveldb_uhs_store final : public uhs_store {
+      public:
+        leveldb_uhs_store() = default;
+        ~leveldb_uhs_store() override = default;
+
+        leveldb_uhs_store(const leveldb_uhs_store&) = delete;
+        auto operator=(const leveldb_uhs_store&)
+            -> leveldb_uhs_store& = delete;
+        leveldb_uhs_store(leveldb_uhs_store&&) = delete;
+        auto operator=(leveldb_uhs_store&&) -> leveldb_uhs_store& = delete;
+
+        /// \copydoc uhs_store::open
+        [[nodiscard]] auto open(const std::string& dir)
+            -> std::optional<std::string> override;
+
+        /// \copydoc uhs_store::find
+        [[nodiscard]] auto find(const std::vector<hash_t>& ids,
+                                std::vector<bool>& found) -> uint64_t override;
+
+        /// \copydoc uhs_store::apply
+        [[nodiscard]] auto apply(uint64_t height,
+                                 const std::vector<hash_t>& added,
+                                 const std::vector<hash_t>& removed)
+            -> bool override;
+
+        /// \copydoc uhs_store::height
+        [[nodiscard]] auto height() const -> uint64_t override;
+
+        /// \copydoc uhs_store::write_snapshot
+        ///
+        /// Iterates over a database snapshot, so blocks can be applied while
+        /// the file is written.
+        [[nodiscard]] auto write_snapshot(const std::string& path)
+            -> std::optional<uint64_t> override;
+
+        /// \copydoc uhs_store::load_snapshot
+        ///
+        /// Writes the UHS IDs in several batches. If interrupted, the store
+        /// reopens at height zero.
+        [[nodiscard]] auto load_snapshot(const std::string& path,
+                                         const config::shard_range_t& range)
+            -> bool override;
+
+      private:
+        void update_snapshot();
+        void set_best_block_height(uint64_t height);
+
+        std::unique_ptr<leveldb::DB> m_db;
+        leveldb::ReadOptions m_read_options;
+        leveldb::WriteOptions m_write_options;
+
+        uint64_t m_best_block_height{};
+
+        std::shared_ptr<const leveldb::Snapshot> m_snp;
+        uint64_t m_snp_height{};
+        mutable std::shared_mutex m_snp_mut;
+
+        const std::string m_best_block_height_key = "bestBlockHeight";
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_LEVELDB_UHS_STORE_H_
@@ -0,0 +1,388 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "memory_uhs_store.hpp"
+
+#include "uhs_snapshot.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/istream_serializer.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <filesystem>
+
+namespace cbdc::shard {
+    memory_uhs_store::memory_uhs_store(size_t checkpoint_interval)
+        : m_checkpoint_interval(checkpoint_interval) {}
+
+    memory_uhs_store::~memory_uhs_store() {
+        {
+            std::lock_guard<std::mutex> l(m_checkpoint_mut);
+            m_stop = true;
+        }
+        m_checkpoint_cv.notify_all();
+        if(m_checkpoint_thread.joinable()) {
+            m_checkpoint_thread.join();
+        }
+    }
+
+    auto memory_uhs_store::open(const std::string& dir)
+        -> std::optional<std::string> {
+        auto err = std::error_code();
+        std::filesystem::create_directories(dir, err);
+        if(err) {
+            return err.message();
+        }
+
+        const auto path = std::filesystem::path(dir);
+        m_checkpoint_file = (path / checkpoint_filename).string();
+        m_log_file = (path / log_filename).string();
+        m_prev_log_file = (path / prev_log_filename).string();
+
+        if(!load_checkpoint()) {
+            return "Failed to load UHS checkpoint " + m_checkpoint_file;
+        }
+
+        m_checkpoint_height = m_height;
+        // A log set aside for a checkpoint which did not complete precedes
+        // the current log
+        auto replayed = replay_log(m_prev_log_file);
+        replayed = replay_log(m_log_file) || replayed;
+        if(replayed) {
+            // Fold the replayed records into a new checkpoint, which also
+            // discards any incomplete record at the end of the log
+            checkpoint();
+        } else {
+            m_log.open(m_log_file,
+                       std::ios::binary | std::ios::out | std::ios::app);
+        }
+
+        if(!m_log.good()) {
+            return "Failed to open UHS log " + m_log_file;
+        }
+
+        if(m_checkpoint_interval != 0 && !m_checkpoint_thread.joinable()) {
+            m_checkpoint_thread = std::thread([&]() {
+                run_checkpoints();
+            });
+        }
+
+        return std::nullopt;
+    }
+
+    auto memory_uhs_store::find(const std::vector<hash_t>& ids,
+                                std::vector<bool>& found) -> uint64_t {
+        found.assign(ids.size(), false);
+
+        std::shared_lock<std::shared_mutex> l(m_mut);
+        if(m_height == 0) {
+            return 0;
+        }
+
+        for(size_t i = 0; i < ids.size(); i++) {
+            found[i] = m_uhs.contains(ids[i]);
+        }
+
+        return m_height;
+    }
+
+    auto memory_uhs_store::apply(uint64_t height,
+                                 const std::vector<hash_t>& added,
+                                 const std::vector<hash_t>& removed)
+        -> bool {
+        // Only this thread modifies the height, so it can be read without
+        // the lock
+        if(height != m_height + 1) {
+            return false;
+        }
+
+        if(m_log.is_open()) {
+            auto ser = ostream_serializer(m_log);
+            if(!(ser << height << added << removed) || !m_log.flush()) {
+                // The block would be lost on restart, and the next
+                // record could not be replayed without it
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        apply_changes(height, added, removed);
+
+        if(m_log.is_open() && m_checkpoint_interval != 0
+           && height - m_checkpoint_height >= m_checkpoint_interval) {
+            start_checkpoint(height);
+        }
+
+        return true;
+    }
+
+    auto memory_uhs_store::height() const -> uint64_t {
+        std::shared_lock<std::shared_mutex> l(m_mut);
+        return m_height;
+    }
+
+    auto memory_uhs_store::write_snapshot(const std::string& path)
+        -> std::optional<uint64_t> {
+        // Written a range at a time like a checkpoint, so blocks can be
+        // applied meanwhile. The peer loading the snapshot applies the
+        // blocks following its height, which makes it exact.
+        uint64_t height{};
+        {
+            std::shared_lock<std::shared_mutex> l(m_mut);
+            height = m_height;
+        }
+
+        if(!write_set(path, height)) {
+            return std::nullopt;
+        }
+
+        return height;
+    }
+
+    auto memory_uhs_store::load_snapshot(const std::string& path,
+                                         const config::shard_range_t& range)
+        -> bool {
+        auto uhs = flat_hash_set();
+        uint64_t height{};
+        auto ok = read_uhs_snapshot(
+            path,
+            [&](uint64_t snp_height, uint64_t /* count */) {
+                height = snp_height;
+            },
+            [&](const hash_t& id) {
+                if(config::hash_in_shard_range(range, id)) {
+                    uhs.insert(id);
+                }
+            });
+        if(!ok) {
+            return false;
+        }
+
+        // The background checkpoint visits the set a range at a time, so
+        // must not see it replaced
+        {
+            std::unique_lock<std::mutex> l(m_checkpoint_mut);
+            m_checkpoint_cv.wait(l, [&]() {
+                return !m_checkpoint_request.has_value();
+            });
+        }
+
+        {
+            std::unique_lock<std::shared_mutex> l(m_mut);
+            m_uhs = std::move(uhs);
+            m_height = height;
+        }
+
+        if(m_log.is_open()) {
+            // Replace the checkpoint and discard the log, whose records
+            // precede the snapshot
+            checkpoint();
+        }
+
+        return true;
+    }
+
+    void memory_uhs_store::apply_changes(uint64_t height,
+                                         const std::vector<hash_t>& added,
+                                         const std::vector<hash_t>& removed) {
+        std::unique_lock<std::shared_mutex> l(m_mut);
+        for(const auto& out : added) {
+            m_uhs.insert(out);
+        }
+        for(const auto& inp : removed) {
+            m_uhs.erase(inp);
+        }
+        m_height = height;
+    }
+
+    auto memory_uhs_store::load_checkpoint() -> bool {
+        if(!std::filesystem::exists(m_checkpoint_file)) {
+            // No checkpoint has been written yet
+            return true;
+        }
+
+        std::unique_lock<std::shared_mutex> l(m_mut);
+        m_uhs.clear();
+        return read_uhs_snapshot(
+            m_checkpoint_file,
+            [&](uint64_t height, uint64_t count) {
+                m_uhs.reserve(count);
+                m_height = height;
+            },
+            [&](const hash_t& id) {
+                m_uhs.insert(id);
+            });
+    }
+
+    auto memory_uhs_store::replay_log(const std::string& path) -> bool {
+        auto file = std::ifstream(path, std::ios::binary);
+        if(!file.good() || file.peek() == std::ifstream::traits_type::eof()) {
+            return false;
+        }
+
+        auto deser = istream_serializer(file);
+        for(;;) {
+            uint64_t height{};
+            auto added = std::vector<hash_t>();
+            auto removed = std::vector<hash_t>();
+            if(!(deser >> height >> added >> removed)) {
+                // End of the log, or a record partially written before a
+                // crash
+                break;
+            }
+            if(height <= m_height) {
+                // Already included in the checkpoint
+                continue;
+            }
+            if(height != m_height + 1) {
+                break;
+            }
+            apply_changes(height, added, removed);
+        }
+
+        return true;
+    }
+
+    void memory_uhs_store::checkpoint() {
+        {
+            std::unique_lock<std::mutex> l(m_checkpoint_mut);
+            m_checkpoint_cv.wait(l, [&]() {
+                return !m_checkpoint_request.has_value();
+            });
+        }
+
+        // This thread is the only one that modifies the set, so the
+        // checkpoint is exact
+        if(!write_set(m_checkpoint_file, m_height)) {
+            std::exit(EXIT_FAILURE);
+        }
+        m_checkpoint_height = m_height;
+
+        auto err = std::error_code();
+        std::filesystem::remove(m_prev_log_file, err);
+        m_log.close();
+        m_log.open(m_log_file,
+                   std::ios::binary | std::ios::trunc | std::ios::out);
+    }
+
+    void memory_uhs_store::start_checkpoint(uint64_t height) {
+        {
+            std::lock_guard<std::mutex> l(m_checkpoint_mut);
+            if(m_checkpoint_request.has_value()) {
+                // Try again after the next block
+                return;
+            }
+        }
+
+        // Records up to this height are covered by the checkpoint once it
+        // completes. Until then they are replayed from the set-aside log.
+        m_log.close();
+        auto err = std::error_code();
+        std::filesystem::rename(m_log_file, m_prev_log_file, err);
+        m_log.open(m_log_file,
+                   std::ios::binary | std::ios::trunc | std::ios::out);
+        if(err || !m_log.good()) {
+            std::exit(EXIT_FAILURE);
+        }
+        m_checkpoint_height = height;
+
+        {
+            std::lock_guard<std::mutex> l(m_checkpoint_mut);
+            m_checkpoint_request = height;
+        }
+        m_checkpoint_cv.notify_all();
+    }
+
+    void memory_uhs_store::run_checkpoints() {
+        for(;;) {
+            auto height = uint64_t();
+            {
+                std::unique_lock<std::mutex> l(m_checkpoint_mut);
+                m_checkpoint_cv.wait(l, [&]() {
+                    return m_stop || m_checkpoint_request.has_value();
+                });
+                if(m_stop) {
+                    return;
+                }
+                height = m_checkpoint_request.value();
+            }
+
+            if(!write_set(m_checkpoint_file, height)) {
+                if(m_stop) {
+                    return;
+                }
+                std::exit(EXIT_FAILURE);
+            }
+
+            auto err = std::error_code();
+            std::filesystem::remove(m_prev_log_file, err);
+            {
+                std::lock_guard<std::mutex> l(m_checkpoint_mut);
+                m_checkpoint_request.reset();
+            }
+            m_checkpoint_cv.notify_all();
+        }
+    }
+
+    auto memory_uhs_store::write_set(const std::string& path,
+                                     uint64_t height) -> bool {
+        const auto tmp_file = path + ".tmp";
+        for(auto done = false; !done;) {
+            auto file = std::ofstream(tmp_file,
+                                      std::ios::binary | std::ios::trunc
+                                          | std::ios::out);
+            auto ser = ostream_serializer(file);
+            // The number of IDs is filled in once they are written
+            uint64_t count{};
+            auto ok = static_cast<bool>(ser << height << count);
+
+            auto slots = size_t();
+            auto rehashes = uint64_t();
+            {
+                std::shared_lock<std::shared_mutex> l(m_mut);
+                slots = m_uhs.slot_count();
+                rehashes = m_uhs.rehash_count();
+            }
+
+            done = true;
+            auto ids = std::vector<hash_t>();
+            for(size_t first = 0; ok && first < slots;
+                first += checkpoint_chunk_slots) {
+                if(m_stop) {
+                    return false;
+                }
+                ids.clear();
+                {
+                    std::shared_lock<std::shared_mutex> l(m_mut);
+                    if(m_uhs.rehash_count() != rehashes) {
+                        // Keys have moved between slots
+                        done = false;
+                        break;
+                    }
+                    m_uhs.for_each(first,
+                                   first + checkpoint_chunk_slots,
+                                   [&](const hash_t& id) {
+                                       ids.push_back(id);
+                                   });
+                }
+                for(const auto& id : ids) {
+                    ok = ok && static_cast<bool>(ser << id);
+                }
+                count += ids.size();
+            }
+            if(!done) {
+                continue;
+            }
+
+            file.seekp(sizeof(height));
+            ok = ok && static_cast<bool>(ser << count);
+            if(!ok || !file.flush()) {
+                return false;
+            }
+        }
+
+        auto err = std::error_code();
+        std::filesystem::rename(tmp_file, path, err);
+        return !err;
+    }
+}
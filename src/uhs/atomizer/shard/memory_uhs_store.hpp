@@ -0,0 +1,144 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_MEMORY_UHS_STORE_H_
+#define OPENCBDC_TX_SRC_SHARD_MEMORY_UHS_STORE_H_
+
+#include "uhs_store.hpp"
+#include "util/common/flat_hash_set.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+
+namespace cbdc::shard {
+    /// \brief Memory-resident UHS ID store.
+    ///
+    /// Holds the UHS IDs in an open-addressing hash set, so lookups do not
+    /// allocate or leave the process. Persists each applied block as a
+    /// record appended to a write-ahead log before updating the set, and
+    /// periodically writes a checkpoint of the full set from a background
+    /// thread. The checkpoint is written a range of slots at a time while
+    /// blocks continue to be applied, so it records the height at which it
+    /// started and is made exact by replaying the later log records;
+    /// applying a block twice has no further effect. The log is set aside
+    /// when a checkpoint starts and removed once it completes. Opening the
+    /// store loads the checkpoint and replays the complete records in the
+    /// set-aside and current logs. Like the LevelDB store's default write
+    /// options, log records are flushed to the operating system but not
+    /// synced to disk.
+    class memory_uhs_store final : public uhs_store {
+      public:
+        /// Constructor.
+        /// \param checkpoint_interval number of blocks between checkpoints
+        ///                            (0=never checkpoint).
+        explicit memory_uhs_store(size_t checkpoint_interval);
+
+        /// Stops the background checkpoint thread. A checkpoint in progress
+        /// is abandoned, and recovered from the logs on the next open.
+        ~memory_uhs_store() override;
+
+        memory_uhs_store() = delete;
+        memory_uhs_store(const memory_uhs_store&) = delete;
+        auto operator=(const memory_uhs_store&) -> memory_uhs_store& = delete;
+        memory_uhs_store(memory_uhs_store&&) = delete;
+        auto operator=(memory_uhs_store&&) -> memory_uhs_store& = delete;
+
+        /// \copydoc uhs_store::open
+        [[nodiscard]] auto open(const std::string& dir)
+            -> std::optional<std::string> override;
+
+        /// \copydoc uhs_store::find
+        [[nodiscard]] auto find(const std::vector<hash_t>& ids,
+                                std::vector<bool>& found) -> uint64_t override;
+
+        /// \copydoc uhs_store::apply
+        [[nodiscard]] auto apply(uint64_t height,
+                                 const std::vector<hash_t>& added,
+                                 const std::vector<hash_t>& removed)
+            -> bool override;
+
+        /// \copydoc uhs_store::height
+        [[nodiscard]] auto height() const -> uint64_t override;
+
+        /// \copydoc uhs_store::write_snapshot
+        ///
+        /// Writes the UHS IDs a range of slots at a time without copying
+        /// the set, so the file may also include changes from blocks
+        /// applied after the returned height. Loading it and applying the
+        /// blocks following that height yields the exact set, as applying
+        /// a block twice has no further effect.
+        [[nodiscard]] auto write_snapshot(const std::string& path)
+            -> std::optional<uint64_t> override;
+
+        /// \copydoc uhs_store::load_snapshot
+        ///
+        /// Replaces the checkpoint with the loaded set and truncates the
+        /// log.
+        [[nodiscard]] auto load_snapshot(const std::string& path,
+                                         const config::shard_range_t& range)
+            -> bool override;
+
+      private:
+        static constexpr auto checkpoint_filename = "uhs_checkpoint";
+        static constexpr auto log_filename = "uhs_log";
+        static constexpr auto prev_log_filename = "uhs_log.prev";
+        /// Number of slots a checkpoint writes per acquisition of the lock.
+        static constexpr size_t checkpoint_chunk_slots{1UL << 16};
+
+        flat_hash_set m_uhs;
+        uint64_t m_height{};
+        /// Guards \ref m_uhs and \ref m_height.
+        mutable std::shared_mutex m_mut;
+
+        size_t m_checkpoint_interval;
+        uint64_t m_checkpoint_height{};
+        std::string m_checkpoint_file;
+        std::string m_log_file;
+        std::string m_prev_log_file;
+        std::ofstream m_log;
+
+        std::thread m_checkpoint_thread;
+        std::mutex m_checkpoint_mut;
+        std::condition_variable m_checkpoint_cv;
+        /// Height of the checkpoint being written by the background thread.
+        std::optional<uint64_t> m_checkpoint_request;
+        std::atomic_bool m_stop{false};
+
+        void apply_changes(uint64_t height,
+                           const std::vector<hash_t>& added,
+                           const std::vector<hash_t>& removed);
+
+        [[nodiscard]] auto load_checkpoint() -> bool;
+
+        /// Replays the contiguous complete records in the given log.
+        /// \return true if the log contained any data.
+        [[nodiscard]] auto replay_log(const std::string& path) -> bool;
+
+        /// Writes a checkpoint on the calling thread once any background
+        /// checkpoint has finished, and discards the logs.
+        void checkpoint();
+
+        /// Sets the log aside and asks the background thread to write a
+        /// checkpoint at the given height, unless one is in progress.
+        void start_checkpoint(uint64_t height);
+
+        void run_checkpoints();
+
+        /// Writes the set to the given path a range of slots at a time,
+        /// under the given height, via a temporary file. Blocks applied
+        /// meanwhile may be partly included. Starts over if the set is
+        /// rehashed while being written.
+        /// \return false if writing failed or the store is stopping.
+        [[nodiscard]] auto write_set(const std::string& path,
+                                     uint64_t height) -> bool;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_MEMORY_UHS_STORE_H_
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_MESSAGES_H_
+#define OPENCBDC_TX_SRC_SHARD_MESSAGES_H_
+
+#include "util/common/buffer.hpp"
+#include "util/common/hash.hpp"
+
+#include <optional>
+
+namespace cbdc::shard {
+    /// \brief Request for part of a shard's UHS snapshot.
+    ///
+    /// Sent from a shard catching up to a peer shard serving snapshots of
+    /// its UHS.
+    struct snapshot_request {
+        /// Height of the snapshot being downloaded, or zero to start
+        /// downloading the peer's current snapshot.
+        uint64_t m_height{};
+        /// Offset in the snapshot file of the first byte to send.
+        uint64_t m_offset{};
+    };
+
+    /// \brief Part of a shard's UHS snapshot.
+    ///
+    /// Response to a \ref snapshot_request. Identifies the complete
+    /// snapshot, so that downloads can be verified and resumed.
+    struct snapshot_chunk {
+        /// Height of the block as of which the snapshot was taken.
+        uint64_t m_height{};
+        /// SHA-256 hash of the complete snapshot file.
+        hash_t m_digest{};
+        /// Size of the complete snapshot file in bytes.
+        uint64_t m_size{};
+        /// Offset in the snapshot file of the first byte in the chunk.
+        uint64_t m_offset{};
+        /// Bytes of the snapshot file starting at the offset.
+        buffer m_data;
+    };
+
+    /// The requested part of the snapshot, or std::nullopt if the peer no
+    /// longer serves the requested snapshot.
+    using snapshot_response = std::optional<snapshot_chunk>;
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_MESSAGES_H_
@@ -5,182 +5,161 @@
 
 #include "shard.hpp"
 
+#include "leveldb_uhs_store.hpp"
+
+#include <algorithm>
+#include <numeric>
 #include <utility>
 
 namespace cbdc::shard {
-    shard::shard(config::shard_range_t prefix_range)
-        : m_prefix_range(std::move(prefix_range)) {}
+    shard::shard(config::shard_range_t prefix_range,
+                 std::unique_ptr<uhs_store> store)
+        : m_store(std::move(store)),
+          m_prefix_range(std::move(prefix_range)) {
+        if(!m_store) {
+            m_store = std::make_unique<leveldb_uhs_store>();
+        }
+    }
 
     auto shard::open_db(const std::string& db_dir)
         -> std::optional<std::string> {
-        leveldb::Options opt;
-        opt.create_if_missing = true;
-
-        leveldb::DB* db_ptr{};
-        const auto res = leveldb::DB::Open(opt, db_dir, &db_ptr);
-
-        if(!res.ok()) {
-            return res.ToString();
-        }
-        this->m_db.reset(db_ptr);
-
-        // Read best block height from database or initialize it to zero
-        std::string bestBlockHeight;
-        const auto bestBlockRes = this->m_db->Get(this->m_read_options,
-                                                  m_best_block_height_key,
-                                                  &bestBlockHeight);
-        if(bestBlockRes.IsNotFound()) {
-            this->m_best_block_height = 0;
-            std::array<char, sizeof(m_best_block_height)> height_arr{};
-            std::memcpy(height_arr.data(),
-                        &m_best_block_height,
-                        sizeof(m_best_block_height));
-            leveldb::Slice startBestBlockHeight(
-                height_arr.data(),
-                sizeof(this->m_best_block_height));
-            this->m_db->Put(this->m_write_options,
-                            m_best_block_height_key,
-                            startBestBlockHeight);
-        } else {
-            assert(bestBlockHeight.size()
-                   == sizeof(this->m_best_block_height));
-            std::memcpy(&this->m_best_block_height,
-                        bestBlockHeight.c_str(),
-                        sizeof(this->m_best_block_height));
-        }
-
-        update_snapshot();
-
-        return std::nullopt;
+        return m_store->open(db_dir);
     }
 
     auto shard::digest_block(const cbdc::atomizer::block& blk) -> bool {
-        if(blk.m_height != m_best_block_height + 1) {
-            return false;
-        }
-
-        leveldb::WriteBatch batch;
+        std::vector<hash_t> added;
+        std::vector<hash_t> removed;
 
         // Iterate over all confirmed transactions
         for(const auto& tx : blk.m_transactions) {
             // Add new outputs
             for(const auto& out : tx.m_uhs_outputs) {
                 if(is_output_on_shard(out)) {
-                    std::array<char, sizeof(out)> out_arr{};
-                    std::memcpy(out_arr.data(), out.data(), out.size());
-                    leveldb::Slice OutPointKey(out_arr.data(), out.size());
-                    batch.Put(OutPointKey, leveldb::Slice());
+                    added.push_back(out);
                 }
             }
 
             // Delete spent inputs
             for(const auto& inp : tx.m_inputs) {
                 if(is_output_on_shard(inp)) {
-                    std::array<char, sizeof(inp)> inp_arr{};
-                    std::memcpy(inp_arr.data(), inp.data(), inp.size());
-                    leveldb::Slice OutPointKey(inp_arr.data(), inp.size());
-                    batch.Delete(OutPointKey);
+                    removed.push_back(inp);
                 }
             }
         }
 
-        // Bump the best block height
-        this->m_best_block_height++;
-        std::array<char, sizeof(m_best_block_height)> height_arr{};
-        std::memcpy(height_arr.data(),
-                    &m_best_block_height,
-                    sizeof(m_best_block_height));
-        leveldb::Slice newBestBlockHeight(height_arr.data(),
-                                          sizeof(this->m_best_block_height));
-        batch.Put(m_best_block_height_key, newBestBlockHeight);
-
-        // Commit the changes atomically
-        this->m_db->Write(this->m_write_options, &batch);
-
-        update_snapshot();
-
-        return true;
+        return m_store->apply(blk.m_height, added, removed);
     }
 
     auto shard::digest_transaction(transaction::compact_tx tx)
-        -> std::variant<atomizer::tx_notify_request,
-                        cbdc::watchtower::tx_error> {
-        std::shared_ptr<const leveldb::Snapshot> snp{};
-        uint64_t snp_height{};
-        {
-            std::shared_lock<std::shared_mutex> l(m_snp_mut);
-            snp_height = m_snp_height;
-            snp = m_snp;
+        -> digest_result {
+        auto txs = std::vector<transaction::compact_tx>();
+        txs.push_back(std::move(tx));
+        return std::move(digest_transactions(std::move(txs)).front());
+    }
+
+    auto shard::digest_transactions(std::vector<transaction::compact_tx>&& txs)
+        -> std::vector<digest_result> {
+        // Only check for inputs/outputs relevant to this shard
+        struct input_ref {
+            size_t m_tx;
+            uint64_t m_idx;
+        };
+        std::vector<input_ref> refs;
+        for(size_t i = 0; i < txs.size(); i++) {
+            for(uint64_t j = 0; j < txs[i].m_inputs.size(); j++) {
+                if(is_output_on_shard(txs[i].m_inputs[j])) {
+                    refs.push_back({i, j});
+                }
+            }
         }
 
-        // Don't process transactions until we've heard from the atomizer
-        if(snp_height == 0) {
-            return cbdc::watchtower::tx_error{
-                tx.m_id,
-                cbdc::watchtower::tx_error_sync{}};
+        // Look up the inputs in key order, which keeps the store's
+        // accesses local
+        auto input_id = [&](size_t ref) -> const hash_t& {
+            return txs[refs[ref].m_tx].m_inputs[refs[ref].m_idx];
+        };
+        std::vector<size_t> order(refs.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return input_id(a) < input_id(b);
+        });
+        std::vector<hash_t> ids;
+        ids.reserve(order.size());
+        for(auto ref : order) {
+            ids.push_back(input_id(ref));
         }
 
-        if(tx.m_inputs.empty()) {
-            return cbdc::watchtower::tx_error{
-                tx.m_id,
-                cbdc::watchtower::tx_error_inputs_dne{{}}};
+        std::vector<bool> found;
+        const auto height = m_store->find(ids, found);
+        std::vector<bool> ref_found(refs.size());
+        for(size_t k = 0; k < order.size(); k++) {
+            ref_found[order[k]] = found[k];
         }
 
-        auto read_options = m_read_options;
-        read_options.snapshot = snp.get();
+        std::vector<digest_result> results;
+        results.reserve(txs.size());
+        size_t ref = 0;
+        for(size_t i = 0; i < txs.size(); i++) {
+            auto& tx = txs[i];
+
+            // Check TX inputs exist
+            std::unordered_set<uint64_t> attestations;
+            std::vector<hash_t> dne_inputs;
+            for(; ref < refs.size() && refs[ref].m_tx == i; ref++) {
+                if(ref_found[ref]) {
+                    attestations.insert(refs[ref].m_idx);
+                } else {
+                    dne_inputs.push_back(input_id(ref));
+                }
+            }
 
-        // Check TX inputs exist
-        std::unordered_set<uint64_t> attestations;
-        std::vector<hash_t> dne_inputs;
-        for(uint64_t i = 0; i < tx.m_inputs.size(); i++) {
-            const auto& inp = tx.m_inputs[i];
-            // Only check for inputs/outputs relevant to this shard
-            if(!is_output_on_shard(inp)) {
+            // Don't process transactions until we've heard from the
+            // atomizer
+            if(height == 0) {
+                results.emplace_back(cbdc::watchtower::tx_error{
+                    tx.m_id,
+                    cbdc::watchtower::tx_error_sync{}});
                 continue;
             }
 
-            std::array<char, sizeof(inp)> inp_arr{};
-            std::memcpy(inp_arr.data(), inp.data(), inp.size());
-            leveldb::Slice OutPointKey(inp_arr.data(), inp.size());
-            std::string op;
+            if(tx.m_inputs.empty()) {
+                results.emplace_back(cbdc::watchtower::tx_error{
+                    tx.m_id,
+                    cbdc::watchtower::tx_error_inputs_dne{{}}});
+                continue;
+            }
 
-            const auto& res = m_db->Get(read_options, OutPointKey, &op);
-            if(res.IsNotFound()) {
-                dne_inputs.push_back(inp);
-            } else {
-                attestations.insert(i);
+            if(!dne_inputs.empty()) {
+                results.emplace_back(cbdc::watchtower::tx_error{
+                    tx.m_id,
+                    cbdc::watchtower::tx_error_inputs_dne{dne_inputs}});
+                continue;
             }
-        }
 
-        if(!dne_inputs.empty()) {
-            return cbdc::watchtower::tx_error{
-                tx.m_id,
-                cbdc::watchtower::tx_error_inputs_dne{dne_inputs}};
+            atomizer::tx_notify_request msg;
+            msg.m_attestations = std::move(attestations);
+            msg.m_tx = std::move(tx);
+            msg.m_block_height = height;
+            results.emplace_back(std::move(msg));
         }
 
-        atomizer::tx_notify_request msg;
-        msg.m_attestations = std::move(attestations);
-        msg.m_tx = std::move(tx);
-        msg.m_block_height = snp_height;
-
-        return msg;
+        return results;
     }
 
     auto shard::best_block_height() const -> uint64_t {
-        return m_best_block_height;
+        return m_store->height();
     }
 
-    auto shard::is_output_on_shard(const hash_t& uhs_hash) const -> bool {
-        return config::hash_in_shard_range(m_prefix_range, uhs_hash);
+    auto shard::write_snapshot(const std::string& path)
+        -> std::optional<uint64_t> {
+        return m_store->write_snapshot(path);
     }
 
-    void shard::update_snapshot() {
-        std::unique_lock<std::shared_mutex> l(m_snp_mut);
-        m_snp_height = m_best_block_height;
-        m_snp = std::shared_ptr<const leveldb::Snapshot>(
-            m_db->GetSnapshot(),
-            [&](const leveldb::Snapshot* p) {
-                m_db->ReleaseSnapshot(p);
-            });
+    auto shard::install_snapshot(const std::string& path) -> bool {
+        return m_store->load_snapshot(path, m_prefix_range);
+    }
+
+    auto shard::is_output_on_shard(const hash_t& uhs_hash) const -> bool {
+        return config::hash_in_shard_range(m_prefix_range, uhs_hash);
     }
 }
@@ -13,6 +13,7 @@
 #include "uhs/atomizer/atomizer/atomizer_raft.hpp"
 #include "uhs/atomizer/atomizer/block.hpp"
 #include "uhs/atomizer/atomizer/format.hpp"
+#include "uhs/atomizer/shard/uhs_store.hpp"
 #include "uhs/atomizer/watchtower/tx_error_messages.hpp"
 #include "uhs/transaction/transaction.hpp"
 #include "util/common/config.hpp"
@@ -21,8 +22,6 @@
 #include "util/serialization/format.hpp"
 
 #include <atomic>
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -37,20 +36,36 @@ namespace cbdc::shard {
       public:
         /// Constructor. Call open_db() before using.
         /// \param prefix_range the inclusive UHS ID prefix range which this shard should track.
-        explicit shard(config::shard_range_t prefix_range);
+        /// \param store storage backend for the shard's UHS IDs. Uses a
+        ///              \ref leveldb_uhs_store if nullptr.
+        explicit shard(config::shard_range_t prefix_range,
+                       std::unique_ptr<uhs_store> store = nullptr);
 
         /// Creates or restores this shard's UTXO database.
         /// \param db_dir relative path to the directory to create or read this shard's database files.
         /// \return nullopt if the shard successfully opened the database. Otherwise, returns the error message.
         auto open_db(const std::string& db_dir) -> std::optional<std::string>;
 
+        /// Result of digesting a transaction: a notification to forward to
+        /// the atomizer or an error to forward to the watchtower.
+        using digest_result
+            = std::variant<atomizer::tx_notify_request, watchtower::tx_error>;
+
         /// Checks the validity of a provided transaction's inputs, and returns
         /// a transaction notification to forward to the atomizer or a
         /// transaction error to forward to the watchtower.
         /// \param tx the transaction to digest.
         /// \return result message to forward.
-        auto digest_transaction(transaction::compact_tx tx)
-            -> std::variant<atomizer::tx_notify_request, watchtower::tx_error>;
+        auto digest_transaction(transaction::compact_tx tx) -> digest_result;
+
+        /// Checks the validity of the inputs of a batch of transactions.
+        /// Looks up the inputs of every transaction in the batch at once, in
+        /// UHS ID order, against the same block height.
+        /// \param txs the transactions to digest.
+        /// \return result message to forward for each transaction, in batch
+        ///         order.
+        auto digest_transactions(std::vector<transaction::compact_tx>&& txs)
+            -> std::vector<digest_result>;
 
         /// Updates records to reflect changes from a new, contiguous
         /// transaction block from the atomizer. Deletes spent UTXOs and adds
@@ -65,25 +80,35 @@ namespace cbdc::shard {
         /// \return the best block height.
         [[nodiscard]] auto best_block_height() const -> uint64_t;
 
-      private:
+        /// Writes a snapshot of the shard's UHS to a file, for installation
+        /// on other shards with \ref install_snapshot. May run concurrently
+        /// with \ref digest_block.
+        /// \param path path of the file to create or replace.
+        /// \return height of the block as of which the snapshot was taken, or
+        ///         std::nullopt if the file could not be written.
+        auto write_snapshot(const std::string& path)
+            -> std::optional<uint64_t>;
+
+        /// Replaces the shard's UHS with the UHS IDs in this shard's range
+        /// from a snapshot file, and sets the best block height to the
+        /// height of the snapshot. Blocks following the snapshot can then be
+        /// digested as usual. Must not run concurrently with \ref
+        /// digest_block.
+        /// \param path path of the snapshot file.
+        /// \return false if the snapshot file could not be read or is
+        ///         malformed.
+        auto install_snapshot(const std::string& path) -> bool;
+
+        /// Checks whether the given UHS ID is within this shard's range.
+        /// \param uhs_hash UHS ID to check.
+        /// \return true if the shard is responsible for the UHS ID.
         [[nodiscard]] auto is_output_on_shard(const hash_t& uhs_hash) const
             -> bool;
 
-        void update_snapshot();
-
-        std::unique_ptr<leveldb::DB> m_db;
-        leveldb::ReadOptions m_read_options;
-        leveldb::WriteOptions m_write_options;
-
-        uint64_t m_best_block_height{};
-
-        std::shared_ptr<const leveldb::Snapshot> m_snp;
-        uint64_t m_snp_height{};
-        std::shared_mutex m_snp_mut;
-
-        const std::string m_best_block_height_key = "bestBlockHeight";
+      private:
+        std::unique_ptr<uhs_store> m_store;
 
-        std::pair<uint8_t, uint8_t> m_prefix_range;
+        config::shard_range_t m_prefix_range;
     };
 }
 
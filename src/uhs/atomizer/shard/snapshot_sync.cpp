@@ -0,0 +1,363 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot_sync.hpp"
+
+#include "crypto/sha256.h"
+#include "format.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/istream_serializer.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+namespace cbdc::shard {
+    auto hash_file(const std::string& path) -> std::optional<hash_t> {
+        auto file = std::ifstream(path, std::ios::binary);
+        if(!file.good()) {
+            return std::nullopt;
+        }
+
+        static constexpr size_t read_size{1UL << 20};
+        auto buf = buffer();
+        buf.extend(read_size);
+        auto sha = CSHA256();
+        while(file) {
+            file.read(static_cast<char*>(buf.data()), read_size);
+            const auto n = static_cast<size_t>(file.gcount());
+            sha.Write(buf.c_ptr(), n);
+        }
+        if(!file.eof()) {
+            return std::nullopt;
+        }
+
+        auto ret = hash_t();
+        sha.Finalize(ret.data());
+        return ret;
+    }
+
+    snapshot_server::snapshot_server(shard& s,
+                                     std::string dir,
+                                     size_t chunk_size,
+                                     uint64_t max_age,
+                                     std::shared_ptr<logging::log> logger)
+        : m_shard(s),
+          m_dir(std::move(dir)),
+          m_path((std::filesystem::path(m_dir) / snapshot_filename).string()),
+          m_chunk_size(std::max(chunk_size, size_t{1})),
+          m_max_age(max_age),
+          m_logger(std::move(logger)) {}
+
+    auto snapshot_server::handle(const snapshot_request& req)
+        -> snapshot_response {
+        if(!m_loaded_existing) {
+            m_loaded_existing = true;
+            m_snapshot = load_existing();
+        }
+
+        if(req.m_height == 0) {
+            const auto height = m_shard.best_block_height();
+            if(!m_snapshot.has_value()
+               || (height > m_snapshot->m_height
+                   && height - m_snapshot->m_height >= m_max_age)) {
+                m_snapshot = take_snapshot();
+            }
+            if(!m_snapshot.has_value()) {
+                return std::nullopt;
+            }
+            return read_chunk(0);
+        }
+
+        if(!m_snapshot.has_value() || req.m_height != m_snapshot->m_height) {
+            return std::nullopt;
+        }
+
+        return read_chunk(req.m_offset);
+    }
+
+    auto snapshot_server::load_existing() -> std::optional<snapshot_info> {
+        auto file = std::ifstream(m_path, std::ios::binary);
+        if(!file.good()) {
+            return std::nullopt;
+        }
+
+        auto info = snapshot_info();
+        auto deser = istream_serializer(file);
+        if(!(deser >> info.m_height)) {
+            return std::nullopt;
+        }
+
+        auto err = std::error_code();
+        info.m_size = std::filesystem::file_size(m_path, err);
+        auto digest = hash_file(m_path);
+        if(err || !digest.has_value()) {
+            return std::nullopt;
+        }
+        info.m_digest = digest.value();
+
+        m_logger->info("Serving existing UHS snapshot at height",
+                       info.m_height);
+        return info;
+    }
+
+    auto snapshot_server::take_snapshot() -> std::optional<snapshot_info> {
+        auto err = std::error_code();
+        std::filesystem::create_directories(m_dir, err);
+        if(err) {
+            m_logger->error("Failed to create snapshot directory",
+                            m_dir,
+                            err.message());
+            return std::nullopt;
+        }
+
+        auto info = snapshot_info();
+        auto height = m_shard.write_snapshot(m_path);
+        if(!height.has_value()) {
+            m_logger->error("Failed to write UHS snapshot", m_path);
+            return std::nullopt;
+        }
+        info.m_height = height.value();
+
+        info.m_size = std::filesystem::file_size(m_path, err);
+        auto digest = hash_file(m_path);
+        if(err || !digest.has_value()) {
+            m_logger->error("Failed to read UHS snapshot", m_path);
+            return std::nullopt;
+        }
+        info.m_digest = digest.value();
+
+        m_logger->info("Took UHS snapshot at height",
+                       info.m_height,
+                       "of",
+                       info.m_size,
+                       "bytes");
+        return info;
+    }
+
+    auto snapshot_server::read_chunk(uint64_t offset)
+        -> std::optional<snapshot_chunk> {
+        if(offset > m_snapshot->m_size) {
+            return std::nullopt;
+        }
+
+        auto chunk = snapshot_chunk();
+        chunk.m_height = m_snapshot->m_height;
+        chunk.m_digest = m_snapshot->m_digest;
+        chunk.m_size = m_snapshot->m_size;
+        chunk.m_offset = offset;
+
+        const auto len = static_cast<size_t>(
+            std::min(static_cast<uint64_t>(m_chunk_size),
+                     m_snapshot->m_size - offset));
+        chunk.m_data.extend(len);
+        auto file = std::ifstream(m_path, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        if(!file.read(static_cast<char*>(chunk.m_data.data()),
+                      static_cast<std::streamsize>(len))) {
+            m_logger->error("Failed to read UHS snapshot", m_path);
+            return std::nullopt;
+        }
+
+        return chunk;
+    }
+
+    auto download_snapshot(const snapshot_fetch_fn& fetch,
+                           const std::string& dir,
+                           uint64_t min_height,
+                           const std::shared_ptr<logging::log>& logger)
+        -> std::optional<std::pair<uint64_t, std::string>> {
+        auto err = std::error_code();
+        std::filesystem::create_directories(dir, err);
+        if(err) {
+            logger->error("Failed to create snapshot directory",
+                          dir,
+                          err.message());
+            return std::nullopt;
+        }
+
+        const auto base = std::filesystem::path(dir);
+        const auto part_path = (base / "uhs_snapshot.part").string();
+        const auto meta_path = (base / "uhs_snapshot.meta").string();
+        const auto complete_path = (base / "uhs_snapshot").string();
+
+        // Snapshot being downloaded and the number of bytes received
+        struct download_state {
+            uint64_t m_height{};
+            hash_t m_digest{};
+            uint64_t m_size{};
+            uint64_t m_offset{};
+        };
+
+        auto state = std::optional<download_state>();
+        {
+            auto meta = std::ifstream(meta_path, std::ios::binary);
+            auto deser = istream_serializer(meta);
+            auto prev = download_state();
+            if(meta.good()
+               && deser >> prev.m_height >> prev.m_digest >> prev.m_size) {
+                // Bytes are appended to the partial file in order, so any
+                // bytes it holds are a prefix of the snapshot
+                prev.m_offset = std::filesystem::file_size(part_path, err);
+                if(!err && prev.m_offset <= prev.m_size
+                   && prev.m_height >= min_height) {
+                    logger->info("Resuming download of UHS snapshot at height",
+                                 prev.m_height,
+                                 "from byte",
+                                 prev.m_offset);
+                    state = prev;
+                }
+            }
+        }
+
+        auto discard = [&]() {
+            std::filesystem::remove(part_path, err);
+            std::filesystem::remove(meta_path, err);
+        };
+
+        static constexpr size_t max_restarts{3};
+        size_t restarts{0};
+        auto file = std::ofstream();
+        while(!state.has_value() || state->m_offset < state->m_size) {
+            auto req = snapshot_request();
+            if(state.has_value()) {
+                req.m_height = state->m_height;
+                req.m_offset = state->m_offset;
+            }
+
+            auto resp = fetch(req);
+            if(!resp.has_value()) {
+                logger->warn("UHS snapshot download interrupted");
+                return std::nullopt;
+            }
+
+            auto& chunk = resp.value();
+            if(chunk.has_value() && state.has_value()
+               && (chunk->m_height != state->m_height
+                   || chunk->m_digest != state->m_digest
+                   || chunk->m_size != state->m_size)) {
+                // The peer serves a different snapshot at the same height
+                chunk.reset();
+            }
+
+            if(!chunk.has_value()) {
+                if(!state.has_value()) {
+                    logger->warn("Peer has no UHS snapshot to serve");
+                    return std::nullopt;
+                }
+                if(++restarts > max_restarts) {
+                    logger->warn("Peer keeps replacing its UHS snapshot");
+                    return std::nullopt;
+                }
+                logger->info("Peer no longer serves UHS snapshot at height",
+                             state->m_height);
+                file.close();
+                state.reset();
+                continue;
+            }
+
+            if(!state.has_value()) {
+                if(chunk->m_height < min_height) {
+                    logger->info("Peer UHS snapshot at height",
+                                 chunk->m_height,
+                                 "is not recent enough to install");
+                    return std::nullopt;
+                }
+
+                state = download_state{chunk->m_height,
+                                       chunk->m_digest,
+                                       chunk->m_size,
+                                       0};
+                auto meta = std::ofstream(meta_path,
+                                          std::ios::binary | std::ios::trunc
+                                              | std::ios::out);
+                auto ser = ostream_serializer(meta);
+                if(!(ser << state->m_height << state->m_digest
+                         << state->m_size)
+                   || !meta.flush()) {
+                    logger->error("Failed to write", meta_path);
+                    return std::nullopt;
+                }
+                file.open(part_path,
+                          std::ios::binary | std::ios::trunc | std::ios::out);
+                logger->info("Downloading UHS snapshot at height",
+                             state->m_height,
+                             "of",
+                             state->m_size,
+                             "bytes");
+            } else if(!file.is_open()) {
+                file.open(part_path,
+                          std::ios::binary | std::ios::app | std::ios::out);
+            }
+
+            const auto len = chunk->m_data.size();
+            if(chunk->m_offset != state->m_offset || len == 0
+               || len > state->m_size - state->m_offset) {
+                logger->error("Invalid UHS snapshot chunk from peer");
+                file.close();
+                discard();
+                return std::nullopt;
+            }
+
+            file.write(static_cast<const char*>(chunk->m_data.data()),
+                       static_cast<std::streamsize>(len));
+            if(!file.flush()) {
+                logger->error("Failed to write", part_path);
+                return std::nullopt;
+            }
+            state->m_offset += len;
+        }
+        file.close();
+
+        auto digest = hash_file(part_path);
+        if(!digest.has_value() || digest.value() != state->m_digest) {
+            logger->error("Downloaded UHS snapshot does not match its hash");
+            discard();
+            return std::nullopt;
+        }
+
+        std::filesystem::rename(part_path, complete_path, err);
+        if(err) {
+            logger->error("Failed to rename", part_path, err.message());
+            return std::nullopt;
+        }
+        std::filesystem::remove(meta_path, err);
+
+        return std::make_pair(state->m_height, complete_path);
+    }
+
+    snapshot_client::snapshot_client(network::endpoint_t endpoint,
+                                     std::shared_ptr<logging::log> logger)
+        : m_endpoint(std::move(endpoint)),
+          m_logger(std::move(logger)) {}
+
+    auto snapshot_client::init() -> bool {
+        return m_sock.connect(m_endpoint);
+    }
+
+    auto snapshot_client::fetch(const snapshot_request& req)
+        -> std::optional<snapshot_response> {
+        if(!m_sock.send(req)) {
+            m_logger->error("Error requesting UHS snapshot from peer.");
+            return std::nullopt;
+        }
+
+        auto resp_pkt = cbdc::buffer();
+        if(!m_sock.receive(resp_pkt)) {
+            m_logger->error("Error receiving UHS snapshot from peer.");
+            return std::nullopt;
+        }
+
+        auto resp = cbdc::from_buffer<snapshot_response>(resp_pkt);
+        if(!resp.has_value()) {
+            m_logger->error("Invalid snapshot response packet");
+            return std::nullopt;
+        }
+
+        return resp;
+    }
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/** \file snapshot_sync.hpp
+ * Transfer of UHS snapshots between shards.
+ */
+
+#ifndef OPENCBDC_TX_SRC_SHARD_SNAPSHOT_SYNC_H_
+#define OPENCBDC_TX_SRC_SHARD_SNAPSHOT_SYNC_H_
+
+#include "messages.hpp"
+#include "shard.hpp"
+#include "util/common/logging.hpp"
+#include "util/network/tcp_socket.hpp"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace cbdc::shard {
+    /// Computes the SHA-256 hash of the contents of a file.
+    /// \param path path of the file.
+    /// \return hash of the file, or std::nullopt if it could not be read.
+    auto hash_file(const std::string& path) -> std::optional<hash_t>;
+
+    /// \brief Serves snapshots of a shard's UHS to other shards.
+    ///
+    /// Keeps a single snapshot file, written on the first request to start
+    /// a download. Later requests to start a download receive the same
+    /// snapshot until the shard has applied the configured number of blocks
+    /// since it was taken, after which a new snapshot replaces it. Requests
+    /// for parts of a replaced snapshot receive std::nullopt, so the
+    /// requester can start over. A snapshot file left in the directory by a
+    /// previous process is served again, so downloads can resume across
+    /// restarts.
+    /// \warning Not thread-safe. Requests must be handled by one thread at a
+    /// time.
+    class snapshot_server {
+      public:
+        /// Constructor.
+        /// \param s shard whose UHS to serve.
+        /// \param dir directory in which to store the snapshot file.
+        /// \param chunk_size maximum number of bytes of the snapshot file
+        ///                   to send in each response.
+        /// \param max_age number of blocks the shard applies after taking a
+        ///                snapshot before a new download takes a new one.
+        /// \param logger log instance.
+        snapshot_server(shard& s,
+                        std::string dir,
+                        size_t chunk_size,
+                        uint64_t max_age,
+                        std::shared_ptr<logging::log> logger);
+
+        /// Returns the requested part of the current snapshot. Takes a new
+        /// snapshot first if the request starts a download and the current
+        /// snapshot is too old.
+        /// \param req snapshot request.
+        /// \return requested part of the snapshot, or std::nullopt if the
+        ///         requested snapshot is not the current one or a snapshot
+        ///         could not be written.
+        auto handle(const snapshot_request& req) -> snapshot_response;
+
+      private:
+        static constexpr auto snapshot_filename = "uhs_snapshot";
+
+        struct snapshot_info {
+            uint64_t m_height{};
+            hash_t m_digest{};
+            uint64_t m_size{};
+        };
+
+        shard& m_shard;
+        std::string m_dir;
+        std::string m_path;
+        size_t m_chunk_size;
+        uint64_t m_max_age;
+        std::shared_ptr<logging::log> m_logger;
+        std::optional<snapshot_info> m_snapshot;
+        bool m_loaded_existing{false};
+
+        [[nodiscard]] auto load_existing() -> std::optional<snapshot_info>;
+        [[nodiscard]] auto take_snapshot() -> std::optional<snapshot_info>;
+        [[nodiscard]] auto read_chunk(uint64_t offset)
+            -> std::optional<snapshot_chunk>;
+    };
+
+    /// Sends a snapshot request to a peer shard.
+    /// Returns the peer's response, or std::nullopt on a network error.
+    using snapshot_fetch_fn
+        = std::function<std::optional<snapshot_response>(
+            const snapshot_request&)>;
+
+    /// \brief Downloads a UHS snapshot from a peer shard.
+    ///
+    /// Writes the snapshot to a partial file in the given directory,
+    /// alongside a file identifying the snapshot being downloaded. If the
+    /// directory holds a partial download, resumes it provided the peer
+    /// still serves the same snapshot, and otherwise starts over. Checks the
+    /// hash of the complete file before returning it.
+    /// \param fetch function to send requests to the peer.
+    /// \param dir directory in which to store the download.
+    /// \param min_height minimum height of a snapshot worth downloading.
+    /// \param logger log instance.
+    /// \return height and path of the complete snapshot file, or
+    ///         std::nullopt if the peer's snapshot is below the minimum
+    ///         height, or the download failed. A download interrupted by a
+    ///         network error can be resumed by a later call.
+    auto download_snapshot(const snapshot_fetch_fn& fetch,
+                           const std::string& dir,
+                           uint64_t min_height,
+                           const std::shared_ptr<logging::log>& logger)
+        -> std::optional<std::pair<uint64_t, std::string>>;
+
+    /// \brief Requests parts of a UHS snapshot from a peer shard via the
+    ///        network.
+    ///
+    /// \warning Not thread-safe. Only one thread can use the client without
+    /// synchronization.
+    class snapshot_client {
+      public:
+        /// Constructor.
+        /// \param endpoint snapshot endpoint of the peer shard.
+        /// \param logger pointer to shared logger.
+        snapshot_client(network::endpoint_t endpoint,
+                        std::shared_ptr<logging::log> logger);
+        snapshot_client() = delete;
+
+        /// Attempts to connect to the peer shard.
+        /// \return true if the connection was successful.
+        auto init() -> bool;
+
+        /// Sends a snapshot request to the peer shard and waits for the
+        /// response.
+        /// \param req snapshot request.
+        /// \return peer's response, or std::nullopt on a network error.
+        auto fetch(const snapshot_request& req)
+            -> std::optional<snapshot_response>;
+
+      private:
+        network::tcp_socket m_sock;
+        network::endpoint_t m_endpoint;
+        std::shared_ptr<logging::log> m_logger;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_SNAPSHOT_SYNC_H_
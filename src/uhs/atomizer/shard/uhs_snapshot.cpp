@@ -0,0 +1,52 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs_snapshot.hpp"
+
+#include "util/serialization/format.hpp"
+#include "util/serialization/istream_serializer.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace cbdc::shard {
+    auto read_uhs_snapshot(
+        const std::string& path,
+        const std::function<void(uint64_t, uint64_t)>& header_fn,
+        const std::function<void(const hash_t&)>& id_fn) -> bool {
+        auto err = std::error_code();
+        const auto file_size = std::filesystem::file_size(path, err);
+        if(err) {
+            return false;
+        }
+
+        auto file = std::ifstream(path, std::ios::binary);
+        auto deser = istream_serializer(file);
+        uint64_t height{};
+        uint64_t count{};
+        if(!(deser >> height >> count)) {
+            return false;
+        }
+
+        // Reject truncated or padded files before acting on the header
+        static constexpr auto header_size = sizeof(height) + sizeof(count);
+        const auto ids_size = file_size - header_size;
+        if(ids_size % sizeof(hash_t) != 0
+           || ids_size / sizeof(hash_t) != count) {
+            return false;
+        }
+
+        header_fn(height, count);
+        for(uint64_t i = 0; i < count; i++) {
+            auto id = hash_t();
+            if(!(deser >> id)) {
+                return false;
+            }
+            id_fn(id);
+        }
+
+        return true;
+    }
+}
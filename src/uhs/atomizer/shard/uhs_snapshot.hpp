@@ -0,0 +1,29 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_UHS_SNAPSHOT_H_
+#define OPENCBDC_TX_SRC_SHARD_UHS_SNAPSHOT_H_
+
+#include "util/common/hash.hpp"
+
+#include <functional>
+#include <string>
+
+namespace cbdc::shard {
+    /// Reads a UHS snapshot file in the format written by
+    /// \ref uhs_store::write_snapshot. Checks that the size of the file
+    /// matches the number of UHS IDs in its header before reading the IDs.
+    /// \param path path of the snapshot file.
+    /// \param header_fn function to call with the height of the snapshot
+    ///                  and its number of UHS IDs before the IDs are read.
+    /// \param id_fn function to call with each UHS ID in the snapshot.
+    /// \return false if the file could not be read or is malformed.
+    auto read_uhs_snapshot(
+        const std::string& path,
+        const std::function<void(uint64_t, uint64_t)>& header_fn,
+        const std::function<void(const hash_t&)>& id_fn) -> bool;
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_UHS_SNAPSHOT_H_
@@ -0,0 +1,97 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_SHARD_UHS_STORE_H_
+#define OPENCBDC_TX_SRC_SHARD_UHS_STORE_H_
+
+#include "util/common/config.hpp"
+#include "util/common/hash.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cbdc::shard {
+    /// \brief Interface for the storage of a shard's unspent UHS IDs.
+    ///
+    /// Tracks the set of unspent UHS IDs in the shard's range along with the
+    /// height of the most recent block applied to the set. Lookups may run
+    /// concurrently with each other and with \ref apply, and always observe
+    /// the set as of a single block height. Calls to \ref apply must not run
+    /// concurrently with each other, or with \ref load_snapshot.
+    ///
+    /// Snapshot files written by \ref write_snapshot hold the block height
+    /// followed by the number of UHS IDs and the UHS IDs themselves, in
+    /// unspecified order, and can be loaded by any store implementation.
+    class uhs_store {
+      public:
+        virtual ~uhs_store() = default;
+
+        uhs_store() = default;
+        uhs_store(const uhs_store&) = delete;
+        auto operator=(const uhs_store&) -> uhs_store& = delete;
+        uhs_store(uhs_store&&) = delete;
+        auto operator=(uhs_store&&) -> uhs_store& = delete;
+
+        /// Creates the store in the given directory, or restores its state
+        /// if it already exists. Must be called before using the store.
+        /// \param dir path of the directory holding the store's files.
+        /// \return std::nullopt on success, or an error message on failure.
+        [[nodiscard]] virtual auto open(const std::string& dir)
+            -> std::optional<std::string> = 0;
+
+        /// Checks whether each of the given UHS IDs is unspent.
+        /// \param ids UHS IDs to look up.
+        /// \param found replaced with whether each UHS ID is unspent, by
+        ///              index in ids.
+        /// \return height of the block as of which the lookups were
+        ///         performed, or zero if no block has been applied or the
+        ///         store is not open. The lookups are skipped in the latter
+        ///         case.
+        [[nodiscard]] virtual auto find(const std::vector<hash_t>& ids,
+                                        std::vector<bool>& found)
+            -> uint64_t = 0;
+
+        /// Atomically adds and removes the given UHS IDs as the result of
+        /// a new block. Accepts only the block following the most recently
+        /// applied block.
+        /// \param height height of the block.
+        /// \param added UHS IDs created by the block.
+        /// \param removed UHS IDs spent by the block.
+        /// \return false if the block height is not contiguous.
+        [[nodiscard]] virtual auto apply(uint64_t height,
+                                         const std::vector<hash_t>& added,
+                                         const std::vector<hash_t>& removed)
+            -> bool = 0;
+
+        /// Returns the height of the most recently applied block.
+        /// \return block height.
+        [[nodiscard]] virtual auto height() const -> uint64_t = 0;
+
+        /// Writes the UHS IDs in the store to a snapshot file. May run
+        /// concurrently with lookups and \ref apply, and may then include
+        /// changes from blocks applied after the returned height; applying
+        /// the blocks following that height to the loaded snapshot yields
+        /// the exact set.
+        /// \param path path of the file to create or replace.
+        /// \return height of the block as of which the snapshot was taken,
+        ///         or std::nullopt if the file could not be written.
+        [[nodiscard]] virtual auto write_snapshot(const std::string& path)
+            -> std::optional<uint64_t> = 0;
+
+        /// Replaces the contents of the store with the UHS IDs in a snapshot
+        /// file that fall within the given range, and sets the height of the
+        /// most recently applied block to the height of the snapshot. The
+        /// store is unchanged if the file cannot be read or is malformed.
+        /// \param path path of the snapshot file.
+        /// \param range inclusive UHS ID prefix range of the IDs to load.
+        /// \return false if the snapshot could not be loaded.
+        [[nodiscard]] virtual auto
+        load_snapshot(const std::string& path,
+                      const config::shard_range_t& range) -> bool = 0;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_SHARD_UHS_STORE_H_
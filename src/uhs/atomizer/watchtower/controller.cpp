@@ -107,18 +107,21 @@ auto cbdc::watchtower::controller::atomizer_handler(
     if(blk.m_height != (m_last_blk_height + 1)) {
         m_logger->warn("Block not contiguous. Last block:", m_last_blk_height);
         while(blk.m_height != (m_last_blk_height + 1)) {
-            auto missed_blk
-                = m_archiver_client.get_block(m_last_blk_height + 1);
-            if(!missed_blk) {
+            const auto next = m_archiver_client.get_blocks(
+                m_last_blk_height + 1,
+                blk.m_height,
+                m_opts.m_archiver_max_inflight,
+                [&](atomizer::block&& missed_blk) {
+                    m_last_blk_height = missed_blk.m_height;
+                    m_watchtower.add_block(std::move(missed_blk));
+                    return true;
+                });
+            if(next != blk.m_height) {
                 m_logger->warn("Waiting for archiver sync");
                 static constexpr auto archiver_wait_time
                     = std::chrono::milliseconds(100);
                 std::this_thread::sleep_for(archiver_wait_time);
-                continue;
             }
-
-            m_last_blk_height = (*missed_blk).m_height;
-            m_watchtower.add_block(std::move(*missed_blk));
         }
     }
     m_last_blk_height = blk.m_height;
@@ -0,0 +1,85 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "attestation_cache.hpp"
+
+#include <cstring>
+
+namespace cbdc::transaction {
+    attestation_cache::attestation_cache(size_t capacity)
+        : m_stripe_capacity((capacity + n_stripes - 1) / n_stripes),
+          m_stripes(n_stripes) {}
+
+    auto attestation_cache::key_hasher::operator()(const key& k) const noexcept
+        -> size_t {
+        // Both halves of the key are uniformly distributed so mixing a
+        // prefix of each is sufficient.
+        auto tx_prefix = size_t();
+        std::memcpy(&tx_prefix, k.first.data(), sizeof(tx_prefix));
+        auto key_prefix = size_t();
+        std::memcpy(&key_prefix, k.second.data(), sizeof(key_prefix));
+        return (tx_prefix ^ key_prefix) * 0x9e3779b97f4a7c15;
+    }
+
+    auto attestation_cache::get_stripe(const key& k) -> stripe& {
+        // Use the high bits of the hash, the map buckets use the low bits.
+        constexpr auto stripe_shift = sizeof(size_t) * 8 - 4;
+        static_assert(n_stripes == 1 << 4);
+        return m_stripes[key_hasher()(k) >> stripe_shift];
+    }
+
+    auto attestation_cache::contains(const hash_t& tx_hash,
+                                     const sentinel_attestation& att)
+        -> bool {
+        auto found = false;
+        if(m_stripe_capacity > 0) {
+            auto k = key{tx_hash, att.first};
+            auto& s = get_stripe(k);
+            std::lock_guard<std::mutex> l(s.m_mut);
+            auto it = s.m_sigs.find(k);
+            found = it != s.m_sigs.end() && it->second == att.second;
+        }
+        if(found) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        return found;
+    }
+
+    void attestation_cache::insert(const hash_t& tx_hash,
+                                   const sentinel_attestation& att) {
+        if(m_stripe_capacity == 0) {
+            return;
+        }
+        auto k = key{tx_hash, att.first};
+        auto& s = get_stripe(k);
+        std::lock_guard<std::mutex> l(s.m_mut);
+        auto [it, inserted] = s.m_sigs.emplace(k, att.second);
+        if(!inserted) {
+            it->second = att.second;
+            return;
+        }
+        s.m_order.push_back(k);
+        if(s.m_order.size() > m_stripe_capacity) {
+            s.m_sigs.erase(s.m_order.front());
+            s.m_order.pop_front();
+        }
+    }
+
+    auto attestation_cache::stats() const -> cache_stats {
+        return {m_hits.load(std::memory_order_relaxed),
+                m_misses.load(std::memory_order_relaxed)};
+    }
+
+    auto attestation_cache::size() const -> size_t {
+        auto ret = size_t();
+        for(const auto& s : m_stripes) {
+            std::lock_guard<std::mutex> l(s.m_mut);
+            ret += s.m_sigs.size();
+        }
+        return ret;
+    }
+}
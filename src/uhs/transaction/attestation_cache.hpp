@@ -0,0 +1,99 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_TRANSACTION_ATTESTATION_CACHE_H_
+#define OPENCBDC_TX_SRC_TRANSACTION_ATTESTATION_CACHE_H_
+
+#include "transaction.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cbdc::transaction {
+    /// \brief Bounded cache of verified sentinel attestations.
+    ///
+    /// Remembers attestations whose signature verified successfully, keyed
+    /// by the signed compact transaction hash and the sentinel public key,
+    /// so that a transaction forwarded to several components of the same
+    /// process is only verified once. An attestation is only reported as
+    /// cached if its signature matches the one that was verified. The cache
+    /// is split into independently locked stripes, each evicting its oldest
+    /// entry once full.
+    /// \note Thread-safe.
+    class attestation_cache {
+      public:
+        /// Hit and miss counters.
+        struct cache_stats {
+            /// Lookups which found a verified attestation.
+            uint64_t m_hits{};
+            /// Lookups which required the signature to be verified.
+            uint64_t m_misses{};
+        };
+
+        /// Constructor.
+        /// \param capacity maximum number of attestations to retain. Zero
+        ///                 disables the cache.
+        explicit attestation_cache(size_t capacity);
+
+        ~attestation_cache() = default;
+
+        attestation_cache() = delete;
+        attestation_cache(const attestation_cache&) = delete;
+        auto operator=(const attestation_cache&)
+            -> attestation_cache& = delete;
+        attestation_cache(attestation_cache&&) = delete;
+        auto operator=(attestation_cache&&) -> attestation_cache& = delete;
+
+        /// Checks whether the given attestation was previously verified for
+        /// the given transaction hash. Updates the hit and miss counters.
+        /// \param tx_hash signed hash of the compact transaction.
+        /// \param att attestation to look up.
+        /// \return true if the attestation is cached.
+        [[nodiscard]] auto contains(const hash_t& tx_hash,
+                                    const sentinel_attestation& att) -> bool;
+
+        /// Records a successfully verified attestation, evicting the oldest
+        /// entry in its stripe if the stripe is full.
+        /// \param tx_hash signed hash of the compact transaction.
+        /// \param att verified attestation.
+        void insert(const hash_t& tx_hash, const sentinel_attestation& att);
+
+        /// Returns the hit and miss counters.
+        /// \return cache statistics.
+        [[nodiscard]] auto stats() const -> cache_stats;
+
+        /// Returns the number of cached attestations.
+        /// \return number of attestations.
+        [[nodiscard]] auto size() const -> size_t;
+
+      private:
+        using key = std::pair<hash_t, pubkey_t>;
+
+        struct key_hasher {
+            auto operator()(const key& k) const noexcept -> size_t;
+        };
+
+        struct stripe {
+            mutable std::mutex m_mut;
+            std::unordered_map<key, signature_t, key_hasher> m_sigs;
+            /// Keys in insertion order, for eviction.
+            std::deque<key> m_order;
+        };
+
+        static constexpr size_t n_stripes{16};
+
+        size_t m_stripe_capacity;
+        std::vector<stripe> m_stripes;
+        std::atomic<uint64_t> m_hits{};
+        std::atomic<uint64_t> m_misses{};
+
+        [[nodiscard]] auto get_stripe(const key& k) -> stripe&;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_TRANSACTION_ATTESTATION_CACHE_H_
@@ -419,4 +419,29 @@ namespace cbdc::transaction::validation {
                                    && tx.verify(secp_context.get(), att);
                            });
     }
+
+    auto check_attestations(
+        const transaction::compact_tx& tx,
+        const std::unordered_set<pubkey_t, hashing::null>& pubkeys,
+        size_t threshold,
+        attestation_cache& cache) -> bool {
+        if(tx.m_attestations.size() < threshold) {
+            return false;
+        }
+
+        const auto tx_hash = tx.hash();
+        for(const auto& att : tx.m_attestations) {
+            if(pubkeys.find(att.first) == pubkeys.end()) {
+                return false;
+            }
+            if(cache.contains(tx_hash, att)) {
+                continue;
+            }
+            if(!tx.verify(secp_context.get(), att)) {
+                return false;
+            }
+            cache.insert(tx_hash, att);
+        }
+        return true;
+    }
 }
@@ -6,6 +6,7 @@
 #ifndef OPENCBDC_TX_SRC_TRANSACTION_VALIDATION_H_
 #define OPENCBDC_TX_SRC_TRANSACTION_VALIDATION_H_
 
+#include "attestation_cache.hpp"
 #include "transaction.hpp"
 
 #include <cassert>
@@ -164,6 +165,22 @@ namespace cbdc::transaction::validation {
         const transaction::compact_tx& tx,
         const std::unordered_set<pubkey_t, hashing::null>& pubkeys,
         size_t threshold) -> bool;
+
+    /// Validates the sentinel attestations attached to a compact transaction,
+    /// skipping signature verification for attestations found in the given
+    /// cache and recording newly verified attestations in it.
+    /// \param tx compact transaction to validate.
+    /// \param pubkeys set of public keys whose attestations will be accepted.
+    /// \param threshold number of attestations required for a transaction to
+    ///                  be considered valid.
+    /// \param cache verified attestation cache.
+    /// \return true if the required number of unique attestations are attached
+    ///         to the compact transaction.
+    auto check_attestations(
+        const transaction::compact_tx& tx,
+        const std::unordered_set<pubkey_t, hashing::null>& pubkeys,
+        size_t threshold,
+        attestation_cache& cache) -> bool;
 }
 
 #endif // OPENCBDC_TX_SRC_TRANSACTION_VALIDATION_H_
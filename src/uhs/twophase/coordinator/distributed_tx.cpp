@@ -14,6 +14,7 @@ namespace cbdc::coordinator {
         std::shared_ptr<logging::log> logger)
         : m_dtx_id(dtx_id),
           m_shards(std::move(shards)),
+          m_routes(shard_ranges(m_shards)),
           m_logger(std::move(logger)) {
         m_txs.resize(m_shards.size());
         m_tx_idxs.resize(m_shards.size());
@@ -145,30 +146,26 @@ namespace cbdc::coordinator {
     }
 
     auto distributed_tx::add_tx(const transaction::compact_tx& tx) -> size_t {
-        for(size_t i{0}; i < m_shards.size(); i++) {
-            const auto& shard = m_shards[i];
-            auto stx = locking_shard::tx();
-            stx.m_tx = tx;
-            bool active{false};
-            if(shard->hash_in_shard_range(tx.m_id)) {
-                active = true;
-            } else {
-                for(const auto& inp : tx.m_inputs) {
-                    if(shard->hash_in_shard_range(inp)) {
-                        active = true;
-                        break;
-                    }
-                }
-                if(!active) {
-                    for(const auto& out : tx.m_uhs_outputs) {
-                        if(shard->hash_in_shard_range(out)) {
-                            active = true;
-                            break;
-                        }
-                    }
-                }
+        // Find the shards responsible for the transaction ID or any of its
+        // UHS IDs
+        auto active = std::vector<bool>(m_shards.size());
+        auto route = [&](const hash_t& h) {
+            for(const auto i : m_routes.shards_for(h)) {
+                active[i] = true;
             }
-            if(active) {
+        };
+        route(tx.m_id);
+        for(const auto& inp : tx.m_inputs) {
+            route(inp);
+        }
+        for(const auto& out : tx.m_uhs_outputs) {
+            route(out);
+        }
+
+        for(size_t i{0}; i < m_shards.size(); i++) {
+            if(active[i]) {
+                auto stx = locking_shard::tx();
+                stx.m_tx = tx;
                 m_txs[i].emplace_back(std::move(stx));
                 m_tx_idxs[i].emplace_back(m_full_txs.size());
             }
@@ -177,6 +174,17 @@ namespace cbdc::coordinator {
         return m_full_txs.size() - 1;
     }
 
+    auto distributed_tx::shard_ranges(
+        const std::vector<std::shared_ptr<locking_shard::interface>>& shards)
+        -> std::vector<config::shard_range_t> {
+        auto ranges = std::vector<config::shard_range_t>();
+        ranges.reserve(shards.size());
+        for(const auto& shard : shards) {
+            ranges.push_back(shard->get_range());
+        }
+        return ranges;
+    }
+
     auto distributed_tx::discard() -> bool {
         if(m_discard_cb) {
             auto res = m_discard_cb(m_dtx_id);
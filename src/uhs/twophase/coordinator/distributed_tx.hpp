@@ -10,6 +10,7 @@
 #include "uhs/transaction/transaction.hpp"
 #include "uhs/twophase/locking_shard/locking_shard.hpp"
 #include "util/common/random_source.hpp"
+#include "util/common/routing_table.hpp"
 #include "util/raft/node.hpp"
 
 #include <memory>
@@ -152,8 +153,14 @@ namespace cbdc::coordinator {
 
         auto discard() -> bool;
 
+        [[nodiscard]] static auto shard_ranges(
+            const std::vector<std::shared_ptr<locking_shard::interface>>&
+                shards) -> std::vector<config::shard_range_t>;
+
         hash_t m_dtx_id;
         std::vector<std::shared_ptr<locking_shard::interface>> m_shards;
+        /// Routes UHS IDs to indexes in \ref m_shards.
+        config::routing_table m_routes;
         std::vector<std::vector<locking_shard::tx>> m_txs;
         std::vector<transaction::compact_tx> m_full_txs;
         std::vector<std::vector<uint64_t>> m_tx_idxs;
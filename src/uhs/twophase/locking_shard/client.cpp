@@ -10,7 +10,7 @@
 
 namespace cbdc::locking_shard::rpc {
     client::client(std::vector<network::endpoint_t> endpoints,
-                   const std::pair<uint8_t, uint8_t>& output_range,
+                   const config::shard_range_t& output_range,
                    logging::log& logger)
         : interface(output_range),
           m_log(logger) {
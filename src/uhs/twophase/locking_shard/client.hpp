@@ -24,7 +24,7 @@ namespace cbdc::locking_shard::rpc {
         ///                     the shard cluster
         /// \param logger log instance for writing status messages
         client(std::vector<network::endpoint_t> endpoints,
-               const std::pair<uint8_t, uint8_t>& output_range,
+               const config::shard_range_t& output_range,
                logging::log& logger);
 
         client() = delete;
@@ -43,7 +43,8 @@ namespace cbdc::locking_shard {
         params.election_timeout_upper_bound_
             = static_cast<int>(m_opts.m_election_timeout_upper);
         params.heart_beat_interval_ = static_cast<int>(m_opts.m_heartbeat);
-        params.snapshot_distance_ = 0; // TODO: implement snapshots
+        params.snapshot_distance_
+            = static_cast<int>(m_opts.m_snapshot_distance);
         params.max_append_size_ = static_cast<int>(m_opts.m_raft_max_batch);
 
         if(m_shard_id > (m_opts.m_shard_ranges.size() - 1)) {
@@ -57,6 +58,8 @@ namespace cbdc::locking_shard {
             m_logger,
             m_opts.m_shard_completed_txs_cache_size,
             m_preseed_dir,
+            "shard" + std::to_string(m_shard_id) + "_snps_"
+                + std::to_string(m_node_id),
             m_opts);
 
         m_shard = m_state_machine->get_shard_instance();
@@ -123,7 +126,7 @@ namespace cbdc::locking_shard {
             m_logger->warn("Became leader, starting listener");
             m_server = std::make_unique<decltype(m_server)::element_type>(
                 m_opts.m_locking_shard_endpoints[m_shard_id][m_node_id]);
-            m_server->register_raft_node(m_raft_serv);
+            m_server->register_raft_node(m_raft_serv, m_shard);
             if(!m_server->init()) {
                 m_logger->fatal("Couldn't start message handler server");
             }
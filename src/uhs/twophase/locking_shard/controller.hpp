@@ -8,10 +8,10 @@
 
 #include "client.hpp"
 #include "locking_shard.hpp"
+#include "server.hpp"
 #include "state_machine.hpp"
 #include "status_server.hpp"
 #include "util/raft/node.hpp"
-#include "util/raft/rpc_server.hpp"
 #include "util/rpc/tcp_server.hpp"
 
 namespace cbdc::locking_shard {
@@ -57,7 +57,7 @@ namespace cbdc::locking_shard {
         std::shared_ptr<locking_shard> m_shard;
         std::shared_ptr<raft::node> m_raft_serv;
         std::unique_ptr<rpc::status_server> m_status_server;
-        std::unique_ptr<cbdc::rpc::tcp_server<raft::rpc::server>> m_server;
+        std::unique_ptr<cbdc::rpc::tcp_server<rpc::server>> m_server;
     };
 }
 
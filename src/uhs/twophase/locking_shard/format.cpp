@@ -18,6 +18,18 @@ namespace cbdc {
         return packet >> tx.m_tx;
     }
 
+    auto operator<<(serializer& packet,
+                    const locking_shard::rpc::verified_lock_params& p)
+        -> serializer& {
+        return packet << p.m_txs << p.m_valid;
+    }
+
+    auto operator>>(serializer& packet,
+                    locking_shard::rpc::verified_lock_params& p)
+        -> serializer& {
+        return packet >> p.m_txs >> p.m_valid;
+    }
+
     auto operator<<(serializer& packet, const locking_shard::rpc::request& p)
         -> serializer& {
         return packet << p.m_dtx_id << p.m_params;
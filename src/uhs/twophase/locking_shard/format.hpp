@@ -14,6 +14,13 @@ namespace cbdc {
         -> serializer&;
     auto operator>>(serializer& packet, locking_shard::tx& tx) -> serializer&;
 
+    auto operator<<(serializer& packet,
+                    const locking_shard::rpc::verified_lock_params& p)
+        -> serializer&;
+    auto operator>>(serializer& packet,
+                    locking_shard::rpc::verified_lock_params& p)
+        -> serializer&;
+
     auto operator<<(serializer& packet, const locking_shard::rpc::request& p)
         -> serializer&;
     auto operator>>(serializer& packet, locking_shard::rpc::request& p)
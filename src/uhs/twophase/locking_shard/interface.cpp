@@ -5,18 +5,20 @@
 
 #include "interface.hpp"
 
-#include "util/common/config.hpp"
-
 #include <utility>
 
 namespace cbdc::locking_shard {
-    interface::interface(std::pair<uint8_t, uint8_t> output_range)
+    interface::interface(config::shard_range_t output_range)
         : m_output_range(std::move(output_range)) {}
 
     auto interface::hash_in_shard_range(const hash_t& h) const -> bool {
         return config::hash_in_shard_range(m_output_range, h);
     }
 
+    auto interface::get_range() const -> const config::shard_range_t& {
+        return m_output_range;
+    }
+
     auto tx::operator==(const tx& rhs) const -> bool {
         return m_tx == rhs.m_tx;
     }
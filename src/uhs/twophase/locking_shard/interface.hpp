@@ -7,6 +7,7 @@
 #define OPENCBDC_TX_SRC_LOCKING_SHARD_LOCKING_SHARD_INTERFACE_H_
 
 #include "uhs/transaction/transaction.hpp"
+#include "util/common/config.hpp"
 #include "util/common/hash.hpp"
 
 #include <optional>
@@ -32,7 +33,7 @@ namespace cbdc::locking_shard {
         /// Constructor.
         /// \param output_range inclusive hash prefix range the shard is
         ///                     responsible for managing.
-        explicit interface(std::pair<uint8_t, uint8_t> output_range);
+        explicit interface(config::shard_range_t output_range);
         virtual ~interface() = default;
         interface() = delete;
         interface(const interface&) = delete;
@@ -72,6 +73,10 @@ namespace cbdc::locking_shard {
         [[nodiscard]] virtual auto hash_in_shard_range(const hash_t& h) const
             -> bool;
 
+        /// Returns the range of UHS ID prefixes the shard is responsible for.
+        /// \return inclusive hash prefix range.
+        [[nodiscard]] auto get_range() const -> const config::shard_range_t&;
+
         /// Discards any cached information about a given distributed
         /// transaction.
         /// \param dtx_id distributed transaction ID of a previous apply
@@ -84,7 +89,7 @@ namespace cbdc::locking_shard {
         virtual void stop() = 0;
 
       private:
-        std::pair<uint8_t, uint8_t> m_output_range;
+        config::shard_range_t m_output_range;
     };
 }
 
@@ -5,12 +5,17 @@
 
 #include "locking_shard.hpp"
 
+#include "format.hpp"
 #include "messages.hpp"
 #include "uhs/transaction/validation.hpp"
 #include "util/common/config.hpp"
 #include "util/serialization/format.hpp"
 #include "util/serialization/istream_serializer.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
 namespace cbdc::locking_shard {
     auto locking_shard::discard_dtx(const hash_t& dtx_id) -> bool {
         std::unique_lock<std::shared_mutex> l(m_mut);
@@ -22,33 +27,33 @@ namespace cbdc::locking_shard {
     }
 
     locking_shard::locking_shard(
-        const std::pair<uint8_t, uint8_t>& output_range,
+        const config::shard_range_t& output_range,
         std::shared_ptr<logging::log> logger,
         size_t completed_txs_cache_size,
         const std::string& preseed_file,
         config::options opts)
         : interface(output_range),
           m_logger(std::move(logger)),
+          m_stripes(uhs_stripes),
           m_completed_txs(completed_txs_cache_size),
           m_opts(std::move(opts)) {
-        m_uhs.max_load_factor(std::numeric_limits<float>::max());
         m_applied_dtxs.max_load_factor(std::numeric_limits<float>::max());
         m_prepared_dtxs.max_load_factor(std::numeric_limits<float>::max());
-        m_locked.max_load_factor(std::numeric_limits<float>::max());
 
         static constexpr auto dtx_buckets = 100000;
         m_applied_dtxs.rehash(dtx_buckets);
         m_prepared_dtxs.rehash(dtx_buckets);
 
-        static constexpr auto locked_buckets = 10000000;
-        m_locked.rehash(locked_buckets);
-
         if(!preseed_file.empty()) {
             m_logger->info("Reading preseed file into memory");
             if(!read_preseed_file(preseed_file)) {
                 m_logger->error("Preseeding failed");
             } else {
-                m_logger->info("Preseeding complete -", m_uhs.size(), "utxos");
+                size_t utxos{};
+                for(const auto& stripe : m_stripes) {
+                    utxos += stripe.m_uhs.size();
+                }
+                m_logger->info("Preseeding complete -", utxos, "utxos");
             }
         }
     }
@@ -56,6 +61,16 @@ namespace cbdc::locking_shard {
     auto locking_shard::read_preseed_file(const std::string& preseed_file)
         -> bool {
         if(std::filesystem::exists(preseed_file)) {
+            for(auto& stripe : m_stripes) {
+                stripe.m_uhs.clear();
+            }
+
+            auto preseed = uhs_preseed();
+            if(preseed.open(preseed_file)) {
+                return load_preseed(preseed);
+            }
+
+            // Otherwise stream a serialized set of UHS IDs
             auto in = std::ifstream(preseed_file, std::ios::binary);
             in.seekg(0, std::ios::end);
             auto sz = in.tellg();
@@ -64,89 +79,268 @@ namespace cbdc::locking_shard {
             }
             in.seekg(0, std::ios::beg);
             auto deser = istream_serializer(in);
-            m_uhs.clear();
-            static constexpr auto uhs_size_factor = 2;
-            auto bucket_count = static_cast<unsigned long>(sz / cbdc::hash_size
-                                                           * uhs_size_factor);
-            m_uhs.rehash(bucket_count);
-            deser >> m_uhs;
-            return true;
+            return read_ids(deser,
+                            static_cast<uint64_t>(sz) / cbdc::hash_size,
+                            false);
         }
         return false;
     }
 
+    auto locking_shard::load_preseed(const uhs_preseed& preseed) -> bool {
+        const auto n_threads
+            = std::max<uint64_t>(std::thread::hardware_concurrency(), 1);
+        const auto per_thread = (preseed.size() + n_threads - 1) / n_threads;
+        auto run = [&](auto&& fn) {
+            auto threads = std::vector<std::thread>();
+            for(uint64_t t = 0; t < n_threads; t++) {
+                const auto begin = std::min(t * per_thread, preseed.size());
+                const auto end = std::min(begin + per_thread, preseed.size());
+                threads.emplace_back(fn, t, begin, end);
+            }
+            for(auto& t : threads) {
+                t.join();
+            }
+        };
+
+        // Check the whole file before inserting anything
+        auto sums = std::vector<std::optional<uint64_t>>(n_threads);
+        run([&](uint64_t t, uint64_t begin, uint64_t end) {
+            sums[t] = preseed.check_range(begin, end);
+        });
+        uint64_t sum{};
+        for(const auto& s : sums) {
+            if(!s.has_value()) {
+                m_logger->error("Preseed UHS IDs are not sorted");
+                return false;
+            }
+            sum += s.value();
+        }
+        if(sum != preseed.checksum()) {
+            m_logger->error("Preseed checksum mismatch");
+            return false;
+        }
+
+        // Batch the UHS IDs for each stripe, so threads take each stripe
+        // lock once per batch rather than once per UHS ID
+        static constexpr size_t batch_size{256};
+        reserve_stripes(preseed.size(), false);
+        run([&](uint64_t /* t */, uint64_t begin, uint64_t end) {
+            auto batches = std::vector<std::vector<hash_t>>(uhs_stripes);
+            auto flush = [&](size_t i) {
+                auto& stripe = m_stripes[i];
+                std::unique_lock<std::shared_mutex> l(stripe.m_mut);
+                for(const auto& uhs_id : batches[i]) {
+                    stripe.m_uhs.insert(uhs_id);
+                }
+                batches[i].clear();
+            };
+            for(auto idx = begin; idx < end; idx++) {
+                const auto uhs_id = preseed.get(idx);
+                const auto i = stripe_index(uhs_id);
+                batches[i].push_back(uhs_id);
+                if(batches[i].size() == batch_size) {
+                    flush(i);
+                }
+            }
+            for(size_t i = 0; i < uhs_stripes; i++) {
+                flush(i);
+            }
+        });
+        return true;
+    }
+
+    void locking_shard::reserve_stripes(uint64_t count, bool locked) {
+        // Leave room for stripes holding more than their share of the UHS
+        // IDs, so few of them grow while loading
+        static constexpr auto stripe_slack = 8;
+        const auto per_stripe = count / uhs_stripes;
+        for(auto& stripe : m_stripes) {
+            auto& set = locked ? stripe.m_locked : stripe.m_uhs;
+            set.reserve(per_stripe + per_stripe / stripe_slack);
+        }
+    }
+
+    auto locking_shard::read_ids(serializer& deser,
+                                 uint64_t max_ids,
+                                 bool locked) -> bool {
+        // Same format as a serialized set of UHS IDs, read directly into the
+        // stripes
+        auto count = uint64_t();
+        if(!(deser >> count) || count > max_ids) {
+            return false;
+        }
+
+        reserve_stripes(count, locked);
+        for(uint64_t i{0}; i < count; i++) {
+            auto uhs_id = hash_t();
+            if(!(deser >> uhs_id)) {
+                return false;
+            }
+            auto& stripe = get_stripe(uhs_id);
+            auto& set = locked ? stripe.m_locked : stripe.m_uhs;
+            set.insert(uhs_id);
+        }
+        return true;
+    }
+
+    void locking_shard::write_ids(serializer& ser, bool locked) const {
+        uint64_t count{};
+        for(const auto& stripe : m_stripes) {
+            count += (locked ? stripe.m_locked : stripe.m_uhs).size();
+        }
+        ser << count;
+        for(const auto& stripe : m_stripes) {
+            (locked ? stripe.m_locked : stripe.m_uhs)
+                .for_each([&](const hash_t& uhs_id) {
+                    ser << uhs_id;
+                });
+        }
+    }
+
     auto locking_shard::lock_outputs(std::vector<tx>&& txs,
                                      const hash_t& dtx_id)
         -> std::optional<std::vector<bool>> {
-        std::unique_lock<std::shared_mutex> l(m_mut);
-        if(!m_running) {
+        const auto valid = verify_attestations(txs);
+        return lock_verified_outputs(std::move(txs), valid, dtx_id);
+    }
+
+    auto locking_shard::lock_verified_outputs(std::vector<tx>&& txs,
+                                              const std::vector<bool>& valid,
+                                              const hash_t& dtx_id)
+        -> std::optional<std::vector<bool>> {
+        if(valid.size() != txs.size()) {
+            m_logger->error("Incorrect number of attestation flags for lock",
+                            to_string(dtx_id),
+                            valid.size(),
+                            "vs",
+                            txs.size());
             return std::nullopt;
         }
 
-        auto prepared_dtx_it = m_prepared_dtxs.find(dtx_id);
-        if(prepared_dtx_it != m_prepared_dtxs.end()) {
-            return prepared_dtx_it->second.m_results;
+        {
+            std::unique_lock<std::shared_mutex> l(m_mut);
+            if(!m_running) {
+                return std::nullopt;
+            }
+
+            // Reserve the dtx before taking any stripe locks, so a
+            // duplicate lock cannot lock the same inputs a second time
+            auto [prepared_dtx_it, reserved]
+                = m_prepared_dtxs.try_emplace(dtx_id);
+            if(!reserved) {
+                if(prepared_dtx_it->second.m_state == dtx_state::locking) {
+                    m_logger->warn("Lock already in progress for dtx",
+                                   to_string(dtx_id));
+                    return std::nullopt;
+                }
+                return prepared_dtx_it->second.m_results;
+            }
         }
 
         auto ret = std::vector<bool>();
         ret.reserve(txs.size());
-        for(auto&& tx : txs) {
-            auto success = check_and_lock_tx(tx);
+        for(size_t i{0}; i < txs.size(); i++) {
+            auto success = false;
+            if(valid[i]) {
+                auto locks = lock_stripes(txs[i], false);
+                success = check_and_lock_tx(txs[i]);
+            }
             ret.push_back(success);
         }
-        auto p = prepared_dtx();
+
+        std::unique_lock<std::shared_mutex> l(m_mut);
+        auto& p = m_prepared_dtxs[dtx_id];
         p.m_results = ret;
         p.m_txs = std::move(txs);
-        m_prepared_dtxs.emplace(dtx_id, std::move(p));
+        p.m_state = dtx_state::locked;
         return ret;
     }
 
-    auto locking_shard::check_and_lock_tx(const tx& t) -> bool {
-        bool success{true};
-        if(!transaction::validation::check_attestations(
-               t.m_tx,
-               m_opts.m_sentinel_public_keys,
-               m_opts.m_attestation_threshold)) {
+    auto locking_shard::verify_attestations(const std::vector<tx>& txs) const
+        -> std::vector<bool> {
+        auto ret = std::vector<bool>();
+        ret.reserve(txs.size());
+        for(const auto& tx : txs) {
+            ret.push_back(verify_attestation(tx));
+        }
+        return ret;
+    }
+
+    auto locking_shard::verify_attestations(const std::vector<tx>& txs,
+                                            worker_pool& workers) const
+        -> std::vector<bool> {
+        if(txs.size() < min_parallel_verify) {
+            return verify_attestations(txs);
+        }
+
+        // std::vector<bool> packs its elements into shared words, so each
+        // thread writes its verdicts to separate bytes instead
+        auto valid = std::vector<uint8_t>(txs.size());
+        workers.run(txs.size(), [&](size_t i) {
+            valid[i] = static_cast<uint8_t>(verify_attestation(txs[i]));
+        });
+        return {valid.begin(), valid.end()};
+    }
+
+    auto locking_shard::verify_attestation(const tx& t) const -> bool {
+        auto success = transaction::validation::check_attestations(
+            t.m_tx,
+            m_opts.m_sentinel_public_keys,
+            m_opts.m_attestation_threshold);
+        if(!success) {
             m_logger->warn("Received invalid compact transaction",
                            to_string(t.m_tx.m_id));
-            success = false;
-        }
-        if(success) {
-            for(const auto& uhs_id : t.m_tx.m_inputs) {
-                if(hash_in_shard_range(uhs_id)
-                   && m_uhs.find(uhs_id) == m_uhs.end()) {
-                    success = false;
-                    break;
+        }
+        return success;
+    }
+
+    auto locking_shard::check_and_lock_tx(const tx& t) -> bool {
+        for(const auto& uhs_id : t.m_tx.m_inputs) {
+            if(hash_in_shard_range(uhs_id)) {
+                auto& stripe = get_stripe(uhs_id);
+                if(!stripe.m_uhs.contains(uhs_id)) {
+                    return false;
                 }
             }
         }
-        if(success) {
-            for(const auto& uhs_id : t.m_tx.m_inputs) {
-                if(hash_in_shard_range(uhs_id)) {
-                    auto n = m_uhs.extract(uhs_id);
-                    assert(!n.empty());
-                    m_locked.emplace(uhs_id);
-                }
+        for(const auto& uhs_id : t.m_tx.m_inputs) {
+            if(hash_in_shard_range(uhs_id)) {
+                auto& stripe = get_stripe(uhs_id);
+                [[maybe_unused]] auto was_unspent
+                    = stripe.m_uhs.erase(uhs_id);
+                assert(was_unspent);
+                stripe.m_locked.insert(uhs_id);
             }
         }
-        return success;
+        return true;
     }
 
     auto locking_shard::apply_outputs(std::vector<bool>&& complete_txs,
                                       const hash_t& dtx_id) -> bool {
-        std::unique_lock<std::shared_mutex> l(m_mut);
-        if(!m_running) {
-            return false;
-        }
-        auto prepared_dtx_it = m_prepared_dtxs.find(dtx_id);
-        if(prepared_dtx_it == m_prepared_dtxs.end()) {
-            if(m_applied_dtxs.find(dtx_id) == m_applied_dtxs.end()) {
-                m_logger->fatal("Unable to find dtx data for apply",
-                                to_string(dtx_id));
+        auto dtx = std::vector<tx>();
+        {
+            std::unique_lock<std::shared_mutex> l(m_mut);
+            if(!m_running) {
+                return false;
+            }
+            auto prepared_dtx_it = m_prepared_dtxs.find(dtx_id);
+            if(prepared_dtx_it == m_prepared_dtxs.end()) {
+                if(m_applied_dtxs.find(dtx_id) == m_applied_dtxs.end()) {
+                    m_logger->fatal("Unable to find dtx data for apply",
+                                    to_string(dtx_id));
+                }
+                return true;
+            }
+            auto& p = prepared_dtx_it->second;
+            if(p.m_state != dtx_state::locked) {
+                m_logger->warn("Lock or apply already in progress for dtx",
+                               to_string(dtx_id));
+                return false;
             }
-            return true;
+            p.m_state = dtx_state::applying;
+            dtx = std::move(p.m_txs);
         }
-        auto& dtx = prepared_dtx_it->second.m_txs;
+
         if(complete_txs.size() != dtx.size()) {
             // This would only happen due to a bug in the controller
             m_logger->fatal("Incorrect number of complete tx flags for apply",
@@ -155,41 +349,161 @@ namespace cbdc::locking_shard {
                             "vs",
                             dtx.size());
         }
+
         for(size_t i{0}; i < dtx.size(); i++) {
             auto&& tx = dtx[i];
             if(hash_in_shard_range(tx.m_tx.m_id)) {
                 m_completed_txs.add(tx.m_tx.m_id);
             }
 
+            auto locks = lock_stripes(tx, complete_txs[i]);
+
             for(auto&& uhs_id : tx.m_tx.m_uhs_outputs) {
                 if(hash_in_shard_range(uhs_id) && complete_txs[i]) {
-                    m_uhs.emplace(uhs_id);
+                    get_stripe(uhs_id).m_uhs.insert(uhs_id);
                 }
             }
             for(auto&& uhs_id : tx.m_tx.m_inputs) {
                 if(hash_in_shard_range(uhs_id)) {
-                    auto was_locked = m_locked.erase(uhs_id);
-                    if(!complete_txs[i] && (was_locked != 0U)) {
-                        m_uhs.emplace(uhs_id);
+                    auto& stripe = get_stripe(uhs_id);
+                    auto was_locked = stripe.m_locked.erase(uhs_id);
+                    if(!complete_txs[i] && was_locked) {
+                        stripe.m_uhs.insert(uhs_id);
                     }
                 }
             }
         }
 
+        // Only report the dtx as applied once the stripes reflect it
+        std::unique_lock<std::shared_mutex> l(m_mut);
         m_prepared_dtxs.erase(dtx_id);
         m_applied_dtxs.insert(dtx_id);
         return true;
     }
 
+    auto locking_shard::stripe_index(const hash_t& uhs_id) -> size_t {
+        // Skip the leading bytes, which select the shard and so vary little
+        // within it
+        uint64_t h{};
+        std::memcpy(&h, uhs_id.data() + sizeof(h), sizeof(h));
+        return static_cast<size_t>(h % uhs_stripes);
+    }
+
+    auto locking_shard::get_stripe(const hash_t& uhs_id) -> uhs_stripe& {
+        return m_stripes[stripe_index(uhs_id)];
+    }
+
+    auto locking_shard::lock_stripes(const tx& t, bool outputs)
+        -> stripe_locks {
+        auto stripes = std::vector<size_t>();
+        for(const auto& uhs_id : t.m_tx.m_inputs) {
+            if(hash_in_shard_range(uhs_id)) {
+                stripes.push_back(stripe_index(uhs_id));
+            }
+        }
+        if(outputs) {
+            for(const auto& uhs_id : t.m_tx.m_uhs_outputs) {
+                if(hash_in_shard_range(uhs_id)) {
+                    stripes.push_back(stripe_index(uhs_id));
+                }
+            }
+        }
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()),
+                      stripes.end());
+
+        auto locks = stripe_locks();
+        locks.reserve(stripes.size());
+        for(const auto i : stripes) {
+            locks.emplace_back(m_stripes[i].m_mut);
+        }
+        return locks;
+    }
+
+    auto locking_shard::lock_all_stripes() -> stripe_locks {
+        auto locks = stripe_locks();
+        locks.reserve(m_stripes.size());
+        for(auto& stripe : m_stripes) {
+            locks.emplace_back(stripe.m_mut);
+        }
+        return locks;
+    }
+
+    auto locking_shard::write_snapshot(serializer& ser) -> bool {
+        std::shared_lock<std::shared_mutex> l(m_mut);
+        auto locks = lock_all_stripes();
+        write_ids(ser, false);
+        write_ids(ser, true);
+
+        ser << static_cast<uint64_t>(m_prepared_dtxs.size());
+        for(const auto& [dtx_id, dtx] : m_prepared_dtxs) {
+            ser << dtx_id << dtx.m_txs << dtx.m_results;
+        }
+        ser << m_applied_dtxs;
+
+        // Oldest first, so that reading the snapshot preserves the order of
+        // eviction
+        ser << static_cast<uint64_t>(m_completed_txs.size());
+        m_completed_txs.for_each([&](const hash_t& tx_id) {
+            ser << tx_id;
+        });
+        return static_cast<bool>(ser);
+    }
+
+    auto locking_shard::read_snapshot(serializer& deser, uint64_t max_ids)
+        -> bool {
+        std::unique_lock<std::shared_mutex> l(m_mut);
+        auto locks = lock_all_stripes();
+        for(auto& stripe : m_stripes) {
+            stripe.m_uhs.clear();
+            stripe.m_locked.clear();
+        }
+        if(!read_ids(deser, max_ids, false)
+           || !read_ids(deser, max_ids, true)) {
+            return false;
+        }
+
+        m_prepared_dtxs.clear();
+        auto n_prepared = uint64_t();
+        if(!(deser >> n_prepared) || n_prepared > max_ids) {
+            return false;
+        }
+        for(uint64_t i{0}; i < n_prepared; i++) {
+            auto dtx_id = hash_t();
+            auto dtx = prepared_dtx();
+            if(!(deser >> dtx_id >> dtx.m_txs >> dtx.m_results)) {
+                return false;
+            }
+            dtx.m_state = dtx_state::locked;
+            m_prepared_dtxs.emplace(dtx_id, std::move(dtx));
+        }
+
+        m_applied_dtxs.clear();
+        auto n_completed = uint64_t();
+        if(!(deser >> m_applied_dtxs >> n_completed)) {
+            return false;
+        }
+        m_completed_txs.clear();
+        for(uint64_t i{0}; i < n_completed; i++) {
+            auto tx_id = hash_t();
+            if(!(deser >> tx_id)) {
+                return false;
+            }
+            m_completed_txs.add(tx_id);
+        }
+        return true;
+    }
+
     void locking_shard::stop() {
         m_running = false;
     }
 
     auto locking_shard::check_unspent(const hash_t& uhs_id)
         -> std::optional<bool> {
-        std::shared_lock<std::shared_mutex> l(m_mut);
-        return m_uhs.find(uhs_id) != m_uhs.end()
-            || m_locked.find(uhs_id) != m_locked.end();
+        auto& stripe = get_stripe(uhs_id);
+        std::shared_lock<std::shared_mutex> l(stripe.m_mut);
+        return stripe.m_uhs.contains(uhs_id)
+            || stripe.m_locked.contains(uhs_id);
     }
 
     auto locking_shard::check_tx_id(const hash_t& tx_id)
@@ -8,17 +8,22 @@
 
 #include "client.hpp"
 #include "interface.hpp"
+#include "preseed.hpp"
 #include "status_interface.hpp"
 #include "uhs/transaction/transaction.hpp"
 #include "util/common/cache_set.hpp"
+#include "util/common/flat_hash_set.hpp"
 #include "util/common/hash.hpp"
 #include "util/common/hashmap.hpp"
 #include "util/common/logging.hpp"
+#include "util/common/worker_pool.hpp"
 
 #include <filesystem>
 #include <future>
 #include <leveldb/db.h>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -29,7 +34,6 @@ namespace cbdc::locking_shard {
     /// \brief In-memory implementation of \ref interface and
     /// \ref status_interface.
     ///
-    /// \warning Not thread safe.
     /// Implements a UHS through conservative two-phase locking. Callers
     /// atomically check a batch of prospective transactions for spendable
     /// input UHS IDs in this shard's range, and lock those UHS IDs. Based on
@@ -41,6 +45,14 @@ namespace cbdc::locking_shard {
     /// recently applied in the system. This is useful for recipients in a
     /// transaction to verify that the transaction has completed, or if the
     /// sender disconnects from the sentinel before receiving a response.
+    ///
+    /// The UHS and the set of locked UHS IDs are partitioned into stripes by
+    /// UHS ID, each guarded by its own lock. Lock and apply operations take
+    /// the stripes touched by one transaction at a time, in ascending order,
+    /// so each transaction is still locked or applied atomically while
+    /// operations on different dtxs run in parallel. A lock or apply for a
+    /// dtx already being locked or applied fails rather than running
+    /// alongside.
     class locking_shard final : public interface, public status_interface {
       public:
         /// Constructor.
@@ -50,9 +62,11 @@ namespace cbdc::locking_shard {
         /// \param completed_txs_cache_size number of confirmed TX IDs to keep
         ///                                 before evicting the oldest TX ID.
         /// \param preseed_file path to file containing shard pre-seeding data
-        ///                     or empty string to disable pre-seeding.
+        ///                     or empty string to disable pre-seeding. Either
+        ///                     a \ref uhs_preseed file, loaded in parallel,
+        ///                     or a serialized set of UHS IDs.
         /// \param opts configuration options.
-        locking_shard(const std::pair<uint8_t, uint8_t>& output_range,
+        locking_shard(const config::shard_range_t& output_range,
                       std::shared_ptr<logging::log> logger,
                       size_t completed_txs_cache_size,
                       const std::string& preseed_file,
@@ -76,6 +90,45 @@ namespace cbdc::locking_shard {
         auto lock_outputs(std::vector<tx>&& txs, const hash_t& dtx_id)
             -> std::optional<std::vector<bool>> final;
 
+        /// \brief Attempts to lock the input hashes for the given batch of
+        /// transactions, whose attestations have already been verified.
+        ///
+        /// Behaves as \ref lock_outputs, but rejects the transactions marked
+        /// invalid rather than verifying their attestations, so the outcome
+        /// is deterministic given the verdicts.
+        /// \param txs list of txs to attempt to lock.
+        /// \param valid result of \ref verify_attestations for txs.
+        /// \param dtx_id distributed tx ID for lock operation.
+        /// \return if lock succeeds, return a vector of flags corresponding to
+        ///         the txs in the input which had their relevant input hashes
+        ///         locked by the shard. Otherwise std::nullopt, including
+        ///         when valid does not hold one flag per transaction.
+        auto lock_verified_outputs(std::vector<tx>&& txs,
+                                   const std::vector<bool>& valid,
+                                   const hash_t& dtx_id)
+            -> std::optional<std::vector<bool>>;
+
+        /// Checks the sentinel attestations of each of the given
+        /// transactions against the configured public keys and threshold.
+        /// Does not access the state of the shard, so may run concurrently
+        /// with any other operation.
+        /// \param txs transactions to check.
+        /// \return flags indicating which transactions have valid
+        ///         attestations, by index in txs.
+        [[nodiscard]] auto
+        verify_attestations(const std::vector<tx>& txs) const
+            -> std::vector<bool>;
+
+        /// Behaves as \ref verify_attestations, but spreads the checks of
+        /// larger batches across the given pool of threads.
+        /// \param txs transactions to check.
+        /// \param workers pool of threads to check the transactions on.
+        /// \return flags indicating which transactions have valid
+        ///         attestations, by index in txs.
+        [[nodiscard]] auto verify_attestations(const std::vector<tx>& txs,
+                                               worker_pool& workers) const
+            -> std::vector<bool>;
+
         /// \brief Selectively applies the transactions from a previous lock
         /// operation.
         ///
@@ -124,20 +177,111 @@ namespace cbdc::locking_shard {
         [[nodiscard]] auto check_tx_id(const hash_t& tx_id)
             -> std::optional<bool> final;
 
+        /// Writes the state of the shard to a snapshot: the unspent and
+        /// locked UHS IDs, the prepared and applied dtxs, and the cache of
+        /// completed TX IDs. UHS IDs are streamed from the stripes rather
+        /// than copied. Must not run concurrently with lock, apply or discard
+        /// operations.
+        /// \param ser serializer to write the snapshot to.
+        /// \return false if the snapshot could not be written.
+        [[nodiscard]] auto write_snapshot(serializer& ser) -> bool;
+
+        /// Replaces the state of the shard with a snapshot written by
+        /// \ref write_snapshot. Must not run concurrently with lock, apply or
+        /// discard operations.
+        /// \param deser serializer to read the snapshot from.
+        /// \param max_ids upper bound on the number of UHS IDs in each set in
+        ///                the snapshot, such as the snapshot size divided by
+        ///                the UHS ID size.
+        /// \return false if the snapshot is malformed, in which case the
+        ///         state of the shard is unspecified.
+        [[nodiscard]] auto read_snapshot(serializer& deser, uint64_t max_ids)
+            -> bool;
+
       private:
-        auto read_preseed_file(const std::string& preseed_file) -> bool;
-        auto check_and_lock_tx(const tx& t) -> bool;
+        /// Progress of a dtx through lock and apply.
+        enum class dtx_state {
+            /// Stripes are being locked. No results yet.
+            locking,
+            /// Locked, and waiting for apply.
+            locked,
+            /// Stripes are being updated by apply.
+            applying
+        };
 
+        /// Lock results for a dtx, reserved in \ref m_prepared_dtxs before
+        /// its stripes are locked so that a duplicate lock or apply for the
+        /// same dtx is rejected rather than running alongside.
         struct prepared_dtx {
             std::vector<tx> m_txs;
             std::vector<bool> m_results;
+            dtx_state m_state{dtx_state::locking};
         };
+
+        /// Partition of the UHS guarded by its own lock. UHS IDs are stored
+        /// inline in flat sets, rather than in one heap node each, to fit
+        /// large preseeded UHSs in memory. The flat sets are also faster to
+        /// insert into and look up than node-based sets; see the uhs-set
+        /// benchmark.
+        struct uhs_stripe {
+            std::shared_mutex m_mut;
+            flat_hash_set m_uhs;
+            flat_hash_set m_locked;
+        };
+
+        using stripe_locks
+            = std::vector<std::unique_lock<std::shared_mutex>>;
+
+        /// Number of lock stripes for the UHS.
+        static constexpr size_t uhs_stripes{256};
+        /// Minimum number of transactions for which \ref verify_attestations
+        /// uses the worker pool.
+        static constexpr size_t min_parallel_verify{8};
+
+        auto read_preseed_file(const std::string& preseed_file) -> bool;
+
+        /// Checks the UHS IDs in a sorted preseed file, then inserts them
+        /// into the stripes. Each step splits the file into contiguous
+        /// ranges across one thread per core.
+        [[nodiscard]] auto load_preseed(const uhs_preseed& preseed) -> bool;
+
+        /// Reserves space in the unspent or locked sets of the stripes for
+        /// their share of the given number of UHS IDs.
+        void reserve_stripes(uint64_t count, bool locked);
+        auto check_and_lock_tx(const tx& t) -> bool;
+
+        /// Checks the sentinel attestations of a single transaction, and
+        /// logs a warning if they are invalid.
+        [[nodiscard]] auto verify_attestation(const tx& t) const -> bool;
+
+        /// Reads a serialized set of UHS IDs into the unspent or locked sets
+        /// of the stripes holding them.
+        [[nodiscard]] auto
+        read_ids(serializer& deser, uint64_t max_ids, bool locked) -> bool;
+
+        /// Writes the unspent or locked sets of all the stripes as a single
+        /// serialized set of UHS IDs.
+        void write_ids(serializer& ser, bool locked) const;
+
+        /// Locks every stripe in ascending order.
+        [[nodiscard]] auto lock_all_stripes() -> stripe_locks;
+
+        [[nodiscard]] static auto stripe_index(const hash_t& uhs_id)
+            -> size_t;
+        [[nodiscard]] auto get_stripe(const hash_t& uhs_id) -> uhs_stripe&;
+
+        /// Locks the stripes holding the transaction's input UHS IDs in this
+        /// shard's range, and its output UHS IDs if requested, in ascending
+        /// order.
+        [[nodiscard]] auto lock_stripes(const tx& t, bool outputs)
+            -> stripe_locks;
+
         std::atomic_bool m_running{true};
 
         std::shared_ptr<logging::log> m_logger;
+        /// Guards the prepared and applied dtx maps.
         mutable std::shared_mutex m_mut;
-        std::unordered_set<hash_t, hashing::null> m_uhs;
-        std::unordered_set<hash_t, hashing::null> m_locked;
+        std::vector<uhs_stripe> m_stripes;
         std::unordered_map<hash_t, prepared_dtx, hashing::null>
             m_prepared_dtxs;
         std::unordered_set<hash_t, hashing::null> m_applied_dtxs;
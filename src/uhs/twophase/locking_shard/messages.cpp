@@ -8,6 +8,11 @@
 #include <tuple>
 
 namespace cbdc::locking_shard::rpc {
+    auto verified_lock_params::operator==(
+        const verified_lock_params& rhs) const -> bool {
+        return std::tie(m_txs, m_valid) == std::tie(rhs.m_txs, rhs.m_valid);
+    }
+
     auto request::operator==(const request& rhs) const -> bool {
         return std::tie(m_dtx_id, m_params)
             == std::tie(rhs.m_dtx_id, rhs.m_params);
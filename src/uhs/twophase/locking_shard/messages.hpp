@@ -23,13 +23,29 @@ namespace cbdc::locking_shard::rpc {
         };
     };
 
+    /// Lock command replicated by the leader of a locking shard cluster once
+    /// it has verified the attestations of each transaction. Replicas lock
+    /// the transactions without verifying them again.
+    struct verified_lock_params {
+        /// Transactions whose outputs the locking shard should lock
+        std::vector<tx> m_txs;
+        /// True if the transaction at the same index has valid attestations
+        std::vector<bool> m_valid;
+
+        auto operator==(const verified_lock_params& rhs) const -> bool;
+    };
+
     /// Request to a shard
     struct request {
         /// The distributed transaction ID corresponding to the request
         hash_t m_dtx_id{};
         /// If the command is lock or apply, the parameters for these
         /// commands
-        std::variant<lock_params, apply_params, discard_params> m_params{};
+        std::variant<lock_params,
+                     apply_params,
+                     discard_params,
+                     verified_lock_params>
+            m_params{};
 
         auto operator==(const request& rhs) const -> bool;
     };
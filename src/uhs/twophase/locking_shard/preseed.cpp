@@ -0,0 +1,221 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "preseed.hpp"
+
+#include "util/serialization/format.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace cbdc::locking_shard {
+    auto uhs_preseed::write(const std::string& path, std::vector<hash_t>& ids)
+        -> bool {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        uint64_t sum{};
+        for(const auto& id : ids) {
+            sum += id_checksum(id.data());
+        }
+
+        auto out = std::ofstream(path, std::ios::binary | std::ios::trunc);
+        if(!out.good()) {
+            return false;
+        }
+        auto ser = ostream_serializer(out);
+        ser << magic << static_cast<uint64_t>(ids.size()) << sum;
+        for(const auto& id : ids) {
+            ser << id;
+        }
+        out.flush();
+        return out.good();
+    }
+
+    auto uhs_preseed::open(const std::string& path) -> bool {
+        if(!m_file.open(path) || m_file.size() < header_size) {
+            m_file.close();
+            return false;
+        }
+
+        uint64_t file_magic{};
+        std::memcpy(&file_magic, m_file.data(), sizeof(file_magic));
+        std::memcpy(&m_size,
+                    m_file.data() + sizeof(file_magic),
+                    sizeof(m_size));
+        std::memcpy(&m_checksum,
+                    m_file.data() + sizeof(file_magic) + sizeof(m_size),
+                    sizeof(m_checksum));
+
+        const auto data_size = m_file.size() - header_size;
+        if(file_magic != magic || data_size % hash_size != 0
+           || data_size / hash_size != m_size) {
+            m_file.close();
+            return false;
+        }
+        return true;
+    }
+
+    auto uhs_preseed::size() const -> uint64_t {
+        return m_size;
+    }
+
+    auto uhs_preseed::get(uint64_t idx) const -> hash_t {
+        auto id = hash_t();
+        std::memcpy(id.data(), id_data(idx), id.size());
+        return id;
+    }
+
+    auto uhs_preseed::check_range(uint64_t begin, uint64_t end) const
+        -> std::optional<uint64_t> {
+        uint64_t sum{};
+        for(auto i = begin; i < end; i++) {
+            if(i > 0
+               && std::memcmp(id_data(i - 1), id_data(i), hash_size) >= 0) {
+                return std::nullopt;
+            }
+            sum += id_checksum(id_data(i));
+        }
+        return sum;
+    }
+
+    auto uhs_preseed::checksum() const -> uint64_t {
+        return m_checksum;
+    }
+
+    auto uhs_preseed::id_checksum(const unsigned char* id) -> uint64_t {
+        uint64_t sum{};
+        for(size_t i = 0; i < hash_size; i += sizeof(uint64_t)) {
+            uint64_t word{};
+            std::memcpy(&word, id + i, sizeof(word));
+            sum += word;
+        }
+        return sum;
+    }
+
+    auto uhs_preseed::id_data(uint64_t idx) const -> const unsigned char* {
+        return m_file.data() + header_size + idx * hash_size;
+    }
+
+    uhs_preseed_writer::uhs_preseed_writer(std::string path,
+                                           size_t max_buffered)
+        : m_path(std::move(path)),
+          m_max_buffered(std::max<size_t>(max_buffered, 1)) {}
+
+    uhs_preseed_writer::~uhs_preseed_writer() {
+        for(const auto& run : m_runs) {
+            auto err = std::error_code();
+            std::filesystem::remove(run, err);
+        }
+    }
+
+    auto uhs_preseed_writer::add(const hash_t& id) -> bool {
+        m_buffer.push_back(id);
+        if(m_buffer.size() < m_max_buffered) {
+            return true;
+        }
+        return write_run();
+    }
+
+    auto uhs_preseed_writer::finish() -> bool {
+        if(m_runs.empty()) {
+            // Everything fits in memory
+            return uhs_preseed::write(m_path, m_buffer);
+        }
+
+        if(!m_buffer.empty() && !write_run()) {
+            return false;
+        }
+        auto ok = merge_runs();
+        for(const auto& run : m_runs) {
+            auto err = std::error_code();
+            std::filesystem::remove(run, err);
+        }
+        m_runs.clear();
+        return ok;
+    }
+
+    auto uhs_preseed_writer::write_run() -> bool {
+        std::sort(m_buffer.begin(), m_buffer.end());
+        m_buffer.erase(std::unique(m_buffer.begin(), m_buffer.end()),
+                       m_buffer.end());
+
+        auto run = m_path + ".run" + std::to_string(m_runs.size());
+        m_runs.push_back(run);
+        auto out = std::ofstream(run, std::ios::binary | std::ios::trunc);
+        for(const auto& id : m_buffer) {
+            out.write(reinterpret_cast<const char*>(id.data()),
+                      static_cast<std::streamsize>(id.size()));
+        }
+        out.flush();
+        m_buffer.clear();
+        return out.good();
+    }
+
+    auto uhs_preseed_writer::merge_runs() -> bool {
+        auto ins = std::vector<std::ifstream>();
+        ins.reserve(m_runs.size());
+        for(const auto& run : m_runs) {
+            ins.emplace_back(run, std::ios::binary);
+            if(!ins.back().good()) {
+                return false;
+            }
+        }
+
+        // Smallest next UHS ID of each run first
+        using head = std::pair<hash_t, size_t>;
+        auto heads
+            = std::priority_queue<head, std::vector<head>, std::greater<>>();
+        auto read_next = [&](size_t i) {
+            auto id = hash_t();
+            if(ins[i].read(reinterpret_cast<char*>(id.data()),
+                           static_cast<std::streamsize>(id.size()))) {
+                heads.emplace(id, i);
+            }
+        };
+        for(size_t i = 0; i < ins.size(); i++) {
+            read_next(i);
+        }
+
+        auto out = std::ofstream(m_path, std::ios::binary | std::ios::trunc);
+        if(!out.good()) {
+            return false;
+        }
+        auto ser = ostream_serializer(out);
+        // The count and checksum are filled in once the UHS IDs are written
+        uint64_t count{};
+        uint64_t sum{};
+        ser << uhs_preseed::magic << count << sum;
+        auto last = std::optional<hash_t>();
+        while(!heads.empty()) {
+            auto [id, i] = heads.top();
+            heads.pop();
+            read_next(i);
+            if(last == id) {
+                continue;
+            }
+            ser << id;
+            sum += uhs_preseed::id_checksum(id.data());
+            count++;
+            last = id;
+        }
+        for(const auto& in : ins) {
+            if(in.bad()) {
+                return false;
+            }
+        }
+
+        out.seekp(0);
+        ser << uhs_preseed::magic << count << sum;
+        out.flush();
+        return out.good();
+    }
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_LOCKING_SHARD_PRESEED_H_
+#define OPENCBDC_TX_SRC_LOCKING_SHARD_PRESEED_H_
+
+#include "util/common/hash.hpp"
+#include "util/common/mapped_file.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cbdc::locking_shard {
+    /// \brief Memory-mapped preseed file of sorted UHS IDs.
+    ///
+    /// The file holds a header followed by the UHS IDs as an array of
+    /// fixed-width hashes in strictly ascending order. The header holds a
+    /// magic number, the number of UHS IDs and a checksum of the array: the
+    /// sum of its 64-bit words, modulo 2^64. Any range of the array can be
+    /// checked and read directly from the mapping, so several threads can
+    /// load the UHS IDs at once.
+    class uhs_preseed {
+      public:
+        /// Writes UHS IDs to a preseed file.
+        /// \param path path of the file to create or replace.
+        /// \param ids UHS IDs to write. Sorted and deduplicated in place.
+        /// \return false if the file could not be written.
+        [[nodiscard]] static auto write(const std::string& path,
+                                        std::vector<hash_t>& ids) -> bool;
+
+        /// Maps a preseed file and checks its header against the size of
+        /// the file. Does not check the UHS IDs themselves.
+        /// \param path path of the file.
+        /// \return false if the file could not be mapped, or is not a
+        ///         preseed file in this format.
+        [[nodiscard]] auto open(const std::string& path) -> bool;
+
+        /// Returns the number of UHS IDs in the file.
+        /// \return UHS ID count.
+        [[nodiscard]] auto size() const -> uint64_t;
+
+        /// Returns the UHS ID at the given index in the file.
+        /// \param idx index of the UHS ID, less than \ref size.
+        /// \return UHS ID.
+        [[nodiscard]] auto get(uint64_t idx) const -> hash_t;
+
+        /// Checks that the UHS IDs in the given range are in strictly
+        /// ascending order, and follow the UHS ID before the range, and
+        /// computes their checksum. The checksums of ranges covering the
+        /// file add up to \ref checksum.
+        /// \param begin index of the first UHS ID in the range.
+        /// \param end index after the last UHS ID in the range.
+        /// \return checksum of the range, or std::nullopt if the UHS IDs are
+        ///         out of order.
+        [[nodiscard]] auto check_range(uint64_t begin, uint64_t end) const
+            -> std::optional<uint64_t>;
+
+        /// Returns the checksum of the UHS IDs recorded in the header.
+        /// \return checksum.
+        [[nodiscard]] auto checksum() const -> uint64_t;
+
+      private:
+        friend class uhs_preseed_writer;
+
+        /// "preseed1" in little-endian byte order.
+        static constexpr uint64_t magic{0x3164656573657270};
+        static constexpr size_t header_size{3 * sizeof(uint64_t)};
+
+        mapped_file m_file;
+        uint64_t m_size{};
+        uint64_t m_checksum{};
+
+        [[nodiscard]] static auto id_checksum(const unsigned char* id)
+            -> uint64_t;
+        [[nodiscard]] auto id_data(uint64_t idx) const -> const unsigned char*;
+    };
+
+    /// \brief Writes a preseed file from UHS IDs in any order, in bounded
+    /// memory.
+    ///
+    /// Buffers up to a given number of UHS IDs, and writes each full buffer
+    /// to a temporary file next to the preseed file as a sorted run. \ref
+    /// finish merges the runs into the preseed file, so writing needs disk
+    /// space for a second copy of the UHS IDs rather than memory for all of
+    /// them.
+    class uhs_preseed_writer {
+      public:
+        /// Constructor.
+        /// \param path path of the preseed file to create or replace.
+        /// \param max_buffered maximum number of UHS IDs to hold in memory.
+        uhs_preseed_writer(std::string path, size_t max_buffered);
+
+        /// Removes any temporary files.
+        ~uhs_preseed_writer();
+
+        uhs_preseed_writer(const uhs_preseed_writer&) = delete;
+        auto operator=(const uhs_preseed_writer&)
+            -> uhs_preseed_writer& = delete;
+        uhs_preseed_writer(uhs_preseed_writer&&) = delete;
+        auto operator=(uhs_preseed_writer&&) -> uhs_preseed_writer& = delete;
+
+        /// Adds a UHS ID to the preseed file. Duplicates are written once.
+        /// \param id UHS ID to add.
+        /// \return false if a temporary file could not be written.
+        [[nodiscard]] auto add(const hash_t& id) -> bool;
+
+        /// Writes the preseed file from the added UHS IDs, and removes the
+        /// temporary files.
+        /// \return false if the file could not be written.
+        [[nodiscard]] auto finish() -> bool;
+
+      private:
+        std::string m_path;
+        size_t m_max_buffered;
+        std::vector<hash_t> m_buffer;
+        std::vector<std::string> m_runs;
+
+        /// Sorts the buffered UHS IDs and writes them to a new run file.
+        [[nodiscard]] auto write_run() -> bool;
+
+        /// Merges the run files into the preseed file.
+        [[nodiscard]] auto merge_runs() -> bool;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_LOCKING_SHARD_PRESEED_H_
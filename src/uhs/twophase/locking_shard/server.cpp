@@ -0,0 +1,120 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "server.hpp"
+
+#include "format.hpp"
+#include "messages.hpp"
+#include "util/raft/serialization.hpp"
+#include "util/raft/util.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/util.hpp"
+
+#include <algorithm>
+
+namespace cbdc::locking_shard::rpc {
+    server::~server() {
+        m_queue.clear();
+        for(auto& t : m_threads) {
+            if(t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    void server::register_raft_node(std::shared_ptr<raft::node> node,
+                                    std::shared_ptr<locking_shard> shard) {
+        m_node = std::move(node);
+        m_shard = std::move(shard);
+        cbdc::rpc::raw_async_server::register_handler_callback(
+            [&](buffer req, response_callback_type resp_cb) -> bool {
+                m_queue.push({std::move(req), std::move(resp_cb)});
+                return true;
+            });
+
+        // hardware_concurrency() may return zero if it cannot be determined
+        auto n_threads
+            = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        m_workers = std::make_unique<worker_pool>(n_threads);
+        for(size_t i = 0; i < n_threads; i++) {
+            m_threads.emplace_back([&]() {
+                while(handle_request()) {}
+            });
+        }
+    }
+
+    auto server::handle_request() -> bool {
+        auto req = request_type();
+        auto popped = m_queue.pop(req);
+        if(!popped) {
+            return false;
+        }
+
+        auto& [request_buf, resp_cb] = req;
+        if(!m_node->is_leader()) {
+            resp_cb(std::nullopt);
+            return true;
+        }
+
+        auto new_log = make_log_entry(request_buf);
+        if(!new_log) {
+            resp_cb(std::nullopt);
+            return true;
+        }
+
+        auto success = m_node->replicate(
+            new_log,
+            [resp_cb = resp_cb](raft::result_type& r,
+                                nuraft::ptr<std::exception>& err) {
+                if(err) {
+                    resp_cb(std::nullopt);
+                    return;
+                }
+
+                const auto res = r.get();
+                if(!res) {
+                    resp_cb(std::nullopt);
+                    return;
+                }
+
+                auto resp_pkt = cbdc::buffer();
+                resp_pkt.append(res->data_begin(), res->size());
+                resp_cb(std::move(resp_pkt));
+            });
+        if(!success) {
+            resp_cb(std::nullopt);
+        }
+
+        return true;
+    }
+
+    auto server::make_log_entry(buffer& request_buf) const
+        -> nuraft::ptr<nuraft::buffer> {
+        auto maybe_req = from_buffer<request>(request_buf);
+        if(!maybe_req.has_value()) {
+            return nullptr;
+        }
+
+        auto& req = maybe_req.value();
+        if(std::holds_alternative<verified_lock_params>(req.m_params)) {
+            // Only the leader may attach attestation verdicts to a lock
+            return nullptr;
+        }
+
+        auto* lock = std::get_if<lock_params>(&req.m_params);
+        if(lock == nullptr) {
+            // Other requests are replicated unchanged
+            auto new_log = nuraft::buffer::alloc(request_buf.size());
+            nuraft::buffer_serializer bs(new_log);
+            bs.put_raw(request_buf.data(), request_buf.size());
+            return new_log;
+        }
+
+        auto valid = m_shard->verify_attestations(*lock, *m_workers);
+        req.m_params
+            = verified_lock_params{std::move(*lock), std::move(valid)};
+        return make_buffer<request, nuraft::ptr<nuraft::buffer>>(req);
+    }
+}
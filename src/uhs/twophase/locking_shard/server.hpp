@@ -0,0 +1,69 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_LOCKING_SHARD_SERVER_H_
+#define OPENCBDC_TX_SRC_LOCKING_SHARD_SERVER_H_
+
+#include "locking_shard.hpp"
+#include "util/common/blocking_queue.hpp"
+#include "util/common/worker_pool.hpp"
+#include "util/raft/node.hpp"
+#include "util/rpc/async_server.hpp"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace cbdc::locking_shard::rpc {
+    /// \brief RPC server for the leader of a locking shard raft cluster.
+    ///
+    /// Replicates requests to the cluster, which executes them via its state
+    /// machine, and returns the result via a callback function. Verifies the
+    /// sentinel attestations of the transactions in lock requests before
+    /// replicating them, spreading the transactions of each request across a
+    /// pool of worker threads, and replicates the verdicts along
+    /// with the transactions. Every node then applies the lock without
+    /// verifying the attestations again, so each signature is checked once
+    /// per cluster, outside the state machine.
+    class server : public cbdc::rpc::raw_async_server {
+      public:
+        server() = default;
+        ~server() override;
+
+        server(const server&) = delete;
+        auto operator=(const server&) -> server& = delete;
+        server(server&&) = delete;
+        auto operator=(server&&) -> server& = delete;
+
+        /// Registers the raft node which replicates requests for this
+        /// server, and starts the request handler threads.
+        /// \param node pointer to the raft node.
+        /// \param shard pointer to the locking shard replicated by the raft
+        ///              node, used to verify attestations.
+        void register_raft_node(std::shared_ptr<raft::node> node,
+                                std::shared_ptr<locking_shard> shard);
+
+      private:
+        using request_type = std::pair<buffer, response_callback_type>;
+
+        std::shared_ptr<raft::node> m_node;
+        std::shared_ptr<locking_shard> m_shard;
+        blocking_queue<request_type> m_queue;
+
+        std::vector<std::thread> m_threads;
+        /// Threads which verify the attestations of lock requests.
+        std::unique_ptr<worker_pool> m_workers;
+
+        auto handle_request() -> bool;
+
+        /// Returns the raft log entry for the given serialized request,
+        /// replacing lock requests with verified lock requests, or nullptr
+        /// if the request is malformed.
+        [[nodiscard]] auto make_log_entry(buffer& request_buf) const
+            -> nuraft::ptr<nuraft::buffer>;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_LOCKING_SHARD_SERVER_H_
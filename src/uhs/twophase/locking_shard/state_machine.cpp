@@ -6,28 +6,54 @@
 #include "state_machine.hpp"
 
 #include "format.hpp"
+#include "util/common/mapped_file.hpp"
 #include "util/raft/serialization.hpp"
 #include "util/serialization/format.hpp"
+#include "util/serialization/istream_serializer.hpp"
+#include "util/serialization/ostream_serializer.hpp"
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <unistd.h>
 
 namespace cbdc::locking_shard {
     state_machine::state_machine(
-        const std::pair<uint8_t, uint8_t>& output_range,
+        const config::shard_range_t& output_range,
         std::shared_ptr<logging::log> logger,
         size_t completed_txs_cache_size,
         const std::string& preseed_file,
+        std::string snapshot_dir,
         config::options opts)
         : m_output_range(output_range),
+          m_snapshot_dir(std::move(snapshot_dir)),
           m_logger(std::move(logger)) {
         register_handler_callback([&](rpc::request req) {
             return process_request(std::move(req));
         });
-        m_shard = std::make_unique<locking_shard>(output_range,
-                                                  m_logger,
-                                                  completed_txs_cache_size,
-                                                  preseed_file,
-                                                  std::move(opts));
+
+        auto err = std::error_code();
+        std::filesystem::create_directory(m_snapshot_dir, err);
+        if(err) {
+            m_logger->fatal("Failed to create snapshot directory",
+                            m_snapshot_dir);
+        }
+
+        // The preseed is only needed if there is no snapshot to restore
+        auto snp = state_machine::last_snapshot();
+        m_shard = std::make_unique<locking_shard>(
+            output_range,
+            m_logger,
+            completed_txs_cache_size,
+            snp ? std::string() : preseed_file,
+            std::move(opts));
+        if(snp) {
+            m_logger->info("Restoring snapshot at log index",
+                           snp->get_last_log_idx());
+            if(!state_machine::apply_snapshot(*snp)) {
+                m_logger->fatal("Failed to restore snapshot");
+            }
+        }
     }
 
     auto state_machine::commit(uint64_t log_idx, nuraft::buffer& data)
@@ -53,12 +79,148 @@ namespace cbdc::locking_shard {
         m_last_committed_idx = log_idx;
     }
 
-    auto state_machine::apply_snapshot(nuraft::snapshot& /* s */) -> bool {
-        return false;
+    auto
+    state_machine::read_logical_snp_obj(nuraft::snapshot& s,
+                                        void*& user_snp_ctx,
+                                        nuraft::ulong obj_id,
+                                        nuraft::ptr<nuraft::buffer>& data_out,
+                                        bool& is_last_obj) -> int {
+        auto* file = static_cast<mapped_file*>(user_snp_ctx);
+        if(file == nullptr) {
+            // Keep the file mapped for the rest of the transfer. The mapping
+            // remains valid if the snapshot is replaced in the meantime.
+            auto mapped = mapped_file();
+            {
+                std::shared_lock<std::shared_mutex> l(m_snp_mut);
+                if(!mapped.open(get_snapshot_path(s.get_last_log_idx()))) {
+                    // Requested snapshot doesn't exist anymore, not fatal
+                    return -1;
+                }
+            }
+            file = new mapped_file(std::move(mapped));
+            user_snp_ctx = file;
+        }
+
+        const auto offset = obj_id * m_snp_chunk_size;
+        if(offset >= file->size()) {
+            return -1;
+        }
+        const auto sz = std::min(m_snp_chunk_size, file->size() - offset);
+        auto buf = nuraft::buffer::alloc(sz);
+        std::memcpy(buf->data_begin(), file->data() + offset, sz);
+        data_out = std::move(buf);
+        is_last_obj = offset + sz == file->size();
+
+        return 0;
+    }
+
+    void state_machine::save_logical_snp_obj(nuraft::snapshot& s,
+                                             nuraft::ulong& obj_id,
+                                             nuraft::buffer& data,
+                                             bool is_first_obj,
+                                             bool is_last_obj) {
+        auto recv_path = get_recv_path();
+        {
+            std::unique_lock<std::shared_mutex> l(m_snp_mut);
+            auto mode = std::ios::out | std::ios::binary;
+            if(is_first_obj) {
+                mode |= std::ios::trunc;
+            } else {
+                mode |= std::ios::in;
+            }
+            auto ss = std::ofstream(recv_path, mode);
+            if(!ss.good()) {
+                // Since we're the exclusive writer, this should work
+                std::exit(EXIT_FAILURE);
+            }
+
+            // Objects are written at their offset so a transfer can resume
+            // from any object ID.
+            ss.seekp(static_cast<std::streamoff>(obj_id * m_snp_chunk_size));
+            ss.write(reinterpret_cast<const char*>(data.data_begin()),
+                     static_cast<std::streamsize>(data.size()));
+            if(!ss.good()) {
+                std::exit(EXIT_FAILURE);
+            }
+
+            ss.flush();
+            ss.close();
+
+            if(is_last_obj) {
+                auto path = get_snapshot_path(s.get_last_log_idx());
+                auto err = std::error_code();
+                std::filesystem::rename(recv_path, path, err);
+                if(err) {
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+        }
+
+        obj_id++;
+    }
+
+    void state_machine::free_user_snp_ctx(void*& user_snp_ctx) {
+        delete static_cast<mapped_file*>(user_snp_ctx);
+        user_snp_ctx = nullptr;
+    }
+
+    auto state_machine::apply_snapshot(nuraft::snapshot& s) -> bool {
+        std::shared_lock<std::shared_mutex> l(m_snp_mut);
+        auto path = get_snapshot_path(s.get_last_log_idx());
+        auto ss = std::ifstream(path, std::ios::in | std::ios::binary);
+        if(!ss.good()) {
+            return false;
+        }
+        auto err = std::error_code();
+        auto sz = std::filesystem::file_size(path, err);
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+
+        // Skip the snapshot metadata, which the caller already has
+        auto deser = cbdc::istream_serializer(ss);
+        uint64_t snp_sz{};
+        if(!(deser >> snp_sz) || snp_sz > sz) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto snp_buf = nuraft::buffer::alloc(snp_sz);
+        if(!deser.read(snp_buf->data_begin(), snp_buf->size())) {
+            std::exit(EXIT_FAILURE);
+        }
+
+        if(!m_shard->read_snapshot(deser, sz / hash_size)) {
+            std::exit(EXIT_FAILURE);
+        }
+        m_last_committed_idx = s.get_last_log_idx();
+        return true;
     }
 
     auto state_machine::last_snapshot() -> nuraft::ptr<nuraft::snapshot> {
-        return nullptr;
+        std::shared_lock<std::shared_mutex> l(m_snp_mut);
+        const auto idx = last_snapshot_idx();
+        if(idx == 0) {
+            return nullptr;
+        }
+
+        auto path = get_snapshot_path(idx);
+        auto ss = std::ifstream(path, std::ios::in | std::ios::binary);
+        auto err = std::error_code();
+        auto sz = std::filesystem::file_size(path, err);
+        if(!ss.good() || err) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto deser = cbdc::istream_serializer(ss);
+        uint64_t snp_sz{};
+        if(!(deser >> snp_sz) || snp_sz > sz) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto snp_buf = nuraft::buffer::alloc(snp_sz);
+        if(!deser.read(snp_buf->data_begin(), snp_buf->size())) {
+            std::exit(EXIT_FAILURE);
+        }
+        auto snp = nuraft::snapshot::deserialize(*snp_buf);
+        snp->set_size(sz);
+        return snp;
     }
 
     auto state_machine::last_commit_index() -> uint64_t {
@@ -66,10 +228,61 @@ namespace cbdc::locking_shard {
     }
 
     void state_machine::create_snapshot(
-        nuraft::snapshot& /* s */,
+        nuraft::snapshot& s,
         nuraft::async_result<bool>::handler_type& when_done) {
+        assert(s.get_last_log_idx() == last_commit_index());
         nuraft::ptr<std::exception> except(nullptr);
-        bool ret = false;
+        bool ret = true;
+
+        auto snp_buf = s.serialize();
+        auto tmp_path = get_tmp_path();
+        auto path = get_snapshot_path(s.get_last_log_idx());
+        {
+            std::unique_lock<std::shared_mutex> l(m_snp_mut);
+            auto ss = std::ofstream(tmp_path,
+                                    std::ios::out | std::ios::trunc
+                                        | std::ios::binary);
+            if(!ss.good()) {
+                // We're the exclusive writer so these file operations should
+                // work
+                std::exit(EXIT_FAILURE);
+            }
+
+            auto ser = cbdc::ostream_serializer(ss);
+            ser << static_cast<uint64_t>(snp_buf->size());
+            ser.write(snp_buf->data_begin(), snp_buf->size());
+            if(!ser || !m_shard->write_snapshot(ser)) {
+                std::exit(EXIT_FAILURE);
+            }
+
+            ss.flush();
+            ss.close();
+
+            auto err = std::error_code();
+            std::filesystem::rename(tmp_path, path, err);
+            if(err) {
+                std::exit(EXIT_FAILURE);
+            }
+
+            // Transfers of the previous snapshot in progress keep reading
+            // their mapping of the removed file
+            for(const auto& p :
+                std::filesystem::directory_iterator(m_snapshot_dir)) {
+                auto name = p.path().filename().generic_string();
+                if(name == m_recv_file) {
+                    continue;
+                }
+                if(name == m_tmp_file
+                   || std::stoull(name) < s.get_last_log_idx()) {
+                    std::filesystem::remove(p, err);
+                    if(err) {
+                        std::exit(EXIT_FAILURE);
+                    }
+                }
+            }
+        }
+
+        m_logger->info("Created snapshot at log index", s.get_last_log_idx());
         when_done(ret, except);
     }
 
@@ -78,12 +291,42 @@ namespace cbdc::locking_shard {
         return m_shard;
     }
 
+    auto state_machine::get_snapshot_path(uint64_t idx) const -> std::string {
+        return m_snapshot_dir + "/" + std::to_string(idx);
+    }
+
+    auto state_machine::get_tmp_path() const -> std::string {
+        return m_snapshot_dir + "/" + m_tmp_file;
+    }
+
+    auto state_machine::get_recv_path() const -> std::string {
+        return m_snapshot_dir + "/" + m_recv_file;
+    }
+
+    auto state_machine::last_snapshot_idx() const -> uint64_t {
+        uint64_t max_idx{0};
+        auto err = std::error_code();
+        for(const auto& p :
+            std::filesystem::directory_iterator(m_snapshot_dir, err)) {
+            auto name = p.path().filename().generic_string();
+            if(name == m_tmp_file || name == m_recv_file) {
+                continue;
+            }
+            max_idx = std::max(max_idx, uint64_t{std::stoull(name)});
+        }
+        if(err) {
+            std::exit(EXIT_FAILURE);
+        }
+        return max_idx;
+    }
+
     auto state_machine::process_request(cbdc::locking_shard::rpc::request req)
-        -> cbdc::locking_shard::rpc::response {
+        -> std::optional<cbdc::locking_shard::rpc::response> {
         auto dtxid_str = to_string(req.m_dtx_id);
         return std::visit(
             overloaded{[&](rpc::lock_params&& params)
-                           -> cbdc::locking_shard::rpc::response {
+                           -> std::optional<
+                               cbdc::locking_shard::rpc::response> {
                            m_logger->info("Processing lock",
                                           dtxid_str,
                                           "with",
@@ -95,8 +338,32 @@ namespace cbdc::locking_shard {
                            m_logger->info("Done lock", dtxid_str);
                            return res.value();
                        },
+                       [&](rpc::verified_lock_params&& params)
+                           -> std::optional<
+                               cbdc::locking_shard::rpc::response> {
+                           m_logger->info("Processing verified lock",
+                                          dtxid_str,
+                                          "with",
+                                          params.m_txs.size(),
+                                          "txs");
+                           auto res = m_shard->lock_verified_outputs(
+                               std::move(params.m_txs),
+                               params.m_valid,
+                               req.m_dtx_id);
+                           if(!res.has_value()) {
+                               // The verdicts are replicated as part of the
+                               // log entry, so reject a malformed entry
+                               // rather than trusting it
+                               m_logger->error("Failed verified lock",
+                                               dtxid_str);
+                               return std::nullopt;
+                           }
+                           m_logger->info("Done lock", dtxid_str);
+                           return res.value();
+                       },
                        [&](rpc::apply_params&& params)
-                           -> cbdc::locking_shard::rpc::response {
+                           -> std::optional<
+                               cbdc::locking_shard::rpc::response> {
                            m_logger->info("Processing apply", dtxid_str);
                            [[maybe_unused]] auto res
                                = m_shard->apply_outputs(std::move(params),
@@ -106,7 +373,8 @@ namespace cbdc::locking_shard {
                            return rpc::apply_response();
                        },
                        [&](rpc::discard_params&& /* params */)
-                           -> cbdc::locking_shard::rpc::response {
+                           -> std::optional<
+                               cbdc::locking_shard::rpc::response> {
                            m_logger->info("Processing discard", dtxid_str);
                            [[maybe_unused]] auto res
                                = m_shard->discard_dtx(req.m_dtx_id);
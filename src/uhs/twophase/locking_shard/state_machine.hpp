@@ -12,9 +12,15 @@
 
 #include <libnuraft/nuraft.hxx>
 #include <mutex>
+#include <shared_mutex>
 
 namespace cbdc::locking_shard {
-    /// Raft state machine for handling locking shard RPC requests.
+    /// \brief Raft state machine for handling locking shard RPC requests.
+    ///
+    /// Snapshots hold the raft snapshot metadata followed by the full state
+    /// of the locking shard, streamed to a file in the snapshot directory.
+    /// Only the most recent snapshot is kept. Snapshots are sent to other
+    /// nodes in fixed-size chunks of the file.
     class state_machine
         : public nuraft::state_machine,
           public cbdc::rpc::blocking_server<rpc::request,
@@ -22,7 +28,9 @@ namespace cbdc::locking_shard {
                                             nuraft::buffer&,
                                             nuraft::ptr<nuraft::buffer>> {
       public:
-        /// Constructor.
+        /// Constructor. Restores the state of the locking shard from the
+        /// most recent snapshot, if there is one, rather than from the
+        /// preseed file.
         /// \param output_range inclusive range of hash prefixes this shard is
         ///                     responsible for.
         /// \param logger log instance.
@@ -30,11 +38,14 @@ namespace cbdc::locking_shard {
         ///                                 before evicting the oldest TX ID.
         /// \param preseed_file path to file containing shard pre-seeding data
         ///                     or empty string to disable pre-seeding.
+        /// \param snapshot_dir path to directory in which to store snapshots.
+        ///                     Will create the directory if it doesn't exist.
         /// \param opts configuration options.
-        state_machine(const std::pair<uint8_t, uint8_t>& output_range,
+        state_machine(const config::shard_range_t& output_range,
                       std::shared_ptr<logging::log> logger,
                       size_t completed_txs_cache_size,
                       const std::string& preseed_file,
+                      std::string snapshot_dir,
                       config::options opts);
 
         /// Commit the given raft log entry at the given log index, and return
@@ -52,23 +63,69 @@ namespace cbdc::locking_shard {
             nuraft::ulong log_idx,
             nuraft::ptr<nuraft::cluster_config>& /*new_conf*/) override;
 
-        /// Not implemented for locking shard.
-        /// \return false.
-        auto apply_snapshot(nuraft::snapshot& /* s */) -> bool override;
-
-        /// Not implemented for locking shard.
-        /// \return nullptr.
+        /// Read the portion of the snapshot with the given metadata and
+        /// object ID into a buffer. Each object is a chunk of the snapshot
+        /// file of at most \ref m_snp_chunk_size bytes, read from a memory
+        /// mapping of the file.
+        /// \param s metadata of snapshot to read.
+        /// \param user_snp_ctx pointer to a snapshot context; must be provided
+        ///                     to all successive calls to this method for the
+        ///                     same snapshot.
+        /// \param obj_id ID of the snapshot object to read.
+        /// \param data_out buffer in which to write the snapshot object.
+        /// \param is_last_obj set to true if this object ID is the last
+        ///                    snapshot object.
+        /// \return 0 if the object was read successfully.
+        auto read_logical_snp_obj(nuraft::snapshot& s,
+                                  void*& user_snp_ctx,
+                                  nuraft::ulong obj_id,
+                                  nuraft::ptr<nuraft::buffer>& data_out,
+                                  bool& is_last_obj) -> int override;
+
+        /// Saves the portion of the snapshot with the given metadata and
+        /// object ID. Each object is written at its offset in a temporary
+        /// file which replaces the snapshot once the last object has been
+        /// received.
+        /// \param s metadata of snapshot to save.
+        /// \param obj_id ID of the snapshot object to save.
+        /// \param data buffer from which to read the snapshot object data to
+        ///             save.
+        /// \param is_first_obj true if this object ID is the first snapshot
+        ///                     object.
+        /// \param is_last_obj true if this object ID is the last snapshot
+        ///                    object.
+        void save_logical_snp_obj(nuraft::snapshot& s,
+                                  nuraft::ulong& obj_id,
+                                  nuraft::buffer& data,
+                                  bool is_first_obj,
+                                  bool is_last_obj) override;
+
+        /// Releases the snapshot file mapping held by a snapshot context.
+        /// \param user_snp_ctx snapshot context from read_logical_snp_obj.
+        void free_user_snp_ctx(void*& user_snp_ctx) override;
+
+        /// Replaces the state of the locking shard with the state stored in
+        /// the snapshot referenced by the given snapshot metadata.
+        /// \param s snapshot metadata.
+        /// \return true if the snapshot was applied.
+        auto apply_snapshot(nuraft::snapshot& s) -> bool override;
+
+        /// Returns the most recent snapshot metadata.
+        /// \return snapshot metadata, or nullptr if there is no snapshot.
         auto last_snapshot() -> nuraft::ptr<nuraft::snapshot> override;
 
         /// Returns the most recently committed log entry index.
         /// \return log entry index.
         auto last_commit_index() -> uint64_t override;
 
-        /// Not implemented for locking shard.
+        /// Writes a snapshot of the locking shard with the given metadata,
+        /// and removes the previous snapshot.
+        /// \param s snapshot metadata.
+        /// \param when_done function to call when snapshot creation is
+        ///                  complete.
         void create_snapshot(
-            nuraft::snapshot& /* s */,
-            nuraft::async_result<bool>::handler_type& /* when_done */)
-            override;
+            nuraft::snapshot& s,
+            nuraft::async_result<bool>::handler_type& when_done) override;
 
         /// Returns a pointer to the locking shard instance managed by this
         /// state machine.
@@ -78,19 +135,32 @@ namespace cbdc::locking_shard {
 
       private:
         auto process_request(cbdc::locking_shard::rpc::request req)
-            -> cbdc::locking_shard::rpc::response;
+            -> std::optional<cbdc::locking_shard::rpc::response>;
 
-        std::atomic<uint64_t> m_last_committed_idx{0};
-        nuraft::ptr<nuraft::snapshot> m_snapshot{};
-        std::shared_mutex m_snapshots_mut{};
+        [[nodiscard]] auto get_snapshot_path(uint64_t idx) const
+            -> std::string;
+
+        [[nodiscard]] auto get_tmp_path() const -> std::string;
+
+        [[nodiscard]] auto get_recv_path() const -> std::string;
 
-        nuraft::ptr<nuraft::snapshot> m_tmp_snapshot{};
-        std::mutex m_tmp_mut{};
+        /// Returns the log index of the most recent snapshot, or zero if
+        /// there is none.
+        [[nodiscard]] auto last_snapshot_idx() const -> uint64_t;
+
+        static constexpr auto m_tmp_file = "tmp";
+        static constexpr auto m_recv_file = "recv";
+
+        /// Size of the objects used to transfer snapshots to other nodes.
+        static constexpr size_t m_snp_chunk_size{4UL * 1024 * 1024};
+
+        std::atomic<uint64_t> m_last_committed_idx{0};
 
         std::shared_ptr<cbdc::locking_shard::locking_shard> m_shard{};
-        std::pair<uint8_t, uint8_t> m_output_range{};
+        config::shard_range_t m_output_range{};
         std::string m_snapshot_dir{};
-        std::string m_db_dir{};
+        /// Guards the files in the snapshot directory.
+        std::shared_mutex m_snp_mut{};
 
         std::shared_ptr<logging::log> m_logger;
     };
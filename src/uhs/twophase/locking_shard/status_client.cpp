@@ -11,12 +11,12 @@ namespace cbdc::locking_shard::rpc {
     status_client::status_client(
         std::vector<std::vector<network::endpoint_t>>
             shard_read_only_endpoints,
-        std::vector<config::shard_range_t> shard_ranges,
+        const std::vector<config::shard_range_t>& shard_ranges,
         std::chrono::milliseconds timeout)
-        : m_shard_ranges(std::move(shard_ranges)),
+        : m_routes(shard_ranges),
           m_request_timeout(timeout) {
-        assert(m_shard_ranges.size() == shard_read_only_endpoints.size());
-        m_shard_clients.reserve(m_shard_ranges.size());
+        assert(m_routes.shard_count() == shard_read_only_endpoints.size());
+        m_shard_clients.reserve(m_routes.shard_count());
         for(auto& cluster : shard_read_only_endpoints) {
             m_shard_clients.emplace_back(
                 std::make_unique<
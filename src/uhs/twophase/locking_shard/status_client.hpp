@@ -9,6 +9,7 @@
 #include "status_interface.hpp"
 #include "status_messages.hpp"
 #include "util/common/config.hpp"
+#include "util/common/routing_table.hpp"
 #include "util/rpc/tcp_client.hpp"
 
 namespace cbdc::locking_shard::rpc {
@@ -28,7 +29,7 @@ namespace cbdc::locking_shard::rpc {
         ///                no timeout.
         status_client(std::vector<std::vector<network::endpoint_t>>
                           shard_read_only_endpoints,
-                      std::vector<config::shard_range_t> shard_ranges,
+                      const std::vector<config::shard_range_t>& shard_ranges,
                       std::chrono::milliseconds timeout
                       = std::chrono::milliseconds::zero());
 
@@ -66,18 +67,17 @@ namespace cbdc::locking_shard::rpc {
         std::vector<std::unique_ptr<
             cbdc::rpc::tcp_client<status_request, status_response>>>
             m_shard_clients;
-        std::vector<config::shard_range_t> m_shard_ranges;
+        config::routing_table m_routes;
         std::chrono::milliseconds m_request_timeout;
 
         template<typename T>
         auto make_request(const hash_t& val) -> std::optional<bool> {
-            // TODO: optimize the algorithm for shard selection.
-            for(size_t i = 0; i < m_shard_ranges.size(); i++) {
-                if(config::hash_in_shard_range(m_shard_ranges[i], val)) {
-                    return m_shard_clients[i]->call(T{val}, m_request_timeout);
-                }
+            const auto& shards = m_routes.shards_for(val);
+            if(shards.empty()) {
+                return std::nullopt;
             }
-            return std::nullopt;
+            return m_shard_clients[shards.front()]->call(T{val},
+                                                         m_request_timeout);
         }
     };
 }
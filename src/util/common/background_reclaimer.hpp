@@ -0,0 +1,71 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_BACKGROUND_RECLAIMER_H_
+#define OPENCBDC_TX_SRC_COMMON_BACKGROUND_RECLAIMER_H_
+
+#include "blocking_queue.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cbdc {
+    /// \brief Destroys objects on a dedicated background thread.
+    ///
+    /// Allows the owner of a large container to release it without paying
+    /// for the element destructors and deallocations on a latency-sensitive
+    /// thread. The background thread is started by the first call to
+    /// \ref retire.
+    class background_reclaimer {
+      public:
+        background_reclaimer() = default;
+
+        background_reclaimer(const background_reclaimer&) = delete;
+        auto operator=(const background_reclaimer&)
+            -> background_reclaimer& = delete;
+
+        background_reclaimer(background_reclaimer&&) = delete;
+        auto operator=(background_reclaimer&&)
+            -> background_reclaimer& = delete;
+
+        /// \brief Destructor.
+        ///
+        /// Stops the background thread. Objects still waiting to be
+        /// reclaimed are destroyed by the calling thread.
+        ~background_reclaimer() {
+            m_queue.clear();
+            if(m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+
+        /// Takes ownership of the given object and queues it for destruction
+        /// on the background thread. Rvalues are moved and lvalues copied.
+        /// \tparam T type of object to retire.
+        /// \param obj object to retire.
+        template<typename T>
+        void retire(T&& obj) {
+            std::call_once(m_start, [&]() {
+                m_thread = std::thread([&]() {
+                    auto retired = std::shared_ptr<void>();
+                    while(m_queue.pop(retired)) {
+                        retired.reset();
+                    }
+                });
+            });
+            m_queue.push(std::make_shared<std::decay_t<T>>(std::forward<T>(obj)));
+        }
+
+      private:
+        blocking_queue<std::shared_ptr<void>> m_queue;
+        std::once_flag m_start;
+        std::thread m_thread;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_BACKGROUND_RECLAIMER_H_
@@ -0,0 +1,77 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blocked_bloom_filter.hpp"
+
+#include <algorithm>
+
+namespace cbdc {
+    blocked_bloom_filter::blocked_bloom_filter(size_t capacity) {
+        static constexpr size_t bits_per_block
+            = words_per_block * sizeof(uint32_t) * 8;
+        auto n_blocks = (capacity * bits_per_key + bits_per_block - 1)
+                      / bits_per_block;
+        m_blocks.resize(std::max(n_blocks, size_t{1}));
+    }
+
+    void blocked_bloom_filter::insert(uint64_t key_hash) {
+        auto& blk = m_blocks[block_index(key_hash)];
+        const auto m = mask(key_hash);
+        for(size_t i = 0; i < words_per_block; i++) {
+            blk.m_words[i] |= m.m_words[i];
+        }
+        m_size++;
+    }
+
+    auto blocked_bloom_filter::maybe_contains(uint64_t key_hash) const
+        -> bool {
+        const auto& blk = m_blocks[block_index(key_hash)];
+        const auto m = mask(key_hash);
+        uint32_t missing{0};
+        for(size_t i = 0; i < words_per_block; i++) {
+            missing |= m.m_words[i] & ~blk.m_words[i];
+        }
+        return missing == 0;
+    }
+
+    void blocked_bloom_filter::clear() {
+        std::fill(m_blocks.begin(), m_blocks.end(), block{});
+        m_size = 0;
+    }
+
+    auto blocked_bloom_filter::size() const -> size_t {
+        return m_size;
+    }
+
+    auto blocked_bloom_filter::block_index(uint64_t key_hash) const
+        -> size_t {
+        // Map the upper half of the hash onto the block range without a
+        // division.
+        static constexpr auto half_bits = 32;
+        return static_cast<size_t>(
+            ((key_hash >> half_bits) * m_blocks.size()) >> half_bits);
+    }
+
+    auto blocked_bloom_filter::mask(uint64_t key_hash) -> block {
+        // Derive one bit position per word from the lower half of the hash
+        // using a distinct odd multiplier for each word.
+        static constexpr std::array<uint32_t, words_per_block> salts{
+            0x47b6137bU,
+            0x44974d91U,
+            0x8824ad5bU,
+            0xa2b7289dU,
+            0x705495c7U,
+            0x2df1424bU,
+            0x9efc4947U,
+            0x5c6bfb31U};
+        static constexpr auto bit_shift = 27;
+        const auto key = static_cast<uint32_t>(key_hash);
+        auto m = block();
+        for(size_t i = 0; i < words_per_block; i++) {
+            m.m_words[i] = uint32_t{1} << ((key * salts[i]) >> bit_shift);
+        }
+        return m;
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_BLOCKED_BLOOM_FILTER_H_
+#define OPENCBDC_TX_SRC_COMMON_BLOCKED_BLOOM_FILTER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cbdc {
+    /// \brief Split-block Bloom filter over 64-bit key hashes.
+    ///
+    /// Each key maps to a single 256-bit block, and sets one bit in each of
+    /// the block's eight 32-bit words. A lookup therefore touches one cache
+    /// line, and the per-word bit computations are independent so the
+    /// compiler can vectorize them. Keys must be well-distributed hashes.
+    /// \warning Not thread-safe.
+    class blocked_bloom_filter {
+      public:
+        /// Constructor.
+        /// \param capacity number of keys the filter is sized for. The false
+        ///                 positive rate rises once the filter holds more
+        ///                 keys than this.
+        explicit blocked_bloom_filter(size_t capacity);
+
+        /// Adds a key to the filter.
+        /// \param key_hash hash of the key to add.
+        void insert(uint64_t key_hash);
+
+        /// Checks whether a key may have been added to the filter.
+        /// \param key_hash hash of the key to check.
+        /// \return false if the key was definitely not added.
+        [[nodiscard]] auto maybe_contains(uint64_t key_hash) const -> bool;
+
+        /// Removes all keys from the filter without releasing its memory.
+        void clear();
+
+        /// Returns the number of keys added since the filter was last
+        /// cleared.
+        /// \return key count.
+        [[nodiscard]] auto size() const -> size_t;
+
+      private:
+        static constexpr size_t words_per_block = 8;
+        static constexpr size_t bits_per_key = 16;
+
+        struct alignas(sizeof(uint32_t) * words_per_block) block {
+            std::array<uint32_t, words_per_block> m_words{};
+        };
+
+        std::vector<block> m_blocks;
+        size_t m_size{};
+
+        [[nodiscard]] auto block_index(uint64_t key_hash) const -> size_t;
+        [[nodiscard]] static auto mask(uint64_t key_hash) -> block;
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_BLOCKED_BLOOM_FILTER_H_
@@ -7,7 +7,8 @@
 #define CACHE_SET_H_INC
 
 #include <cassert>
-#include <queue>
+#include <deque>
+#include <functional>
 #include <shared_mutex>
 #include <unordered_set>
 
@@ -39,11 +40,11 @@ namespace cbdc {
             std::unique_lock<std::shared_mutex> l(m_mut);
             auto added = m_vals.emplace(std::forward<T>(val));
             if(added.second) {
-                m_eviction_queue.push(std::ref(*added.first));
+                m_eviction_queue.push_back(std::ref(*added.first));
                 if(m_eviction_queue.size() >= m_max_size) {
                     auto& v = m_eviction_queue.front();
                     m_vals.erase(v);
-                    m_eviction_queue.pop();
+                    m_eviction_queue.pop_front();
                 }
             }
             assert(m_eviction_queue.size() <= m_max_size);
@@ -58,9 +59,34 @@ namespace cbdc {
             return m_vals.find(val) != m_vals.end();
         }
 
+        /// Returns the number of values in the set.
+        /// \return value count.
+        [[nodiscard]] auto size() const -> size_t {
+            std::shared_lock<std::shared_mutex> l(m_mut);
+            return m_eviction_queue.size();
+        }
+
+        /// Calls the given function with each value in the set, from the
+        /// oldest to the most recently added.
+        /// \param fn function to call with each value.
+        template<typename F>
+        void for_each(F&& fn) const {
+            std::shared_lock<std::shared_mutex> l(m_mut);
+            for(const auto& v : m_eviction_queue) {
+                fn(v.get());
+            }
+        }
+
+        /// Removes all values from the set.
+        void clear() {
+            std::unique_lock<std::shared_mutex> l(m_mut);
+            m_eviction_queue.clear();
+            m_vals.clear();
+        }
+
       private:
         std::unordered_set<K, H> m_vals;
-        std::queue<std::reference_wrapper<const K>> m_eviction_queue;
+        std::deque<std::reference_wrapper<const K>> m_eviction_queue;
         size_t m_max_size;
         mutable std::shared_mutex m_mut;
     };
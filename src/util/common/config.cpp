@@ -75,6 +75,13 @@ namespace cbdc::config {
         return ss.str();
     }
 
+    auto get_shard_sync_endpoint_key(size_t shard_id) -> std::string {
+        std::stringstream ss;
+        get_shard_key_prefix(ss, shard_id);
+        ss << sync_endpoint_postfix;
+        return ss.str();
+    }
+
     auto get_shard_end_key(size_t shard_id) -> std::string {
         std::stringstream ss;
         get_shard_key_prefix(ss, shard_id);
@@ -294,6 +301,16 @@ namespace cbdc::config {
 
     auto read_shard_options(options& opts, const parser& cfg)
         -> std::optional<std::string> {
+        const auto prefix_bits
+            = cfg.get_ulong(shard_prefix_bits_key)
+                  .value_or(shard_range_t::default_prefix_bits);
+        if(prefix_bits == 0
+           || prefix_bits > shard_range_t::max_prefix_bits) {
+            return "Shard prefix bits must be between 1 and 32 ("
+                 + std::string(shard_prefix_bits_key) + ")";
+        }
+        const auto max_prefix = (uint64_t{1} << prefix_bits) - 1;
+
         const auto shard_count = cfg.get_ulong(shard_count_key).value_or(0);
         for(size_t i{0}; i < shard_count; i++) {
             if(!opts.m_twophase_mode) {
@@ -312,6 +329,9 @@ namespace cbdc::config {
                          + std::to_string(i) + " (" + shard_db_str + ")";
                 }
                 opts.m_shard_db_dirs.push_back(*shard_db);
+
+                opts.m_shard_sync_endpoints.push_back(
+                    cfg.get_endpoint(get_shard_sync_endpoint_key(i)));
             }
 
             const auto shard_loglevel_key = get_shard_loglevel_key(i);
@@ -331,10 +351,15 @@ namespace cbdc::config {
                 return "No range end specified for shard " + std::to_string(i)
                      + " (" + end_key + ")";
             }
-            const auto shard_range
-                = std::make_pair(static_cast<uint8_t>(*range_start),
-                                 static_cast<uint8_t>(*range_end));
-            opts.m_shard_ranges.push_back(shard_range);
+            if(*range_start > *range_end || *range_end > max_prefix) {
+                return "Invalid range specified for shard "
+                     + std::to_string(i) + " (" + start_key + ", " + end_key
+                     + ")";
+            }
+            opts.m_shard_ranges.emplace_back(
+                static_cast<uint32_t>(*range_start),
+                static_cast<uint32_t>(*range_end),
+                static_cast<uint8_t>(prefix_bits));
         }
 
         opts.m_shard_completed_txs_cache_size
@@ -492,6 +517,64 @@ namespace cbdc::config {
         opts.m_stxo_cache_depth
             = cfg.get_ulong(stxo_cache_key).value_or(opts.m_stxo_cache_depth);
 
+        opts.m_stxo_filter_capacity
+            = cfg.get_ulong(stxo_filter_capacity_key)
+                  .value_or(opts.m_stxo_filter_capacity);
+
+        opts.m_atomizer_apply_threads
+            = cfg.get_ulong(atomizer_apply_threads_key)
+                  .value_or(opts.m_atomizer_apply_threads);
+
+        opts.m_atomizer_block_memory
+            = cfg.get_ulong(atomizer_block_memory_key)
+                  .value_or(opts.m_atomizer_block_memory);
+
+        opts.m_atomizer_block_max_txs
+            = cfg.get_ulong(atomizer_block_max_txs_key)
+                  .value_or(opts.m_atomizer_block_max_txs);
+
+        opts.m_atomizer_block_max_bytes
+            = cfg.get_ulong(atomizer_block_max_bytes_key)
+                  .value_or(opts.m_atomizer_block_max_bytes);
+
+        opts.m_atomizer_block_max_latency
+            = cfg.get_ulong(atomizer_block_max_latency_key)
+                  .value_or(opts.m_atomizer_block_max_latency);
+
+        opts.m_attestation_cache_size
+            = cfg.get_ulong(attestation_cache_size_key)
+                  .value_or(opts.m_attestation_cache_size);
+
+        opts.m_shard_compact_notifications
+            = cfg.get_ulong(shard_compact_notifications_key).value_or(0) != 0;
+
+        opts.m_atomizer_replication_delay
+            = cfg.get_ulong(atomizer_replication_delay_key)
+                  .value_or(opts.m_atomizer_replication_delay);
+
+        opts.m_atomizer_replication_max_txs
+            = cfg.get_ulong(atomizer_replication_max_txs_key)
+                  .value_or(opts.m_atomizer_replication_max_txs);
+
+        opts.m_atomizer_replication_max_inflight
+            = cfg.get_ulong(atomizer_replication_max_inflight_key)
+                  .value_or(opts.m_atomizer_replication_max_inflight);
+
+        opts.m_shard_memory_uhs
+            = cfg.get_ulong(shard_memory_uhs_key).value_or(0) != 0;
+
+        opts.m_shard_checkpoint_interval
+            = cfg.get_ulong(shard_checkpoint_interval_key)
+                  .value_or(opts.m_shard_checkpoint_interval);
+
+        opts.m_shard_sync_threshold
+            = cfg.get_ulong(shard_sync_threshold_key)
+                  .value_or(opts.m_shard_sync_threshold);
+
+        opts.m_shard_sync_chunk_size
+            = cfg.get_ulong(shard_sync_chunk_size_key)
+                  .value_or(opts.m_shard_sync_chunk_size);
+
         return std::nullopt;
     }
 
@@ -523,6 +606,10 @@ namespace cbdc::config {
             opts.m_archiver_db_dirs.push_back(*archiver_db);
         }
 
+        opts.m_archiver_max_inflight
+            = cfg.get_ulong(archiver_max_inflight_key)
+                  .value_or(opts.m_archiver_max_inflight);
+
         return std::nullopt;
     }
 
@@ -733,9 +820,34 @@ namespace cbdc::config {
         return std::nullopt;
     }
 
+    shard_range_t::shard_range_t(uint32_t start,
+                                 uint32_t end,
+                                 uint8_t prefix_bits)
+        : std::pair<uint32_t, uint32_t>(start, end),
+          m_prefix_bits(prefix_bits) {}
+
+    auto shard_range_t::operator==(const shard_range_t& rhs) const -> bool {
+        return first == rhs.first && second == rhs.second
+            && m_prefix_bits == rhs.m_prefix_bits;
+    }
+
+    auto shard_range_t::operator!=(const shard_range_t& rhs) const -> bool {
+        return !(*this == rhs);
+    }
+
     auto hash_in_shard_range(const shard_range_t& range, const hash_t& val)
         -> bool {
-        return val[0] >= range.first && val[0] <= range.second;
+        const auto prefix = hash_prefix(val, range.m_prefix_bits);
+        return prefix >= range.first && prefix <= range.second;
+    }
+
+    auto hash_prefix(const hash_t& val, uint8_t prefix_bits) -> uint32_t {
+        static constexpr auto bits_per_byte = 8;
+        uint32_t prefix{};
+        for(size_t i = 0; i < sizeof(prefix); i++) {
+            prefix = (prefix << bits_per_byte) | val[i];
+        }
+        return prefix >> (shard_range_t::max_prefix_bits - prefix_bits);
     }
 
     auto loadgen_seed_range(const options& opts, size_t gen_id)
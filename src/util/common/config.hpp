@@ -63,6 +63,20 @@ namespace cbdc::config {
         static constexpr size_t output_count{2};
         static constexpr double fixed_tx_rate{1.0};
         static constexpr size_t attestation_threshold{1};
+        static constexpr size_t atomizer_apply_threads{1};
+        static constexpr size_t stxo_filter_capacity{1024UL * 1024};
+        static constexpr size_t atomizer_block_memory{256UL * 1024 * 1024};
+        static constexpr size_t atomizer_block_max_txs{0};
+        static constexpr size_t atomizer_block_max_bytes{0};
+        static constexpr size_t atomizer_block_max_latency{0};
+        static constexpr size_t attestation_cache_size{100000};
+        static constexpr size_t atomizer_replication_delay{500};
+        static constexpr size_t atomizer_replication_max_txs{10000};
+        static constexpr size_t atomizer_replication_max_inflight{4};
+        static constexpr size_t shard_checkpoint_interval{1000};
+        static constexpr size_t shard_sync_threshold{1000};
+        static constexpr size_t shard_sync_chunk_size{4UL * 1024 * 1024};
+        static constexpr size_t archiver_max_inflight{64};
 
         static constexpr auto log_level = logging::log_level::warn;
     }
@@ -82,6 +96,7 @@ namespace cbdc::config {
     static constexpr auto sentinel_prefix = "sentinel";
     static constexpr auto config_separator = "_";
     static constexpr auto db_postfix = "db";
+    static constexpr auto sync_endpoint_postfix = "sync_endpoint";
     static constexpr auto start_postfix = "start";
     static constexpr auto end_postfix = "end";
     static constexpr auto atomizer_count_key = "atomizer_count";
@@ -124,9 +139,59 @@ namespace cbdc::config {
     static constexpr auto private_key_postfix = "private_key";
     static constexpr auto public_key_postfix = "public_key";
     static constexpr auto attestation_threshold_key = "attestation_threshold";
+    static constexpr auto stxo_filter_capacity_key = "stxo_filter_capacity";
+    static constexpr auto atomizer_apply_threads_key
+        = "atomizer_apply_threads";
+    static constexpr auto atomizer_block_memory_key = "atomizer_block_memory";
+    static constexpr auto atomizer_block_max_txs_key
+        = "atomizer_block_max_txs";
+    static constexpr auto atomizer_block_max_bytes_key
+        = "atomizer_block_max_bytes";
+    static constexpr auto atomizer_block_max_latency_key
+        = "atomizer_block_max_latency";
+    static constexpr auto attestation_cache_size_key
+        = "attestation_cache_size";
+    static constexpr auto shard_compact_notifications_key
+        = "shard_compact_notifications";
+    static constexpr auto atomizer_replication_delay_key
+        = "atomizer_replication_delay";
+    static constexpr auto atomizer_replication_max_txs_key
+        = "atomizer_replication_max_txs";
+    static constexpr auto atomizer_replication_max_inflight_key
+        = "atomizer_replication_max_inflight";
+    static constexpr auto shard_memory_uhs_key = "shard_memory_uhs";
+    static constexpr auto shard_checkpoint_interval_key
+        = "shard_checkpoint_interval";
+    static constexpr auto shard_sync_threshold_key = "shard_sync_threshold";
+    static constexpr auto shard_sync_chunk_size_key = "shard_sync_chunk_size";
+    static constexpr auto shard_prefix_bits_key = "shard_prefix_bits";
+    static constexpr auto archiver_max_inflight_key = "archiver_max_inflight";
+
+    /// \brief Inclusive range [start, end] of UHS ID prefixes.
+    ///
+    /// A prefix is the given number of leading bits of a UHS ID, read as a
+    /// big-endian integer. Ranges default to 8-bit prefixes, the first byte
+    /// of the ID, so pairs of byte values convert to ranges directly.
+    struct shard_range_t : std::pair<uint32_t, uint32_t> {
+        using std::pair<uint32_t, uint32_t>::pair;
+
+        shard_range_t() = default;
+
+        /// Constructor.
+        /// \param start first prefix in the range.
+        /// \param end last prefix in the range.
+        /// \param prefix_bits number of bits in each prefix, up to 32.
+        shard_range_t(uint32_t start, uint32_t end, uint8_t prefix_bits);
 
-    /// [start, end] inclusive.
-    using shard_range_t = std::pair<uint8_t, uint8_t>;
+        auto operator==(const shard_range_t& rhs) const -> bool;
+        auto operator!=(const shard_range_t& rhs) const -> bool;
+
+        /// Number of leading UHS ID bits in each prefix.
+        uint8_t m_prefix_bits{default_prefix_bits};
+
+        static constexpr uint8_t default_prefix_bits{8};
+        static constexpr uint8_t max_prefix_bits{32};
+    };
 
     /// Project-wide configuration options.
     struct options {
@@ -167,6 +232,60 @@ namespace cbdc::config {
         size_t m_batch_size{defaults::batch_size};
         /// Target block creation interval in the atomizer in milliseconds.
         size_t m_target_block_interval{defaults::target_block_interval};
+        /// Number of recently spent UHS IDs the atomizer's spent output
+        /// filter is initially sized for (0=disabled). The filter grows with
+        /// the spent output cache beyond this size.
+        size_t m_stxo_filter_capacity{defaults::stxo_filter_capacity};
+        /// Number of worker threads the atomizer state machine uses to apply
+        /// batches of transaction notifications (1=sequential).
+        size_t m_atomizer_apply_threads{defaults::atomizer_apply_threads};
+        /// Maximum size in bytes of the unpruned blocks the atomizer holds
+        /// in memory. Older blocks are spilled to disk.
+        size_t m_atomizer_block_memory{defaults::atomizer_block_memory};
+        /// Number of complete transactions at which the atomizer creates a
+        /// block before the target block interval elapses (0=disabled).
+        size_t m_atomizer_block_max_txs{defaults::atomizer_block_max_txs};
+        /// Serialized size in bytes of the complete transactions at which
+        /// the atomizer creates a block before the target block interval
+        /// elapses (0=disabled).
+        size_t m_atomizer_block_max_bytes{defaults::atomizer_block_max_bytes};
+        /// Time in milliseconds a complete transaction may wait before the
+        /// atomizer creates a block before the target block interval
+        /// elapses (0=disabled).
+        size_t m_atomizer_block_max_latency{
+            defaults::atomizer_block_max_latency};
+        /// Maximum number of verified sentinel attestations a process
+        /// remembers to skip repeated signature checks (0=disabled).
+        size_t m_attestation_cache_size{defaults::attestation_cache_size};
+        /// Whether shards which do not hold a transaction's first input send
+        /// the atomizer only their attestations, without the transaction.
+        bool m_shard_compact_notifications{false};
+        /// Time in microseconds the atomizer waits after a transaction
+        /// completes for more to replicate in the same log entry.
+        size_t m_atomizer_replication_delay{
+            defaults::atomizer_replication_delay};
+        /// Maximum number of complete transactions in an atomizer log entry.
+        /// Reaching it replicates the waiting transactions without waiting
+        /// for the replication delay (0=unlimited).
+        size_t m_atomizer_replication_max_txs{
+            defaults::atomizer_replication_max_txs};
+        /// Maximum number of atomizer transaction log entries being
+        /// replicated at once (0=unlimited).
+        size_t m_atomizer_replication_max_inflight{
+            defaults::atomizer_replication_max_inflight};
+        /// Whether shards keep their UHS IDs in memory, persisted by a
+        /// write-ahead log and periodic checkpoints, rather than in LevelDB.
+        bool m_shard_memory_uhs{false};
+        /// Number of blocks between checkpoints of a memory-resident shard
+        /// UHS (0=never checkpoint).
+        size_t m_shard_checkpoint_interval{
+            defaults::shard_checkpoint_interval};
+        /// Number of blocks a shard must be behind a peer's UHS snapshot
+        /// at startup to install the snapshot rather than catch up from the
+        /// archiver (0=never install snapshots).
+        size_t m_shard_sync_threshold{defaults::shard_sync_threshold};
+        /// Maximum number of bytes of a UHS snapshot sent in one message.
+        size_t m_shard_sync_chunk_size{defaults::shard_sync_chunk_size};
         /// List of atomizer log levels by atomizer ID.
         std::vector<logging::log_level> m_atomizer_loglevels;
         /// Raft election timeout upper bound in milliseconds.
@@ -177,7 +296,8 @@ namespace cbdc::config {
             defaults::election_timeout_lower_bound};
         /// Raft heartbeat timeout in milliseconds.
         int32_t m_heartbeat{defaults::heartbeat};
-        /// Raft snapshot distance, in number of log entries.
+        /// Raft snapshot distance of atomizer and locking shard clusters, in
+        /// number of log entries (0=no snapshots).
         int32_t m_snapshot_distance{0};
         /// Maximum number of raft log entries to batch into one RPC message.
         int32_t m_raft_max_batch{defaults::raft_max_batch};
@@ -185,8 +305,14 @@ namespace cbdc::config {
         std::vector<logging::log_level> m_shard_loglevels;
         /// List of shard DB paths by shard ID.
         std::vector<std::string> m_shard_db_dirs;
+        /// List of endpoints from which shards serve snapshots of their UHS
+        /// to other shards, by shard ID. Shards without an endpoint do not
+        /// serve snapshots.
+        std::vector<std::optional<network::endpoint_t>>
+            m_shard_sync_endpoints;
         /// List of shard UHS ID ranges by shard ID. Each shard range is
-        /// inclusive of the start and end of the range.
+        /// inclusive of the start and end of the range. All ranges use
+        /// prefixes of the configured number of bits.
         std::vector<shard_range_t> m_shard_ranges;
 
         /// private key used for initial seed.
@@ -206,6 +332,9 @@ namespace cbdc::config {
         std::vector<logging::log_level> m_watchtower_loglevels;
         /// List of archiver DB paths by archiver ID.
         std::vector<std::string> m_archiver_db_dirs;
+        /// Maximum number of block requests shards and watchtowers keep
+        /// outstanding with the archiver while catching up.
+        size_t m_archiver_max_inflight{defaults::archiver_max_inflight};
         /// Flag set if m_input_count or m_output_count are greater than zero.
         /// Causes the atomizer-cli to send fixed-size transactions.
         bool m_fixed_tx_mode{false};
@@ -288,6 +417,13 @@ namespace cbdc::config {
     auto hash_in_shard_range(const shard_range_t& range, const hash_t& val)
         -> bool;
 
+    /// Returns the given number of leading bits of a hash, read as a
+    /// big-endian integer.
+    /// \param val hash from which to read the prefix.
+    /// \param prefix_bits number of bits in the prefix, from 1 to 32.
+    /// \return hash prefix.
+    auto hash_prefix(const hash_t& val, uint8_t prefix_bits) -> uint32_t;
+
     /// Calculates the sub-range of total seeded outputs for a particular load
     /// generator ID.
     /// \param opts options struct from which to read seed data.
@@ -0,0 +1,195 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flat_hash_set.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cbdc {
+    flat_hash_set::flat_hash_set(size_t capacity) {
+        if(capacity > 0) {
+            reserve(capacity);
+        }
+    }
+
+    auto flat_hash_set::insert(const hash_t& key) -> bool {
+        if(m_size + m_tombstones + 1 > max_load(m_ctrl.size())) {
+            // Grow geometrically if the live keys need it, otherwise only
+            // clear out the tombstones
+            auto slots = m_ctrl.size();
+            if(m_size + 1 > max_load(slots)) {
+                slots = slots_for(std::max(m_size + 1, 2 * max_load(slots)));
+            }
+            rehash(slots);
+        }
+
+        const auto tag = key_tag(key);
+        auto target = m_ctrl.size();
+        for(auto i = home_slot(key_hash(key));; i = next_slot(i)) {
+            const auto ctrl = m_ctrl[i];
+            if(ctrl == tag && m_slots[i] == key) {
+                return false;
+            }
+            if(ctrl == tombstone_ctrl && target == m_ctrl.size()) {
+                target = i;
+            } else if(ctrl == empty_ctrl) {
+                if(target == m_ctrl.size()) {
+                    target = i;
+                } else {
+                    m_tombstones--;
+                }
+                break;
+            }
+        }
+
+        m_ctrl[target] = tag;
+        m_slots[target] = key;
+        m_size++;
+        return true;
+    }
+
+    auto flat_hash_set::erase(const hash_t& key) -> bool {
+        const auto i = find(key);
+        if(i == m_ctrl.size()) {
+            return false;
+        }
+
+        // No probe sequence passes through the slot if the next one is
+        // empty, so it can be marked empty rather than as a tombstone
+        if(m_ctrl[next_slot(i)] == empty_ctrl) {
+            m_ctrl[i] = empty_ctrl;
+        } else {
+            m_ctrl[i] = tombstone_ctrl;
+            m_tombstones++;
+        }
+        m_size--;
+        return true;
+    }
+
+    auto flat_hash_set::contains(const hash_t& key) const -> bool {
+        return find(key) != m_ctrl.size();
+    }
+
+    void flat_hash_set::reserve(size_t capacity) {
+        const auto slots = slots_for(capacity);
+        if(slots > m_ctrl.size()) {
+            rehash(slots);
+        }
+    }
+
+    void flat_hash_set::clear() {
+        std::fill(m_ctrl.begin(), m_ctrl.end(), empty_ctrl);
+        m_size = 0;
+        m_tombstones = 0;
+    }
+
+    auto flat_hash_set::size() const -> size_t {
+        return m_size;
+    }
+
+    auto flat_hash_set::slot_count() const -> size_t {
+        return m_ctrl.size();
+    }
+
+    auto flat_hash_set::rehash_count() const -> uint64_t {
+        return m_rehashes;
+    }
+
+    auto flat_hash_set::memory_usage() const -> size_t {
+        return m_ctrl.capacity() * sizeof(uint8_t)
+            + m_slots.capacity() * sizeof(hash_t);
+    }
+
+    auto flat_hash_set::key_hash(const hash_t& key) -> uint64_t {
+        static constexpr uint64_t multiplier = 0x9e3779b97f4a7c15;
+        uint64_t prefix{};
+        std::memcpy(&prefix, key.data(), sizeof(prefix));
+        return prefix * multiplier;
+    }
+
+    auto flat_hash_set::key_tag(const hash_t& key) -> uint8_t {
+        // Hashes the second eight bytes, which are independent of the slot
+        // and of any routing prefix, and keeps the top seven bits
+        static constexpr uint64_t multiplier = 0x9e3779b97f4a7c15;
+        static constexpr auto tag_shift = 57;
+        uint64_t word{};
+        std::memcpy(&word, key.data() + sizeof(word), sizeof(word));
+        return static_cast<uint8_t>((word * multiplier) >> tag_shift);
+    }
+
+    auto flat_hash_set::is_full(uint8_t ctrl) -> bool {
+        return (ctrl & empty_ctrl) == 0;
+    }
+
+    auto flat_hash_set::max_load(size_t slots) -> size_t {
+        // Limit the load factor to 3/4 to keep probe sequences short
+        return slots - slots / 4;
+    }
+
+    auto flat_hash_set::slots_for(size_t capacity) -> size_t {
+        // Any multiple of the minimum works, so the set can be sized close
+        // to the requested capacity
+        static constexpr size_t min_slots{8};
+        auto slots = std::max(min_slots,
+                              (capacity + capacity / 3) / min_slots
+                                  * min_slots);
+        while(max_load(slots) < capacity) {
+            slots += min_slots;
+        }
+        return slots;
+    }
+
+    auto flat_hash_set::home_slot(uint64_t h) const -> size_t {
+        // Scales the high half of the hash to the number of slots, which
+        // need not be a power of two. Exact for up to 2^32 slots.
+        static constexpr auto half_bits = 32;
+        return static_cast<size_t>(((h >> half_bits) * m_ctrl.size())
+                                   >> half_bits);
+    }
+
+    auto flat_hash_set::next_slot(size_t i) const -> size_t {
+        return i + 1 == m_ctrl.size() ? 0 : i + 1;
+    }
+
+    auto flat_hash_set::find(const hash_t& key) const -> size_t {
+        if(m_ctrl.empty()) {
+            return m_ctrl.size();
+        }
+
+        const auto tag = key_tag(key);
+        for(auto i = home_slot(key_hash(key));; i = next_slot(i)) {
+            const auto ctrl = m_ctrl[i];
+            if(ctrl == tag && m_slots[i] == key) {
+                return i;
+            }
+            if(ctrl == empty_ctrl) {
+                return m_ctrl.size();
+            }
+        }
+    }
+
+    void flat_hash_set::rehash(size_t slots) {
+        auto old_ctrl = std::move(m_ctrl);
+        auto old_slots = std::move(m_slots);
+
+        m_ctrl.assign(slots, empty_ctrl);
+        m_slots.assign(slots, hash_t{});
+        m_tombstones = 0;
+        m_rehashes++;
+
+        for(size_t j = 0; j < old_ctrl.size(); j++) {
+            if(!is_full(old_ctrl[j])) {
+                continue;
+            }
+            auto i = home_slot(key_hash(old_slots[j]));
+            while(m_ctrl[i] != empty_ctrl) {
+                i = next_slot(i);
+            }
+            m_ctrl[i] = old_ctrl[j];
+            m_slots[i] = old_slots[j];
+        }
+    }
+}
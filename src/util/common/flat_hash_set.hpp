@@ -0,0 +1,129 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_FLAT_HASH_SET_H_
+#define OPENCBDC_TX_SRC_COMMON_FLAT_HASH_SET_H_
+
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cbdc {
+    /// \brief Open-addressing set of hashes.
+    ///
+    /// Stores keys inline in a single array probed linearly, alongside an
+    /// array of one-byte control entries holding a seven-bit tag of each
+    /// key. Probes compare the control bytes first, so most mismatched
+    /// slots are skipped without touching the keys. Keys must be uniformly
+    /// distributed hashes, such as UHS IDs; their first eight bytes select
+    /// the slot and the next eight the tag. Keys routed to the same shard
+    /// share their first bytes, so the tag does not depend on them. The
+    /// number of slots is any multiple of eight, so a reserved set holds
+    /// little more than its keys. Erased slots are marked as tombstones and
+    /// reclaimed by the next rehash.
+    /// \warning Not thread-safe.
+    class flat_hash_set {
+      public:
+        /// Constructor.
+        /// \param capacity number of keys to reserve space for.
+        explicit flat_hash_set(size_t capacity = 0);
+
+        /// Adds a key to the set.
+        /// \param key key to add.
+        /// \return true if the key was not already in the set.
+        auto insert(const hash_t& key) -> bool;
+
+        /// Removes a key from the set.
+        /// \param key key to remove.
+        /// \return true if the key was in the set.
+        auto erase(const hash_t& key) -> bool;
+
+        /// Checks whether a key is in the set.
+        /// \param key key to check.
+        /// \return true if the set contains the key.
+        [[nodiscard]] auto contains(const hash_t& key) const -> bool;
+
+        /// Ensures the set can hold the given number of keys without
+        /// rehashing.
+        /// \param capacity number of keys.
+        void reserve(size_t capacity);
+
+        /// Removes all keys from the set without releasing its memory.
+        void clear();
+
+        /// Returns the number of keys in the set.
+        /// \return key count.
+        [[nodiscard]] auto size() const -> size_t;
+
+        /// Returns the number of bytes allocated for the set's slots.
+        /// \return allocated bytes.
+        [[nodiscard]] auto memory_usage() const -> size_t;
+
+        /// Calls the given function with each key in the set, in
+        /// unspecified order.
+        /// \param fn function to call with each key.
+        template<typename F>
+        void for_each(F&& fn) const {
+            for_each(0, m_ctrl.size(), std::forward<F>(fn));
+        }
+
+        /// Calls the given function with each key stored in the given range
+        /// of slots. Keys stay in their slots until the next rehash, so a
+        /// caller can visit the set a range at a time while it is modified
+        /// in between, as long as \ref rehash_count does not change.
+        /// \param first first slot to visit.
+        /// \param last slot after the last one to visit.
+        /// \param fn function to call with each key.
+        template<typename F>
+        void for_each(size_t first, size_t last, F&& fn) const {
+            last = std::min(last, m_ctrl.size());
+            for(size_t i = first; i < last; i++) {
+                if(is_full(m_ctrl[i])) {
+                    fn(m_slots[i]);
+                }
+            }
+        }
+
+        /// Returns the number of slots.
+        /// \return slot count.
+        [[nodiscard]] auto slot_count() const -> size_t;
+
+        /// Returns the number of times keys have been moved to new slots
+        /// since the set was constructed.
+        /// \return rehash count.
+        [[nodiscard]] auto rehash_count() const -> uint64_t;
+
+      private:
+        static constexpr uint8_t empty_ctrl = 0x80;
+        static constexpr uint8_t tombstone_ctrl = 0xfe;
+
+        std::vector<uint8_t> m_ctrl;
+        std::vector<hash_t> m_slots;
+        size_t m_size{};
+        size_t m_tombstones{};
+        uint64_t m_rehashes{};
+
+        [[nodiscard]] static auto key_hash(const hash_t& key) -> uint64_t;
+        [[nodiscard]] static auto key_tag(const hash_t& key) -> uint8_t;
+        [[nodiscard]] static auto is_full(uint8_t ctrl) -> bool;
+        [[nodiscard]] static auto max_load(size_t slots) -> size_t;
+        [[nodiscard]] static auto slots_for(size_t capacity) -> size_t;
+
+        /// Returns the first slot probed for a key with the given hash.
+        [[nodiscard]] auto home_slot(uint64_t h) const -> size_t;
+        [[nodiscard]] auto next_slot(size_t i) const -> size_t;
+
+        /// Returns the slot holding the key, or the number of slots if the
+        /// set does not contain it.
+        [[nodiscard]] auto find(const hash_t& key) const -> size_t;
+
+        void rehash(size_t slots);
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_FLAT_HASH_SET_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace cbdc {
+    mapped_file::~mapped_file() {
+        close();
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)) {}
+
+    auto mapped_file::operator=(mapped_file&& other) noexcept
+        -> mapped_file& {
+        if(this != &other) {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    auto mapped_file::open(const std::string& path) -> bool {
+        close();
+
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if(fd == -1) {
+            return false;
+        }
+
+        struct stat st {};
+        if(fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        auto sz = static_cast<size_t>(st.st_size);
+        if(sz > 0) {
+            auto* addr = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            m_data = addr;
+        }
+        m_size = sz;
+
+        // The mapping holds its own reference to the file
+        ::close(fd);
+        return true;
+    }
+
+    void mapped_file::close() {
+        if(m_data != nullptr) {
+            munmap(m_data, m_size);
+            m_data = nullptr;
+        }
+        m_size = 0;
+    }
+
+    auto mapped_file::data() const -> const unsigned char* {
+        return static_cast<const unsigned char*>(m_data);
+    }
+
+    auto mapped_file::size() const -> size_t {
+        return m_size;
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_MAPPED_FILE_H_
+#define OPENCBDC_TX_SRC_COMMON_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace cbdc {
+    /// \brief Read-only memory mapping of a file.
+    ///
+    /// Gives access to the contents of a file without reading it into a
+    /// heap buffer. Pages are loaded by the kernel on demand and can be
+    /// evicted again under memory pressure. The mapping stays valid if the
+    /// file is removed or replaced while it is open.
+    class mapped_file {
+      public:
+        mapped_file() = default;
+
+        /// Unmaps the file, if mapped.
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+        mapped_file(mapped_file&& other) noexcept;
+        auto operator=(mapped_file&& other) noexcept -> mapped_file&;
+
+        /// Maps the file at the given path, replacing any existing mapping.
+        /// \param path path of the file to map.
+        /// \return true if the file was opened and mapped successfully.
+        [[nodiscard]] auto open(const std::string& path) -> bool;
+
+        /// Unmaps the file. Has no effect if no file is mapped.
+        void close();
+
+        /// Returns a pointer to the start of the mapped file contents.
+        /// \return pointer to the file contents, or nullptr if no file is
+        ///         mapped or the file is empty.
+        [[nodiscard]] auto data() const -> const unsigned char*;
+
+        /// Returns the size of the mapped file.
+        /// \return size in bytes.
+        [[nodiscard]] auto size() const -> size_t;
+
+      private:
+        void* m_data{nullptr};
+        size_t m_size{0};
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_MAPPED_FILE_H_
@@ -0,0 +1,328 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_MPMC_QUEUE_H_
+#define OPENCBDC_TX_SRC_COMMON_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cbdc {
+    /// \brief Bounded lock-free multi-producer multi-consumer FIFO queue.
+    ///
+    /// Producers and consumers claim slots in a ring buffer with a single
+    /// compare-and-swap and publish them through a per-slot sequence number,
+    /// so uncontended operations never take a lock. Blocking operations spin
+    /// for a configurable number of attempts before parking on a condition
+    /// variable, which is only signalled when a thread is parked. A full
+    /// queue is reported to producers as backpressure by \ref try_push,
+    /// while \ref push waits for space.
+    ///
+    /// Mirrors the clearing semantics of \ref blocking_queue: \ref clear
+    /// discards the queued elements and unblocks waiting threads, and \ref
+    /// reset must be called before re-using the queue.
+    /// \tparam T type of object stored in the queue. Must be default
+    ///           constructible and move assignable.
+    template<typename T>
+    class mpmc_queue {
+      public:
+        /// Default number of attempts before a blocking call parks.
+        static constexpr size_t default_spin_count{128};
+
+        /// Constructor.
+        /// \param capacity minimum number of elements the queue can hold.
+        ///                 Rounded up to a power of two.
+        /// \param spin_count number of attempts a blocking call makes before
+        ///                   parking the calling thread.
+        explicit mpmc_queue(size_t capacity,
+                            size_t spin_count = default_spin_count)
+            : m_mask(round_capacity(capacity) - 1),
+              m_cells(std::make_unique<cell[]>(m_mask + 1)),
+              m_spin_count(spin_count) {
+            for(size_t i = 0; i <= m_mask; i++) {
+                m_cells[i].m_seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        mpmc_queue() = delete;
+        mpmc_queue(const mpmc_queue&) = delete;
+        auto operator=(const mpmc_queue&) -> mpmc_queue& = delete;
+        mpmc_queue(mpmc_queue&&) = delete;
+        auto operator=(mpmc_queue&&) -> mpmc_queue& = delete;
+
+        /// \brief Destructor.
+        ///
+        /// Clears the queue and unblocks any waiting threads.
+        ~mpmc_queue() {
+            clear();
+        }
+
+        /// Pushes an element onto the queue if there is space.
+        /// \param item object to push. Only moved from on success.
+        /// \return true if the element was queued, false if the queue is
+        ///         full.
+        template<typename U>
+        [[nodiscard]] auto try_push(U&& item) -> bool {
+            if(!try_push_one(std::forward<U>(item))) {
+                return false;
+            }
+            wake(m_pop_waiters, m_not_empty, false);
+            return true;
+        }
+
+        /// \brief Pushes an element onto the queue.
+        ///
+        /// Waits for space if the queue is full. Returns without pushing if
+        /// the queue is cleared while waiting.
+        /// \param item object to push.
+        /// \return true if the element was queued.
+        template<typename U>
+        auto push(U&& item) -> bool {
+            if(!wait_for(m_push_waiters, m_not_full, [&]() {
+                   return try_push_one(std::forward<U>(item));
+               })) {
+                return false;
+            }
+            wake(m_pop_waiters, m_not_empty, false);
+            return true;
+        }
+
+        /// Pops an element from the queue if one is available.
+        /// \param item object into which to move the popped element.
+        /// \return true if an element was popped, false if the queue is
+        ///         empty.
+        [[nodiscard]] auto try_pop(T& item) -> bool {
+            if(!try_pop_one(item)) {
+                return false;
+            }
+            wake(m_push_waiters, m_not_full, false);
+            return true;
+        }
+
+        /// \brief Pops an element from the queue.
+        ///
+        /// Blocks if the queue is empty. Unblocks on destruction or \ref
+        /// clear without returning an element.
+        /// \param item object into which to move the popped element.
+        /// \return true on success, false if interrupted by \ref clear() or
+        ///         destruction.
+        [[nodiscard]] auto pop(T& item) -> bool {
+            if(!wait_for(m_pop_waiters, m_not_empty, [&]() {
+                   return try_pop_one(item);
+               })) {
+                return false;
+            }
+            wake(m_push_waiters, m_not_full, false);
+            return true;
+        }
+
+        /// \brief Pops up to the given number of elements from the queue.
+        ///
+        /// Blocks until at least one element is available, then pops the
+        /// elements queued at that point, up to the limit.
+        /// \param items vector to which to append the popped elements.
+        /// \param max_items maximum number of elements to pop.
+        /// \return number of elements popped, or zero if interrupted by \ref
+        ///         clear() or destruction.
+        [[nodiscard]] auto pop_batch(std::vector<T>& items, size_t max_items)
+            -> size_t {
+            auto n = size_t();
+            auto item = T();
+            auto popped = wait_for(m_pop_waiters, m_not_empty, [&]() {
+                while(n < max_items && try_pop_one(item)) {
+                    items.push_back(std::move(item));
+                    n++;
+                }
+                return n > 0;
+            });
+            if(popped) {
+                wake(m_push_waiters, m_not_full, n > 1);
+            }
+            return n;
+        }
+
+        /// Clears the queue and unblocks waiting threads.
+        void clear() {
+            {
+                std::unique_lock<std::mutex> l(m_mut);
+                m_closed = true;
+            }
+            m_closed_hint.store(true, std::memory_order_relaxed);
+            auto item = T();
+            while(try_pop_one(item)) {}
+            m_not_empty.notify_all();
+            m_not_full.notify_all();
+        }
+
+        /// Removes the wakeup flag for waiting threads. Must be called after
+        /// \ref clear() before re-using the queue. All blocked threads must
+        /// have returned before calling this method.
+        void reset() {
+            std::unique_lock<std::mutex> l(m_mut);
+            m_closed = false;
+            m_closed_hint.store(false, std::memory_order_relaxed);
+        }
+
+        /// Returns the number of queued elements. Only exact if no other
+        /// thread is using the queue.
+        /// \return number of elements.
+        [[nodiscard]] auto size() const -> size_t {
+            const auto head = m_head.load(std::memory_order_acquire);
+            const auto tail = m_tail.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+
+        /// Returns the maximum number of elements the queue can hold.
+        /// \return queue capacity.
+        [[nodiscard]] auto capacity() const -> size_t {
+            return m_mask + 1;
+        }
+
+      private:
+        static constexpr size_t cache_line{64};
+
+        struct cell {
+            std::atomic<size_t> m_seq{};
+            T m_value{};
+        };
+
+        static auto round_capacity(size_t capacity) -> size_t {
+            auto ret = size_t{2};
+            while(ret < capacity) {
+                ret <<= 1;
+            }
+            return ret;
+        }
+
+        template<typename U>
+        auto try_push_one(U&& item) -> bool {
+            auto pos = m_tail.load(std::memory_order_relaxed);
+            cell* c{};
+            for(;;) {
+                c = &m_cells[pos & m_mask];
+                const auto seq = c->m_seq.load(std::memory_order_acquire);
+                const auto dif = static_cast<intptr_t>(seq)
+                               - static_cast<intptr_t>(pos);
+                if(dif == 0) {
+                    if(m_tail.compare_exchange_weak(
+                           pos,
+                           pos + 1,
+                           std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if(dif < 0) {
+                    return false;
+                } else {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+            c->m_value = std::forward<U>(item);
+            c->m_seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        auto try_pop_one(T& item) -> bool {
+            auto pos = m_head.load(std::memory_order_relaxed);
+            cell* c{};
+            for(;;) {
+                c = &m_cells[pos & m_mask];
+                const auto seq = c->m_seq.load(std::memory_order_acquire);
+                const auto dif = static_cast<intptr_t>(seq)
+                               - static_cast<intptr_t>(pos + 1);
+                if(dif == 0) {
+                    if(m_head.compare_exchange_weak(
+                           pos,
+                           pos + 1,
+                           std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if(dif < 0) {
+                    return false;
+                } else {
+                    pos = m_head.load(std::memory_order_relaxed);
+                }
+            }
+            item = std::move(c->m_value);
+            c->m_seq.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Retries the given operation, spinning and then parking on the
+        /// given condition variable, until it succeeds or the queue is
+        /// cleared.
+        template<typename F>
+        auto wait_for(std::atomic<size_t>& waiters,
+                      std::condition_variable& cv,
+                      F&& attempt) -> bool {
+            for(size_t i = 0; i < m_spin_count; i++) {
+                if(attempt()) {
+                    return true;
+                }
+                if(m_closed_hint.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            std::unique_lock<std::mutex> l(m_mut);
+            waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto done = false;
+            // Retry under the lock after registering as a waiter, so that a
+            // thread completing the opposite operation either sees the
+            // waiter or its change is visible here.
+            cv.wait(l, [&]() {
+                done = attempt();
+                return done || m_closed;
+            });
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+            return done;
+        }
+
+        /// Signals threads parked on the given condition variable, if any.
+        void wake(std::atomic<size_t>& waiters,
+                  std::condition_variable& cv,
+                  bool all) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(waiters.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            {
+                // Taking the lock orders the notification after a waiter's
+                // final attempt.
+                std::unique_lock<std::mutex> l(m_mut);
+            }
+            if(all) {
+                cv.notify_all();
+            } else {
+                cv.notify_one();
+            }
+        }
+
+        const size_t m_mask;
+        std::unique_ptr<cell[]> m_cells;
+        const size_t m_spin_count;
+
+        alignas(cache_line) std::atomic<size_t> m_head{0};
+        alignas(cache_line) std::atomic<size_t> m_tail{0};
+
+        alignas(cache_line) std::atomic<size_t> m_pop_waiters{0};
+        std::atomic<size_t> m_push_waiters{0};
+        std::mutex m_mut;
+        std::condition_variable m_not_empty;
+        std::condition_variable m_not_full;
+        bool m_closed{false};
+        /// Copy of \ref m_closed for spinning threads, which do not hold
+        /// the lock.
+        std::atomic<bool> m_closed_hint{false};
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_MPMC_QUEUE_H_
@@ -0,0 +1,81 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "routing_table.hpp"
+
+#include <algorithm>
+
+namespace cbdc::config {
+    routing_table::routing_table(const std::vector<shard_range_t>& ranges)
+        : m_shard_count(ranges.size()) {
+        // Widen each range to 32-bit prefixes, as [start, end)
+        auto bounds = std::vector<std::pair<uint64_t, uint64_t>>();
+        bounds.reserve(ranges.size());
+        for(const auto& range : ranges) {
+            const auto shift
+                = shard_range_t::max_prefix_bits - range.m_prefix_bits;
+            bounds.emplace_back(uint64_t{range.first} << shift,
+                                (uint64_t{range.second} + 1) << shift);
+        }
+
+        static constexpr auto prefix_space
+            = uint64_t{1} << shard_range_t::max_prefix_bits;
+        auto starts = std::vector<uint64_t>{0};
+        for(const auto& [start, end] : bounds) {
+            starts.push_back(start);
+            if(end < prefix_space) {
+                starts.push_back(end);
+            }
+        }
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+        m_starts.reserve(starts.size());
+        m_shards.reserve(starts.size());
+        for(const auto start : starts) {
+            m_starts.push_back(static_cast<uint32_t>(start));
+            auto& shards = m_shards.emplace_back();
+            for(size_t i = 0; i < bounds.size(); i++) {
+                if(start >= bounds[i].first && start < bounds[i].second) {
+                    shards.push_back(i);
+                }
+            }
+        }
+
+        // Size the index to about twice the number of intervals, so most
+        // entries contain at most one interval boundary
+        unsigned index_bits{1};
+        while(index_bits < max_index_bits
+              && (size_t{1} << index_bits) < 2 * m_starts.size()) {
+            index_bits++;
+        }
+        m_index_shift = shard_range_t::max_prefix_bits - index_bits;
+        m_index.resize(size_t{1} << index_bits);
+        uint32_t interval{0};
+        for(size_t i = 0; i < m_index.size(); i++) {
+            const auto entry_start = uint64_t{i} << m_index_shift;
+            while(interval + 1 < m_starts.size()
+                  && m_starts[interval + 1] <= entry_start) {
+                interval++;
+            }
+            m_index[i] = interval;
+        }
+    }
+
+    auto routing_table::shards_for(const hash_t& val) const
+        -> const std::vector<size_t>& {
+        const auto prefix = hash_prefix(val, shard_range_t::max_prefix_bits);
+        auto interval = size_t{m_index[prefix >> m_index_shift]};
+        while(interval + 1 < m_starts.size()
+              && m_starts[interval + 1] <= prefix) {
+            interval++;
+        }
+        return m_shards[interval];
+    }
+
+    auto routing_table::shard_count() const -> size_t {
+        return m_shard_count;
+    }
+}
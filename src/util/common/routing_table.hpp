@@ -0,0 +1,53 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_ROUTING_TABLE_H_
+#define OPENCBDC_TX_SRC_COMMON_ROUTING_TABLE_H_
+
+#include "config.hpp"
+
+#include <vector>
+
+namespace cbdc::config {
+    /// \brief Maps UHS IDs to the shards whose ranges contain them.
+    ///
+    /// Splits the 32-bit prefix space at every range boundary into
+    /// intervals covered by the same set of shards, and indexes the
+    /// intervals by the leading bits of the prefix. A lookup reads the index
+    /// and steps over the few interval boundaries that fall within the
+    /// index entry, so takes constant time for any number of shards. Ranges
+    /// may use different prefix widths.
+    class routing_table {
+      public:
+        /// Constructor.
+        /// \param ranges UHS ID ranges by shard ID.
+        explicit routing_table(const std::vector<shard_range_t>& ranges);
+
+        /// Returns the shards whose ranges contain the given UHS ID.
+        /// \param val UHS ID to route.
+        /// \return shard IDs in ascending order.
+        [[nodiscard]] auto shards_for(const hash_t& val) const
+            -> const std::vector<size_t>&;
+
+        /// Returns the number of shards in the table.
+        /// \return shard count.
+        [[nodiscard]] auto shard_count() const -> size_t;
+
+      private:
+        static constexpr unsigned max_index_bits{16};
+
+        size_t m_shard_count;
+        /// First 32-bit prefix of each interval, in ascending order.
+        std::vector<uint32_t> m_starts;
+        /// Shards covering each interval.
+        std::vector<std::vector<size_t>> m_shards;
+        /// Last interval starting at or before the start of each index
+        /// entry.
+        std::vector<uint32_t> m_index;
+        unsigned m_index_shift{};
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_ROUTING_TABLE_H_
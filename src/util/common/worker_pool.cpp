@@ -0,0 +1,98 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "worker_pool.hpp"
+
+namespace cbdc {
+    worker_pool::worker_pool(size_t n_threads) {
+        for(size_t i = 1; i < n_threads; i++) {
+            m_threads.emplace_back([&]() {
+                worker();
+            });
+        }
+    }
+
+    worker_pool::~worker_pool() {
+        {
+            std::unique_lock<std::mutex> l(m_mut);
+            m_stop = true;
+        }
+        m_start_cv.notify_all();
+        for(auto& t : m_threads) {
+            t.join();
+        }
+    }
+
+    void worker_pool::run(size_t n_tasks,
+                          const std::function<void(size_t)>& fn) {
+        if(m_threads.empty() || n_tasks < 2) {
+            for(size_t i = 0; i < n_tasks; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::unique_lock<std::mutex> run_lck(m_run_mut);
+        {
+            std::unique_lock<std::mutex> l(m_mut);
+            m_fn = &fn;
+            m_n_tasks = n_tasks;
+            m_next = 0;
+            m_generation++;
+        }
+        m_start_cv.notify_all();
+
+        drain(fn, n_tasks);
+
+        // Every index has been claimed, so the loop is complete once the
+        // threads which joined it have finished their last call. Clear the
+        // function so threads waking up late do not join a finished loop.
+        std::unique_lock<std::mutex> l(m_mut);
+        m_done_cv.wait(l, [&]() {
+            return m_active == 0;
+        });
+        m_fn = nullptr;
+    }
+
+    auto worker_pool::size() const -> size_t {
+        return m_threads.size() + 1;
+    }
+
+    void worker_pool::worker() {
+        uint64_t seen{};
+        std::unique_lock<std::mutex> l(m_mut);
+        while(true) {
+            m_start_cv.wait(l, [&]() {
+                return m_stop || m_generation != seen;
+            });
+            if(m_stop) {
+                return;
+            }
+            seen = m_generation;
+            if(m_fn == nullptr) {
+                continue;
+            }
+            const auto* fn = m_fn;
+            const auto n_tasks = m_n_tasks;
+            m_active++;
+            l.unlock();
+
+            drain(*fn, n_tasks);
+
+            l.lock();
+            m_active--;
+            if(m_active == 0) {
+                m_done_cv.notify_one();
+            }
+        }
+    }
+
+    void worker_pool::drain(const std::function<void(size_t)>& fn,
+                            size_t n_tasks) {
+        for(auto i = m_next++; i < n_tasks; i = m_next++) {
+            fn(i);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OPENCBDC_TX_SRC_COMMON_WORKER_POOL_H_
+#define OPENCBDC_TX_SRC_COMMON_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cbdc {
+    /// \brief Persistent pool of threads for fork-join parallel loops.
+    ///
+    /// Threads are started once on construction and sleep between calls to
+    /// \ref run, so short parallel sections do not pay for thread creation.
+    /// The calling thread takes part in each loop alongside the pool.
+    class worker_pool {
+      public:
+        /// Constructor. Starts the background threads.
+        /// \param n_threads total number of threads to run each loop on,
+        ///                  including the calling thread.
+        explicit worker_pool(size_t n_threads);
+
+        /// Stops and joins the background threads.
+        ~worker_pool();
+
+        worker_pool(const worker_pool&) = delete;
+        auto operator=(const worker_pool&) -> worker_pool& = delete;
+
+        worker_pool(worker_pool&&) = delete;
+        auto operator=(worker_pool&&) -> worker_pool& = delete;
+
+        /// Calls the given function once for each index in [0, n_tasks),
+        /// spread across the pool and the calling thread. Returns once all
+        /// calls have completed. Concurrent calls are run one at a time.
+        /// \param n_tasks number of indices.
+        /// \param fn function to call with each index.
+        void run(size_t n_tasks, const std::function<void(size_t)>& fn);
+
+        /// Returns the number of threads each loop runs on, including the
+        /// calling thread.
+        /// \return thread count.
+        [[nodiscard]] auto size() const -> size_t;
+
+      private:
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_run_mut;
+
+        std::mutex m_mut;
+        std::condition_variable m_start_cv;
+        std::condition_variable m_done_cv;
+        uint64_t m_generation{};
+        bool m_stop{false};
+        const std::function<void(size_t)>* m_fn{};
+        size_t m_n_tasks{};
+        size_t m_active{};
+        std::atomic<size_t> m_next{};
+
+        void worker();
+        void drain(const std::function<void(size_t)>& fn, size_t n_tasks);
+    };
+}
+
+#endif // OPENCBDC_TX_SRC_COMMON_WORKER_POOL_H_
@@ -38,11 +38,8 @@ namespace cbdc::network {
     }
 
     void connection_manager::broadcast(const std::shared_ptr<buffer>& data) {
-        {
-            std::shared_lock<std::shared_mutex> l(m_peer_mutex);
-            for(const auto& peer : m_peers) {
-                peer.m_peer->send(data);
-            }
+        for(const auto& peer : peers()) {
+            std::ignore = peer->send(data);
         }
     }
 
@@ -212,7 +209,7 @@ namespace cbdc::network {
         }
 
         if(peer) {
-            peer->send(data);
+            std::ignore = peer->send(data);
         }
     }
 
@@ -235,25 +232,36 @@ namespace cbdc::network {
 
     auto connection_manager::send_to_one(const std::shared_ptr<buffer>& data)
         -> bool {
-        bool sent{false};
+        auto peers = this->peers();
+        if(peers.empty()) {
+            return false;
+        }
+        // Start at a random place in the peers vector to balance load
+        // across connections
+        auto offset = size_t();
         {
-            std::shared_lock<std::shared_mutex> l(m_peer_mutex);
-            // Start at a random place in the peers vector to balance load
-            // across connections
+            std::lock_guard<std::mutex> l(m_rnd_mut);
             auto dist
-                = std::uniform_int_distribution<size_t>(0, m_peers.size() - 1);
-            auto offset = dist(m_rnd);
-            for(size_t i = 0; i < m_peers.size(); i++) {
-                auto idx = (i + offset) % m_peers.size();
-                const auto& p = m_peers[idx];
-                if(p.m_peer->connected()) {
-                    p.m_peer->send(data);
-                    sent = true;
-                    break;
-                }
+                = std::uniform_int_distribution<size_t>(0, peers.size() - 1);
+            offset = dist(m_rnd);
+        }
+        for(size_t i = 0; i < peers.size(); i++) {
+            const auto& p = peers[(i + offset) % peers.size()];
+            if(p->connected() && p->send(data)) {
+                return true;
             }
         }
-        return sent;
+        return false;
+    }
+
+    auto connection_manager::peers() -> std::vector<std::shared_ptr<peer>> {
+        auto ret = std::vector<std::shared_ptr<peer>>();
+        std::shared_lock<std::shared_mutex> l(m_peer_mutex);
+        ret.reserve(m_peers.size());
+        for(const auto& p : m_peers) {
+            ret.push_back(p.m_peer);
+        }
+        return ret;
     }
 
     connection_manager::m_peer_t::m_peer_t(std::unique_ptr<peer> peer,
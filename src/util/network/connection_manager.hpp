@@ -21,6 +21,7 @@
 #include <shared_mutex>
 #include <sys/socket.h>
 #include <thread>
+#include <tuple>
 
 namespace cbdc::network {
     /// Peer IDs within a \ref connection_manager.
@@ -232,7 +233,13 @@ namespace cbdc::network {
         socket_selector m_listen_selector;
 
         std::random_device m_r{cbdc::config::random_source};
+        std::mutex m_rnd_mut;
         std::default_random_engine m_rnd{m_r()};
+
+        /// Returns the current peers, so packets can be queued without
+        /// holding the peer lock.
+        /// \return added peers.
+        [[nodiscard]] auto peers() -> std::vector<std::shared_ptr<peer>>;
     };
 }
 
@@ -24,10 +24,11 @@ namespace cbdc::network {
         shutdown();
     }
 
-    void peer::send(const std::shared_ptr<cbdc::buffer>& data) {
-        if(!m_shut_down) {
-            m_send_queue.push(data);
+    auto peer::send(const std::shared_ptr<cbdc::buffer>& data) -> bool {
+        if(m_shut_down) {
+            return false;
         }
+        return m_send_queue.try_push(data);
     }
 
     void peer::shutdown() {
@@ -45,18 +46,25 @@ namespace cbdc::network {
 
     void peer::do_send() {
         m_send_thread = std::thread([&]() {
+            auto pkts = std::vector<std::shared_ptr<cbdc::buffer>>();
+            pkts.reserve(send_batch_size);
             while(m_running) {
-                std::shared_ptr<cbdc::buffer> pkt;
-                if(!m_send_queue.pop(pkt)) {
+                pkts.clear();
+                if(m_send_queue.pop_batch(pkts, send_batch_size) == 0) {
                     assert(!m_running);
                     break;
                 }
 
-                if(pkt) {
-                    const auto result = m_sock->send(*pkt);
-                    if(!result) {
-                        signal_reconnect();
-                        return;
+                for(const auto& pkt : pkts) {
+                    if(pkt) {
+                        const auto result = m_sock->send(*pkt);
+                        if(!result) {
+                            // Closing the peer discards the queue, so the
+                            // rest of this batch is dropped with it.
+                            pkts.clear();
+                            signal_reconnect();
+                            return;
+                        }
                     }
                 }
             }
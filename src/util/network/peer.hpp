@@ -7,9 +7,10 @@
 #define OPENCBDC_TX_SRC_NETWORK_PEER_H_
 
 #include "tcp_socket.hpp"
-#include "util/common/blocking_queue.hpp"
+#include "util/common/mpmc_queue.hpp"
 
 #include <atomic>
+#include <functional>
 #include <thread>
 
 namespace cbdc::network {
@@ -51,9 +52,14 @@ namespace cbdc::network {
         /// \brief Sends buffered data.
         ///
         /// Queues a packet to send via the TCP socket. The recipient peer
-        /// receives it as a discrete unit.
+        /// receives it as a discrete unit. Never blocks: the packet is
+        /// dropped if the send queue is full, which happens while the peer
+        /// is disconnected or not keeping up. Packets still queued when the
+        /// connection is lost are discarded rather than sent after a
+        /// reconnect.
         /// \param data buffer to send.
-        void send(const std::shared_ptr<cbdc::buffer>& data);
+        /// \return true if the packet was queued.
+        auto send(const std::shared_ptr<cbdc::buffer>& data) -> bool;
 
         /// Clears any packets in the pending send queue. Stops the send,
         /// receive, and reconnect threads. Disconnects the TCP socket.
@@ -66,7 +72,14 @@ namespace cbdc::network {
       private:
         std::unique_ptr<tcp_socket> m_sock;
 
-        blocking_queue<std::shared_ptr<cbdc::buffer>> m_send_queue;
+        /// Maximum number of packets waiting to be sent. Further packets are
+        /// dropped until the queue drains.
+        static constexpr size_t send_queue_size{1UL << 16};
+        /// Maximum number of packets the send thread dequeues at once.
+        static constexpr size_t send_batch_size{64};
+
+        mpmc_queue<std::shared_ptr<cbdc::buffer>> m_send_queue{
+            send_queue_size};
 
         std::thread m_recv_thread;
         std::thread m_send_thread;
@@ -7,6 +7,7 @@
 
 #include <array>
 #include <cstring>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace cbdc::network {
@@ -58,26 +59,35 @@ namespace cbdc::network {
     }
 
     auto tcp_socket::send(const buffer& pkt) const -> bool {
+        // Write the size prefix and the packet with one system call so
+        // they leave in the same segment. Separate writes would hold back
+        // the packet until the prefix is acknowledged.
         const auto sz_val = static_cast<uint64_t>(pkt.size());
         std::array<std::byte, sizeof(sz_val)> sz_arr{};
         std::memcpy(sz_arr.data(), &sz_val, sizeof(sz_val));
+        const auto total = sizeof(sz_val) + pkt.size();
         size_t total_written = 0;
-        while(total_written != sizeof(sz_val)) {
-            auto n = write(m_sock_fd,
-                           &sz_arr.at(total_written),
-                           sizeof(sz_val) - total_written);
-            if(n <= 0) {
-                return false;
+        while(total_written != total) {
+            std::array<iovec, 2> iov{};
+            size_t n_iov{0};
+            if(total_written < sizeof(sz_val)) {
+                iov.at(n_iov).iov_base = &sz_arr.at(total_written);
+                iov.at(n_iov).iov_len = sizeof(sz_val) - total_written;
+                n_iov++;
             }
-            total_written += static_cast<size_t>(n);
-        }
-
-        total_written = 0;
-        while(total_written
-              != static_cast<decltype(total_written)>(pkt.size())) {
-            auto n = write(m_sock_fd,
-                           pkt.data_at(total_written),
-                           pkt.size() - total_written);
+            const auto pkt_written
+                = total_written > sizeof(sz_val)
+                    ? total_written - sizeof(sz_val)
+                    : size_t{0};
+            if(pkt_written < pkt.size()) {
+                // writev does not modify the data
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+                auto* data = const_cast<void*>(pkt.data_at(pkt_written));
+                iov.at(n_iov).iov_base = data;
+                iov.at(n_iov).iov_len = pkt.size() - pkt_written;
+                n_iov++;
+            }
+            auto n = writev(m_sock_fd, iov.data(), static_cast<int>(n_iov));
             if(n <= 0) {
                 return false;
             }
@@ -16,6 +16,7 @@
 #include <cassert>
 #include <cstdint>
 #include <limits>
+#include <map>
 #include <optional>
 #include <set>
 #include <unordered_map>
@@ -284,6 +285,45 @@ namespace cbdc {
         return deser;
     }
 
+    /// Serializes the count of key-value pairs, and then each key and value.
+    /// \see \ref cbdc::operator<<(serializer&, T)
+    template<typename K, typename V, typename... Ts>
+    auto operator<<(serializer& ser, const std::map<K, V, Ts...>& map)
+        -> serializer& {
+        auto len = static_cast<uint64_t>(map.size());
+        ser << len;
+        for(const auto& it : map) {
+            ser << it.first << it.second;
+        }
+        return ser;
+    }
+
+    /// Deserializes an ordered map of key-value pairs.
+    /// \see \ref cbdc::operator<<(serializer&, const std::map<K, V, Ts...>&)
+    template<typename K, typename V, typename... Ts>
+    auto operator>>(serializer& deser, std::map<K, V, Ts...>& map)
+        -> serializer& {
+        auto len = uint64_t();
+        if(!(deser >> len)) {
+            return deser;
+        }
+
+        for(uint64_t i = 0; i < len; i++) {
+            auto key = K();
+            if(!(deser >> key)) {
+                return deser;
+            }
+
+            auto val = V();
+            if(!(deser >> val)) {
+                return deser;
+            }
+
+            map.emplace_hint(map.end(), std::move(key), std::move(val));
+        }
+        return deser;
+    }
+
     /// Serializes the count of items, and then each item statically-casted.
     /// \see \ref cbdc::operator<<(serializer&, T)
     template<typename K, typename... Ts>
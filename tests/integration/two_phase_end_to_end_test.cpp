@@ -72,6 +72,7 @@ class two_phase_end_to_end_test : public ::testing::Test {
         std::filesystem::remove_all("shard0_raft_log_0");
         std::filesystem::remove("shard0_raft_config_0.dat");
         std::filesystem::remove("shard0_raft_state_0.dat");
+        std::filesystem::remove_all("shard0_snps_0");
         std::filesystem::remove("tp_samples.txt");
     }
 
@@ -269,6 +269,42 @@ TEST_F(ArchiverTest, client) {
               m_dummy_blocks[0].m_transactions[2].m_id);
 }
 
+// Test pipelined retrieval of a range of blocks
+TEST_F(ArchiverTest, client_get_blocks) {
+    m_archiver->init_leveldb();
+    m_archiver->init_best_block();
+    ASSERT_TRUE(m_archiver->init_archiver_server());
+    m_archiver->digest_block(m_dummy_blocks[0]);
+    m_archiver->digest_block(m_dummy_blocks[1]);
+    m_archiver->digest_block(m_dummy_blocks[2]);
+
+    auto client
+        = cbdc::archiver::client(m_config_opts.m_archiver_endpoints[0], m_log);
+    ASSERT_TRUE(client.init());
+
+    // The archiver does not have block 4, so retrieval stops there
+    auto heights = std::vector<uint64_t>();
+    auto next = client.get_blocks(1, 6, 2, [&](cbdc::atomizer::block&& blk) {
+        heights.push_back(blk.m_height);
+        return true;
+    });
+    ASSERT_EQ(next, 4UL);
+    ASSERT_EQ(heights, (std::vector<uint64_t>{1, 2, 3}));
+
+    // Stopping early discards the outstanding responses
+    heights.clear();
+    next = client.get_blocks(1, 4, 3, [&](cbdc::atomizer::block&& blk) {
+        heights.push_back(blk.m_height);
+        return false;
+    });
+    ASSERT_EQ(next, 1UL);
+    ASSERT_EQ(heights, (std::vector<uint64_t>{1}));
+
+    auto blk = client.get_block(2);
+    ASSERT_TRUE(blk.has_value());
+    ASSERT_EQ(blk.value().m_height, 2UL);
+}
+
 // Test if the archiver returns null for a non existent block
 TEST_F(ArchiverTest, get_block_non_existent) {
     m_archiver->init_leveldb();
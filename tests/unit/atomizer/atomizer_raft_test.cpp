@@ -0,0 +1,117 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/atomizer_raft.hpp"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+
+// Exercises the handling of notifications before they are replicated, so the
+// raft node is never started.
+class atomizer_raft_test : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        cleanup();
+        m_opts.m_attestation_threshold = 0;
+        m_opts.m_atomizer_replication_max_txs = 1;
+        m_raft = std::make_unique<cbdc::atomizer::atomizer_raft>(
+            0,
+            std::vector<cbdc::network::endpoint_t>{{"127.0.0.1", 5000}},
+            m_stxo_cache_depth,
+            std::make_shared<cbdc::logging::log>(
+                cbdc::logging::log_level::warn),
+            m_opts,
+            nullptr);
+    }
+
+    void TearDown() override {
+        m_raft.reset();
+        cleanup();
+    }
+
+    static void cleanup() {
+        std::filesystem::remove_all("atomizer_raft_log_0");
+        std::filesystem::remove_all("atomizer_raft_config_0.dat");
+        std::filesystem::remove_all("atomizer_raft_state_0.dat");
+        std::filesystem::remove_all("atomizer_snps_0");
+        std::filesystem::remove_all("atomizer_blocks_0");
+    }
+
+    /// Returns a transaction whose ID differs from the others only in its
+    /// last byte, so all of them share a lock stripe.
+    static auto make_tx(uint8_t id, size_t n_inputs)
+        -> cbdc::transaction::compact_tx {
+        auto tx = cbdc::transaction::compact_tx();
+        tx.m_id.back() = id;
+        for(size_t i = 0; i < n_inputs; i++) {
+            auto inp = cbdc::hash_t();
+            inp[0] = id;
+            inp[1] = static_cast<uint8_t>(i);
+            tx.m_inputs.push_back(inp);
+        }
+        return tx;
+    }
+
+    void notify(const cbdc::transaction::compact_tx& tx,
+                uint64_t input,
+                uint64_t height) {
+        auto notif = cbdc::atomizer::tx_notify_request();
+        notif.m_tx = tx;
+        notif.m_attestations = {input};
+        notif.m_block_height = height;
+        m_raft->tx_notify(std::move(notif));
+    }
+
+    void attest(const cbdc::transaction::compact_tx& tx,
+                uint64_t input,
+                uint64_t height) {
+        auto notif = cbdc::atomizer::tx_attestation_notify_request();
+        notif.m_tx_id = tx.m_id;
+        notif.m_attestations = {uint64_t(1) << input};
+        notif.m_block_height = height;
+        m_raft->tx_attestation_notify(std::move(notif));
+    }
+
+    static constexpr size_t m_stxo_cache_depth{2};
+
+    cbdc::config::options m_opts{};
+    std::unique_ptr<cbdc::atomizer::atomizer_raft> m_raft;
+};
+
+TEST_F(atomizer_raft_test, orphan_completes_transaction) {
+    auto tx = make_tx(1, 2);
+    attest(tx, 1, 1);
+    ASSERT_EQ(m_raft->orphan_count(), 1UL);
+
+    notify(tx, 0, 2);
+    ASSERT_EQ(m_raft->orphan_count(), 0UL);
+    ASSERT_TRUE(m_raft->wait_for_complete_txs());
+}
+
+TEST_F(atomizer_raft_test, orphan_expiry) {
+    auto a = make_tx(1, 2);
+    auto b = make_tx(2, 2);
+    auto c = make_tx(3, 2);
+
+    attest(a, 0, 1);
+    attest(b, 0, 3);
+    ASSERT_EQ(m_raft->orphan_count(), 2UL);
+
+    // Newer attestations keep an orphan alive past its first height.
+    attest(a, 1, 3);
+    attest(b, 1, 4);
+    ASSERT_EQ(m_raft->orphan_count(), 2UL);
+
+    // Height 3 is now beyond the cache depth.
+    attest(c, 0, 6);
+    ASSERT_EQ(m_raft->orphan_count(), 2UL);
+    notify(a, 0, 6);
+    ASSERT_EQ(m_raft->orphan_count(), 2UL);
+
+    // Full notifications still pick up the attestations of live orphans.
+    notify(b, 0, 6);
+    ASSERT_EQ(m_raft->orphan_count(), 1UL);
+    ASSERT_TRUE(m_raft->wait_for_complete_txs());
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/block_store.hpp"
+#include "uhs/atomizer/atomizer/format.hpp"
+#include "util.hpp"
+#include "util/serialization/buffer_serializer.hpp"
+#include "util/serialization/util.hpp"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+
+class block_store_test : public ::testing::Test {
+  protected:
+    void TearDown() override {
+        std::filesystem::remove_all(m_dir);
+    }
+
+    static auto make_block(uint64_t height) -> cbdc::atomizer::block {
+        auto blk = cbdc::atomizer::block();
+        blk.m_height = height;
+        auto id = static_cast<unsigned char>(height);
+        blk.m_transactions.push_back(
+            cbdc::test::simple_tx({id}, {{id, 'a'}}, {{id, 'b'}}));
+        return blk;
+    }
+
+    static constexpr auto m_dir = "block_store_test";
+    static constexpr uint64_t m_n_blocks{20};
+};
+
+TEST_F(block_store_test, spill_and_get) {
+    const auto blk_size = cbdc::serialized_size(make_block(0));
+    static constexpr size_t blocks_in_memory = 4;
+    static constexpr size_t blocks_per_segment = 3;
+    auto store = cbdc::atomizer::block_store(m_dir,
+                                             blk_size * blocks_in_memory,
+                                             blk_size * blocks_per_segment);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        store.add(make_block(h));
+    }
+
+    auto stats = store.stats();
+    ASSERT_EQ(stats.m_blocks, m_n_blocks);
+    ASSERT_EQ(stats.m_memory_bytes, blk_size * blocks_in_memory);
+    ASSERT_EQ(stats.m_disk_bytes,
+              blk_size * (m_n_blocks - blocks_in_memory));
+
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        ASSERT_TRUE(store.contains(h));
+        ASSERT_EQ(store.get(h), make_block(h));
+    }
+    ASSERT_FALSE(store.contains(m_n_blocks));
+    ASSERT_FALSE(store.get(m_n_blocks).has_value());
+}
+
+TEST_F(block_store_test, prune_drops_segments) {
+    const auto blk_size = cbdc::serialized_size(make_block(0));
+    auto store = cbdc::atomizer::block_store(m_dir, blk_size, blk_size * 2);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        store.add(make_block(h));
+    }
+
+    static constexpr uint64_t prune_height = 7;
+    store.prune(prune_height);
+    ASSERT_EQ(store.size(), m_n_blocks - prune_height);
+    ASSERT_FALSE(store.contains(prune_height - 1));
+    ASSERT_FALSE(store.get(prune_height - 1).has_value());
+    for(uint64_t h = prune_height; h < m_n_blocks; h++) {
+        ASSERT_TRUE(store.contains(h));
+        ASSERT_EQ(store.get(h), make_block(h));
+    }
+
+    // All but the newest block are spilled into segments of two blocks
+    // each. Only the segments below the one containing heights 6 and 7 are
+    // removed.
+    static constexpr uint64_t n_segments = m_n_blocks / 2;
+    auto n_files = std::distance(std::filesystem::directory_iterator(m_dir),
+                                 std::filesystem::directory_iterator());
+    ASSERT_EQ(static_cast<uint64_t>(n_files),
+              n_segments - prune_height / 2);
+
+    store.prune(m_n_blocks);
+    ASSERT_EQ(store.size(), 0UL);
+    ASSERT_EQ(store.stats().m_disk_bytes, 0UL);
+    ASSERT_EQ(store.stats().m_memory_bytes, 0UL);
+}
+
+TEST_F(block_store_test, serialization) {
+    const auto blk_size = cbdc::serialized_size(make_block(0));
+    auto store = cbdc::atomizer::block_store(m_dir, blk_size * 2);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        store.add(make_block(h));
+    }
+
+    auto buf = cbdc::buffer();
+    auto ser = cbdc::buffer_serializer(buf);
+    ASSERT_TRUE(ser << store);
+
+    auto deser = cbdc::buffer_serializer(buf);
+    auto other = cbdc::atomizer::block_store();
+    ASSERT_TRUE(deser >> other);
+    ASSERT_EQ(other.size(), m_n_blocks);
+    ASSERT_EQ(other.stats().m_disk_bytes, 0UL);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        ASSERT_EQ(other.get(h), make_block(h));
+    }
+}
+
+TEST_F(block_store_test, shares_serialized_blocks) {
+    const auto blk_size = cbdc::serialized_size(make_block(0));
+    auto store = cbdc::atomizer::block_store(m_dir, blk_size);
+    auto first = store.add(make_block(0));
+    ASSERT_EQ(*first, cbdc::make_buffer(make_block(0)));
+    ASSERT_EQ(store.get_serialized(0), first);
+
+    // Spilled blocks are read back into a new buffer
+    auto second = store.add(make_block(1));
+    ASSERT_EQ(store.get_serialized(1), second);
+    auto spilled = store.get_serialized(0);
+    ASSERT_NE(spilled, first);
+    ASSERT_EQ(*spilled, *first);
+    ASSERT_FALSE(store.get_serialized(2));
+}
+
+TEST_F(block_store_test, replace_spilled) {
+    const auto blk_size = cbdc::serialized_size(make_block(0));
+    auto store = cbdc::atomizer::block_store(m_dir, blk_size, blk_size * 2);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        store.add(make_block(h));
+    }
+    ASSERT_EQ(store.stats().m_disk_bytes, blk_size * (m_n_blocks - 1));
+
+    // Re-adding spilled heights moves them back to memory, and spills the
+    // same amount again.
+    store.add(make_block(0));
+    store.add(make_block(1));
+    auto stats = store.stats();
+    ASSERT_EQ(stats.m_blocks, m_n_blocks);
+    ASSERT_EQ(stats.m_memory_bytes, blk_size);
+    ASSERT_EQ(stats.m_disk_bytes, blk_size * (m_n_blocks - 1));
+
+    // The segment which held heights 0 and 1 is removed.
+    static constexpr uint64_t n_segments = m_n_blocks / 2 + 1;
+    auto n_files = std::distance(std::filesystem::directory_iterator(m_dir),
+                                 std::filesystem::directory_iterator());
+    ASSERT_EQ(static_cast<uint64_t>(n_files), n_segments - 1);
+    for(uint64_t h = 0; h < m_n_blocks; h++) {
+        ASSERT_EQ(store.get(h), make_block(h));
+    }
+
+    store.prune(m_n_blocks);
+    ASSERT_EQ(store.stats().m_disk_bytes, 0UL);
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/complete_tx_queue.hpp"
+
+#include <future>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+class complete_tx_queue_test : public ::testing::Test {
+  protected:
+    static void push(cbdc::atomizer::complete_tx_queue& queue, size_t n) {
+        for(size_t i = 0; i < n; i++) {
+            queue.push(cbdc::atomizer::aggregate_tx_notification());
+        }
+    }
+
+    /// Replication function which records the size of each entry and holds
+    /// its completion function until released.
+    auto hold_fn() -> cbdc::atomizer::complete_tx_queue::replicate_fn {
+        return [&](cbdc::atomizer::aggregate_tx_notify_request&& req,
+                   std::function<void()> done) {
+            {
+                std::lock_guard<std::mutex> l(m_mut);
+                m_sizes.push_back(req.m_agg_txs.size());
+                m_done.push_back(std::move(done));
+            }
+            m_cv.notify_all();
+            return true;
+        };
+    }
+
+    /// Waits until the given number of entries have been replicated.
+    auto wait_for_sent(size_t n) -> bool {
+        std::unique_lock<std::mutex> l(m_mut);
+        return m_cv.wait_for(l, m_timeout, [&]() {
+            return m_sizes.size() >= n;
+        });
+    }
+
+    /// Calls the completion function of the given entry.
+    void release(size_t i) {
+        auto done = std::function<void()>();
+        {
+            std::lock_guard<std::mutex> l(m_mut);
+            done = m_done[i];
+        }
+        done();
+    }
+
+    static constexpr auto m_timeout = 5s;
+    static constexpr auto m_long_delay = std::chrono::microseconds(60s);
+
+    std::mutex m_mut;
+    std::condition_variable m_cv;
+    std::vector<size_t> m_sizes;
+    std::vector<std::function<void()>> m_done;
+};
+
+TEST_F(complete_tx_queue_test, wait_for_first_tx) {
+    auto queue = cbdc::atomizer::complete_tx_queue(10, 0us, 0);
+    auto res = std::async(std::launch::async, [&]() {
+        return queue.wait();
+    });
+    ASSERT_EQ(res.wait_for(50ms), std::future_status::timeout);
+
+    push(queue, 1);
+    ASSERT_EQ(res.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_TRUE(res.get());
+}
+
+TEST_F(complete_tx_queue_test, wait_for_delay) {
+    static constexpr auto delay = 50ms;
+    auto queue = cbdc::atomizer::complete_tx_queue(10, delay, 0);
+    push(queue, 1);
+
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(queue.wait());
+    ASSERT_GE(std::chrono::steady_clock::now() - start, delay);
+}
+
+TEST_F(complete_tx_queue_test, wait_for_max_txs) {
+    auto queue = cbdc::atomizer::complete_tx_queue(2, m_long_delay, 0);
+    push(queue, 1);
+    auto res = std::async(std::launch::async, [&]() {
+        return queue.wait();
+    });
+    ASSERT_EQ(res.wait_for(50ms), std::future_status::timeout);
+
+    // Filling an entry ends the delay early.
+    push(queue, 1);
+    ASSERT_EQ(res.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_TRUE(res.get());
+}
+
+TEST_F(complete_tx_queue_test, stop) {
+    auto queue = cbdc::atomizer::complete_tx_queue(10, m_long_delay, 0);
+    auto empty = std::async(std::launch::async, [&]() {
+        return queue.wait();
+    });
+    push(queue, 1);
+    auto delayed = std::async(std::launch::async, [&]() {
+        return queue.wait();
+    });
+    ASSERT_EQ(delayed.wait_for(50ms), std::future_status::timeout);
+
+    queue.stop();
+    ASSERT_EQ(empty.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_EQ(delayed.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_FALSE(empty.get());
+    ASSERT_FALSE(delayed.get());
+    ASSERT_FALSE(queue.wait());
+}
+
+TEST_F(complete_tx_queue_test, send_splits_entries) {
+    auto queue = cbdc::atomizer::complete_tx_queue(2, 0us, 0);
+    push(queue, 5);
+    ASSERT_EQ(queue.size(), 5UL);
+
+    ASSERT_TRUE(queue.send(hold_fn()));
+    ASSERT_EQ(queue.size(), 0UL);
+    ASSERT_EQ(m_sizes, (std::vector<size_t>{2, 2, 1}));
+    ASSERT_EQ(queue.inflight(), 3UL);
+
+    for(size_t i = 0; i < m_done.size(); i++) {
+        release(i);
+    }
+    ASSERT_EQ(queue.inflight(), 0UL);
+}
+
+TEST_F(complete_tx_queue_test, send_not_accepted) {
+    auto queue = cbdc::atomizer::complete_tx_queue(2, 0us, 1);
+    push(queue, 3);
+
+    auto calls = size_t();
+    ASSERT_FALSE(queue.send([&](cbdc::atomizer::aggregate_tx_notify_request&&,
+                                const std::function<void()>&) {
+        calls++;
+        return false;
+    }));
+    // Rejected entries do not count against the in-flight limit.
+    ASSERT_EQ(calls, 2UL);
+    ASSERT_EQ(queue.inflight(), 0UL);
+}
+
+TEST_F(complete_tx_queue_test, inflight_limit) {
+    static constexpr size_t max_inflight = 2;
+    static constexpr size_t n_entries = 4;
+    auto queue = cbdc::atomizer::complete_tx_queue(1, 0us, max_inflight);
+    push(queue, n_entries);
+
+    auto res = std::async(std::launch::async, [&]() {
+        return queue.send(hold_fn());
+    });
+    ASSERT_TRUE(wait_for_sent(max_inflight));
+    ASSERT_EQ(res.wait_for(50ms), std::future_status::timeout);
+    {
+        std::lock_guard<std::mutex> l(m_mut);
+        ASSERT_EQ(m_sizes.size(), max_inflight);
+    }
+    ASSERT_EQ(queue.inflight(), max_inflight);
+
+    // Each result lets one more entry through.
+    release(0);
+    ASSERT_TRUE(wait_for_sent(max_inflight + 1));
+    release(1);
+    ASSERT_TRUE(wait_for_sent(n_entries));
+    ASSERT_EQ(res.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_TRUE(res.get());
+    ASSERT_EQ(queue.inflight(), max_inflight);
+
+    release(2);
+    release(3);
+    ASSERT_EQ(queue.inflight(), 0UL);
+}
+
+TEST_F(complete_tx_queue_test, stop_while_inflight) {
+    auto queue = cbdc::atomizer::complete_tx_queue(1, 0us, 1);
+    push(queue, 2);
+
+    auto res = std::async(std::launch::async, [&]() {
+        return queue.send(hold_fn());
+    });
+    ASSERT_TRUE(wait_for_sent(1));
+    ASSERT_EQ(res.wait_for(50ms), std::future_status::timeout);
+
+    queue.stop();
+    ASSERT_EQ(res.wait_for(m_timeout), std::future_status::ready);
+    ASSERT_TRUE(res.get());
+    ASSERT_EQ(m_sizes.size(), 1UL);
+    release(0);
+}
@@ -23,7 +23,9 @@ TEST_F(atomizer_messages_test, snapshot) {
     auto blocks
         = std::make_shared<decltype(cbdc::atomizer::state_machine::snapshot::
                                         m_blocks)::element_type>();
-    blocks->emplace(5, cbdc::atomizer::block());
+    auto blk = cbdc::atomizer::block();
+    blk.m_height = 5;
+    blocks->add(blk);
     auto snp = cbdc::atomizer::state_machine::snapshot{std::move(atm),
                                                        std::move(nuraft_snp),
                                                        std::move(blocks)};
@@ -41,9 +43,59 @@ TEST_F(atomizer_messages_test, snapshot) {
                                                   std::move(other_blks)};
     ASSERT_TRUE(m_deser >> deser_snp);
     ASSERT_EQ(*snp.m_atomizer, *deser_snp.m_atomizer);
-    ASSERT_EQ(*snp.m_blocks, *deser_snp.m_blocks);
+    ASSERT_EQ(deser_snp.m_blocks->size(), 1UL);
+    ASSERT_EQ(deser_snp.m_blocks->get(5), blk);
     ASSERT_EQ(snp.m_snp->get_last_log_term(),
               deser_snp.m_snp->get_last_log_term());
     ASSERT_EQ(snp.m_snp->get_last_log_idx(),
               deser_snp.m_snp->get_last_log_idx());
 }
+
+TEST_F(atomizer_messages_test, attestation_notify) {
+    auto notif = cbdc::atomizer::tx_notify_request();
+    notif.m_tx.m_id = {'a'};
+    static constexpr size_t n_inputs = 70;
+    notif.m_tx.m_inputs.resize(n_inputs);
+    notif.m_attestations = {0, 5, 63, 64, 69};
+    notif.m_block_height = 12;
+
+    auto compact = cbdc::atomizer::make_attestation_notify(notif);
+    ASSERT_EQ(compact.m_tx_id, notif.m_tx.m_id);
+    ASSERT_EQ(compact.m_block_height, notif.m_block_height);
+    ASSERT_EQ(compact.m_attestations.size(), 2UL);
+    auto expected = std::vector<uint64_t>{0, 5, 63, 64, 69};
+    ASSERT_EQ(cbdc::atomizer::attested_inputs(compact), expected);
+
+    ASSERT_TRUE(m_ser << cbdc::atomizer::request{compact});
+    auto deser = cbdc::atomizer::request();
+    ASSERT_TRUE(m_deser >> deser);
+    ASSERT_TRUE(
+        std::holds_alternative<cbdc::atomizer::tx_attestation_notify_request>(
+            deser));
+    ASSERT_EQ(std::get<cbdc::atomizer::tx_attestation_notify_request>(deser),
+              compact);
+}
+
+TEST_F(atomizer_messages_test, notify_batch) {
+    auto batch = cbdc::atomizer::tx_notify_batch_request();
+    for(unsigned char i = 0; i < 3; i++) {
+        auto notif = cbdc::atomizer::tx_notify_request();
+        notif.m_tx.m_id = {i};
+        notif.m_tx.m_inputs = {{i}, {'x'}};
+        notif.m_attestations = {0};
+        notif.m_block_height = i;
+        batch.m_notifications.push_back(notif);
+        notif.m_attestations = {1};
+        batch.m_attestation_notifications.push_back(
+            cbdc::atomizer::make_attestation_notify(notif));
+    }
+
+    ASSERT_TRUE(m_ser << cbdc::atomizer::request{batch});
+    auto deser = cbdc::atomizer::request();
+    ASSERT_TRUE(m_deser >> deser);
+    ASSERT_TRUE(
+        std::holds_alternative<cbdc::atomizer::tx_notify_batch_request>(
+            deser));
+    ASSERT_EQ(std::get<cbdc::atomizer::tx_notify_batch_request>(deser),
+              batch);
+}
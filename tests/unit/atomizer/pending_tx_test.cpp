@@ -0,0 +1,86 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/pending_tx.hpp"
+#include "util.hpp"
+#include "util/serialization/buffer_serializer.hpp"
+
+#include <gtest/gtest.h>
+
+class pending_tx_test : public ::testing::Test {
+  protected:
+    static auto make_tx(size_t n_inputs) -> cbdc::transaction::compact_tx {
+        auto tx = cbdc::transaction::compact_tx();
+        tx.m_id = {'a'};
+        for(size_t i = 0; i < n_inputs; i++) {
+            auto inp = cbdc::hash_t();
+            std::memcpy(inp.data(), &i, sizeof(i));
+            tx.m_inputs.push_back(inp);
+        }
+        return tx;
+    }
+};
+
+TEST_F(pending_tx_test, complete_across_heights) {
+    auto ptx = cbdc::atomizer::pending_tx(make_tx(3));
+    ASSERT_TRUE(ptx.empty());
+
+    ASSERT_TRUE(ptx.add(5, {0}));
+    ASSERT_FALSE(ptx.complete());
+    ASSERT_TRUE(ptx.add(3, {1}));
+    ASSERT_FALSE(ptx.add(5, {1}));
+    ASSERT_FALSE(ptx.complete());
+    ASSERT_EQ(ptx.oldest_height(), 3UL);
+
+    // Out-of-range input indices are ignored.
+    ASSERT_TRUE(ptx.add(6, {3}));
+    ASSERT_FALSE(ptx.complete());
+
+    ASSERT_FALSE(ptx.add(6, {2}));
+    ASSERT_TRUE(ptx.complete());
+}
+
+TEST_F(pending_tx_test, evict) {
+    auto ptx = cbdc::atomizer::pending_tx(make_tx(2));
+    ASSERT_TRUE(ptx.add(1, {0}));
+    ASSERT_TRUE(ptx.add(2, {1}));
+    ASSERT_TRUE(ptx.complete());
+
+    ASSERT_TRUE(ptx.evict(1));
+    ASSERT_FALSE(ptx.evict(1));
+    ASSERT_FALSE(ptx.complete());
+    ASSERT_EQ(ptx.oldest_height(), 2UL);
+
+    ASSERT_TRUE(ptx.evict(2));
+    ASSERT_TRUE(ptx.empty());
+}
+
+TEST_F(pending_tx_test, wide_bitmap) {
+    static constexpr uint32_t n_inputs = 130;
+    auto ptx = cbdc::atomizer::pending_tx(make_tx(n_inputs));
+    for(uint32_t i = 0; i < n_inputs; i++) {
+        ASSERT_FALSE(ptx.complete());
+        std::ignore = ptx.add(i % 3, {i});
+    }
+    ASSERT_TRUE(ptx.complete());
+}
+
+TEST_F(pending_tx_test, serialization) {
+    auto ptx = cbdc::atomizer::pending_tx(make_tx(2));
+    ASSERT_TRUE(ptx.add(4, {1}));
+    ASSERT_TRUE(ptx.add(2, {}));
+
+    auto buf = cbdc::buffer();
+    auto ser = cbdc::buffer_serializer(buf);
+    ASSERT_TRUE(ser << ptx);
+
+    auto deser = cbdc::buffer_serializer(buf);
+    auto other = cbdc::atomizer::pending_tx();
+    ASSERT_TRUE(deser >> other);
+    ASSERT_EQ(ptx, other);
+    ASSERT_EQ(other.oldest_height(), 2UL);
+    ASSERT_FALSE(other.add(4, {0}));
+    ASSERT_TRUE(other.complete());
+}
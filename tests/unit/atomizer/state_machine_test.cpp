@@ -0,0 +1,273 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/format.hpp"
+#include "uhs/atomizer/atomizer/state_machine.hpp"
+#include "util/raft/serialization.hpp"
+#include "util/raft/util.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/util.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <gtest/gtest.h>
+
+class atomizer_state_machine_test : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        cleanup();
+        m_src = make_sm(m_src_snps, m_src_blocks);
+        m_dst = make_sm(m_dst_snps, m_dst_blocks);
+    }
+
+    void TearDown() override {
+        m_src.reset();
+        m_dst.reset();
+        cleanup();
+    }
+
+    static void cleanup() {
+        for(const auto* dir :
+            {m_src_snps, m_src_blocks, m_dst_snps, m_dst_blocks}) {
+            std::filesystem::remove_all(dir);
+        }
+    }
+
+    static auto make_sm(const std::string& snps,
+                        const std::string& blocks,
+                        size_t block_memory = m_block_memory)
+        -> std::shared_ptr<cbdc::atomizer::state_machine> {
+        return std::make_shared<cbdc::atomizer::state_machine>(
+            m_stxo_cache_depth,
+            0,
+            snps,
+            1,
+            blocks,
+            block_memory);
+    }
+
+    /// Commits enough transactions to the source state machine to span
+    /// more than one snapshot object, followed by a block containing them.
+    /// \return log index of the make block request.
+    auto commit_make_block() -> uint64_t {
+        auto notify = cbdc::atomizer::aggregate_tx_notify_request();
+        notify.m_agg_txs.resize(m_txs_per_block);
+        for(auto& agg : notify.m_agg_txs) {
+            agg.m_oldest_attestation = m_height;
+            for(size_t i = 0; i < m_tx_width; i++) {
+                agg.m_tx.m_inputs.push_back(next_hash());
+                agg.m_tx.m_uhs_outputs.push_back(next_hash());
+            }
+            agg.m_tx.m_id = next_hash();
+        }
+        // Every transaction is accepted, so there are no errors to return
+        EXPECT_EQ(
+            commit(cbdc::atomizer::state_machine::request{std::move(notify)}),
+            nullptr);
+        EXPECT_NE(commit(cbdc::atomizer::state_machine::request{
+                      cbdc::atomizer::make_block_request{}}),
+                  nullptr);
+        m_height++;
+        return m_log_idx;
+    }
+
+    auto commit(const cbdc::atomizer::state_machine::request& req)
+        -> nuraft::ptr<nuraft::buffer> {
+        auto buf = cbdc::make_buffer<cbdc::atomizer::state_machine::request,
+                                     nuraft::ptr<nuraft::buffer>>(req);
+        return m_src->commit(++m_log_idx, *buf);
+    }
+
+    auto next_hash() -> cbdc::hash_t {
+        auto ret = cbdc::hash_t();
+        m_hash_count++;
+        std::memcpy(ret.data(), &m_hash_count, sizeof(m_hash_count));
+        return ret;
+    }
+
+    void create_snapshot(uint64_t log_idx) {
+        auto snp = nuraft::snapshot(log_idx,
+                                    1,
+                                    nuraft::cs_new<nuraft::cluster_config>());
+        auto done = false;
+        nuraft::async_result<bool>::handler_type when_done
+            = [&](bool& ret, nuraft::ptr<std::exception>& /* err */) {
+                  done = ret;
+              };
+        m_src->create_snapshot(snp, when_done);
+        ASSERT_TRUE(done);
+    }
+
+    /// Reads every object of the snapshot at the given index from the
+    /// source state machine, starting from the given object.
+    auto read_objs(uint64_t log_idx, uint64_t first_obj = 0)
+        -> std::vector<nuraft::ptr<nuraft::buffer>> {
+        auto snp = nuraft::snapshot(log_idx,
+                                    1,
+                                    nuraft::cs_new<nuraft::cluster_config>());
+        auto objs = std::vector<nuraft::ptr<nuraft::buffer>>();
+        void* ctx = nullptr;
+        auto is_last = false;
+        for(auto obj_id = first_obj; !is_last; obj_id++) {
+            auto data = nuraft::ptr<nuraft::buffer>();
+            if(m_src->read_logical_snp_obj(snp, ctx, obj_id, data, is_last)
+               != 0) {
+                break;
+            }
+            objs.push_back(std::move(data));
+        }
+        m_src->free_user_snp_ctx(ctx);
+        return objs;
+    }
+
+    static auto equal(const nuraft::buffer& a, const nuraft::buffer& b)
+        -> bool {
+        return a.size() == b.size()
+            && std::memcmp(a.data_begin(), b.data_begin(), a.size()) == 0;
+    }
+
+    static constexpr auto m_src_snps = "atomizer_sm_test_src_snps";
+    static constexpr auto m_src_blocks = "atomizer_sm_test_src_blocks";
+    static constexpr auto m_dst_snps = "atomizer_sm_test_dst_snps";
+    static constexpr auto m_dst_blocks = "atomizer_sm_test_dst_blocks";
+    static constexpr size_t m_stxo_cache_depth{2};
+    static constexpr size_t m_block_memory{1024 * 1024};
+    static constexpr size_t m_txs_per_block{10000};
+    static constexpr size_t m_tx_width{4};
+
+    std::shared_ptr<cbdc::atomizer::state_machine> m_src;
+    std::shared_ptr<cbdc::atomizer::state_machine> m_dst;
+    uint64_t m_log_idx{0};
+    uint64_t m_height{0};
+    uint64_t m_hash_count{0};
+};
+
+TEST_F(atomizer_state_machine_test, chunked_delta_transfer) {
+    // Blocks loaded from the snapshot must all spill to disk.
+    m_dst.reset();
+    m_dst = make_sm(m_dst_snps, m_dst_blocks, 1);
+
+    // A base snapshot followed by a delta, which the transfer rewrites as a
+    // base image split across several objects.
+    commit_make_block();
+    create_snapshot(commit_make_block());
+    const auto log_idx = commit_make_block();
+    create_snapshot(log_idx);
+
+    auto objs = read_objs(log_idx);
+    ASSERT_GT(objs.size(), 2UL);
+    for(size_t i = 0; i + 1 < objs.size(); i++) {
+        ASSERT_EQ(objs[i]->size(), objs[0]->size());
+    }
+    ASSERT_LE(objs.back()->size(), objs[0]->size());
+
+    // A resumed transfer starts from a later object with a new context.
+    auto resumed = read_objs(log_idx, 1);
+    ASSERT_EQ(resumed.size(), objs.size() - 1);
+    for(size_t i = 0; i < resumed.size(); i++) {
+        ASSERT_TRUE(equal(*resumed[i], *objs[i + 1]));
+    }
+
+    auto snp = nuraft::snapshot(log_idx,
+                                1,
+                                nuraft::cs_new<nuraft::cluster_config>());
+    void* ctx = nullptr;
+    auto data = nuraft::ptr<nuraft::buffer>();
+    auto is_last = false;
+    const auto past_end = objs.size();
+    ASSERT_NE(m_src->read_logical_snp_obj(snp, ctx, past_end, data, is_last),
+              0);
+    m_src->free_user_snp_ctx(ctx);
+
+    // Save in order
+    for(size_t i = 0; i < objs.size(); i++) {
+        nuraft::ulong obj_id = i;
+        m_dst->save_logical_snp_obj(snp,
+                                    obj_id,
+                                    *objs[i],
+                                    i == 0,
+                                    i + 1 == objs.size());
+        ASSERT_EQ(obj_id, i + 1);
+    }
+    ASSERT_TRUE(m_dst->apply_snapshot(snp));
+    ASSERT_EQ(m_dst->last_commit_index(), log_idx);
+    for(uint64_t height = 1; height <= 3; height++) {
+        ASSERT_NE(m_dst->get_serialized_block(height), nullptr);
+    }
+    auto stats = m_dst->block_retention_stats();
+    ASSERT_EQ(stats.m_blocks, 3UL);
+    ASSERT_EQ(stats.m_memory_bytes, 0UL);
+    ASSERT_GT(stats.m_disk_bytes, 0UL);
+}
+
+TEST_F(atomizer_state_machine_test, out_of_order_and_missing_objects) {
+    commit_make_block();
+    const auto log_idx = commit_make_block();
+    create_snapshot(log_idx);
+
+    auto objs = read_objs(log_idx);
+    ASSERT_GT(objs.size(), 2UL);
+    const auto last = objs.size() - 1;
+    auto snp = nuraft::snapshot(log_idx,
+                                1,
+                                nuraft::cs_new<nuraft::cluster_config>());
+
+    // Send every object but the first, last one first.
+    nuraft::ulong obj_id = last;
+    m_dst->save_logical_snp_obj(snp, obj_id, *objs[last], false, true);
+    ASSERT_EQ(obj_id, 0UL);
+    for(size_t i = 1; i < last; i++) {
+        obj_id = i;
+        m_dst->save_logical_snp_obj(snp, obj_id, *objs[i], false, false);
+        ASSERT_EQ(obj_id, 0UL);
+    }
+
+    // The snapshot is not published while an object is missing.
+    ASSERT_FALSE(m_dst->apply_snapshot(snp));
+
+    obj_id = 0;
+    m_dst->save_logical_snp_obj(snp, obj_id, *objs[0], true, false);
+    ASSERT_EQ(obj_id, objs.size());
+    ASSERT_TRUE(m_dst->apply_snapshot(snp));
+    ASSERT_EQ(m_dst->last_commit_index(), log_idx);
+    ASSERT_NE(m_dst->get_serialized_block(2), nullptr);
+
+    // Objects of a different snapshot restart the transfer.
+    const auto next_idx = commit_make_block();
+    create_snapshot(next_idx);
+    auto next_objs = read_objs(next_idx);
+    auto next_snp = nuraft::snapshot(next_idx,
+                                     1,
+                                     nuraft::cs_new<nuraft::cluster_config>());
+    obj_id = 1;
+    m_dst->save_logical_snp_obj(next_snp,
+                                obj_id,
+                                *next_objs[1],
+                                false,
+                                false);
+    ASSERT_EQ(obj_id, 0UL);
+}
+
+TEST_F(atomizer_state_machine_test, last_snapshot_after_restart) {
+    ASSERT_EQ(m_src->last_snapshot(), nullptr);
+
+    // A base snapshot followed by a delta
+    create_snapshot(commit_make_block());
+    const auto log_idx = commit_make_block();
+    create_snapshot(log_idx);
+    auto snp = m_src->last_snapshot();
+    ASSERT_NE(snp, nullptr);
+    ASSERT_EQ(snp->get_last_log_idx(), log_idx);
+
+    // The restarted state machine restores the newest snapshot and reports
+    // its metadata
+    m_src.reset();
+    m_src = make_sm(m_src_snps, m_src_blocks);
+    snp = m_src->last_snapshot();
+    ASSERT_NE(snp, nullptr);
+    ASSERT_EQ(snp->get_last_log_idx(), log_idx);
+    ASSERT_EQ(m_src->last_commit_index(), log_idx);
+    ASSERT_NE(m_src->get_serialized_block(2), nullptr);
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/stxo_cache.hpp"
+#include "util/serialization/buffer_serializer.hpp"
+#include "util/serialization/format.hpp"
+
+#include <gtest/gtest.h>
+
+class stxo_cache_test : public ::testing::Test {
+  protected:
+    static auto make_id(uint64_t n) -> cbdc::hash_t {
+        auto id = cbdc::hash_t();
+        std::memcpy(id.data(), &n, sizeof(n));
+        return id;
+    }
+
+    cbdc::atomizer::stxo_cache m_cache{};
+};
+
+TEST_F(stxo_cache_test, find_inserted) {
+    m_cache.insert({'a'}, 3);
+    m_cache.insert({'b'}, 4);
+    ASSERT_EQ(m_cache.find({'a'}), 3UL);
+    ASSERT_EQ(m_cache.find({'b'}), 4UL);
+    ASSERT_FALSE(m_cache.find({'c'}).has_value());
+    ASSERT_EQ(m_cache.size(), 2UL);
+
+    m_cache.insert({'a'}, 5);
+    ASSERT_EQ(m_cache.find({'a'}), 5UL);
+    ASSERT_EQ(m_cache.size(), 2UL);
+}
+
+TEST_F(stxo_cache_test, evict_below) {
+    m_cache.insert({'a'}, 1);
+    m_cache.insert({'b'}, 2);
+    m_cache.insert({'c'}, 3);
+
+    m_cache.evict_below(3);
+    ASSERT_FALSE(m_cache.find({'a'}).has_value());
+    ASSERT_FALSE(m_cache.find({'b'}).has_value());
+    ASSERT_EQ(m_cache.find({'c'}), 3UL);
+    ASSERT_EQ(m_cache.size(), 1UL);
+
+    // Evicted IDs can be spent again at a newer height.
+    m_cache.insert({'a'}, 4);
+    ASSERT_EQ(m_cache.find({'a'}), 4UL);
+    ASSERT_EQ(m_cache.size(), 2UL);
+}
+
+TEST_F(stxo_cache_test, rotate_many_heights) {
+    static constexpr uint64_t n_heights = 50;
+    static constexpr uint64_t ids_per_height = 1000;
+    static constexpr uint64_t depth = 3;
+    for(uint64_t h = 0; h < n_heights; h++) {
+        for(uint64_t i = 0; i < ids_per_height; i++) {
+            m_cache.insert(make_id(h * ids_per_height + i), h);
+        }
+        if(h >= depth) {
+            m_cache.evict_below(h - depth);
+        }
+    }
+
+    ASSERT_EQ(m_cache.size(), (depth + 1) * ids_per_height);
+    for(uint64_t h = 0; h < n_heights; h++) {
+        for(uint64_t i = 0; i < ids_per_height; i++) {
+            auto res = m_cache.find(make_id(h * ids_per_height + i));
+            if(h + depth + 1 < n_heights) {
+                ASSERT_FALSE(res.has_value());
+            } else {
+                ASSERT_EQ(res, h);
+            }
+        }
+    }
+}
+
+TEST_F(stxo_cache_test, serialization) {
+    m_cache.insert({'a'}, 1);
+    m_cache.insert({'b'}, 2);
+    m_cache.insert({'c'}, 3);
+    m_cache.evict_below(2);
+
+    auto buf = cbdc::buffer();
+    auto ser = cbdc::buffer_serializer(buf);
+    ASSERT_TRUE(ser << m_cache);
+
+    auto deser = cbdc::buffer_serializer(buf);
+    auto other = cbdc::atomizer::stxo_cache();
+    other.insert({'d'}, 0);
+    ASSERT_TRUE(deser >> other);
+    ASSERT_EQ(m_cache, other);
+    ASSERT_EQ(other.min_height(), 2UL);
+    ASSERT_FALSE(other.find({'d'}).has_value());
+}
+
+TEST_F(stxo_cache_test, filter_stats) {
+    static constexpr uint64_t n_ids = 1000;
+    for(uint64_t i = 0; i < n_ids; i++) {
+        m_cache.insert(make_id(i), 1);
+    }
+    for(uint64_t i = 0; i < n_ids * 2; i++) {
+        auto res = m_cache.find(make_id(i));
+        ASSERT_EQ(res.has_value(), i < n_ids);
+    }
+
+    const auto& stats = m_cache.stats();
+    ASSERT_EQ(stats.m_queries, n_ids * 2);
+    ASSERT_EQ(stats.m_filtered + stats.m_false_positives, n_ids);
+    ASSERT_LT(stats.m_false_positives, n_ids / 10);
+
+    // Evicted heights no longer pass the filter.
+    const auto filtered = stats.m_filtered;
+    m_cache.evict_below(2);
+    ASSERT_FALSE(m_cache.find(make_id(0)).has_value());
+    ASSERT_EQ(m_cache.stats().m_filtered, filtered + 1);
+}
+
+TEST_F(stxo_cache_test, filter_grows_past_capacity) {
+    // Rotate many more IDs through a small filter than it is sized for, and
+    // check that it keeps rejecting unspent IDs.
+    static constexpr size_t filter_capacity = 64;
+    static constexpr uint64_t ids_per_height = 1000;
+    static constexpr uint64_t depth = 4;
+    static constexpr uint64_t n_heights = 20;
+    auto cache = cbdc::atomizer::stxo_cache(filter_capacity);
+    for(uint64_t height = 0; height < n_heights; height++) {
+        if(height >= depth) {
+            cache.evict_below(height - depth + 1);
+        }
+        for(uint64_t i = 0; i < ids_per_height; i++) {
+            cache.insert(make_id(height * ids_per_height + i), height);
+        }
+    }
+    ASSERT_EQ(cache.size(), depth * ids_per_height);
+
+    static constexpr uint64_t n_queries = 10000;
+    const auto unspent_base = n_heights * ids_per_height;
+    for(uint64_t i = 0; i < n_queries; i++) {
+        ASSERT_FALSE(cache.find(make_id(unspent_base + i)).has_value());
+    }
+    ASSERT_LT(cache.stats().m_false_positives, n_queries / 100);
+
+    // Evicted IDs are not reported, whether or not they pass the filter.
+    ASSERT_FALSE(cache.find(make_id(0)).has_value());
+    ASSERT_EQ(cache.find(make_id(unspent_base - 1)), n_heights - 1);
+
+    cache.set_filter_capacity(0);
+    ASSERT_EQ(cache.find(make_id(unspent_base - 1)), n_heights - 1);
+    ASSERT_FALSE(cache.find(make_id(unspent_base)).has_value());
+}
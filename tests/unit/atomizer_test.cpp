@@ -4,7 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "uhs/atomizer/atomizer/atomizer.hpp"
+#include "uhs/transaction/messages.hpp"
 #include "util.hpp"
+#include "util/serialization/util.hpp"
 
 #include <gtest/gtest.h>
 
@@ -150,3 +152,178 @@ TEST_F(atomizer_test, err_incomplete) {
 
     verify_serialization();
 }
+
+TEST_F(atomizer_test, stxo_cache_range) {
+    auto tx0 = cbdc::test::simple_tx({'a'}, {{'B'}}, {{'c'}});
+    auto err = m_atomizer->insert(0, tx0, {0});
+    ASSERT_FALSE(err.has_value());
+    auto errs = m_atomizer->make_block().second;
+    ASSERT_TRUE(errs.empty());
+    errs = m_atomizer->make_block().second;
+    ASSERT_TRUE(errs.empty());
+
+    // Attestations from after the spend are covered by the shard's UHS so
+    // the atomizer does not report the input as spent.
+    auto tx1 = cbdc::test::simple_tx({'d'}, {{'B'}}, {{'e'}});
+    err = m_atomizer->insert(2, tx1, {0});
+    ASSERT_FALSE(err.has_value());
+
+    // Attestations from the height of the spend must be rejected.
+    auto tx2 = cbdc::test::simple_tx({'F'}, {{'B'}}, {{'g'}});
+    err = m_atomizer->insert(0, tx2, {0});
+    auto want = cbdc::watchtower::tx_error{
+        {'F'},
+        cbdc::watchtower::tx_error_inputs_spent{{{'B'}}}};
+    ASSERT_TRUE(err.has_value());
+    ASSERT_EQ(err.value(), want);
+
+    verify_serialization();
+}
+
+TEST_F(atomizer_test, merge_attestations_across_rotations) {
+    // Rotate the generation ring past its size so the notifications below
+    // land in reused slots.
+    static constexpr auto n_rotations = 5;
+    for(int i{0}; i < n_rotations; i++) {
+        auto errs = m_atomizer->make_block().second;
+        ASSERT_TRUE(errs.empty());
+    }
+
+    auto tx = cbdc::test::simple_tx({'A'}, {{'b'}, {'c'}}, {{'d'}});
+    auto err = m_atomizer->insert(n_rotations, tx, {0});
+    ASSERT_FALSE(err.has_value());
+    auto errs = m_atomizer->make_block().second;
+    ASSERT_TRUE(errs.empty());
+    errs = m_atomizer->make_block().second;
+    ASSERT_TRUE(errs.empty());
+
+    err = m_atomizer->insert(n_rotations + 2, tx, {1});
+    ASSERT_FALSE(err.has_value());
+    ASSERT_EQ(m_atomizer->pending_transactions(), 1UL);
+
+    verify_serialization();
+
+    auto [blk, blk_errs] = m_atomizer->make_block();
+    ASSERT_TRUE(blk_errs.empty());
+    ASSERT_EQ(blk.m_transactions.size(), 1UL);
+    ASSERT_EQ(blk.m_transactions[0], tx);
+
+    // Nothing remains pending in any generation.
+    for(int i{0}; i < n_rotations; i++) {
+        errs = m_atomizer->make_block().second;
+        ASSERT_TRUE(errs.empty());
+    }
+}
+
+TEST_F(atomizer_test, parallel_batch_matches_sequential) {
+    static constexpr auto n_blocks = 5;
+    static constexpr auto n_txs = 1000;
+    static constexpr auto n_uhs_ids = 4000;
+    static constexpr auto max_inputs = 3;
+    static constexpr auto max_offset = 3;
+    static constexpr auto n_threads = 4;
+    static constexpr auto stxo_cache_depth = 2;
+
+    auto make_id = [](uint64_t n) {
+        auto id = cbdc::hash_t();
+        std::memcpy(id.data(), &n, sizeof(n));
+        return id;
+    };
+
+    auto engine = std::default_random_engine();
+    auto id_dist = std::uniform_int_distribution<uint64_t>(0, n_uhs_ids - 1);
+    auto input_dist = std::uniform_int_distribution<size_t>(1, max_inputs);
+    auto offset_dist = std::uniform_int_distribution<uint64_t>(0, max_offset);
+
+    auto seq = std::make_unique<cbdc::atomizer::atomizer>(0, stxo_cache_depth);
+    auto par = std::make_unique<cbdc::atomizer::atomizer>(0, stxo_cache_depth);
+    uint64_t tx_count{n_uhs_ids};
+    for(int b{0}; b < n_blocks; b++) {
+        auto batch = std::vector<cbdc::atomizer::aggregate_tx_notification>();
+        for(int i{0}; i < n_txs; i++) {
+            auto msg = cbdc::atomizer::aggregate_tx_notification();
+            msg.m_tx.m_id = make_id(tx_count++);
+            auto n_inputs = input_dist(engine);
+            for(size_t j{0}; j < n_inputs; j++) {
+                msg.m_tx.m_inputs.push_back(make_id(id_dist(engine)));
+            }
+            msg.m_oldest_attestation
+                = seq->height() - std::min(seq->height(), offset_dist(engine));
+            batch.push_back(std::move(msg));
+        }
+
+        auto seq_errs = seq->insert_complete_batch(
+            std::vector<cbdc::atomizer::aggregate_tx_notification>(batch),
+            1);
+        auto par_errs = par->insert_complete_batch(std::move(batch),
+                                                   n_threads);
+        ASSERT_FALSE(seq_errs.empty());
+        ASSERT_EQ(seq_errs, par_errs);
+        ASSERT_EQ(*seq, *par);
+
+        auto [seq_blk, seq_blk_errs] = seq->make_block();
+        auto [par_blk, par_blk_errs] = par->make_block();
+        ASSERT_EQ(seq_blk, par_blk);
+        ASSERT_EQ(seq_blk_errs, par_blk_errs);
+    }
+}
+
+TEST_F(atomizer_test, delta_roundtrip) {
+    auto base = m_atomizer->serialize();
+    m_atomizer->clear_delta();
+
+    auto tx0 = cbdc::test::simple_tx({'a'}, {{'b'}}, {{'c'}});
+    auto err = m_atomizer->insert(0, tx0, {0});
+    ASSERT_FALSE(err.has_value());
+    auto tx1 = cbdc::test::simple_tx({'d'}, {{'e'}, {'f'}}, {{'g'}});
+    err = m_atomizer->insert(0, tx1, {0, 1});
+    ASSERT_FALSE(err.has_value());
+    for(int i{0}; i < 4; i++) {
+        auto errs = m_atomizer->make_block().second;
+        ASSERT_TRUE(errs.empty());
+    }
+    auto tx2 = cbdc::test::simple_tx({'h'}, {{'i'}}, {{'j'}});
+    err = m_atomizer->insert(4, tx2, {0});
+    ASSERT_FALSE(err.has_value());
+
+    auto delta = m_atomizer->serialize_delta();
+
+    auto restored = std::make_unique<cbdc::atomizer::atomizer>(0, 0);
+    auto base_view = cbdc::buffer_serializer(base);
+    restored->deserialize(base_view);
+    auto delta_view = cbdc::buffer_serializer(delta);
+    restored->apply_delta(delta_view);
+    ASSERT_TRUE(delta_view);
+    ASSERT_EQ(*m_atomizer, *restored);
+
+    // Spends that fell out of the cache while the delta was being
+    // accumulated are not replayed.
+    auto tx3 = cbdc::test::simple_tx({'k'}, {{'b'}}, {{'l'}});
+    ASSERT_EQ(m_atomizer->insert(4, tx3, {0}),
+              restored->insert(4, tx3, {0}));
+}
+
+TEST_F(atomizer_test, pending_bytes) {
+    ASSERT_EQ(m_atomizer->pending_bytes(), 0UL);
+
+    const cbdc::transaction::compact_tx tx0
+        = cbdc::test::simple_tx({'a'}, {{'b'}}, {{'c'}});
+    const cbdc::transaction::compact_tx tx1
+        = cbdc::test::simple_tx({'d'}, {{'e'}, {'f'}}, {{'g'}});
+    ASSERT_FALSE(m_atomizer->insert(0, tx0, {0}).has_value());
+    ASSERT_FALSE(m_atomizer->insert(0, tx1, {0}).has_value());
+    ASSERT_EQ(m_atomizer->pending_bytes(), cbdc::serialized_size(tx0));
+    ASSERT_FALSE(m_atomizer->insert(0, tx1, {1}).has_value());
+    const auto want = cbdc::serialized_size(tx0) + cbdc::serialized_size(tx1);
+    ASSERT_EQ(m_atomizer->pending_bytes(), want);
+
+    auto restored = std::make_unique<cbdc::atomizer::atomizer>(0, 0);
+    auto ser = m_atomizer->serialize();
+    auto ser_view = cbdc::buffer_serializer(ser);
+    restored->deserialize(ser_view);
+    ASSERT_EQ(restored->pending_bytes(), want);
+
+    auto [blk, errs] = m_atomizer->make_block();
+    ASSERT_EQ(blk.m_transactions.size(), 2UL);
+    ASSERT_EQ(m_atomizer->pending_bytes(), 0UL);
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/blocked_bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+
+class blocked_bloom_filter_test : public ::testing::Test {
+  protected:
+    static constexpr size_t m_capacity{10000};
+
+    cbdc::blocked_bloom_filter m_filter{m_capacity};
+    std::mt19937_64 m_engine{};
+};
+
+TEST_F(blocked_bloom_filter_test, no_false_negatives) {
+    auto keys = std::vector<uint64_t>(m_capacity);
+    for(auto& k : keys) {
+        k = m_engine();
+        m_filter.insert(k);
+    }
+    ASSERT_EQ(m_filter.size(), m_capacity);
+    for(const auto& k : keys) {
+        ASSERT_TRUE(m_filter.maybe_contains(k));
+    }
+}
+
+TEST_F(blocked_bloom_filter_test, false_positive_rate) {
+    for(size_t i = 0; i < m_capacity; i++) {
+        m_filter.insert(m_engine());
+    }
+
+    static constexpr size_t n_queries{100000};
+    static constexpr double max_fp_rate{0.01};
+    size_t false_positives{0};
+    for(size_t i = 0; i < n_queries; i++) {
+        if(m_filter.maybe_contains(m_engine())) {
+            false_positives++;
+        }
+    }
+    ASSERT_LT(static_cast<double>(false_positives) / n_queries, max_fp_rate);
+}
+
+TEST_F(blocked_bloom_filter_test, clear) {
+    auto key = m_engine();
+    m_filter.insert(key);
+    ASSERT_TRUE(m_filter.maybe_contains(key));
+    m_filter.clear();
+    ASSERT_FALSE(m_filter.maybe_contains(key));
+    ASSERT_EQ(m_filter.size(), 0UL);
+}
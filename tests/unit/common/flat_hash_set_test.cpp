@@ -0,0 +1,137 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/flat_hash_set.hpp"
+#include "util/common/hashmap.hpp"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_set>
+
+class flat_hash_set_test : public ::testing::Test {
+  protected:
+    auto make_key() -> cbdc::hash_t {
+        auto key = cbdc::hash_t();
+        for(size_t i = 0; i < key.size(); i += sizeof(uint64_t)) {
+            auto val = m_engine();
+            std::memcpy(&key[i], &val, sizeof(val));
+        }
+        return key;
+    }
+
+    cbdc::flat_hash_set m_set{};
+    std::mt19937_64 m_engine{};
+};
+
+TEST_F(flat_hash_set_test, insert_erase) {
+    auto key = make_key();
+    ASSERT_FALSE(m_set.contains(key));
+    ASSERT_FALSE(m_set.erase(key));
+
+    ASSERT_TRUE(m_set.insert(key));
+    ASSERT_FALSE(m_set.insert(key));
+    ASSERT_TRUE(m_set.contains(key));
+    ASSERT_EQ(m_set.size(), 1UL);
+
+    ASSERT_TRUE(m_set.erase(key));
+    ASSERT_FALSE(m_set.contains(key));
+    ASSERT_EQ(m_set.size(), 0UL);
+}
+
+TEST_F(flat_hash_set_test, matches_unordered_set) {
+    // Keys sharing their slot-selecting prefix exercise long probe
+    // sequences and tombstones within them
+    auto keys = std::vector<cbdc::hash_t>();
+    for(size_t i = 0; i < 1000; i++) {
+        auto key = make_key();
+        if(i % 4 == 0) {
+            std::memset(key.data(), 0, sizeof(uint64_t));
+        }
+        keys.push_back(key);
+    }
+
+    auto want = std::unordered_set<cbdc::hash_t, cbdc::hashing::null>();
+    for(size_t i = 0; i < 100000; i++) {
+        const auto& key = keys[m_engine() % keys.size()];
+        if(m_engine() % 2 == 0) {
+            ASSERT_EQ(m_set.insert(key), want.insert(key).second);
+        } else {
+            ASSERT_EQ(m_set.erase(key), want.erase(key) == 1);
+        }
+        ASSERT_EQ(m_set.size(), want.size());
+    }
+
+    for(const auto& key : keys) {
+        ASSERT_EQ(m_set.contains(key), want.count(key) == 1);
+    }
+
+    auto got = std::unordered_set<cbdc::hash_t, cbdc::hashing::null>();
+    m_set.for_each([&](const cbdc::hash_t& key) {
+        got.insert(key);
+    });
+    ASSERT_EQ(got, want);
+}
+
+TEST_F(flat_hash_set_test, shared_first_byte) {
+    // Keys of one shard share their first byte. Every other key also
+    // shares its slot-selecting bytes with the key before it.
+    static constexpr size_t n_keys{20000};
+    static constexpr uint8_t shard_prefix{0x2a};
+    auto keys = std::vector<cbdc::hash_t>();
+    for(size_t i = 0; i < n_keys; i++) {
+        auto key = make_key();
+        key[0] = shard_prefix;
+        if(i % 2 == 0 && !keys.empty()) {
+            std::memcpy(key.data(), keys.back().data(), sizeof(uint64_t));
+        }
+        keys.push_back(key);
+        ASSERT_TRUE(m_set.insert(key));
+    }
+    ASSERT_EQ(m_set.size(), n_keys);
+
+    for(size_t i = 0; i < n_keys; i += 2) {
+        ASSERT_TRUE(m_set.erase(keys[i]));
+    }
+    for(size_t i = 0; i < n_keys; i++) {
+        ASSERT_EQ(m_set.contains(keys[i]), i % 2 == 1);
+        auto other = keys[i];
+        other[0] = shard_prefix + 1;
+        ASSERT_FALSE(m_set.contains(other));
+    }
+}
+
+TEST_F(flat_hash_set_test, clear) {
+    static constexpr size_t n_keys{10000};
+    m_set.reserve(n_keys);
+    auto keys = std::vector<cbdc::hash_t>(n_keys);
+    for(auto& key : keys) {
+        key = make_key();
+        ASSERT_TRUE(m_set.insert(key));
+    }
+    const auto usage = m_set.memory_usage();
+    ASSERT_GE(usage, n_keys * (sizeof(cbdc::hash_t) + 1));
+    m_set.clear();
+    ASSERT_EQ(m_set.size(), 0UL);
+    ASSERT_EQ(m_set.memory_usage(), usage);
+    for(const auto& key : keys) {
+        ASSERT_FALSE(m_set.contains(key));
+    }
+}
+
+TEST_F(flat_hash_set_test, reserve_close_to_capacity) {
+    static constexpr size_t n_keys{100000};
+    m_set.reserve(n_keys);
+    const auto usage = m_set.memory_usage();
+    // At most the slots needed at the maximum load factor, plus rounding
+    static constexpr size_t slot_size{sizeof(cbdc::hash_t) + 1};
+    ASSERT_LE(usage, (n_keys + n_keys / 3 + 8) * slot_size);
+
+    for(size_t i{0}; i < n_keys; i++) {
+        ASSERT_TRUE(m_set.insert(make_key()));
+    }
+    ASSERT_EQ(m_set.size(), n_keys);
+    ASSERT_EQ(m_set.memory_usage(), usage);
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/mapped_file.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+class mapped_file_test : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        auto ss = std::ofstream(m_path, std::ios::out | std::ios::trunc);
+        ss << m_contents;
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(m_path);
+    }
+
+    static constexpr auto m_path = "mapped_file_test.dat";
+    std::string m_contents{"snapshot contents"};
+};
+
+TEST_F(mapped_file_test, open_and_read) {
+    auto file = cbdc::mapped_file();
+    ASSERT_TRUE(file.open(m_path));
+    ASSERT_EQ(file.size(), m_contents.size());
+    ASSERT_EQ(std::memcmp(file.data(), m_contents.data(), file.size()), 0);
+
+    file.close();
+    ASSERT_EQ(file.size(), 0UL);
+    ASSERT_EQ(file.data(), nullptr);
+}
+
+TEST_F(mapped_file_test, open_missing) {
+    auto file = cbdc::mapped_file();
+    ASSERT_FALSE(file.open("mapped_file_test_missing.dat"));
+    ASSERT_EQ(file.size(), 0UL);
+}
+
+TEST_F(mapped_file_test, survives_remove_and_move) {
+    auto file = cbdc::mapped_file();
+    ASSERT_TRUE(file.open(m_path));
+    std::filesystem::remove(m_path);
+
+    auto moved = std::move(file);
+    ASSERT_EQ(moved.size(), m_contents.size());
+    ASSERT_EQ(std::memcmp(moved.data(), m_contents.data(), moved.size()), 0);
+}
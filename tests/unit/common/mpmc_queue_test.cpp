@@ -0,0 +1,132 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/mpmc_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <numeric>
+#include <thread>
+
+TEST(mpmc_queue_test, fifo) {
+    auto q = cbdc::mpmc_queue<uint64_t>(8);
+    ASSERT_EQ(q.capacity(), 8UL);
+    for(uint64_t i = 0; i < 5; i++) {
+        ASSERT_TRUE(q.push(i));
+    }
+    ASSERT_EQ(q.size(), 5UL);
+    for(uint64_t i = 0; i < 5; i++) {
+        uint64_t val{};
+        ASSERT_TRUE(q.pop(val));
+        ASSERT_EQ(val, i);
+    }
+    uint64_t val{};
+    ASSERT_FALSE(q.try_pop(val));
+}
+
+TEST(mpmc_queue_test, backpressure) {
+    auto q = cbdc::mpmc_queue<std::unique_ptr<uint64_t>>(4);
+    for(uint64_t i = 0; i < 4; i++) {
+        ASSERT_TRUE(q.try_push(std::make_unique<uint64_t>(i)));
+    }
+    auto item = std::make_unique<uint64_t>(4);
+    ASSERT_FALSE(q.try_push(std::move(item)));
+    // A rejected push leaves the item with the caller.
+    ASSERT_NE(item, nullptr);
+
+    auto out = std::unique_ptr<uint64_t>();
+    ASSERT_TRUE(q.try_pop(out));
+    ASSERT_EQ(*out, 0UL);
+    ASSERT_TRUE(q.try_push(std::move(item)));
+}
+
+TEST(mpmc_queue_test, pop_batch) {
+    auto q = cbdc::mpmc_queue<uint64_t>(16);
+    for(uint64_t i = 0; i < 10; i++) {
+        ASSERT_TRUE(q.push(i));
+    }
+    auto items = std::vector<uint64_t>();
+    ASSERT_EQ(q.pop_batch(items, 4), 4UL);
+    ASSERT_EQ(q.pop_batch(items, 100), 6UL);
+    auto expected = std::vector<uint64_t>(10);
+    std::iota(expected.begin(), expected.end(), 0);
+    ASSERT_EQ(items, expected);
+}
+
+TEST(mpmc_queue_test, clear_unblocks) {
+    auto q = cbdc::mpmc_queue<uint64_t>(2, 1);
+    auto consumer = std::thread([&]() {
+        uint64_t val{};
+        ASSERT_FALSE(q.pop(val));
+        auto items = std::vector<uint64_t>();
+        ASSERT_EQ(q.pop_batch(items, 4), 0UL);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.clear();
+    consumer.join();
+
+    ASSERT_TRUE(q.push(1UL));
+    ASSERT_TRUE(q.push(2UL));
+    auto producer = std::thread([&]() {
+        ASSERT_FALSE(q.push(3UL));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.clear();
+    producer.join();
+    ASSERT_EQ(q.size(), 0UL);
+
+    q.reset();
+    ASSERT_TRUE(q.push(4UL));
+    uint64_t val{};
+    ASSERT_TRUE(q.pop(val));
+    ASSERT_EQ(val, 4UL);
+}
+
+TEST(mpmc_queue_test, concurrent) {
+    static constexpr uint64_t n_threads = 4;
+    static constexpr uint64_t n_items = 100000;
+    auto q = cbdc::mpmc_queue<uint64_t>(64);
+
+    auto producers = std::vector<std::thread>();
+    for(uint64_t t = 0; t < n_threads; t++) {
+        producers.emplace_back([&, t]() {
+            for(uint64_t i = 0; i < n_items; i++) {
+                ASSERT_TRUE(q.push(t * n_items + i + 1));
+            }
+        });
+    }
+
+    auto sums = std::vector<uint64_t>(n_threads);
+    auto counts = std::vector<uint64_t>(n_threads);
+    auto consumers = std::vector<std::thread>();
+    for(uint64_t t = 0; t < n_threads; t++) {
+        consumers.emplace_back([&, t]() {
+            auto items = std::vector<uint64_t>();
+            while(q.pop_batch(items, 16) > 0) {
+                for(auto v : items) {
+                    sums[t] += v;
+                    counts[t]++;
+                }
+                items.clear();
+            }
+        });
+    }
+
+    for(auto& t : producers) {
+        t.join();
+    }
+    while(q.size() > 0) {
+        std::this_thread::yield();
+    }
+    q.clear();
+    for(auto& t : consumers) {
+        t.join();
+    }
+
+    const auto total = n_threads * n_items;
+    ASSERT_EQ(std::accumulate(counts.begin(), counts.end(), uint64_t{0}),
+              total);
+    ASSERT_EQ(std::accumulate(sums.begin(), sums.end(), uint64_t{0}),
+              total * (total + 1) / 2);
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/routing_table.hpp"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+
+class routing_table_test : public ::testing::Test {
+  protected:
+    auto make_key() -> cbdc::hash_t {
+        auto key = cbdc::hash_t();
+        for(size_t i = 0; i < key.size(); i += sizeof(uint64_t)) {
+            auto val = m_engine();
+            std::memcpy(&key[i], &val, sizeof(val));
+        }
+        return key;
+    }
+
+    static auto make_prefix_key(uint32_t prefix) -> cbdc::hash_t {
+        auto key = cbdc::hash_t();
+        for(size_t i = 0; i < sizeof(prefix); i++) {
+            key[i] = static_cast<uint8_t>(prefix >> (24 - 8 * i));
+        }
+        return key;
+    }
+
+    // Checks the table against a linear scan of the ranges
+    void check_routes(const std::vector<cbdc::config::shard_range_t>& ranges,
+                      size_t n) {
+        auto table = cbdc::config::routing_table(ranges);
+        ASSERT_EQ(table.shard_count(), ranges.size());
+        for(size_t i = 0; i < n; i++) {
+            auto key = make_key();
+            auto expected = std::vector<size_t>();
+            for(size_t j = 0; j < ranges.size(); j++) {
+                if(cbdc::config::hash_in_shard_range(ranges[j], key)) {
+                    expected.push_back(j);
+                }
+            }
+            ASSERT_EQ(table.shards_for(key), expected);
+        }
+    }
+
+    std::mt19937_64 m_engine{};
+};
+
+TEST_F(routing_table_test, hash_prefix) {
+    auto key = make_prefix_key(0xa1b2c3d4);
+    EXPECT_EQ(cbdc::config::hash_prefix(key, 8), 0xa1U);
+    EXPECT_EQ(cbdc::config::hash_prefix(key, 12), 0xa1bU);
+    EXPECT_EQ(cbdc::config::hash_prefix(key, 16), 0xa1b2U);
+    EXPECT_EQ(cbdc::config::hash_prefix(key, 32), 0xa1b2c3d4U);
+}
+
+TEST_F(routing_table_test, byte_ranges) {
+    check_routes({{0, 63}, {64, 127}, {128, 191}, {192, 255}}, 10000);
+}
+
+TEST_F(routing_table_test, wide_prefix_ranges) {
+    auto ranges = std::vector<cbdc::config::shard_range_t>();
+    static constexpr uint32_t shards{1000};
+    static constexpr uint32_t space{1U << 16U};
+    for(uint32_t i = 0; i < shards; i++) {
+        ranges.emplace_back(i * space / shards,
+                            (i + 1) * space / shards - 1,
+                            16);
+    }
+    check_routes(ranges, 100000);
+
+    ranges.clear();
+    ranges.emplace_back(0, 0x7fffffff, 32);
+    ranges.emplace_back(0x80000000, 0x80000000, 32);
+    ranges.emplace_back(0x80000001, 0xffffffff, 32);
+    check_routes(ranges, 10000);
+
+    auto table = cbdc::config::routing_table(ranges);
+    EXPECT_EQ(table.shards_for(make_prefix_key(0x80000000)),
+              std::vector<size_t>{1});
+    EXPECT_EQ(table.shards_for(make_prefix_key(0x7fffffff)),
+              std::vector<size_t>{0});
+    EXPECT_EQ(table.shards_for(make_prefix_key(0x80000001)),
+              std::vector<size_t>{2});
+}
+
+TEST_F(routing_table_test, overlapping_mixed_ranges) {
+    auto ranges = std::vector<cbdc::config::shard_range_t>();
+    ranges.emplace_back(0, 127, 8);
+    ranges.emplace_back(0x4000, 0xbfff, 16);
+    ranges.emplace_back(0x7fff0000, 0xffffffff, 32);
+    ranges.emplace_back(200, 200, 8);
+    check_routes(ranges, 100000);
+
+    auto table = cbdc::config::routing_table(ranges);
+    EXPECT_EQ(table.shards_for(make_prefix_key(0x7fff0000)),
+              (std::vector<size_t>{0, 1, 2}));
+    EXPECT_EQ(table.shards_for(make_prefix_key(0xc0000000)),
+              std::vector<size_t>{2});
+}
+
+TEST_F(routing_table_test, uncovered_prefixes) {
+    auto ranges = std::vector<cbdc::config::shard_range_t>();
+    ranges.emplace_back(16, 31, 8);
+    auto table = cbdc::config::routing_table(ranges);
+    EXPECT_TRUE(table.shards_for(make_prefix_key(0)).empty());
+    EXPECT_TRUE(table.shards_for(make_prefix_key(0x20000000)).empty());
+    EXPECT_EQ(table.shards_for(make_prefix_key(0x10000000)),
+              std::vector<size_t>{0});
+}
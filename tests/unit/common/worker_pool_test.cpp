@@ -0,0 +1,56 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/worker_pool.hpp"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(worker_pool_test, runs_each_index_once) {
+    auto pool = cbdc::worker_pool(4);
+    ASSERT_EQ(pool.size(), 4UL);
+    static constexpr size_t n_tasks = 1000;
+    for(size_t round = 0; round < 50; round++) {
+        auto counts = std::vector<std::atomic<size_t>>(n_tasks);
+        pool.run(n_tasks, [&](size_t i) {
+            counts[i]++;
+        });
+        for(const auto& c : counts) {
+            ASSERT_EQ(c.load(), 1UL);
+        }
+    }
+}
+
+TEST(worker_pool_test, single_thread) {
+    auto pool = cbdc::worker_pool(1);
+    ASSERT_EQ(pool.size(), 1UL);
+    const auto caller = std::this_thread::get_id();
+    size_t sum{};
+    pool.run(10, [&](size_t i) {
+        ASSERT_EQ(std::this_thread::get_id(), caller);
+        sum += i;
+    });
+    ASSERT_EQ(sum, 45UL);
+}
+
+TEST(worker_pool_test, concurrent_callers) {
+    auto pool = cbdc::worker_pool(3);
+    auto total = std::atomic<size_t>();
+    auto callers = std::vector<std::thread>();
+    for(size_t c = 0; c < 4; c++) {
+        callers.emplace_back([&]() {
+            for(size_t round = 0; round < 20; round++) {
+                pool.run(8, [&](size_t /* i */) {
+                    total++;
+                });
+            }
+        });
+    }
+    for(auto& t : callers) {
+        t.join();
+    }
+    ASSERT_EQ(total.load(), 4UL * 20 * 8);
+}
@@ -39,6 +39,19 @@ TEST_F(locking_shard_format_test, lock_request) {
     ASSERT_EQ(req, deser_req);
 }
 
+TEST_F(locking_shard_format_test, verified_lock_request) {
+    auto req = cbdc::locking_shard::rpc::request();
+    req.m_dtx_id = {'b'};
+    req.m_params
+        = cbdc::locking_shard::rpc::verified_lock_params{{m_tx, m_tx},
+                                                         {true, false}};
+    ASSERT_TRUE(m_ser << req);
+
+    auto deser_req = cbdc::locking_shard::rpc::request();
+    ASSERT_TRUE(m_deser >> deser_req);
+    ASSERT_EQ(req, deser_req);
+}
+
 TEST_F(locking_shard_format_test, apply_request) {
     auto req = cbdc::locking_shard::rpc::request();
     req.m_dtx_id = {'b'};
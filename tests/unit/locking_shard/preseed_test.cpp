@@ -0,0 +1,180 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/twophase/locking_shard/locking_shard.hpp"
+#include "uhs/twophase/locking_shard/preseed.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+class preseed_test : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        for(uint64_t i = 0; i < 1000; i++) {
+            m_ids.push_back(make_id(i));
+        }
+        // Duplicate UHS IDs are written once
+        m_ids.push_back(make_id(0));
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(m_file);
+    }
+
+    static auto make_id(uint64_t i) -> cbdc::hash_t {
+        auto id = cbdc::hash_t();
+        const auto v = i * 0x9e3779b97f4a7c15;
+        std::memcpy(id.data(), &v, sizeof(v));
+        std::memcpy(id.data() + sizeof(v), &v, sizeof(v));
+        return id;
+    }
+
+    // Overwrites a byte of the preseed file
+    void set_byte(size_t offset, char value) {
+        auto f = std::fstream(m_file,
+                              std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(offset));
+        f.put(value);
+    }
+
+    auto make_shard() -> cbdc::locking_shard::locking_shard {
+        return cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                  m_logger,
+                                                  1,
+                                                  m_file,
+                                                  m_opts);
+    }
+
+    static constexpr size_t m_header_size{24};
+    static constexpr auto m_file = "preseed_test_file";
+    std::vector<cbdc::hash_t> m_ids;
+    std::shared_ptr<cbdc::logging::log> m_logger{
+        std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::warn)};
+    cbdc::config::options m_opts{};
+};
+
+TEST_F(preseed_test, write_open) {
+    ASSERT_TRUE(cbdc::locking_shard::uhs_preseed::write(m_file, m_ids));
+    ASSERT_EQ(m_ids.size(), 1000);
+    ASSERT_TRUE(std::is_sorted(m_ids.begin(), m_ids.end()));
+
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_TRUE(preseed.open(m_file));
+    ASSERT_EQ(preseed.size(), m_ids.size());
+    for(uint64_t i = 0; i < preseed.size(); i++) {
+        ASSERT_EQ(preseed.get(i), m_ids[i]);
+    }
+
+    auto first = preseed.check_range(0, 400);
+    auto second = preseed.check_range(400, preseed.size());
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(first.value() + second.value(), preseed.checksum());
+}
+
+TEST_F(preseed_test, load) {
+    ASSERT_TRUE(cbdc::locking_shard::uhs_preseed::write(m_file, m_ids));
+    auto shard = make_shard();
+    for(const auto& id : m_ids) {
+        ASSERT_TRUE(*shard.check_unspent(id));
+    }
+    ASSERT_FALSE(*shard.check_unspent(make_id(1000)));
+}
+
+TEST_F(preseed_test, load_stream) {
+    // Preseed files of serialized UHS IDs are still accepted
+    {
+        auto out = std::ofstream(m_file, std::ios::binary);
+        auto ser = cbdc::ostream_serializer(out);
+        ser << static_cast<uint64_t>(m_ids.size());
+        for(const auto& id : m_ids) {
+            ser << id;
+        }
+    }
+    auto shard = make_shard();
+    for(const auto& id : m_ids) {
+        ASSERT_TRUE(*shard.check_unspent(id));
+    }
+}
+
+TEST_F(preseed_test, truncated) {
+    ASSERT_TRUE(cbdc::locking_shard::uhs_preseed::write(m_file, m_ids));
+    std::filesystem::resize_file(m_file,
+                                 std::filesystem::file_size(m_file) - 1);
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_FALSE(preseed.open(m_file));
+
+    auto shard = make_shard();
+    ASSERT_FALSE(*shard.check_unspent(m_ids[0]));
+}
+
+TEST_F(preseed_test, corrupt) {
+    ASSERT_TRUE(cbdc::locking_shard::uhs_preseed::write(m_file, m_ids));
+    // Change the last byte of the last UHS ID, which keeps the UHS IDs
+    // sorted
+    set_byte(m_header_size + m_ids.size() * cbdc::hash_size - 1, 1);
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_TRUE(preseed.open(m_file));
+    ASSERT_NE(preseed.check_range(0, preseed.size()), preseed.checksum());
+
+    auto shard = make_shard();
+    ASSERT_FALSE(*shard.check_unspent(m_ids[0]));
+}
+
+TEST_F(preseed_test, unsorted) {
+    ASSERT_TRUE(cbdc::locking_shard::uhs_preseed::write(m_file, m_ids));
+    // Move the first UHS ID after the second
+    set_byte(m_header_size, static_cast<char>(0xff));
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_TRUE(preseed.open(m_file));
+    ASSERT_FALSE(preseed.check_range(0, preseed.size()).has_value());
+}
+
+TEST_F(preseed_test, writer_runs) {
+    // Spill the UHS IDs to several sorted runs, with the duplicate in a
+    // different run from the original
+    static constexpr size_t max_buffered{64};
+    {
+        auto writer
+            = cbdc::locking_shard::uhs_preseed_writer(m_file, max_buffered);
+        for(auto it = m_ids.rbegin(); it != m_ids.rend(); it++) {
+            ASSERT_TRUE(writer.add(*it));
+        }
+        ASSERT_TRUE(writer.finish());
+    }
+    ASSERT_FALSE(std::filesystem::exists(std::string(m_file) + ".run0"));
+
+    std::sort(m_ids.begin(), m_ids.end());
+    m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_TRUE(preseed.open(m_file));
+    ASSERT_EQ(preseed.size(), m_ids.size());
+    for(uint64_t i = 0; i < preseed.size(); i++) {
+        ASSERT_EQ(preseed.get(i), m_ids[i]);
+    }
+    ASSERT_EQ(preseed.check_range(0, preseed.size()), preseed.checksum());
+}
+
+TEST_F(preseed_test, writer_in_memory) {
+    {
+        auto writer = cbdc::locking_shard::uhs_preseed_writer(
+            m_file,
+            m_ids.size() + 1);
+        for(const auto& id : m_ids) {
+            ASSERT_TRUE(writer.add(id));
+        }
+        ASSERT_TRUE(writer.finish());
+    }
+
+    auto preseed = cbdc::locking_shard::uhs_preseed();
+    ASSERT_TRUE(preseed.open(m_file));
+    ASSERT_EQ(preseed.size(), m_ids.size() - 1);
+    ASSERT_EQ(preseed.check_range(0, preseed.size()), preseed.checksum());
+}
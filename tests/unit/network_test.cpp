@@ -106,3 +106,35 @@ TEST_F(NetworkTest, reset_net) {
     m_blocking_net->close();
     listener.join();
 }
+
+TEST_F(NetworkTest, full_send_queue) {
+    static constexpr auto listen_port = 30003;
+    auto listener = cbdc::network::tcp_listener();
+    ASSERT_TRUE(listener.listen(cbdc::network::localhost, listen_port));
+
+    auto sock = std::make_unique<cbdc::network::tcp_socket>();
+    ASSERT_TRUE(sock->connect(cbdc::network::localhost, listen_port));
+    // Never read from, so the socket and then the send queue fill up.
+    auto server_sock = cbdc::network::tcp_socket();
+    ASSERT_TRUE(listener.accept(server_sock));
+
+    auto client_net = cbdc::network::connection_manager();
+    client_net.add(std::move(sock));
+
+    static constexpr size_t pkt_size = 1UL << 16;
+    static constexpr size_t max_sends = 1UL << 20;
+    auto pkt = std::make_shared<cbdc::buffer>();
+    pkt->extend(pkt_size);
+    auto full = false;
+    for(size_t i = 0; i < max_sends && !full; i++) {
+        full = !client_net.send_to_one(pkt);
+    }
+    ASSERT_TRUE(full);
+
+    // Packets to a peer which is not keeping up are dropped without
+    // blocking.
+    client_net.broadcast(pkt);
+    ASSERT_FALSE(client_net.send_to_one(pkt));
+
+    client_net.close();
+}
@@ -296,6 +296,48 @@ TEST_F(format_test, malformed_unordered_maps_cannot_roundtrip) {
     EXPECT_EQ(m1.size(), r2.size());
 }
 
+TEST_F(format_test, wellformed_maps_roundtrip) {
+    std::map<int16_t, std::vector<uint64_t>> m0{};
+    ser << m0;
+    EXPECT_TRUE(ser);
+
+    std::map<int16_t, std::vector<uint64_t>> r0{};
+    deser >> r0;
+
+    // empty map
+    EXPECT_TRUE(deser);
+    EXPECT_EQ(r0, m0);
+    ser.reset();
+    deser.reset();
+    EXPECT_TRUE(ser);
+
+    m0.emplace(0, std::vector<uint64_t>{std::numeric_limits<uint64_t>::max()});
+    m0.emplace(-1, std::vector<uint64_t>{});
+    m0.emplace(std::numeric_limits<int16_t>::min(),
+               std::vector<uint64_t>{1, 2, 3});
+
+    ser << m0;
+    EXPECT_TRUE(ser);
+
+    std::map<int16_t, std::vector<uint64_t>> r1{};
+    deser >> r1;
+
+    // populated map
+    EXPECT_TRUE(deser);
+    EXPECT_EQ(r1, m0);
+}
+
+TEST_F(format_test, malformed_maps_cannot_roundtrip) {
+    // say there is a key-value pair when there is only a key
+    ser << 1LLU << int16_t(45);
+    std::map<int16_t, uint64_t> r0{};
+    deser >> r0;
+
+    // fails at trying to read the value
+    EXPECT_FALSE(deser);
+    EXPECT_TRUE(r0.empty());
+}
+
 TEST_F(format_test, wellformed_sets_roundtrip) {
     // empty set
     std::set<uint64_t> s0;
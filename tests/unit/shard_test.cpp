@@ -3,14 +3,22 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "uhs/atomizer/shard/format.hpp"
+#include "uhs/atomizer/shard/memory_uhs_store.hpp"
 #include "uhs/atomizer/shard/shard.hpp"
+#include "uhs/atomizer/shard/snapshot_sync.hpp"
 #include "uhs/transaction/wallet.hpp"
 #include "util.hpp"
 
+#include <atomic>
 #include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <thread>
 
 static constexpr auto g_shard_test_dir = "test_shard_db";
+static constexpr auto g_shard_peer_test_dir = "test_shard_peer_db";
+static constexpr auto g_shard_snapshot_test_dir = "test_shard_snapshot";
 
 TEST(shard_sync_test, digest_tx_sync_err) {
     cbdc::shard::shard m_shard{{3, 8}};
@@ -149,3 +157,364 @@ TEST_F(shard_test, digest_block_valid) {
 
     ASSERT_EQ(invalid_got, invalid_want);
 }
+
+class memory_shard_test : public shard_test {
+  protected:
+    void SetUp() override {
+        m_shard = cbdc::shard::shard(
+            {3, 8},
+            std::make_unique<cbdc::shard::memory_uhs_store>(
+                m_checkpoint_interval));
+        shard_test::SetUp();
+    }
+
+    /// Returns a block whose transaction spends an output of the previous
+    /// block's and creates one output to be spent by the next block and one
+    /// to be kept.
+    static auto chain_block(uint64_t height) -> cbdc::atomizer::block {
+        cbdc::atomizer::block blk;
+        blk.m_height = height;
+        auto inputs = std::vector<cbdc::hash_t>();
+        if(height > 2) {
+            inputs.push_back(spent_id(height - 1));
+        }
+        blk.m_transactions.push_back(
+            cbdc::test::simple_tx({'c'},
+                                  inputs,
+                                  {spent_id(height), kept_id(height)}));
+        return blk;
+    }
+
+    /// Checks that the shard holds exactly the unspent outputs of the
+    /// blocks from \ref chain_block up to the given height.
+    static void check_chain(cbdc::shard::shard& shard, uint64_t n_blocks) {
+        cbdc::transaction::compact_tx ctx{};
+        ctx.m_id = {'a'};
+        auto want = std::unordered_set<uint64_t>();
+        for(uint64_t height = 2; height <= n_blocks; height++) {
+            want.insert(ctx.m_inputs.size());
+            ctx.m_inputs.push_back(kept_id(height));
+        }
+        want.insert(ctx.m_inputs.size());
+        ctx.m_inputs.push_back(spent_id(n_blocks));
+        auto res = shard.digest_transaction(ctx);
+        ASSERT_TRUE(
+            std::holds_alternative<cbdc::atomizer::tx_notify_request>(res));
+        auto got = std::get<cbdc::atomizer::tx_notify_request>(res);
+        ASSERT_EQ(got.m_block_height, n_blocks);
+        ASSERT_EQ(got.m_attestations, want);
+
+        ctx.m_inputs.clear();
+        for(uint64_t height = 2; height < n_blocks; height++) {
+            ctx.m_inputs.push_back(spent_id(height));
+        }
+        res = shard.digest_transaction(ctx);
+        ASSERT_TRUE(std::holds_alternative<cbdc::watchtower::tx_error>(res));
+        auto want_err = cbdc::watchtower::tx_error{
+            ctx.m_id,
+            cbdc::watchtower::tx_error_inputs_dne{ctx.m_inputs}};
+        ASSERT_EQ(std::get<cbdc::watchtower::tx_error>(res), want_err);
+    }
+
+    static constexpr size_t m_checkpoint_interval{2};
+
+  private:
+    static auto spent_id(uint64_t height) -> cbdc::hash_t {
+        return {3, static_cast<unsigned char>(height)};
+    }
+
+    static auto kept_id(uint64_t height) -> cbdc::hash_t {
+        return {4, static_cast<unsigned char>(height)};
+    }
+};
+
+TEST_F(memory_shard_test, digest_tx_valid) {
+    cbdc::transaction::compact_tx ctx{};
+    ctx.m_id = {'a'};
+    ctx.m_inputs = {{0}, {3}, {6}, {100}};
+    ctx.m_uhs_outputs = {{'x'}, {'y'}};
+
+    auto res = m_shard.digest_transaction(ctx);
+    ASSERT_TRUE(
+        std::holds_alternative<cbdc::atomizer::tx_notify_request>(res));
+    auto got = std::get<cbdc::atomizer::tx_notify_request>(res);
+
+    cbdc::atomizer::tx_notify_request want{};
+    want.m_tx = ctx;
+    want.m_attestations = {1, 2};
+    want.m_block_height = 1;
+
+    ASSERT_EQ(got, want);
+}
+
+TEST_F(memory_shard_test, restart) {
+    // Blocks are restored from the checkpoint and the logs
+    for(uint64_t height = 2; height <= 3; height++) {
+        cbdc::atomizer::block blk;
+        blk.m_height = height;
+        blk.m_transactions.push_back(cbdc::test::simple_tx(
+            {'c'},
+            {{static_cast<unsigned char>(height + 1)}},
+            {{static_cast<unsigned char>(height + 5)}}));
+        ASSERT_TRUE(m_shard.digest_block(blk));
+    }
+
+    // Stop the background checkpoint before restarting
+    m_shard = cbdc::shard::shard({3, 8});
+
+    // Simulate a record partially written before a crash
+    {
+        auto log = std::ofstream(std::string(g_shard_test_dir) + "/uhs_log",
+                                 std::ios::binary | std::ios::app);
+        log.put('x');
+    }
+
+    auto restarted = cbdc::shard::shard(
+        {3, 8},
+        std::make_unique<cbdc::shard::memory_uhs_store>(
+            m_checkpoint_interval));
+    ASSERT_FALSE(restarted.open_db(g_shard_test_dir).has_value());
+    ASSERT_EQ(restarted.best_block_height(), 3UL);
+
+    cbdc::transaction::compact_tx ctx{};
+    ctx.m_id = {'a'};
+    ctx.m_inputs = {{5}, {6}, {7}, {8}};
+    auto res = restarted.digest_transaction(ctx);
+    ASSERT_TRUE(
+        std::holds_alternative<cbdc::atomizer::tx_notify_request>(res));
+
+    ctx.m_inputs = {{3}, {4}};
+    res = restarted.digest_transaction(ctx);
+    ASSERT_TRUE(std::holds_alternative<cbdc::watchtower::tx_error>(res));
+
+    cbdc::atomizer::block b4;
+    b4.m_height = 4;
+    ASSERT_TRUE(restarted.digest_block(b4));
+}
+
+TEST_F(memory_shard_test, checkpoint_while_applying) {
+    // Checkpoint after every block, so background checkpoints overlap the
+    // blocks applied after them
+    m_shard = cbdc::shard::shard(
+        {3, 8},
+        std::make_unique<cbdc::shard::memory_uhs_store>(1));
+    ASSERT_FALSE(m_shard.open_db(g_shard_test_dir).has_value());
+
+    static constexpr uint64_t n_blocks{40};
+    for(uint64_t height = 2; height <= n_blocks; height++) {
+        ASSERT_TRUE(m_shard.digest_block(chain_block(height)));
+    }
+    check_chain(m_shard, n_blocks);
+
+    m_shard = cbdc::shard::shard({3, 8});
+    auto restarted = cbdc::shard::shard(
+        {3, 8},
+        std::make_unique<cbdc::shard::memory_uhs_store>(1));
+    ASSERT_FALSE(restarted.open_db(g_shard_test_dir).has_value());
+    ASSERT_EQ(restarted.best_block_height(), n_blocks);
+    check_chain(restarted, n_blocks);
+}
+
+TEST_F(memory_shard_test, snapshot_while_applying) {
+    std::filesystem::create_directories(g_shard_snapshot_test_dir);
+    const auto snapshot_file
+        = std::string(g_shard_snapshot_test_dir) + "/uhs_snapshot";
+
+    // Keep writing snapshots while blocks are applied
+    auto applied = std::atomic_bool{false};
+    auto snapshot_height = std::optional<uint64_t>();
+    auto writer = std::thread([&]() {
+        do {
+            snapshot_height = m_shard.write_snapshot(snapshot_file);
+        } while(snapshot_height.has_value() && !applied);
+    });
+    static constexpr uint64_t n_blocks{200};
+    for(uint64_t height = 2; height <= n_blocks; height++) {
+        ASSERT_TRUE(m_shard.digest_block(chain_block(height)));
+    }
+    applied = true;
+    writer.join();
+    ASSERT_TRUE(snapshot_height.has_value());
+
+    // Applying the blocks following the snapshot's height makes it exact,
+    // whichever later changes it includes
+    {
+        auto peer = cbdc::shard::shard(
+            {3, 8},
+            std::make_unique<cbdc::shard::memory_uhs_store>(0));
+        ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+        ASSERT_TRUE(peer.install_snapshot(snapshot_file));
+        ASSERT_EQ(peer.best_block_height(), snapshot_height.value());
+        for(auto height = snapshot_height.value() + 1; height <= n_blocks;
+            height++) {
+            ASSERT_TRUE(peer.digest_block(chain_block(height)));
+        }
+        check_chain(peer, n_blocks);
+    }
+
+    std::filesystem::remove_all(g_shard_peer_test_dir);
+    std::filesystem::remove_all(g_shard_snapshot_test_dir);
+}
+
+TEST_F(shard_test, digest_txs_batch) {
+    auto txs = std::vector<cbdc::transaction::compact_tx>(3);
+    txs[0].m_id = {'a'};
+    txs[0].m_inputs = {{6}, {0}, {3}};
+    txs[1].m_id = {'b'};
+    txs[1].m_inputs = {{8}, {4}, {7}};
+    txs[2].m_id = {'c'};
+    txs[2].m_inputs = {{5}};
+    auto batch = txs;
+
+    auto res = m_shard.digest_transactions(std::move(batch));
+    ASSERT_EQ(res.size(), txs.size());
+
+    // Each result matches digesting its transaction on its own
+    for(size_t i = 0; i < txs.size(); i++) {
+        ASSERT_EQ(res[i], m_shard.digest_transaction(txs[i]));
+    }
+
+    auto want_err = cbdc::watchtower::tx_error{
+        {'b'},
+        cbdc::watchtower::tx_error_inputs_dne{{{8}, {7}}}};
+    ASSERT_EQ(std::get<cbdc::watchtower::tx_error>(res[1]), want_err);
+    ASSERT_EQ(std::get<cbdc::atomizer::tx_notify_request>(res[0])
+                  .m_attestations,
+              (std::unordered_set<uint64_t>{0, 2}));
+}
+
+class shard_snapshot_test : public shard_test {
+  protected:
+    void TearDown() override {
+        shard_test::TearDown();
+        std::filesystem::remove_all(g_shard_peer_test_dir);
+        std::filesystem::remove_all(g_shard_snapshot_test_dir);
+    }
+
+    void check_peer(cbdc::shard::shard& peer) {
+        ASSERT_EQ(peer.best_block_height(), 1UL);
+
+        // Only the IDs in the peer's range are installed
+        cbdc::transaction::compact_tx ctx{};
+        ctx.m_id = {'a'};
+        ctx.m_inputs = {{3}, {4}, {5}, {6}};
+        auto res = peer.digest_transaction(ctx);
+        ASSERT_TRUE(
+            std::holds_alternative<cbdc::atomizer::tx_notify_request>(res));
+        ASSERT_EQ(
+            std::get<cbdc::atomizer::tx_notify_request>(res).m_attestations,
+            (std::unordered_set<uint64_t>{1, 2}));
+
+        cbdc::atomizer::block b2;
+        b2.m_height = 2;
+        ASSERT_TRUE(peer.digest_block(b2));
+    }
+
+    const std::string m_snapshot_file
+        = std::string(g_shard_snapshot_test_dir) + "/uhs_snapshot";
+};
+
+TEST_F(shard_snapshot_test, install_snapshot) {
+    std::filesystem::create_directories(g_shard_snapshot_test_dir);
+    ASSERT_EQ(m_shard.write_snapshot(m_snapshot_file), 1UL);
+
+    auto peer = cbdc::shard::shard({4, 5});
+    ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+    ASSERT_TRUE(peer.install_snapshot(m_snapshot_file));
+    check_peer(peer);
+}
+
+TEST_F(shard_snapshot_test, install_snapshot_memory) {
+    std::filesystem::create_directories(g_shard_snapshot_test_dir);
+    ASSERT_EQ(m_shard.write_snapshot(m_snapshot_file), 1UL);
+
+    {
+        auto peer = cbdc::shard::shard(
+            {4, 5},
+            std::make_unique<cbdc::shard::memory_uhs_store>(0));
+        ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+        ASSERT_TRUE(peer.install_snapshot(m_snapshot_file));
+    }
+
+    // The installed snapshot persists across restarts
+    auto peer = cbdc::shard::shard(
+        {4, 5},
+        std::make_unique<cbdc::shard::memory_uhs_store>(0));
+    ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+    ASSERT_EQ(peer.write_snapshot(m_snapshot_file), 1UL);
+    check_peer(peer);
+
+    // Snapshots written by either store can be installed by the other
+    std::filesystem::remove_all(g_shard_test_dir);
+    auto other = cbdc::shard::shard({4, 5});
+    ASSERT_FALSE(other.open_db(g_shard_test_dir).has_value());
+    ASSERT_TRUE(other.install_snapshot(m_snapshot_file));
+    check_peer(other);
+}
+
+TEST_F(shard_snapshot_test, install_snapshot_malformed) {
+    std::filesystem::create_directories(g_shard_snapshot_test_dir);
+    ASSERT_EQ(m_shard.write_snapshot(m_snapshot_file), 1UL);
+    std::filesystem::resize_file(
+        m_snapshot_file,
+        std::filesystem::file_size(m_snapshot_file) - 1);
+
+    auto peer = cbdc::shard::shard({4, 5});
+    ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+    ASSERT_FALSE(peer.install_snapshot(m_snapshot_file));
+    ASSERT_FALSE(peer.install_snapshot("test_shard_no_snapshot"));
+    ASSERT_EQ(peer.best_block_height(), 0UL);
+}
+
+TEST_F(shard_snapshot_test, download_resume) {
+    static constexpr size_t chunk_size{40};
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::fatal);
+    auto server = cbdc::shard::snapshot_server(
+        m_shard,
+        std::string(g_shard_snapshot_test_dir) + "/server",
+        chunk_size,
+        0,
+        logger);
+    const auto dir = std::string(g_shard_snapshot_test_dir) + "/client";
+
+    // Fail after the first chunk, as if the connection dropped
+    size_t requests{0};
+    size_t max_requests{1};
+    auto fetch = [&](const cbdc::shard::snapshot_request& req)
+        -> std::optional<cbdc::shard::snapshot_response> {
+        if(requests == max_requests) {
+            return std::nullopt;
+        }
+        requests++;
+        auto pkt = cbdc::make_buffer(req);
+        auto resp = server.handle(
+            cbdc::from_buffer<cbdc::shard::snapshot_request>(pkt).value());
+        auto resp_pkt = cbdc::make_buffer(resp);
+        return cbdc::from_buffer<cbdc::shard::snapshot_response>(resp_pkt);
+    };
+
+    ASSERT_FALSE(cbdc::shard::download_snapshot(fetch, dir, 1, logger)
+                     .has_value());
+
+    // The snapshot is not worth downloading below the minimum height
+    requests = 0;
+    ASSERT_FALSE(cbdc::shard::download_snapshot(fetch, dir, 2, logger)
+                     .has_value());
+
+    // Resume from the second chunk
+    requests = 0;
+    max_requests = std::numeric_limits<size_t>::max();
+    auto snp = cbdc::shard::download_snapshot(fetch, dir, 1, logger);
+    ASSERT_TRUE(snp.has_value());
+    ASSERT_EQ(snp->first, 1UL);
+
+    // Header and four UHS IDs
+    static constexpr size_t snapshot_size{16 + 4 * 32};
+    ASSERT_EQ(requests, (snapshot_size + chunk_size - 1) / chunk_size - 1);
+
+    auto peer = cbdc::shard::shard({4, 5});
+    ASSERT_FALSE(peer.open_db(g_shard_peer_test_dir).has_value());
+    ASSERT_TRUE(peer.install_snapshot(snp->second));
+    check_peer(peer);
+}
@@ -4,11 +4,22 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "uhs/twophase/coordinator/distributed_tx.hpp"
+#include "uhs/twophase/locking_shard/format.hpp"
 #include "uhs/twophase/locking_shard/locking_shard.hpp"
-
+#include "uhs/twophase/locking_shard/state_machine.hpp"
+#include "util/common/keys.hpp"
+#include "util/raft/serialization.hpp"
+#include "util/raft/util.hpp"
+#include "util/rpc/format.hpp"
+#include "util/serialization/buffer_serializer.hpp"
+#include "util/serialization/util.hpp"
+
+#include <filesystem>
 #include <gtest/gtest.h>
 #include <queue>
 #include <random>
+#include <secp256k1.h>
+#include <thread>
 
 class TwoPhaseTest : public ::testing::Test {
   public:
@@ -379,3 +390,398 @@ TEST_F(TwoPhaseTest, test_two_shards_conflicting) {
         ASSERT_FALSE((*res)[i]);
     }
 }
+
+TEST_F(TwoPhaseTest, test_one_shard_concurrent) {
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::warn);
+    auto shard = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                    logger,
+                                                    10000000,
+                                                    "",
+                                                    m_opts);
+
+    static constexpr size_t n_threads{8};
+    static constexpr size_t n_dtxs{10};
+    static constexpr size_t dtx_size{100};
+
+    auto e = std::default_random_engine();
+    auto rnd = std::uniform_int_distribution<uint64_t>();
+    auto make_id = [&]() {
+        auto id = cbdc::hash_t();
+        for(size_t j{0}; j < 4; j++) {
+            const auto val = rnd(e);
+            std::memcpy(&id[j * 8], &val, sizeof(val));
+        }
+        return id;
+    };
+
+    // Every thread attempts to spend the contested output in its first dtx
+    auto contested = make_id();
+    auto seed = std::vector<cbdc::locking_shard::tx>(1);
+    seed[0].m_tx.m_uhs_outputs.push_back(contested);
+    auto inputs = std::vector<std::vector<cbdc::hash_t>>(n_threads);
+    auto outputs = std::vector<std::vector<cbdc::hash_t>>(n_threads);
+    for(size_t t{0}; t < n_threads; t++) {
+        for(size_t i{0}; i < n_dtxs * dtx_size; i++) {
+            inputs[t].push_back(make_id());
+            outputs[t].push_back(make_id());
+            seed[0].m_tx.m_uhs_outputs.push_back(inputs[t].back());
+        }
+    }
+    auto seed_id = make_id();
+    auto seed_res = shard.lock_outputs(std::move(seed), seed_id);
+    ASSERT_TRUE(seed_res.has_value());
+    ASSERT_TRUE(shard.apply_outputs(std::move(*seed_res), seed_id));
+
+    auto dtx_ids = std::vector<cbdc::hash_t>();
+    for(size_t i{0}; i < n_threads * n_dtxs; i++) {
+        dtx_ids.push_back(make_id());
+    }
+
+    auto contested_wins = std::atomic<size_t>();
+    auto threads = std::vector<std::thread>();
+    for(size_t t{0}; t < n_threads; t++) {
+        threads.emplace_back([&, t]() {
+            for(size_t d{0}; d < n_dtxs; d++) {
+                auto txs = std::vector<cbdc::locking_shard::tx>();
+                for(size_t i{0}; i < dtx_size; i++) {
+                    auto tx = cbdc::locking_shard::tx();
+                    tx.m_tx.m_inputs.push_back(inputs[t][d * dtx_size + i]);
+                    tx.m_tx.m_uhs_outputs.push_back(
+                        outputs[t][d * dtx_size + i]);
+                    txs.push_back(tx);
+                }
+                if(d == 0) {
+                    // Abort the transaction if its second input was spent
+                    txs[0].m_tx.m_inputs.push_back(contested);
+                }
+                const auto& dtx_id = dtx_ids[t * n_dtxs + d];
+                auto res = shard.lock_outputs(std::move(txs), dtx_id);
+                ASSERT_TRUE(res.has_value());
+                if(d == 0 && (*res)[0]) {
+                    contested_wins++;
+                }
+                ASSERT_TRUE(shard.apply_outputs(std::move(*res), dtx_id));
+                ASSERT_TRUE(shard.discard_dtx(dtx_id));
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+
+    ASSERT_EQ(contested_wins, 1UL);
+    ASSERT_FALSE(*shard.check_unspent(contested));
+    size_t unspent_inputs{};
+    for(size_t t{0}; t < n_threads; t++) {
+        for(size_t i{0}; i < n_dtxs * dtx_size; i++) {
+            if(*shard.check_unspent(inputs[t][i])) {
+                unspent_inputs++;
+                ASSERT_EQ(i, 0UL);
+                ASSERT_FALSE(*shard.check_unspent(outputs[t][i]));
+            } else {
+                ASSERT_TRUE(*shard.check_unspent(outputs[t][i]));
+            }
+        }
+    }
+    ASSERT_EQ(unspent_inputs, n_threads - 1);
+}
+
+TEST_F(TwoPhaseTest, test_one_shard_duplicate_dtx) {
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::fatal);
+    auto shard = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                    logger,
+                                                    10000000,
+                                                    "",
+                                                    m_opts);
+
+    static constexpr size_t n_threads{8};
+    static constexpr size_t dtx_size{10000};
+
+    auto make_id = [](size_t i, unsigned char tag) {
+        auto id = cbdc::hash_t();
+        std::memcpy(&id[8], &i, sizeof(i));
+        id[0] = tag;
+        return id;
+    };
+
+    auto seed = std::vector<cbdc::locking_shard::tx>(1);
+    auto txs = std::vector<cbdc::locking_shard::tx>(dtx_size);
+    for(size_t i{0}; i < dtx_size; i++) {
+        seed[0].m_tx.m_uhs_outputs.push_back(make_id(i, 'i'));
+        txs[i].m_tx.m_inputs.push_back(make_id(i, 'i'));
+        txs[i].m_tx.m_uhs_outputs.push_back(make_id(i, 'o'));
+    }
+    auto seed_id = make_id(0, 's');
+    auto seed_res = shard.lock_outputs(std::move(seed), seed_id);
+    ASSERT_TRUE(seed_res.has_value());
+    ASSERT_TRUE(shard.apply_outputs(std::move(*seed_res), seed_id));
+
+    // Duplicate locks and applies of one dtx either fail or report the
+    // outcome of the first, but never lock or apply its inputs twice
+    const auto dtx_id = make_id(0, 'd');
+    const auto all_locked = std::vector<bool>(dtx_size, true);
+    auto locked = std::atomic<size_t>();
+    auto applied = std::atomic<size_t>();
+    auto ready = std::atomic<size_t>();
+    auto wait_for_all = [&]() {
+        ready++;
+        while(ready % n_threads != 0) {
+            std::this_thread::yield();
+        }
+    };
+    auto threads = std::vector<std::thread>();
+    for(size_t t{0}; t < n_threads; t++) {
+        threads.emplace_back([&]() {
+            auto dtx = txs;
+            wait_for_all();
+            auto res = shard.lock_outputs(std::move(dtx), dtx_id);
+            if(res.has_value()) {
+                ASSERT_EQ(*res, all_locked);
+                locked++;
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    ASSERT_GE(locked, 1UL);
+
+    threads.clear();
+    for(size_t t{0}; t < n_threads; t++) {
+        threads.emplace_back([&]() {
+            wait_for_all();
+            if(shard.apply_outputs(std::vector(all_locked), dtx_id)) {
+                applied++;
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    ASSERT_GE(applied, 1UL);
+    ASSERT_TRUE(shard.apply_outputs(std::vector(all_locked), dtx_id));
+
+    for(size_t i{0}; i < dtx_size; i++) {
+        ASSERT_FALSE(*shard.check_unspent(make_id(i, 'i')));
+        ASSERT_TRUE(*shard.check_unspent(make_id(i, 'o')));
+    }
+}
+
+TEST_F(TwoPhaseTest, test_one_shard_snapshot) {
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::warn);
+    auto shard = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                    logger,
+                                                    100,
+                                                    "",
+                                                    m_opts);
+
+    auto make_id = [](uint64_t i) {
+        auto id = cbdc::hash_t();
+        std::memcpy(id.data(), &i, sizeof(i));
+        std::memcpy(id.data() + sizeof(i), &i, sizeof(i));
+        return id;
+    };
+
+    // Create UHS IDs, then lock half of them in a dtx that is not applied
+    auto mint = std::vector<cbdc::locking_shard::tx>(1);
+    mint[0].m_tx.m_id = make_id(1000);
+    for(uint64_t i{0}; i < 100; i++) {
+        mint[0].m_tx.m_uhs_outputs.push_back(make_id(i));
+    }
+    auto mint_res = shard.lock_outputs(std::move(mint), make_id(2000));
+    ASSERT_TRUE(mint_res.has_value());
+    ASSERT_TRUE(shard.apply_outputs(std::move(*mint_res), make_id(2000)));
+
+    auto spend = std::vector<cbdc::locking_shard::tx>();
+    for(uint64_t i{0}; i < 50; i++) {
+        auto tx = cbdc::locking_shard::tx();
+        tx.m_tx.m_id = make_id(1001 + i);
+        tx.m_tx.m_inputs.push_back(make_id(i));
+        tx.m_tx.m_uhs_outputs.push_back(make_id(100 + i));
+        spend.push_back(tx);
+    }
+    auto spend_res = shard.lock_outputs(std::move(spend), make_id(2001));
+    ASSERT_TRUE(spend_res.has_value());
+
+    auto buf = cbdc::buffer();
+    auto ser = cbdc::buffer_serializer(buf);
+    ASSERT_TRUE(shard.write_snapshot(ser));
+
+    auto restored
+        = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                             logger,
+                                             100,
+                                             "",
+                                             m_opts);
+    auto deser = cbdc::buffer_serializer(buf);
+    ASSERT_TRUE(restored.read_snapshot(deser, buf.size()));
+
+    ASSERT_TRUE(*restored.check_tx_id(make_id(1000)));
+    for(uint64_t i{0}; i < 100; i++) {
+        ASSERT_TRUE(*restored.check_unspent(make_id(i)));
+        ASSERT_FALSE(*restored.check_unspent(make_id(100 + i)));
+    }
+
+    // The prepared dtx is restored, so it can be applied. The locked UHS IDs
+    // cannot be locked again.
+    auto again = std::vector<cbdc::locking_shard::tx>(1);
+    again[0].m_tx.m_inputs.push_back(make_id(0));
+    auto again_res = restored.lock_outputs(std::move(again), make_id(2002));
+    ASSERT_TRUE(again_res.has_value());
+    ASSERT_FALSE((*again_res)[0]);
+    ASSERT_EQ(*restored.lock_outputs({}, make_id(2001)), *spend_res);
+    ASSERT_TRUE(restored.apply_outputs(std::move(*spend_res), make_id(2001)));
+    for(uint64_t i{0}; i < 50; i++) {
+        ASSERT_FALSE(*restored.check_unspent(make_id(i)));
+        ASSERT_TRUE(*restored.check_unspent(make_id(100 + i)));
+        ASSERT_TRUE(*restored.check_tx_id(make_id(1001 + i)));
+    }
+
+    // Truncated snapshots are rejected
+    auto short_buf = cbdc::buffer();
+    short_buf.append(buf.data(), buf.size() / 2);
+    auto short_deser = cbdc::buffer_serializer(short_buf);
+    ASSERT_FALSE(restored.read_snapshot(short_deser, short_buf.size()));
+}
+
+TEST_F(TwoPhaseTest, test_one_shard_verified) {
+    // Require an attestation, which the transactions below lack
+    m_opts.m_attestation_threshold = 1;
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::warn);
+    auto shard = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                    logger,
+                                                    100,
+                                                    "",
+                                                    m_opts);
+
+    auto make_id = [](uint64_t i) {
+        auto id = cbdc::hash_t();
+        std::memcpy(id.data(), &i, sizeof(i));
+        std::memcpy(id.data() + sizeof(i), &i, sizeof(i));
+        return id;
+    };
+
+    auto mint = std::vector<cbdc::locking_shard::tx>(1);
+    mint[0].m_tx.m_uhs_outputs = {make_id(0), make_id(1)};
+    ASSERT_EQ(shard.verify_attestations(mint), std::vector<bool>{false});
+    auto mint_res = shard.lock_outputs(std::vector(mint), make_id(1000));
+    ASSERT_TRUE(mint_res.has_value());
+    ASSERT_EQ(*mint_res, std::vector<bool>{false});
+
+    // Verdicts from the leader are applied without verifying again
+    mint_res = shard.lock_verified_outputs(std::move(mint),
+                                           {true},
+                                           make_id(1001));
+    ASSERT_TRUE(mint_res.has_value());
+    ASSERT_EQ(*mint_res, std::vector<bool>{true});
+    ASSERT_TRUE(shard.apply_outputs(std::move(*mint_res), make_id(1001)));
+
+    auto spend = std::vector<cbdc::locking_shard::tx>(2);
+    spend[0].m_tx.m_inputs.push_back(make_id(0));
+    spend[1].m_tx.m_inputs.push_back(make_id(1));
+    auto spend_res = shard.lock_verified_outputs(std::move(spend),
+                                                 {false, true},
+                                                 make_id(1002));
+    ASSERT_TRUE(spend_res.has_value());
+    ASSERT_EQ(*spend_res, (std::vector<bool>{false, true}));
+    ASSERT_TRUE(shard.apply_outputs(std::move(*spend_res), make_id(1002)));
+    ASSERT_TRUE(*shard.check_unspent(make_id(0)));
+    ASSERT_FALSE(*shard.check_unspent(make_id(1)));
+}
+
+TEST_F(TwoPhaseTest, test_one_shard_verify_workers) {
+    auto secp = std::unique_ptr<secp256k1_context,
+                                decltype(&secp256k1_context_destroy)>(
+        secp256k1_context_create(SECP256K1_CONTEXT_SIGN
+                                 | SECP256K1_CONTEXT_VERIFY),
+        &secp256k1_context_destroy);
+    const auto priv = cbdc::hash_from_hex(
+        "0000000000000001000000000000000000000000000000000000000000000000");
+    m_opts.m_sentinel_public_keys.insert(
+        cbdc::pubkey_from_privkey(priv, secp.get()));
+    m_opts.m_attestation_threshold = 1;
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::fatal);
+    auto shard = cbdc::locking_shard::locking_shard(std::make_pair(0, 255),
+                                                    logger,
+                                                    100,
+                                                    "",
+                                                    m_opts);
+
+    // Only every third transaction is attested
+    static constexpr size_t n_txs{100};
+    auto txs = std::vector<cbdc::locking_shard::tx>(n_txs);
+    auto want = std::vector<bool>(n_txs);
+    for(size_t i{0}; i < n_txs; i++) {
+        auto& ctx = txs[i].m_tx;
+        std::memcpy(ctx.m_id.data(), &i, sizeof(i));
+        ctx.m_inputs.push_back(ctx.m_id);
+        want[i] = i % 3 == 0;
+        if(want[i]) {
+            ctx.m_attestations.insert(ctx.sign(secp.get(), priv));
+        }
+    }
+
+    auto workers = cbdc::worker_pool(4);
+    ASSERT_EQ(shard.verify_attestations(txs, workers), want);
+    ASSERT_EQ(shard.verify_attestations(txs), want);
+}
+
+TEST_F(TwoPhaseTest, test_one_shard_forged_verdicts) {
+    static constexpr auto snapshot_dir = "twophase_test_forged_snps";
+    std::filesystem::remove_all(snapshot_dir);
+    auto logger = std::make_shared<cbdc::logging::log>(
+        cbdc::logging::log_level::fatal);
+    auto sm = cbdc::locking_shard::state_machine(std::make_pair(0, 255),
+                                                 logger,
+                                                 100,
+                                                 "",
+                                                 snapshot_dir,
+                                                 m_opts);
+
+    using rpc_request
+        = cbdc::rpc::request<cbdc::locking_shard::rpc::request>;
+    using rpc_response
+        = cbdc::rpc::response<cbdc::locking_shard::rpc::response>;
+    auto commit = [&](uint64_t log_idx,
+                      cbdc::locking_shard::rpc::request req) {
+        auto buf = cbdc::make_buffer<rpc_request, nuraft::ptr<nuraft::buffer>>(
+            rpc_request{{log_idx}, std::move(req)});
+        auto resp_buf = sm.commit(log_idx, *buf);
+        EXPECT_NE(resp_buf, nullptr);
+        auto resp = cbdc::from_buffer<rpc_response>(*resp_buf);
+        EXPECT_TRUE(resp.has_value());
+        return resp.value().m_payload;
+    };
+
+    auto txs = std::vector<cbdc::locking_shard::tx>(2);
+    txs[0].m_tx.m_uhs_outputs.push_back({'a'});
+    txs[1].m_tx.m_uhs_outputs.push_back({'b'});
+    const auto dtx_id = cbdc::hash_t{'c'};
+
+    // A log entry with fewer verdicts than transactions is rejected
+    // without reserving the dtx
+    auto res = commit(1,
+                      {dtx_id,
+                       cbdc::locking_shard::rpc::verified_lock_params{
+                           std::vector(txs),
+                           {true}}});
+    ASSERT_FALSE(res.has_value());
+
+    res = commit(2,
+                 {dtx_id,
+                  cbdc::locking_shard::rpc::verified_lock_params{
+                      std::move(txs),
+                      {true, false}}});
+    ASSERT_TRUE(res.has_value());
+    auto* lock_res
+        = std::get_if<cbdc::locking_shard::rpc::lock_response>(&*res);
+    ASSERT_NE(lock_res, nullptr);
+    ASSERT_EQ(*lock_res, (std::vector<bool>{true, false}));
+
+    std::filesystem::remove_all(snapshot_dir);
+}
@@ -336,3 +336,61 @@ TEST_F(WalletTxValidationTest, sign_verify_compact) {
     ASSERT_FALSE(
         cbdc::transaction::validation::check_attestations(ctx, m_pubkeys, 2));
 }
+
+TEST_F(WalletTxValidationTest, check_attestations_cached) {
+    auto ctx = cbdc::transaction::compact_tx(m_valid_tx);
+    ctx.m_attestations.insert(ctx.sign(m_secp.get(), m_priv0));
+    ctx.m_attestations.insert(ctx.sign(m_secp.get(), m_priv1));
+
+    auto cache = cbdc::transaction::attestation_cache(16);
+    ASSERT_TRUE(cbdc::transaction::validation::check_attestations(ctx,
+                                                                  m_pubkeys,
+                                                                  2,
+                                                                  cache));
+    ASSERT_EQ(cache.stats().m_hits, 0UL);
+    ASSERT_EQ(cache.stats().m_misses, 2UL);
+    ASSERT_EQ(cache.size(), 2UL);
+
+    ASSERT_TRUE(cbdc::transaction::validation::check_attestations(ctx,
+                                                                  m_pubkeys,
+                                                                  2,
+                                                                  cache));
+    ASSERT_EQ(cache.stats().m_hits, 2UL);
+    ASSERT_EQ(cache.stats().m_misses, 2UL);
+
+    // A different signature from the same sentinel is not a cache hit.
+    auto bad = ctx;
+    auto att = *bad.m_attestations.begin();
+    bad.m_attestations.erase(att.first);
+    att.second[0] ^= 1;
+    bad.m_attestations.insert(att);
+    ASSERT_FALSE(cbdc::transaction::validation::check_attestations(bad,
+                                                                   m_pubkeys,
+                                                                   2,
+                                                                   cache));
+
+    // Cached attestations are still subject to the public key set.
+    m_pubkeys.clear();
+    ASSERT_FALSE(cbdc::transaction::validation::check_attestations(ctx,
+                                                                   m_pubkeys,
+                                                                   2,
+                                                                   cache));
+}
+
+TEST(attestation_cache_test, bounded) {
+    static constexpr size_t capacity = 64;
+    auto cache = cbdc::transaction::attestation_cache(capacity);
+    for(uint64_t i = 0; i < capacity * 16; i++) {
+        auto tx_hash = cbdc::hash_t();
+        std::memcpy(tx_hash.data(), &i, sizeof(i));
+        cache.insert(tx_hash, {cbdc::pubkey_t{}, cbdc::signature_t{}});
+    }
+    ASSERT_LE(cache.size(), capacity + 16);
+    ASSERT_GT(cache.size(), 0UL);
+
+    auto disabled = cbdc::transaction::attestation_cache(0);
+    disabled.insert(cbdc::hash_t{}, {cbdc::pubkey_t{}, cbdc::signature_t{}});
+    ASSERT_FALSE(disabled.contains(cbdc::hash_t{},
+                                   {cbdc::pubkey_t{}, cbdc::signature_t{}}));
+    ASSERT_EQ(disabled.size(), 0UL);
+}
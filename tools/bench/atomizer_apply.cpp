@@ -0,0 +1,98 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/atomizer.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/// Compares sequential and parallel application of aggregate transaction
+/// notification batches in the atomizer. Both atomizers receive identical
+/// batches and must end up in the same state.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 4) {
+        std::cerr << "Usage: " << args[0]
+                  << " <batch size> <batch count> <thread count>"
+                     " [<inputs per tx(default: 2)>]"
+                  << std::endl;
+        return -1;
+    }
+
+    const auto batch_size = std::stoull(args[1]);
+    const auto batch_count = std::stoull(args[2]);
+    const auto n_threads = std::stoull(args[3]);
+    const auto n_inputs = args.size() > 4
+                            ? std::stoull(args[4])
+                            : cbdc::config::defaults::input_count;
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    auto engine = std::mt19937_64();
+    auto make_id = [&]() {
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto val = engine();
+            std::memcpy(&id[i], &val, sizeof(val));
+        }
+        return id;
+    };
+
+    logger->info("Generating", batch_count, "batches of", batch_size, "txs");
+    auto batches = std::vector<
+        std::vector<cbdc::atomizer::aggregate_tx_notification>>(batch_count);
+    for(uint64_t height = 0; height < batch_count; height++) {
+        auto& batch = batches[height];
+        batch.reserve(batch_size);
+        for(size_t i = 0; i < batch_size; i++) {
+            auto msg = cbdc::atomizer::aggregate_tx_notification();
+            msg.m_tx.m_id = make_id();
+            for(size_t j = 0; j < n_inputs; j++) {
+                msg.m_tx.m_inputs.push_back(make_id());
+            }
+            msg.m_tx.m_uhs_outputs.push_back(make_id());
+            msg.m_oldest_attestation = height;
+            batch.push_back(std::move(msg));
+        }
+    }
+
+    auto run = [&](size_t threads) {
+        auto atm = std::make_unique<cbdc::atomizer::atomizer>(
+            0,
+            cbdc::config::defaults::stxo_cache_depth);
+        auto elapsed = std::chrono::nanoseconds::zero();
+        for(const auto& batch : batches) {
+            auto txs = batch;
+            auto start = std::chrono::high_resolution_clock::now();
+            auto errs = atm->insert_complete_batch(std::move(txs), threads);
+            elapsed += std::chrono::high_resolution_clock::now() - start;
+            if(!errs.empty()) {
+                logger->fatal("Unexpected errors applying batch");
+            }
+            std::ignore = atm->make_block();
+        }
+        const auto total_txs = batch_size * batch_count;
+        const auto secs = std::chrono::duration<double>(elapsed).count();
+        logger->info(threads,
+                     "thread(s):",
+                     secs,
+                     "s,",
+                     static_cast<double>(total_txs) / secs,
+                     "tx/s");
+        return atm;
+    };
+
+    auto seq = run(1);
+    auto par = run(n_threads);
+    if(!(*seq == *par)) {
+        logger->fatal("Sequential and parallel atomizer states differ");
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/twophase/locking_shard/locking_shard.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+/// Measures locking shard throughput with concurrent dtxs. Each thread locks,
+/// applies and discards its own dtxs, spending preseeded UHS IDs.
+/// A configurable fraction of transactions also spend a UHS ID shared by all
+/// threads, so that they contend for the same UHS ID and are aborted.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 2) {
+        std::cerr << "Usage: " << args[0]
+                  << " <dtxs per thread> [<max threads(default: 16)>]"
+                     " [<txs per dtx(default: 100)>]"
+                     " [<contended txs per dtx(default: 0)>]"
+                  << std::endl;
+        return -1;
+    }
+
+    static constexpr size_t default_max_threads{16};
+    static constexpr size_t default_dtx_size{100};
+    const auto n_dtxs = std::stoull(args[1]);
+    const auto max_threads
+        = args.size() > 2 ? std::stoull(args[2]) : default_max_threads;
+    const auto dtx_size
+        = args.size() > 3 ? std::stoull(args[3]) : default_dtx_size;
+    const auto n_contended = args.size() > 4 ? std::stoull(args[4]) : 0;
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+    auto opts = cbdc::config::options();
+    opts.m_attestation_threshold = 0;
+
+    auto make_id = [](uint64_t idx) {
+        // splitmix64 of the index, so that IDs are uniformly distributed
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto z = (idx * id.size() + i) + 0x9e3779b97f4a7c15;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            z ^= z >> 31;
+            std::memcpy(&id[i], &z, sizeof(z));
+        }
+        return id;
+    };
+
+    for(size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        // ID index layout: 0 is the contended UHS ID, followed by the input
+        // UHS IDs, the output UHS IDs and the TX IDs of every transaction
+        const auto n_txs = n_threads * n_dtxs * dtx_size;
+        const auto first_output = 1 + n_txs;
+        const auto first_tx_id = first_output + n_txs;
+
+        // Preseed the shard with the input UHS IDs, as the shard seeder does
+        static constexpr auto preseed_file = "locking_shard_bench_preseed";
+        {
+            auto ids = std::vector<cbdc::hash_t>();
+            ids.reserve(first_output);
+            for(uint64_t idx = 0; idx < first_output; idx++) {
+                ids.push_back(make_id(idx));
+            }
+            if(!cbdc::locking_shard::uhs_preseed::write(preseed_file, ids)) {
+                logger->fatal("Failed to write preseed file");
+            }
+        }
+        auto shard = cbdc::locking_shard::locking_shard(
+            cbdc::config::shard_range_t(0, 255),
+            logger,
+            n_txs,
+            preseed_file,
+            opts);
+        std::filesystem::remove(preseed_file);
+
+        // Build the dtxs up front so that only the shard is measured
+        using dtx = std::vector<cbdc::locking_shard::tx>;
+        auto dtxs = std::vector<std::vector<dtx>>(n_threads);
+        for(size_t t = 0; t < n_threads; t++) {
+            for(size_t d = 0; d < n_dtxs; d++) {
+                auto& txs = dtxs[t].emplace_back();
+                for(size_t i = 0; i < dtx_size; i++) {
+                    const auto n = (t * n_dtxs + d) * dtx_size + i;
+                    auto tx = cbdc::locking_shard::tx();
+                    tx.m_tx.m_id = make_id(first_tx_id + n);
+                    tx.m_tx.m_inputs.push_back(make_id(1 + n));
+                    if(i < n_contended) {
+                        tx.m_tx.m_inputs.push_back(make_id(0));
+                    }
+                    tx.m_tx.m_uhs_outputs.push_back(make_id(first_output + n));
+                    txs.push_back(std::move(tx));
+                }
+            }
+        }
+
+        auto completed = std::atomic<uint64_t>();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto threads = std::vector<std::thread>();
+        for(size_t t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t]() {
+                for(size_t d = 0; d < n_dtxs; d++) {
+                    const auto dtx_id = make_id(first_tx_id + n_txs
+                                                + t * n_dtxs + d);
+                    auto res
+                        = shard.lock_outputs(std::move(dtxs[t][d]), dtx_id);
+                    if(!res.has_value()) {
+                        logger->fatal("Lock failed");
+                    }
+                    for(auto r : *res) {
+                        completed += r ? 1 : 0;
+                    }
+                    if(!shard.apply_outputs(std::move(*res), dtx_id)
+                       || !shard.discard_dtx(dtx_id)) {
+                        logger->fatal("Apply failed");
+                    }
+                }
+            });
+        }
+        for(auto& t : threads) {
+            t.join();
+        }
+        auto secs = std::chrono::duration<double>(
+                        std::chrono::high_resolution_clock::now() - start)
+                        .count();
+
+        logger->info(n_threads,
+                     "thread(s):",
+                     static_cast<double>(n_txs) / secs,
+                     "txs/s,",
+                     static_cast<double>(n_threads * n_dtxs) / secs,
+                     "dtxs/s,",
+                     completed.load(),
+                     "of",
+                     n_txs,
+                     "txs completed");
+    }
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/blocking_queue.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+#include "util/common/mpmc_queue.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+/// Compares producer-consumer throughput of the mutex-based blocking queue
+/// and the lock-free queue, popping one element at a time and in batches,
+/// with an equal number of producer and consumer threads.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 2) {
+        std::cerr << "Usage: " << args[0]
+                  << " <items per producer> [<max threads(default: 64)>]"
+                     " [<queue capacity(default: 65536)>]"
+                  << std::endl;
+        return -1;
+    }
+
+    static constexpr size_t default_max_threads = 64;
+    static constexpr size_t default_capacity = 1UL << 16;
+    static constexpr size_t batch_size = 64;
+    const auto n_items = std::stoull(args[1]);
+    const auto max_threads
+        = args.size() > 2 ? std::stoull(args[2]) : default_max_threads;
+    const auto capacity
+        = args.size() > 3 ? std::stoull(args[3]) : default_capacity;
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    // Runs the given producer and consumer functions on n_threads threads
+    // each and returns the throughput in items per second. Consumers return
+    // the number of items they popped once the queue is cleared.
+    auto run = [&](size_t n_threads,
+                   const std::function<void(uint64_t)>& produce,
+                   const std::function<uint64_t()>& consume,
+                   const std::function<size_t()>& size,
+                   const std::function<void()>& clear) {
+        auto consumed = std::vector<uint64_t>(n_threads);
+        auto start = std::chrono::high_resolution_clock::now();
+        auto consumers = std::vector<std::thread>();
+        for(size_t t = 0; t < n_threads; t++) {
+            consumers.emplace_back([&, t]() {
+                consumed[t] = consume();
+            });
+        }
+        auto producers = std::vector<std::thread>();
+        for(size_t t = 0; t < n_threads; t++) {
+            producers.emplace_back([&]() {
+                for(uint64_t i = 0; i < n_items; i++) {
+                    produce(i);
+                }
+            });
+        }
+        for(auto& t : producers) {
+            t.join();
+        }
+        while(size() > 0) {
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        clear();
+        for(auto& t : consumers) {
+            t.join();
+        }
+
+        auto total = uint64_t();
+        for(auto n : consumed) {
+            total += n;
+        }
+        if(total != n_items * n_threads) {
+            logger->fatal("Consumed", total, "of", n_items * n_threads);
+        }
+        const auto secs = std::chrono::duration<double>(elapsed).count();
+        return static_cast<double>(total) / secs;
+    };
+
+    for(size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        auto bq = cbdc::blocking_queue<uint64_t>();
+        auto bq_size = std::atomic<size_t>();
+        auto blocking = run(
+            n_threads,
+            [&](uint64_t i) {
+                bq_size += 1;
+                bq.push(i);
+            },
+            [&]() {
+                auto n = uint64_t();
+                auto val = uint64_t();
+                while(bq.pop(val)) {
+                    bq_size -= 1;
+                    n++;
+                }
+                return n;
+            },
+            [&]() {
+                return bq_size.load();
+            },
+            [&]() {
+                bq.clear();
+            });
+
+        auto mq = cbdc::mpmc_queue<uint64_t>(capacity);
+        auto single = run(
+            n_threads,
+            [&](uint64_t i) {
+                mq.push(i);
+            },
+            [&]() {
+                auto n = uint64_t();
+                auto val = uint64_t();
+                while(mq.pop(val)) {
+                    n++;
+                }
+                return n;
+            },
+            [&]() {
+                return mq.size();
+            },
+            [&]() {
+                mq.clear();
+            });
+
+        auto mq_batch = cbdc::mpmc_queue<uint64_t>(capacity);
+        auto batched = run(
+            n_threads,
+            [&](uint64_t i) {
+                mq_batch.push(i);
+            },
+            [&]() {
+                auto n = uint64_t();
+                auto items = std::vector<uint64_t>();
+                items.reserve(batch_size);
+                while(mq_batch.pop_batch(items, batch_size) > 0) {
+                    n += items.size();
+                    items.clear();
+                }
+                return n;
+            },
+            [&]() {
+                return mq_batch.size();
+            },
+            [&]() {
+                mq_batch.clear();
+            });
+
+        logger->info(n_threads,
+                     "producer(s)/consumer(s): blocking_queue",
+                     blocking,
+                     "items/s, mpmc_queue",
+                     single,
+                     "items/s, mpmc_queue batched",
+                     batched,
+                     "items/s");
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/twophase/locking_shard/locking_shard.hpp"
+#include "uhs/twophase/locking_shard/preseed.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+#include "util/serialization/format.hpp"
+#include "util/serialization/ostream_serializer.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+/// Measures locking shard startup time with a preseeded UHS. Writes the UHS
+/// IDs as a stream of serialized UHS IDs, and as a sorted preseed file, then
+/// times the construction of a locking shard from each. The files are
+/// written and removed in the working directory.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 2) {
+        std::cerr << "Usage: " << args[0] << " <UHS ID count>" << std::endl;
+        return -1;
+    }
+
+    const auto n_ids = std::stoull(args[1]);
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    auto make_id = [](uint64_t idx) {
+        // splitmix64 of the index, so that IDs are uniformly distributed
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto z = (idx * id.size() + i) + 0x9e3779b97f4a7c15;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            z ^= z >> 31;
+            std::memcpy(&id[i], &z, sizeof(z));
+        }
+        return id;
+    };
+
+    static constexpr auto stream_file = "preseed_bench_stream";
+    static constexpr auto sorted_file = "preseed_bench_sorted";
+    {
+        auto out = std::ofstream(stream_file, std::ios::binary);
+        auto ser = cbdc::ostream_serializer(out);
+        ser << uint64_t{n_ids};
+        auto ids = std::vector<cbdc::hash_t>();
+        ids.reserve(n_ids);
+        for(uint64_t idx = 0; idx < n_ids; idx++) {
+            ids.push_back(make_id(idx));
+            ser << ids.back();
+        }
+        if(!cbdc::locking_shard::uhs_preseed::write(sorted_file, ids)) {
+            logger->fatal("Failed to write preseed file");
+        }
+    }
+
+    for(const auto* file : {stream_file, sorted_file}) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto shard = cbdc::locking_shard::locking_shard(
+            cbdc::config::shard_range_t(0, 255),
+            logger,
+            1,
+            file,
+            cbdc::config::options());
+        auto secs = std::chrono::duration<double>(
+                        std::chrono::high_resolution_clock::now() - start)
+                        .count();
+
+        if(n_ids > 0
+           && (!*shard.check_unspent(make_id(0))
+               || !*shard.check_unspent(make_id(n_ids - 1)))) {
+            logger->fatal("Preseeded UHS IDs missing");
+        }
+        logger->info(file,
+                     ":",
+                     secs,
+                     "s,",
+                     static_cast<double>(n_ids) / secs,
+                     "UHS IDs/s");
+    }
+
+    std::filesystem::remove(stream_file);
+    std::filesystem::remove(sorted_file);
+}
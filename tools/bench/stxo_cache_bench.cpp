@@ -0,0 +1,102 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/atomizer/stxo_cache.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+/// Measures spent UHS ID cache lookup throughput with and without the
+/// per-height filters, and reports the filters' false positive rate for the
+/// given filter sizing.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 4) {
+        std::cerr << "Usage: " << args[0]
+                  << " <spends per height> <filter capacity> <lookup count>"
+                     " [<cache depth(default: 1)>]"
+                  << std::endl;
+        return -1;
+    }
+
+    const auto spends_per_height = std::stoull(args[1]);
+    const auto filter_capacity = std::stoull(args[2]);
+    const auto n_lookups = std::stoull(args[3]);
+    const auto depth = args.size() > 4
+                         ? std::stoull(args[4])
+                         : cbdc::config::defaults::stxo_cache_depth;
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    auto engine = std::mt19937_64();
+    auto make_id = [&]() {
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto val = engine();
+            std::memcpy(&id[i], &val, sizeof(val));
+        }
+        return id;
+    };
+
+    // Fill the cache over a few more heights than it retains so that both
+    // the table and the filters have been rotated.
+    const auto n_heights = depth + 2;
+    auto spent = std::vector<std::pair<cbdc::hash_t, uint64_t>>();
+    spent.reserve(spends_per_height * n_heights);
+    for(uint64_t h = 0; h < n_heights; h++) {
+        for(size_t i = 0; i < spends_per_height; i++) {
+            spent.emplace_back(make_id(), h);
+        }
+    }
+    auto lookups = std::vector<cbdc::hash_t>();
+    lookups.reserve(n_lookups);
+    for(size_t i = 0; i < n_lookups; i++) {
+        lookups.push_back(make_id());
+    }
+
+    auto run = [&](size_t capacity) {
+        auto cache = cbdc::atomizer::stxo_cache(capacity);
+        for(const auto& [id, h] : spent) {
+            cache.insert(id, h);
+            if(h > depth) {
+                cache.evict_below(h - depth);
+            }
+        }
+
+        size_t found{0};
+        auto start = std::chrono::high_resolution_clock::now();
+        for(const auto& id : lookups) {
+            found += cache.find(id).has_value() ? 1 : 0;
+        }
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        const auto secs = std::chrono::duration<double>(elapsed).count();
+
+        const auto& stats = cache.stats();
+        const auto negatives = stats.m_filtered + stats.m_false_positives;
+        logger->info("filter capacity:",
+                     capacity,
+                     ", entries:",
+                     cache.size(),
+                     ", lookups/s:",
+                     static_cast<double>(lookups.size()) / secs,
+                     ", false positive rate:",
+                     negatives == 0 ? 0.0
+                                    : static_cast<double>(
+                                        stats.m_false_positives)
+                                          / static_cast<double>(negatives),
+                     ", found:",
+                     found);
+    };
+
+    run(0);
+    run(filter_capacity);
+
+    return 0;
+}
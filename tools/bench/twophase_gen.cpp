@@ -9,6 +9,7 @@
 #include "uhs/transaction/wallet.hpp"
 #include "uhs/twophase/coordinator/client.hpp"
 #include "uhs/twophase/locking_shard/status_client.hpp"
+#include "util/common/blocking_queue.hpp"
 #include "util/common/config.hpp"
 #include "util/common/logging.hpp"
 #include "util/network/connection_manager.hpp"
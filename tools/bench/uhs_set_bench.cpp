@@ -0,0 +1,170 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util/common/config.hpp"
+#include "util/common/flat_hash_set.hpp"
+#include "util/common/hashmap.hpp"
+#include "util/common/logging.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+    /// Number of bytes allocated through \ref counting_allocator.
+    size_t allocated_bytes{};
+
+    /// Allocator that tracks the number of bytes allocated by a container.
+    template<typename T>
+    struct counting_allocator {
+        using value_type = T;
+
+        counting_allocator() = default;
+        template<typename U>
+        explicit counting_allocator(
+            const counting_allocator<U>& /* other */) {}
+
+        auto allocate(size_t n) -> T* {
+            allocated_bytes += n * sizeof(T);
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* p, size_t n) {
+            allocated_bytes -= n * sizeof(T);
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        auto operator==(const counting_allocator& /* rhs */) const -> bool {
+            return true;
+        }
+
+        auto operator!=(const counting_allocator& /* rhs */) const -> bool {
+            return false;
+        }
+    };
+}
+
+/// Compares the memory use and lookup throughput of the node-based UHS ID
+/// set used by the locking shard before flat_hash_set, and flat_hash_set.
+/// Memory use counts the bytes allocated by each set, excluding allocator
+/// overhead. Lookups alternate between UHS IDs in the set and UHS IDs not
+/// in the set.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 3) {
+        std::cerr << "Usage: " << args[0] << " <UHS ID count> <lookup count>"
+                  << std::endl;
+        return -1;
+    }
+
+    const auto n_ids = std::stoull(args[1]);
+    const auto n_lookups = std::stoull(args[2]);
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    auto make_id = [](uint64_t idx) {
+        // splitmix64 of the index, so that IDs are uniformly distributed
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto z = (idx * id.size() + i) + 0x9e3779b97f4a7c15;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            z ^= z >> 31;
+            std::memcpy(&id[i], &z, sizeof(z));
+        }
+        return id;
+    };
+
+    auto lookup_ids = std::vector<cbdc::hash_t>();
+    lookup_ids.reserve(n_lookups);
+    for(uint64_t i = 0; i < n_lookups; i++) {
+        // Even lookups hit, odd lookups miss
+        lookup_ids.push_back(
+            make_id(i % 2 == 0 ? (i / 2) % n_ids : n_ids + i));
+    }
+
+    auto secs_since = [](auto start) {
+        return std::chrono::duration<double>(
+                   std::chrono::high_resolution_clock::now() - start)
+            .count();
+    };
+
+    auto run = [&](const std::string& name,
+                   auto& set,
+                   const std::function<size_t()>& memory_usage,
+                   auto&& insert,
+                   auto&& contains) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for(uint64_t i = 0; i < n_ids; i++) {
+            insert(set, make_id(i));
+        }
+        const auto load_secs = secs_since(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        size_t found{};
+        for(const auto& id : lookup_ids) {
+            found += contains(set, id) ? 1 : 0;
+        }
+        const auto lookup_secs = secs_since(start);
+        if(found != (n_lookups + 1) / 2) {
+            logger->fatal(name, "found", found, "of", (n_lookups + 1) / 2);
+        }
+
+        logger->info(name,
+                     ":",
+                     static_cast<double>(memory_usage())
+                         / static_cast<double>(n_ids),
+                     "bytes/UHS ID,",
+                     static_cast<double>(n_ids) / load_secs,
+                     "inserts/s,",
+                     static_cast<double>(n_lookups) / lookup_secs,
+                     "lookups/s");
+    };
+
+    {
+        // Sized as the locking shard sized its set for preseeding
+        static constexpr auto uhs_size_factor = 2;
+        auto set = std::unordered_set<cbdc::hash_t,
+                                      cbdc::hashing::null,
+                                      std::equal_to<>,
+                                      counting_allocator<cbdc::hash_t>>();
+        set.max_load_factor(std::numeric_limits<float>::max());
+        set.rehash(n_ids * uhs_size_factor);
+        run(
+            "std::unordered_set",
+            set,
+            [&]() {
+                return allocated_bytes;
+            },
+            [](auto& s, const cbdc::hash_t& id) {
+                s.insert(id);
+            },
+            [](auto& s, const cbdc::hash_t& id) {
+                return s.find(id) != s.end();
+            });
+    }
+
+    {
+        auto set = cbdc::flat_hash_set(n_ids);
+        run(
+            "cbdc::flat_hash_set",
+            set,
+            [&]() {
+                return set.memory_usage();
+            },
+            [](auto& s, const cbdc::hash_t& id) {
+                s.insert(id);
+            },
+            [](auto& s, const cbdc::hash_t& id) {
+                return s.contains(id);
+            });
+    }
+
+    return 0;
+}
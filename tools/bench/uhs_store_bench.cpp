@@ -0,0 +1,125 @@
+// Copyright (c) 2021 MIT Digital Currency Initiative,
+//                    Federal Reserve Bank of Boston
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "uhs/atomizer/shard/leveldb_uhs_store.hpp"
+#include "uhs/atomizer/shard/memory_uhs_store.hpp"
+#include "util/common/config.hpp"
+#include "util/common/logging.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+/// Measures shard UHS ID lookup throughput of the LevelDB and memory-resident
+/// UHS stores. Loads the given number of UHS IDs into each store, then looks
+/// up transaction inputs of which half are unspent. UHS IDs are derived from
+/// their index so that they need not be held in memory, which allows loading
+/// 100M or more of them.
+auto main(int argc, char** argv) -> int {
+    auto args = cbdc::config::get_args(argc, argv);
+    if(args.size() < 3) {
+        std::cerr << "Usage: " << args[0]
+                  << " <UHS ID count> <lookup count>"
+                     " [<UHS IDs per block(default: 100000)>]"
+                  << std::endl;
+        return -1;
+    }
+
+    const auto n_ids = std::stoull(args[1]);
+    const auto n_lookups = std::stoull(args[2]);
+    static constexpr size_t default_block_size{100000};
+    const auto block_size
+        = args.size() > 3 ? std::stoull(args[3]) : default_block_size;
+
+    auto logger
+        = std::make_shared<cbdc::logging::log>(cbdc::logging::log_level::info);
+
+    auto make_id = [](uint64_t idx) {
+        // splitmix64 of the index, so that IDs are uniformly distributed
+        auto id = cbdc::hash_t();
+        for(size_t i = 0; i < id.size(); i += sizeof(uint64_t)) {
+            auto z = (idx * id.size() + i) + 0x9e3779b97f4a7c15;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            z ^= z >> 31;
+            std::memcpy(&id[i], &z, sizeof(z));
+        }
+        return id;
+    };
+
+    auto run = [&](const std::string& name, cbdc::shard::uhs_store& store) {
+        const auto dir = "uhs_store_bench_" + name;
+        std::filesystem::remove_all(dir);
+        if(auto err = store.open(dir)) {
+            logger->fatal("Failed to open", name, "store:", *err);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto height = uint64_t();
+        auto added = std::vector<cbdc::hash_t>();
+        for(uint64_t idx = 0; idx < n_ids;) {
+            added.clear();
+            for(; idx < n_ids && added.size() < block_size; idx++) {
+                added.push_back(make_id(idx));
+            }
+            if(!store.apply(++height, added, {})) {
+                logger->fatal("Failed to apply block", height);
+            }
+        }
+        auto secs = std::chrono::duration<double>(
+                        std::chrono::high_resolution_clock::now() - start)
+                        .count();
+        logger->info(name, "loaded", n_ids, "UHS IDs in", secs, "s");
+
+        // Look up transaction inputs as the shard does, with every other
+        // input not in the store
+        auto engine = std::mt19937_64();
+        const auto n_inputs = cbdc::config::defaults::input_count;
+        auto inputs = std::vector<cbdc::hash_t>(n_inputs);
+        auto found = std::vector<bool>();
+        auto n_found = size_t();
+        start = std::chrono::high_resolution_clock::now();
+        for(size_t i = 0; i < n_lookups; i += n_inputs) {
+            for(size_t j = 0; j < n_inputs; j++) {
+                auto idx = engine() % n_ids;
+                if(j % 2 == 1) {
+                    idx += n_ids;
+                }
+                inputs[j] = make_id(idx);
+            }
+            std::ignore = store.find(inputs, found);
+            for(auto f : found) {
+                n_found += f ? 1 : 0;
+            }
+        }
+        secs = std::chrono::duration<double>(
+                   std::chrono::high_resolution_clock::now() - start)
+                   .count();
+        logger->info(name,
+                     ":",
+                     static_cast<double>(n_lookups) / secs,
+                     "lookups/s,",
+                     n_found,
+                     "found");
+
+        std::filesystem::remove_all(dir);
+    };
+
+    {
+        auto store = cbdc::shard::leveldb_uhs_store();
+        run("leveldb", store);
+    }
+    {
+        // Checkpoint only once, after loading, so that the load time
+        // includes writing out the full set
+        auto store = cbdc::shard::memory_uhs_store(
+            (n_ids + block_size - 1) / block_size);
+        run("memory", store);
+    }
+
+    return 0;
+}
@@ -6,10 +6,10 @@
 #include "uhs/transaction/transaction.hpp"
 #include "uhs/transaction/validation.hpp"
 #include "uhs/transaction/wallet.hpp"
+#include "uhs/twophase/locking_shard/preseed.hpp"
 #include "util/common/config.hpp"
 #include "util/serialization/buffer_serializer.hpp"
 #include "util/serialization/format.hpp"
-#include "util/serialization/ostream_serializer.hpp"
 
 #include <algorithm>
 #include <chrono>
@@ -22,6 +22,10 @@ static constexpr int leveldb_buffer_size
     = 16 * 1024 * 1024; // 16MB can hold ~ 500K UHS_IDs
 static constexpr int write_batch_size
     = 450000; // well within the write buffer size
+// UHS IDs each 2PC shard thread sorts in memory before spilling them to a
+// temporary file, so seeding needs about 512MB per shard however many UHS
+// IDs it holds, plus disk space for a second copy of the preseed files
+static constexpr size_t preseed_buffer_ids = 1UL << 24;
 
 auto get_2pc_uhs_key(const cbdc::hash_t& uhs_id) -> std::string {
     auto ret = std::string();
@@ -74,20 +78,11 @@ auto main(int argc, char** argv) -> int {
     cbdc::transaction::wallet wal;
     wal.seed_readonly(witness_commitment, utxo_val, 0, num_utxos);
 
-    auto shard_range
-        = (std::numeric_limits<cbdc::config::shard_range_t::first_type>::max()
-           + 1)
-        / num_shards;
     auto gen_threads = std::vector<std::thread>(num_shards);
     for(size_t i = 0; i < num_shards; i++) {
         std::thread t(
             [&](size_t shard_idx) {
-                auto shard_start = shard_idx * shard_range;
-                auto shard_end = (shard_idx + 1) * shard_range - 1;
-                if(shard_idx == num_shards - 1) {
-                    shard_end = std::numeric_limits<
-                        cbdc::config::shard_range_t::first_type>::max();
-                }
+                const auto& shard_range = unique_ranges[shard_idx];
 
                 std::stringstream shard_db_dir;
                 if(cfg.m_twophase_mode) {
@@ -130,8 +125,8 @@ auto main(int argc, char** argv) -> int {
                         tx.m_inputs[0].m_prevout.m_index = tx_idx;
                         cbdc::transaction::compact_tx ctx(tx);
                         const cbdc::hash_t& output_hash = ctx.m_uhs_outputs[0];
-                        if(output_hash[0] >= shard_start
-                           && output_hash[0] <= shard_end) {
+                        if(cbdc::config::hash_in_shard_range(shard_range,
+                                                             output_hash)) {
                             std::array<char, sizeof(output_hash)> hash_arr{};
                             std::memcpy(hash_arr.data(),
                                         output_hash.data(),
@@ -152,25 +147,29 @@ auto main(int argc, char** argv) -> int {
                     }
                     logger.info("Shard ", shard_idx, " succesfully seeded");
                 } else if(cfg.m_twophase_mode) { // 2PC Shard
-                    auto out
-                        = std::ofstream(shard_db_dir.str(), std::ios::binary);
-                    size_t count = 0;
-                    // write dummy size
-                    auto ser = cbdc::ostream_serializer(out);
-                    ser << count;
+                    // Sorted, so that the shard can check and load the
+                    // preseed in parallel
+                    auto writer = cbdc::locking_shard::uhs_preseed_writer(
+                        shard_db_dir.str(),
+                        preseed_buffer_ids);
+                    auto ok = true;
                     auto tx = wal.create_seeded_transaction(0).value();
-                    for(size_t tx_idx = 0; tx_idx != num_utxos; tx_idx++) {
+                    for(size_t tx_idx = 0; ok && tx_idx != num_utxos;
+                        tx_idx++) {
                         tx.m_inputs[0].m_prevout.m_index = tx_idx;
                         cbdc::transaction::compact_tx ctx(tx);
                         const cbdc::hash_t& output_hash = ctx.m_uhs_outputs[0];
-                        if(output_hash[0] >= shard_start
-                           && output_hash[0] <= shard_end) {
-                            ser << output_hash;
-                            count++;
+                        if(cbdc::config::hash_in_shard_range(shard_range,
+                                                             output_hash)) {
+                            ok = writer.add(output_hash);
                         }
                     }
-                    ser.reset();
-                    ser << count;
+                    if(!ok || !writer.finish()) {
+                        logger.error("Failed to write preseed file ",
+                                     shard_db_dir.str());
+                        return;
+                    }
+                    logger.info("Shard ", shard_idx, " succesfully seeded");
                 }
             },
             i);